@@ -11,6 +11,7 @@
  * \date 2019
  * \copyright Interflop
  */
+#include <map>
 #include <vector>
 #include <string>
 
@@ -24,6 +25,11 @@
 #include "padloc/symbol_config.hpp"
 #include "padloc/padloc_client.h"
 #include "padloc/analyse.hpp"
+#include "padloc/profile.hpp"
+#include "padloc/samples.hpp"
+#include "padloc/roi.hpp"
+#include "padloc/trace.hpp"
+#include "padloc/persist.hpp"
 
 /**
  * \brief Callback called when a module is loaded
@@ -43,6 +49,38 @@ static void module_load_handler(void *drcontext, const module_data_t *module,
                                     should_instrument_module(module));
 }
 
+/**
+ * \brief Callback called when a module is unloaded
+ * 
+ * \param drcontext DynamoRIO's context
+ * \param module Module that has been unloaded
+ */
+static void module_unload_handler(void *drcontext, const module_data_t *module){
+    unload_module_lookup(module);
+}
+
+/**
+ * \brief Callback called when a module is loaded, when generating the symbols
+ * 
+ * \param drcontext DynamoRIO's context
+ * \param module Module that has been loaded
+ * \param loaded (Kept for backward compatibility, only set to true) 
+ * tells if the module is fully loaded 
+ */
+static void symbol_table_load_handler(void *drcontext, const module_data_t *module, bool loaded){
+    load_symbol_table(module);
+}
+
+/**
+ * \brief Callback called when a module is unloaded, when generating the symbols
+ * 
+ * \param drcontext DynamoRIO's context
+ * \param module Module that has been unloaded
+ */
+static void symbol_table_unload_handler(void *drcontext, const module_data_t *module){
+    unload_symbol_table(module);
+}
+
 /**
  * \brief Gather all the DynamoRIO packages and structure initializations
  * \details Contains the initialization of the following packages :
@@ -63,17 +101,20 @@ static void api_initialisation(){
     drreg_options.do_not_sum_slots = true;
     drreg_options.error_callback = NULL;
     drreg_init(&drreg_options);
+    plc_block_descriptors_init();
 }
 
 /**
  * \brief Gather all the TLS registers registration
- * \details Currently register 3 TLS fields, used for result,
- * GPR and FP registers.
+ * \details Currently register 3 TLS fields, used for the thread context
+ * (result), GPR and FP registers, and the TLS field of the profiler if the
+ * profiling mode is enabled.
  */
 static void tls_register(){
     set_index_tls_result(drmgr_register_tls_field());
     set_index_tls_float(drmgr_register_tls_field());
     set_index_tls_gpr(drmgr_register_tls_field());
+    plc_profile_init();
 }
 
 /**
@@ -88,28 +129,41 @@ static void event_exit(){
     if(get_symbol_mode() == PLC_SYMBOL_GENERATE){
         write_symbols_to_file();
     }
+    //If we were profiling, write the report
+    plc_profile_exit();
+    plc_samples_exit();
+    plc_trace_exit();
+    symbol_lookup_exit();
     //Exiting the api
     drreg_exit();
     drmgr_exit();
     drsym_exit();
+    plc_block_descriptors_exit();
+    plc_persist_exit();
     Interflop::verrou_end();
 }
 
+/**
+ * \brief Number of threads created so far, used as the index of the next thread
+ * \details Seeding the random generator of a thread from its creation index (rather than
+ * its thread id) keeps the runs reproducible for a given seed.
+ */
+static volatile int nb_threads = 0;
+
 /**
  * \brief Callback called when a thread is created
+ * \details Allocates the backend context of the thread, which holds its own
+ * random generator, and the TLS buffers of the thread, from a single cache line
+ * aligned arena whose thread context keeps the backend context.
  * 
  * \param dr_context Context of the created thread
  */
 static void thread_init(void *dr_context){
-    SET_TLS(dr_context, get_index_tls_result(), 
-        dr_thread_alloc(dr_context, 8));
-    SET_TLS(dr_context, get_index_tls_float(),
-            dr_thread_alloc(dr_context,
-                            AVX_512_SUPPORTED ? 64 * 32 
-                                              : AVX_SUPPORTED ? 32 * 16 
-                                                              : 16 * 16));
-    SET_TLS(dr_context, get_index_tls_gpr(),
-            dr_thread_alloc(dr_context, 17 * 8));
+    void *backend_context = dr_thread_alloc(dr_context, Interflop::verrou_thread_context_size());
+    Interflop::verrou_thread_prepare(backend_context, dr_atomic_add32_return_sum(&nb_threads, 1) - 1);
+
+    plc_thread_arena_init(dr_context, backend_context);
+    plc_profile_thread_init(dr_context);
 }
 
 
@@ -118,12 +172,99 @@ static void thread_init(void *dr_context){
  * \param dr_context Context of the exiting thread
  */
 static void thread_exit(void *dr_context){
-    dr_thread_free(dr_context, GET_TLS(dr_context, get_index_tls_result()), 8);
-    dr_thread_free(dr_context, GET_TLS(dr_context, get_index_tls_float()),
-                   AVX_512_SUPPORTED ? 64 * 32 : AVX_SUPPORTED ? 32 * 16 
-                                                               : 16 * 16);
-    dr_thread_free(dr_context, GET_TLS(dr_context, get_index_tls_gpr()),
-                   17 * 8);
+    plc_profile_thread_exit(dr_context);
+    dr_thread_free(dr_context, plc_get_thread_context(dr_context)->backend,
+                   Interflop::verrou_thread_context_size());
+    plc_thread_arena_exit(dr_context);
+}
+
+/**
+ * \brief Returns the profiling counter of \p instr
+ * \details The name of the symbol is looked up once per basic block, the
+ * first time a counter is needed
+ * 
+ * \param instr Instrumented instruction
+ * \param oc Operation category of \p instr
+ * \param symbol Name of the symbol of the basic block, empty if not looked up yet
+ * \return uint32_t Index of the counter
+ */
+static uint32_t profile_site(instr_t *instr, OPERATION_CATEGORY oc, std::string *symbol){
+    if(symbol->empty()){
+        *symbol = get_symbol_full_name(instr_get_app_pc(instr));
+    }
+    return plc_profile_site(*symbol, oc);
+}
+
+/**
+ * \brief Instruments the run of floating point instructions starting at
+ * \p first with a single call to the block dispatcher
+ * \details Used when the call mode is PLC_CALL_BLOCK. The registers are saved
+ * once, the dispatcher interprets the descriptor table of the whole run, then
+ * the registers are restored and the original instructions are removed.
+ * 
+ * \param drcontext DynamoRIO's context
+ * \param bb Linked list of instructions of the basic block
+ * \param first First instrumented instruction of the run
+ * \param nb Counter of instrumented instructions, for logging purposes
+ * \param symbol Name of the symbol of the basic block, for profiling purposes
+ * \param persistable Set to false if the descriptor of the run can't be persisted
+ * \return The first application instruction following the run
+ */
+static instr_t *instrument_run_batched(void *drcontext, instrlist_t *bb,
+                                       instr_t *first, int *nb, std::string *symbol,
+                                       bool *persistable){
+    plc_register_set_t regs;
+    plc_compute_register_set(bb, first, &regs);
+    const plc_block_desc_t *block = plc_get_block_descriptor(first, &regs);
+    if(!plc_persist_owns(block)){
+        *persistable = false;
+    }
+
+    bool profiling = plc_profile_enabled();
+
+    insert_save_gpr_and_flags(drcontext, bb, first, &regs);
+    if(profiling){
+        plc_profile_insert_timestamp(drcontext, bb, first, PLC_PROFILE_START);
+    }
+    insert_save_simd_registers(drcontext, bb, first, &regs);
+    if(profiling){
+        plc_profile_insert_timestamp(drcontext, bb, first, PLC_PROFILE_SAVE);
+        //A single increment per counter for the whole run
+        std::map<uint32_t, uint32_t> counts;
+        instr_t *instr = first;
+        for(uint32_t i = 0; i < block->count; i++, instr = instr_get_next_app(instr)){
+            counts[profile_site(instr, plc_get_operation_category(instr), symbol)]++;
+        }
+        for(const auto &count : counts){
+            plc_profile_insert_count(drcontext, bb, first, count.first, count.second, DR_SCRATCH_REG);
+        }
+    }
+    insert_restore_rsp(drcontext, bb, first);
+    translate_insert(XINST_CREATE_sub(drcontext, OP_REG(DR_REG_XSP),
+                                      OP_INT(32)), bb, first);
+    insert_block_call(drcontext, bb, first, block);
+    if(profiling){
+        plc_profile_insert_timestamp(drcontext, bb, first, PLC_PROFILE_BACKEND);
+    }
+    insert_restore_simd_registers(drcontext, bb, first, &regs);
+    if(profiling){
+        plc_profile_insert_timestamp(drcontext, bb, first, PLC_PROFILE_RESTORE);
+    }
+    insert_restore_gpr_and_flags(drcontext, bb, first, &regs);
+
+    // Remove the original instructions
+    instr_t *instr = first, *next_instr;
+    for(uint32_t i = 0; i < block->count; i++, instr = next_instr){
+        next_instr = instr_get_next_app(instr);
+        if(get_log_level() >= 1){
+            dr_printf("%d ", *nb);
+            dr_print_instr(drcontext, STDOUT, instr, ": ");
+        }
+        ++*nb;
+        instrlist_remove(bb, instr);
+        instr_destroy(drcontext, instr);
+    }
+    return instr;
 }
 
 /**
@@ -135,22 +276,37 @@ static void thread_exit(void *dr_context){
  * \param bb Linked list of instructions of the basic block
  * \param for_trace True if this callback is called for trace creation
  * \param translating True if this callback is called for address translation
- * \return dr_emit_flags_t DR_EMIT_DEFAULT
+ * \return dr_emit_flags_t DR_EMIT_PERSISTABLE in persist mode if the
+ * instrumentation only refers to persistable addresses, else DR_EMIT_DEFAULT
  */
 static dr_emit_flags_t app2app_bb_event(void *drcontext, void *tag,
                                         instrlist_t *bb, bool for_trace,
                                         bool translating){
     instr_t *instr, *next_instr;
     OPERATION_CATEGORY oc;
-    //Checks if we need to instrument this basic bloc based on the whitelist-blacklist
-    if(!needs_to_instrument(bb)){
-        return DR_EMIT_DEFAULT;
+    //The code inserted refers to the client and to the application by absolute addresses, which persist
+    bool persistable = plc_persist_enabled();
+    //Checks if we need to instrument this basic bloc based on the region of interest and the whitelist-blacklist
+    if(!plc_roi_active() || !needs_to_instrument(bb)){
+        return persistable ? DR_EMIT_PERSISTABLE : DR_EMIT_DEFAULT;
     }
     static int nb = 0;
+    bool profiling = plc_profile_enabled();
+    //Name of the symbol of the basic block, looked up when profiling
+    std::string symbol;
     for(instr = instrlist_first_app(bb); instr != NULL; instr = next_instr){
         oc = plc_get_operation_category(instr);
+        //An instruction which can't be described in a block descriptor gets its own backend call
+        const bool batched = get_call_mode() == PLC_CALL_BLOCK;
+        if(batched && (!plc_is_instrumented(oc) || plc_block_describable(instr))){
+            next_instr = plc_is_instrumented(oc)
+                ? instrument_run_batched(drcontext, bb, instr, &nb, &symbol, &persistable)
+                : instr_get_next_app(instr);
+            continue;
+        }
         bool registers_saved = false;
         bool should_continue = false;
+        plc_register_set_t regs;
 
         do{
             next_instr = instr_get_next_app(instr);
@@ -167,16 +323,32 @@ static dr_emit_flags_t app2app_bb_event(void *drcontext, void *tag,
 
                 //If the registers haven't been saved yet
                 if(!registers_saved){
-                    insert_save_gpr_and_flags(drcontext, bb, instr);
-                    insert_save_simd_registers(drcontext, bb, instr);
+                    //Only the registers needed by this run of instructions are saved
+                    plc_compute_register_set(bb, instr, &regs);
+                    insert_save_gpr_and_flags(drcontext, bb, instr, &regs);
+                    if(profiling){
+                        plc_profile_insert_timestamp(drcontext, bb, instr, PLC_PROFILE_START);
+                    }
+                    insert_save_simd_registers(drcontext, bb, instr, &regs);
+                    if(profiling){
+                        plc_profile_insert_timestamp(drcontext, bb, instr, PLC_PROFILE_SAVE);
+                    }
+                }
+
+                if(profiling){
+                    //OP_A is overwritten right after, by the destination
+                    plc_profile_insert_count(drcontext, bb, instr, profile_site(instr, oc, &symbol),
+                                             1, DR_REG_OP_A_ADDR);
                 }
 
                 //Make the result tls point to the correct location
                 insert_set_destination_tls(drcontext, bb, instr,
-                                           GET_REG(DST(instr, 0)));
+                                           GET_REG(DST(instr, 0)), &regs);
+                //Describe the masking and broadcast of AVX 512 instructions
+                insert_set_evex_control(drcontext, bb, instr, instr, oc);
 
                 //Setup the calling convention
-                insert_set_operands(drcontext, bb, instr, instr, oc);
+                insert_set_operands(drcontext, bb, instr, instr, oc, &regs);
 
                 if(!registers_saved){
                     //If it's the first instrumented instruction of the instrumented block, we need to setup rsp
@@ -186,15 +358,29 @@ static dr_emit_flags_t app2app_bb_event(void *drcontext, void *tag,
                                              OP_INT(32)), bb, instr);
                 }
                 registers_saved = true;
+                //If the operation turns out to be exact, the backend is skipped
+                //(the registers of the fast path are only saved in the per-instruction mode)
+                instr_t *fast_path_end = batched ? nullptr
+                                                 : insert_exact_fast_path(drcontext, bb,
+                                                                          instr, instr, oc, &regs);
                 //Insert the call to the function which corresponds to the instruction
                 insert_call(drcontext, bb, instr, oc, is_double);
+                if(fast_path_end != nullptr){
+                    instrlist_meta_preinsert(bb, instr, fast_path_end);
+                }
                 oc = plc_get_operation_category(next_instr);
-                should_continue = next_instr != nullptr &&
+                should_continue = !batched && next_instr != nullptr &&
                                   plc_is_instrumented(oc);
                 if(!should_continue){
                     //It's not a floating point operation
-                    insert_restore_simd_registers(drcontext, bb, instr);
-                    insert_restore_gpr_and_flags(drcontext, bb, instr);
+                    if(profiling){
+                        plc_profile_insert_timestamp(drcontext, bb, instr, PLC_PROFILE_BACKEND);
+                    }
+                    insert_restore_simd_registers(drcontext, bb, instr, &regs);
+                    if(profiling){
+                        plc_profile_insert_timestamp(drcontext, bb, instr, PLC_PROFILE_RESTORE);
+                    }
+                    insert_restore_gpr_and_flags(drcontext, bb, instr, &regs);
                 }
                 // Remove original instruction
                 instrlist_remove(bb, instr);
@@ -204,7 +390,7 @@ static dr_emit_flags_t app2app_bb_event(void *drcontext, void *tag,
             instr = next_instr;
         }while(should_continue);
     }
-    return DR_EMIT_DEFAULT;
+    return persistable ? DR_EMIT_PERSISTABLE : DR_EMIT_DEFAULT;
 }
 
 /**
@@ -251,10 +437,15 @@ static dr_emit_flags_t symbol_lookup_event(void *drcontext, void *tag,
  *  - exit event
  *  - thread init/exit event
  *  - instrumentation phase's function event
- *  - module load event
+ *  - module load/unload event
  *  - app2app phase's function event
+ *  - events of the Monte-Carlo sampling driver, if enabled
+ *  - events of the region of interest mode, if enabled
+ *  - events of the trace recorder, if enabled
+ * 
+ * \param id ID of the client
  */
-static void api_register(){
+static void api_register(client_id_t id){
     // Define the functions to be called before exiting this client program
     dr_register_exit_event(event_exit);
 
@@ -262,11 +453,18 @@ static void api_register(){
     drmgr_register_thread_exit_event(thread_exit);
 
     if(get_symbol_mode() == PLC_SYMBOL_GENERATE){
+        drmgr_register_module_load_event(symbol_table_load_handler);
+        drmgr_register_module_unload_event(symbol_table_unload_handler);
         drmgr_register_bb_instrumentation_event(symbol_lookup_event, NULL, NULL);
     }else{
         drmgr_register_module_load_event(module_load_handler);
+        drmgr_register_module_unload_event(module_unload_handler);
         drmgr_register_bb_app2app_event(app2app_bb_event, NULL);
     }
+
+    plc_samples_init();
+    plc_roi_init(id);
+    plc_trace_init();
 }
 
 /**
@@ -292,10 +490,12 @@ DR_EXPORT void dr_client_main(client_id_t id, // client ID
         return;
     }
 
-    api_register();
+    api_register(id);
 
     tls_register();
 
+    plc_persist_init(id, argc, argv);
+
     if(get_log_level() >= 2){
         print_register_vectors();
     }else if(get_log_level() == 1){
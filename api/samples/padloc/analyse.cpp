@@ -21,6 +21,11 @@
 #include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <sstream>
+#include <unordered_set>
+#ifdef LINUX
+#include <elf.h>
+#endif
 
 #include "analyse.hpp"
 #include "drsyms.h"
@@ -34,10 +39,53 @@
 static bool NEED_SSE_INVERSE = false;
 
 /**
- * This vector contains addresses and is used so that we don't follow each 
- * and every call when we already checked it once.
+ * This set contains the addresses of the blocks already analysed, so that
+ * we don't decode a block, or follow a call, more than once.
+ */
+static std::unordered_set<app_pc> visited_pcs;
+
+/**
+ * Directory of the analysis cache. If empty, the cache is put in the
+ * directory of the library.
+ */
+static std::string cache_directory;
+
+/**
+ * True if the analysis cache is used (default)
+ */
+static bool cache_enabled = true;
+
+/**
+ * First line of the analysis cache files, changed with their format
+ */
+static const char *ANALYSIS_CACHE_HEADER = "padloc_analysis 3";
+
+/**
+ * \struct analyse_block_t
+ * \brief Block waiting in the worklist of the backend analysis
  */
-static std::vector<app_pc> app_pc_vect;
+struct analyse_block_t{
+    /** Address of the first instruction of the block */
+    app_pc pc;
+    /** The tabulations for the block, used for display purposes */
+    int tabs;
+};
+
+/**
+ * Width in bytes of the widest part of a SIMD register modified by the
+ * backend : 16 if it only modifies the XMM part of the registers, 64 if
+ * it may modify or zero the upper parts. 0 if the backend wasn't analysed.
+ */
+static int simd_write_width = 0;
+
+/**
+ * True if the analysis followed every path of the backend, so that the
+ * registers found are all the registers it may modify. False if it met an
+ * indirect jump or call, a target outside of the library (such as a PLT stub
+ * or a function of another module) or a system call, or if the registers
+ * weren't found by the analysis of this run.
+ */
+static bool call_graph_resolved = false;
 
 /**
  * This vector contains the different GPR used by the backend.
@@ -66,6 +114,14 @@ std::vector<reg_id_t> get_float_reg(){
     return float_reg;
 }
 
+int get_simd_write_width(){
+    return simd_write_width;
+}
+
+bool get_call_graph_resolved(){
+    return call_graph_resolved;
+}
+
 std::vector<reg_id_t> get_all_registers(){
     std::vector<reg_id_t> ret;
 
@@ -204,6 +260,42 @@ static void add_to_vect(reg_id_t reg){
     }
 }
 
+/**
+ * \brief Returns the width of the part of the SIMD registers modified by an instruction
+ * \details Legacy SSE instructions only modify the XMM part of their destination.
+ * VEX and EVEX encoded instructions zero the upper part of the destination
+ * (up to the widest register of the processor), and so do vzeroupper and vzeroall.
+ * XMM16 to XMM31 can only be written by EVEX encoded instructions.
+ * 
+ * \param instr The instruction
+ * \return 0 if the instruction doesn't write SIMD registers, 16 if it only
+ * writes their XMM part, 64 otherwise
+ */
+static int simd_write_width_of(instr_t *instr){
+#if defined(X86)
+    if(instr_get_opcode(instr) == OP_vzeroupper || instr_get_opcode(instr) == OP_vzeroall){
+        return 64;
+    }
+    int width = 0;
+    for(int i = 0; i < instr_num_dsts(instr); ++i){
+        opnd_t operand = instr_get_dst(instr, i);
+        if(!opnd_is_reg(operand)){
+            continue;
+        }
+        reg_id_t reg = opnd_get_reg(operand);
+        if(reg_is_strictly_ymm(reg) || reg_is_strictly_zmm(reg) ||
+           (reg_is_strictly_xmm(reg) && (reg - DR_REG_START_XMM >= 16 || instr_zeroes_ymmh(instr)))){
+            return 64;
+        }else if(reg_is_strictly_xmm(reg)){
+            width = 16;
+        }
+    }
+    return width;
+#else
+    return 64;
+#endif
+}
+
 /**
  * \brief Fill the two vectors according to the registers used by
  * an instruction
@@ -254,109 +346,177 @@ static void fill_reg_vect(instr_t *instr){
         add_to_vect(reg1);
         add_to_vect(reg2);
     }
+
+    simd_write_width = std::max(simd_write_width, simd_write_width_of(instr));
+}
+
+/**
+ * \brief Adds a block to the worklist if it hasn't been analysed yet
+ * 
+ * \param worklist The worklist of the analysis
+ * \param pc Address of the first instruction of the block
+ * \param tabs The tabulations for the block, used for display purposes
+ * \return True if the block was added, false if it was already visited
+ */
+static bool push_block(std::vector<analyse_block_t> &worklist, app_pc pc, int tabs){
+    if(!visited_pcs.insert(pc).second){
+        return false;
+    }
+    worklist.push_back({pc, tabs});
+    return true;
+}
+
+/**
+ * \brief Records that the analysis can't follow a path of the backend
+ * \details The registers modified along that path are unknown, so the
+ * registers found by the analysis are not all the registers the backend
+ * may modify.
+ * 
+ * \param drcontext The current context
+ * \param instr The instruction whose target is unknown
+ * \param tabs The tabulations for the block, used for display purposes
+ */
+static void mark_unresolved(void *drcontext, instr_t *instr, int tabs){
+    if(get_log_level() >= 3){
+        print_tabs(tabs);
+        dr_print_instr(drcontext, STDOUT, instr, "UNRESOLVED TARGET : ");
+    }
+    call_graph_resolved = false;
+}
+
+/**
+ * \brief Adds the target of a direct jump or call to the worklist
+ * \details Targets outside of the library aren't analysed, they make the
+ * call graph unresolved.
+ * 
+ * \param drcontext The current context
+ * \param lib_data The module data corresponding to the backend library
+ * \param worklist The worklist of the analysis
+ * \param instr The jump or call
+ * \param tabs The tabulations for the target, used for display purposes
+ */
+static void push_target(void *drcontext, module_data_t *lib_data,
+                        std::vector<analyse_block_t> &worklist, instr_t *instr, int tabs){
+    opnd_t target = instr_get_target(instr);
+    if(!opnd_is_pc(target) || opnd_get_pc(target) < lib_data->start ||
+       opnd_get_pc(target) >= lib_data->end){
+        mark_unresolved(drcontext, instr, tabs);
+        return;
+    }
+    app_pc apc = opnd_get_pc(target);
+    if(push_block(worklist, apc, tabs)){
+        if(get_log_level() >= 3){
+            print_tabs(tabs);
+            dr_printf("Add the app_pc = %p to the worklist\n", apc);
+        }
+    }else if(get_log_level() >= 3){
+        print_tabs(tabs);
+        dr_printf("The app_pc = %p has already been checked\n", apc);
+    }
+}
+
+/**
+ * \brief Adds the registers any function may modify to the vectors
+ * \details Used when the analysis couldn't follow every path of the backend :
+ * the functions it didn't analyse may modify every caller-saved register of
+ * the SysV calling convention (RAX, RCX, RDX, RSI, RDI, R8 to R11 and all the
+ * SIMD registers, including their upper parts and the opmask registers).
+ */
+static void add_caller_saved_registers(){
+#if defined(X86) && defined(X64)
+    static const reg_id_t caller_saved_gpr[] = {DR_REG_RAX, DR_REG_RCX, DR_REG_RDX,
+                                                DR_REG_RSI, DR_REG_RDI, DR_REG_R8,
+                                                DR_REG_R9, DR_REG_R10, DR_REG_R11};
+    for(auto reg : caller_saved_gpr){
+        add_to_vect(reg);
+    }
+    for(reg_id_t reg = DR_REG_START_ZMM; reg <= DR_REG_STOP_ZMM; ++reg){
+        add_to_vect(reg);
+    }
+#endif
+    simd_write_width = 64;
 }
 
 /**
  * \brief Iterate through the instructions of a backend symbol to add the
  * registers used by each instruction to one of the two register vectors.
- * \details Recursive function which decodes the symbol at 
- * lib_data->start + offset as a list of instructions, iterate through it 
- * and call fill_reg_vect with each instruction. 
- * Also, follows each call in the symbol if the target app_pc
- * is not already in the app_pc vector, effectively instrumenting all the
- * functions used by the backend.
+ * \details Decodes the symbol at lib_data->start + offset as a list of
+ * instructions, iterate through it and call fill_reg_vect with each
+ * instruction. The blocks following each jump and call, as well as the
+ * targets of the direct jumps and calls, are pushed to a worklist,
+ * effectively analysing all the functions used by the backend. Each block is
+ * decoded at most once during the whole analysis, thanks to the visited_pcs
+ * set. Indirect jumps and calls, targets outside of the library and system
+ * calls can't be followed, they clear call_graph_resolved.
  * 
  * \param drcontext The current context
  * \param lib_data The module data corresponding to the backend library
  * \param offset The offset of a symbol from the start of the library
- * \param tabs The tabulations for the current function, used for display
- * purposes
  */
 static void show_instr_of_symbols(void *drcontext, module_data_t *lib_data,
-                                  size_t offset, int tabs){
-    /* Decodes the current symbol as a block of instructions */
-    instrlist_t *list_bb = decode_as_bb(drcontext, lib_data->start + offset);
-    instr_t *instr = nullptr, *next = nullptr;
-    app_pc apc = 0;
+                                  size_t offset){
+    std::vector<analyse_block_t> worklist;
+    push_block(worklist, lib_data->start + offset, 0);
 
-    for(instr = instrlist_first_app(list_bb); instr != NULL; instr = next){
-        next = instr_get_next_app(instr);
-        if(get_log_level() >= 3){
-            print_tabs(tabs);
-            dr_print_instr(drcontext, STDOUT, instr, "ENUM_SYMBOLS : ");
-        }
+    while(!worklist.empty()){
+        analyse_block_t block = worklist.back();
+        worklist.pop_back();
 
-        /* Fill the two vectors with the current instruction */
-        fill_reg_vect(instr);
-
-        /* If the instruction is a jump, it is also the last instruction of
-         * of the block, so if we stop there, the end of the symbol won't be
-         * instrumented. That means that have to skip the jump to continue 
-         * instrumenting, i.e we call show_instr_of_symbols with a new offset
-         * equal to : 
-         * current instruction's app_pc - app_pc of the start of the library
-         *                              + length of the current instruction
-         * This sum will actually put the offset at the instruction following
-         * the jump.
-         */
-        if(instr_is_ubr(instr) || instr_is_cbr(instr) ||
-           instr_get_opcode(instr) == OP_jmp_ind ||
-           instr_get_opcode(instr) == OP_jmp_far_ind){
-            show_instr_of_symbols(drcontext, lib_data,
-                                  instr_get_app_pc(instr)
-                                  - lib_data->start
-                                  + instr_length(drcontext, instr), tabs);
-        }
+        /* Decodes the current block as a list of instructions */
+        instrlist_t *list_bb = decode_as_bb(drcontext, block.pc);
+        instr_t *instr = nullptr, *next = nullptr;
 
-        /* If the instruction is a call, we have to follow it to it's
-         * destination so that we can instrument it too.
-         * Therefore, we have to get the operand and get the app_pc associated.
-         * If we already followed and went to the call target, that means we
-         * already instrumented the destination, and it is necessary to do
-         * so again. So to ensure that we don't check the same destination
-         * twice throughout the analysis, we add the target app_pc to a vector
-         * and check it when trying to follow a call.
-         */
-        if(instr_is_call(instr)){
-            apc = opnd_get_pc(instr_get_src(instr, 0));
-            if(std::find(app_pc_vect.begin(), app_pc_vect.end(), apc)
-               == app_pc_vect.end()){
-                /* If the target hasn't been checked already, 
-                 * add it to the vector.
-                 */
-                app_pc_vect.push_back(apc);
-                if(get_log_level() >= 3){
-                    print_tabs(tabs);
-                    dr_printf("Add the app_pc = %p to the vector\n", apc);
-                }
-                /* We have to follow the call, so we call show_instr_of_symbols
-                 * with a new offset of :
-                 * destination app_pc - app_pc of the start of the library
-                 * This simply put us at the start of the call symbol.
-                 */
-                show_instr_of_symbols(drcontext, lib_data,
-                                      apc - lib_data->start, tabs + 1);
-            }else{
-                if(get_log_level() >= 3){
-                    print_tabs(tabs);
-                    dr_printf("The app_pc = %p has already been checked\n",
-                              apc);
-                }
+        for(instr = instrlist_first_app(list_bb); instr != NULL; instr = next){
+            next = instr_get_next_app(instr);
+            if(get_log_level() >= 3){
+                print_tabs(block.tabs);
+                dr_print_instr(drcontext, STDOUT, instr, "ENUM_SYMBOLS : ");
             }
 
-            /* In the same way to have to call show_instr_of_symbols again
-             * when there is a jump to instrument the rest of the symbol,
-             * we also have to do it when a call is encountered, as it also
-             * finish the instruction block
+            /* Fill the two vectors with the current instruction */
+            fill_reg_vect(instr);
+
+            /* If the instruction is a jump, it is also the last instruction of
+             * of the block, so if we stop there, the end of the symbol won't be
+             * analysed. That means that have to skip the jump to continue,
+             * i.e we push the instruction following the jump to the worklist.
+             * The target of a direct jump is pushed too, as it may be a tail
+             * call to another function.
              */
-            show_instr_of_symbols(drcontext, lib_data,
-                                  instr_get_app_pc(instr)
-                                  - lib_data->start
-                                  + instr_length(drcontext, instr), tabs);
+            if(instr_is_ubr(instr) || instr_is_cbr(instr)){
+                push_target(drcontext, lib_data, worklist, instr, block.tabs);
+                push_block(worklist, instr_get_app_pc(instr)
+                                     + instr_length(drcontext, instr), block.tabs);
+            }else if(instr_get_opcode(instr) == OP_jmp_ind ||
+                     instr_get_opcode(instr) == OP_jmp_far_ind){
+                mark_unresolved(drcontext, instr, block.tabs);
+                push_block(worklist, instr_get_app_pc(instr)
+                                     + instr_length(drcontext, instr), block.tabs);
+            }
+
+            /* If the instruction is a call, we have to follow it to it's
+             * destination so that we can analyse it too. The target is only
+             * pushed if it hasn't been visited already, so that we don't
+             * check the same destination twice throughout the analysis.
+             * As a call also finishes the block, the instruction following
+             * the call is pushed too.
+             */
+            if(instr_is_call(instr)){
+                push_target(drcontext, lib_data, worklist, instr, block.tabs + 1);
+                push_block(worklist, instr_get_app_pc(instr)
+                                     + instr_length(drcontext, instr), block.tabs);
+            }
+
+            /* The kernel may modify registers on a system call (RCX and R11
+             * for syscall on X86_64)
+             */
+            if(instr_is_syscall(instr) || instr_is_interrupt(instr)){
+                mark_unresolved(drcontext, instr, block.tabs);
+            }
         }
+        /* When using decode_as_bb, we are to destroy the returned list */
+        instrlist_clear_and_destroy(drcontext, list_bb);
     }
-    /* When using decode_as_bb, we are to destroy the returned list */
-    instrlist_clear_and_destroy(drcontext, list_bb);
 }
 
 /**
@@ -463,29 +623,25 @@ static void write_reg_to_file(const char *path){
 }
 
 /**
- * \brief Read the content of an input file given by the path, and
- * populate the two vectors of registers.
- * \details Open the given path as an input file, reads each line and
- * populate the two vectors with each values.
+ * \brief Read the registers from an input stream, and populate the two
+ * given vectors of registers.
+ * \details Reads each line of the stream and populate the two vectors with
+ * each values.
  * 
- * \param path The path to the input file we read from.
+ * \param analyse_file The stream we read from
+ * \param gpr The vector of GPR to populate
+ * \param simd The vector of FP registers to populate
  * \return True if we have to stop the execution of the program because of
  * a failure, or false if everything went smoothly.
- * \todo In the "read_reg_from_file" function, when we detect an number,
+ * \todo In the "read_reg_from_stream" function, when we detect an number,
  * check if it is in the possible values for GPR and FP registers.
  */
-static bool read_reg_from_file(const char *path){
-    std::ifstream analyse_file;
+static bool read_reg_from_stream(std::istream &analyse_file, std::vector<reg_id_t> &gpr,
+                                 std::vector<reg_id_t> &simd){
     std::string buffer;
     int line_number = 0;
     bool float_vect = false;
 
-    analyse_file.open(path);
-    if(analyse_file.fail()){
-        dr_fprintf(STDERR, "FAILED TO OPEN THE GIVEN FILE FOR READING : \"%s\"\n",
-                   path);
-        return true;
-    }
     /* The file is supposed to be of the form :
      * "A
      * numbers
@@ -503,28 +659,242 @@ static bool read_reg_from_file(const char *path){
          * the gpr_reg vector. If it is "float_reg", they will populate
          * float_reg. If the line is a number, add it's cast to reg_id_t 
          * to the current vector selected. Else, the line is wrong, so we
-         * close the file and quit.
+         * quit.
          */
         if(buffer == "gpr_reg"){
             float_vect = false;
         }else if(buffer == "float_reg"){
             float_vect = true;
         }else if(is_number(buffer)){
-            (float_vect ? float_reg : gpr_reg).push_back((reg_id_t)std::stoi(buffer));
+            (float_vect ? simd : gpr).push_back((reg_id_t)std::stoi(buffer));
         }else{
             dr_fprintf(STDERR, "FAILED TO CORRECTLY READ THE FILE : Problem on file line %d = \"%s\"\n",
-                       line_number, buffer);
-            analyse_file.close();
+                       line_number, buffer.c_str());
             return true;
         }
         ++line_number;
     }
-    /* Everything went fine, so we close the file. Note that we assume the
-     * registers in the vectors are those we have to save for the current
-     * backend, so it is still possible that they're not the right registers.
+    return false;
+}
+
+/**
+ * \brief Read the content of an input file given by the path, and
+ * populate the two vectors of registers.
+ * \details Open the given path as an input file, and read it with
+ * read_reg_from_stream.
+ * 
+ * \param path The path to the input file we read from.
+ * \return True if we have to stop the execution of the program because of
+ * a failure, or false if everything went smoothly.
+ */
+static bool read_reg_from_file(const char *path){
+    std::ifstream analyse_file;
+
+    analyse_file.open(path);
+    if(analyse_file.fail()){
+        dr_fprintf(STDERR, "FAILED TO OPEN THE GIVEN FILE FOR READING : \"%s\"\n",
+                   path);
+        return true;
+    }
+    bool failed = read_reg_from_stream(analyse_file, gpr_reg, float_reg);
+    /* Note that we assume the registers in the vectors are those we have
+     * to save for the current backend, so it is still possible that they're
+     * not the right registers.
      */
     analyse_file.close();
-    return false;
+    return failed;
+}
+
+#ifdef LINUX
+#ifdef X64
+typedef Elf64_Ehdr plc_elf_ehdr_t;
+typedef Elf64_Phdr plc_elf_phdr_t;
+typedef Elf64_Nhdr plc_elf_nhdr_t;
+#else
+typedef Elf32_Ehdr plc_elf_ehdr_t;
+typedef Elf32_Phdr plc_elf_phdr_t;
+typedef Elf32_Nhdr plc_elf_nhdr_t;
+#endif
+
+/**
+ * \brief Get the GNU build-id of a loaded module, as an hexadecimal string
+ * \details Looks for the NT_GNU_BUILD_ID note in the PT_NOTE segments of the
+ * module, as mapped in memory.
+ * 
+ * \param lib_data The module data of the library
+ * \return The build-id, or an empty string if the module has none
+ */
+static std::string module_build_id(module_data_t *lib_data){
+    const plc_elf_ehdr_t *ehdr = (const plc_elf_ehdr_t *)lib_data->start;
+    if(memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0){
+        return "";
+    }
+    const plc_elf_phdr_t *phdr = (const plc_elf_phdr_t *)(lib_data->start + ehdr->e_phoff);
+
+    /* The notes are found at their virtual address, relative to the first
+     * loaded segment
+     */
+    app_pc load_delta = nullptr;
+    for(int i = 0; i < ehdr->e_phnum; i++){
+        if(phdr[i].p_type == PT_LOAD){
+            load_delta = lib_data->start - (phdr[i].p_vaddr & ~(ptr_uint_t)(dr_page_size() - 1));
+            break;
+        }
+    }
+
+    for(int i = 0; i < ehdr->e_phnum; i++){
+        if(phdr[i].p_type != PT_NOTE){
+            continue;
+        }
+        const byte *note = load_delta + phdr[i].p_vaddr;
+        const byte *note_end = note + phdr[i].p_memsz;
+        while(note + sizeof(plc_elf_nhdr_t) <= note_end){
+            const plc_elf_nhdr_t *nhdr = (const plc_elf_nhdr_t *)note;
+            const byte *name = note + sizeof(plc_elf_nhdr_t);
+            const byte *desc = name + ((nhdr->n_namesz + 3) & ~3u);
+            if(nhdr->n_type == NT_GNU_BUILD_ID && nhdr->n_namesz == 4 &&
+               memcmp(name, "GNU", 4) == 0){
+                std::ostringstream build_id;
+                build_id << std::hex;
+                for(size_t j = 0; j < nhdr->n_descsz; j++){
+                    build_id << (desc[j] >> 4) << (desc[j] & 0xf);
+                }
+                return build_id.str();
+            }
+            note = desc + ((nhdr->n_descsz + 3) & ~3u);
+        }
+    }
+    return "";
+}
+#endif
+
+/**
+ * \brief Get the key identifying the build of the library for the analysis cache
+ * \details The key is the GNU build-id of the library when there is one.
+ * Otherwise, it is a FNV-1a hash of the content of the library file.
+ * 
+ * \param path The path to the library
+ * \return The key, or an empty string if the library couldn't be read
+ */
+static std::string library_build_key(const char *path){
+#ifdef LINUX
+    module_data_t *lib_data = dr_lookup_module_by_name("libpadloc.so");
+    std::string build_id = module_build_id(lib_data);
+    dr_free_module_data(lib_data);
+    if(!build_id.empty()){
+        return build_id;
+    }
+#endif
+    std::ifstream library(path, std::ios::binary);
+    if(library.fail()){
+        return "";
+    }
+    uint64 hash = 0xcbf29ce484222325ULL;
+    char buffer[4096];
+    while(library.read(buffer, sizeof(buffer)) || library.gcount() > 0){
+        for(std::streamsize i = 0; i < library.gcount(); i++){
+            hash = (hash ^ (unsigned char)buffer[i]) * 0x100000001b3ULL;
+        }
+    }
+    std::ostringstream key;
+    key << "fnv" << std::hex << hash;
+    return key.str();
+}
+
+/**
+ * \brief Get the path of the analysis cache file of the library
+ * \details The file is named after the build key of the library, which
+ * identifies both the client and the backend linked in it, and the version of
+ * the DynamoRIO API the client was built with : a rebuild of either gives a
+ * new cache file. It is put in the cache directory, or next to the library if
+ * none was given.
+ * 
+ * \param path The path to the library
+ * \return The path of the cache file, or an empty string if the cache
+ * is disabled or the library couldn't be identified
+ */
+static std::string cache_file_path(const char *path){
+    if(!cache_enabled){
+        return "";
+    }
+    std::string key = library_build_key(path);
+    if(key.empty()){
+        return "";
+    }
+    std::string directory = cache_directory;
+    if(directory.empty()){
+        directory = path;
+        size_t separator = directory.find_last_of("/\\");
+        directory = separator == std::string::npos ? "." : directory.substr(0, separator);
+    }
+    std::ostringstream name;
+    name << directory << "/padloc_analysis_" << key << "_dr" << _USES_DR_VERSION_ << ".cache";
+    return name.str();
+}
+
+/**
+ * \brief Read the analysis cache file
+ * \details The cache file starts with ANALYSIS_CACHE_HEADER, the
+ * NEED_SSE_INVERSE boolean, the width of the SIMD writes of the backend and
+ * whether its call graph was resolved, followed by the registers in the
+ * format of read_reg_from_stream. Nothing is updated if the file can't be read.
+ * 
+ * \param file The path of the cache file
+ * \param with_registers True if the vectors of registers must be updated,
+ * false if only NEED_SSE_INVERSE is
+ * \return True if the cache was found and read
+ */
+static bool read_analysis_cache(const std::string &file, bool with_registers){
+    std::ifstream cache(file);
+    if(cache.fail()){
+        return false;
+    }
+    std::string header, sse_inverse, width, resolved;
+    std::vector<reg_id_t> gpr, simd;
+    if(!std::getline(cache, header) || header != ANALYSIS_CACHE_HEADER ||
+       !std::getline(cache, sse_inverse) || (sse_inverse != "0" && sse_inverse != "1") ||
+       !std::getline(cache, width) || !is_number(width) ||
+       !std::getline(cache, resolved) || (resolved != "0" && resolved != "1") ||
+       read_reg_from_stream(cache, gpr, simd)){
+        return false;
+    }
+    if(with_registers){
+        gpr_reg = gpr;
+        float_reg = simd;
+        simd_write_width = std::stoi(width);
+        call_graph_resolved = resolved == "1";
+    }
+    set_need_sse_inverse(sse_inverse == "1");
+    return true;
+}
+
+/**
+ * \brief Write the result of the analysis to the cache file
+ * \details The file is written under a temporary name then renamed, so that
+ * concurrent runs never read a partial cache.
+ * 
+ * \param file The path of the cache file
+ */
+static void write_analysis_cache(const std::string &file){
+    std::ostringstream tmp_name;
+    tmp_name << file << '.' << dr_get_process_id();
+    std::string tmp = tmp_name.str();
+
+    std::ofstream cache(tmp);
+    if(cache.fail()){
+        if(get_log_level() >= 2){
+            dr_fprintf(STDERR, "WARNING : Couldn't write the analysis cache \"%s\"\n", file.c_str());
+        }
+        return;
+    }
+    cache << ANALYSIS_CACHE_HEADER << '\n' << (get_need_sse_inverse() ? 1 : 0) << '\n'
+          << simd_write_width << '\n' << (call_graph_resolved ? 1 : 0) << '\n';
+    write_vect(cache, gpr_reg, "gpr_reg");
+    write_vect(cache, float_reg, "float_reg");
+    cache.close();
+    if(cache.fail() || !dr_rename_file(tmp.c_str(), file.c_str(), true)){
+        dr_delete_file(tmp.c_str());
+    }
 }
 
 /**
@@ -535,25 +905,25 @@ static bool read_reg_from_file(const char *path){
  * 
  * \param name The name of the symbol
  * \param modoffs The offset of the sybol from the start of the library
- * \param data Eventual data passed from the function that does the callback
+ * \param data The module data corresponding to the backend library
  * \return True if we want to continue going through the symbols
  */
 bool enum_symbols_registers(const char *name, size_t modoffs, void *data){
     void *drcontext = nullptr;
-    module_data_t *lib_data = nullptr;
+    module_data_t *lib_data = (module_data_t *)data;
 
     std::string str(name);
     /* We check whether the string contains "<>::apply" because that's the
      * name of the function we insert with dr_insert_call later. Therefore,
      * we consider it as our entry point to the backend, because it is the 
      * first function that shouldn't be called in the application.
+     * The block dispatcher is inserted the same way when the backend is
+     * called per block, and calls the "<>::apply" functions itself.
      */
-    if(str.find("<>::apply") != std::string::npos){
+    if(str.find("<>::apply") != std::string::npos ||
+       str.find("padloc_block_backend::apply") != std::string::npos){
         drcontext = dr_get_current_drcontext();
-        lib_data = dr_lookup_module_by_name("libpadloc.so");
-        show_instr_of_symbols(drcontext, lib_data, modoffs, 0);
-        /* As per DynamoRIO's API, we must free the module data */
-        dr_free_module_data(lib_data);
+        show_instr_of_symbols(drcontext, lib_data, modoffs);
     }
     return true;
 }
@@ -597,6 +967,31 @@ static void path_to_library(char *path, size_t length){
     dr_free_module_data(mdata);
 }
 
+/**
+ * \brief Enumerate through all the symbols of the library to analyse the backend
+ * 
+ * \param path The path to the library
+ * \return True if the analysis succeeded
+ */
+static bool analyse_backend(const char *path){
+    simd_write_width = 16;
+    call_graph_resolved = true;
+    module_data_t *lib_data = dr_lookup_module_by_name("libpadloc.so");
+    bool success = drsym_enumerate_symbols(path, enum_symbols_registers,
+                                           lib_data, DRSYM_DEFAULT_FLAGS) == DRSYM_SUCCESS;
+    /* As per DynamoRIO's API, we must free the module data */
+    dr_free_module_data(lib_data);
+    /* If nothing was found, the analysis can't tell anything about the SIMD writes */
+    if(!success || (gpr_reg.empty() && float_reg.empty())){
+        simd_write_width = 0;
+        call_graph_resolved = false;
+    }else if(!call_graph_resolved){
+        /* An indirect or unknown target may modify any caller-saved register */
+        add_caller_saved_registers();
+    }
+    return success;
+}
+
 /**
  * \brief Analyse the backend and put the content of the vectors in the
  * given file path/
@@ -609,8 +1004,7 @@ static void path_to_library(char *path, size_t length){
 static void AA_argument_detected(const char *file){
     char path[256];
     path_to_library(path, 256);
-    if(drsym_enumerate_symbols(path, enum_symbols_registers,
-                               NULL, DRSYM_DEFAULT_FLAGS) == DRSYM_SUCCESS){
+    if(analyse_backend(path)){
         write_reg_to_file(file);
     }else{
         dr_fprintf(STDERR,
@@ -652,6 +1046,19 @@ bool analyse_argument_parser(std::string arg, int *i, int argc, const char *argv
     }else if(arg == "--analyse_run" || arg == "-ar"){
         /* Do nothing, because the analysis will be done later. */
         return false;
+    }else if(arg == "--analyse_cache" || arg == "-ac"){
+        *i += 1;
+        if(*i < argc){
+            cache_directory = argv[*i];
+            return false;
+        }else{
+            dr_fprintf(STDERR,
+                       "ANALYSE FAILURE : Directory not given for \"-ac\"\n");
+            return true;
+        }
+    }else if(arg == "--analyse_no_cache" || arg == "-anc"){
+        cache_enabled = false;
+        return false;
     }else{
         /* If the argument is not one we know, increment the error counter */
         inc_error();
@@ -663,11 +1070,20 @@ void analyse_mode_manager(){
     char path[256];
     path_to_library(path, 256);
 
+    /* If this build of the library was already analysed, reuse the result */
+    std::string cache_file = cache_file_path(path);
+    if(!cache_file.empty() &&
+       read_analysis_cache(cache_file, get_analyse_mode() == PLC_ANALYSE_NEEDED)){
+        if(get_log_level() >= 1){
+            dr_printf("Backend analysis read from the cache \"%s\"\n", cache_file.c_str());
+        }
+        return;
+    }
+
     switch(get_analyse_mode()){
         case PLC_ANALYSE_NEEDED:
             /* Analyse the backend and update the vectors */
-            if(drsym_enumerate_symbols(path, enum_symbols_registers,
-                                       NULL, DRSYM_DEFAULT_FLAGS) != DRSYM_SUCCESS){
+            if(!analyse_backend(path)){
                 DR_ASSERT_MSG(false,
                               "ANALYSE FAILURE : Couldn't finish analysing the backend\n");
             }
@@ -689,6 +1105,13 @@ void analyse_mode_manager(){
                    "ANALYSE FAILURE : Couldn't finish analysing the symbols of the library\n");
     }
 #endif
+
+    /* The registers read from a file (-af) aren't the result of the
+     * analysis, so they are not cached
+     */
+    if(!cache_file.empty() && get_analyse_mode() == PLC_ANALYSE_NEEDED){
+        write_analysis_cache(cache_file);
+    }
 }
 
 /**
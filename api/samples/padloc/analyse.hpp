@@ -41,12 +41,28 @@ std::vector<reg_id_t> get_gpr_reg();
  */
 std::vector<reg_id_t> get_float_reg();
 
+/**
+ * \brief Getter for the width of the SIMD registers modified by the backend
+ * \return 16 if the backend only modifies the XMM part of the SIMD registers,
+ * 64 if it may modify their upper part, 0 if it is unknown (the backend
+ * wasn't analysed)
+ */
+int get_simd_write_width();
+
+/**
+ * \brief Getter for the completeness of the backend analysis
+ * \return True if the analysis of this run followed every path of the
+ * backend, so that the registers found are all the registers it may modify.
+ * False if it met an indirect jump or call, a target outside of the library
+ * or a system call, or if the registers were read from a file or weren't
+ * analysed.
+ */
+bool get_call_graph_resolved();
+
 /**
  * \brief Gather the gpr_reg and float_reg vectors into a single one,
  * containing all registers used by the backend
  * \return The combination of both vectors
- * \todo Actually use the vectors when we save the registers, instead
- * of saving everything.
  */
 std::vector<reg_id_t> get_all_registers();
 
@@ -71,6 +87,8 @@ void print_register_vectors_single();
  *      the vectors
  *      - "analyse and run", to analyse the backend and run the program
  *      normaly. Default option.
+ *      - "analyse cache", to choose the directory of the analysis cache
+ *      - "analyse no cache", to disable the analysis cache
  * 
  * \param arg The current argument as string
  * \param i The index of the current argument, given as pointer to be modified
@@ -88,6 +106,8 @@ bool analyse_argument_parser(std::string arg, int *i, int argc,
  * \details Call drsym_enumerate_symbols to analyse the backend if needed,
  * updating the vectors of registers. Also call drsym_enumerate_symbols
  * with the SSE analyser, in order to update NEED_SSE_INVERSE.
+ * Both results are read from the analysis cache instead when this build
+ * of the library was already analysed.
  * \todo Add sanity checks to verify if the result of functions is good,
  * instead of assuming they are (e.g, control that "dr_lookup_module_by_name"
  * returns no error).
@@ -23,18 +23,71 @@ namespace Interflop {
     /**
      * \brief Init verrou backend with the random rounding mode
      */
-    static void verrou_prepare(){
+    static inline void verrou_prepare(){
         interflop_verrou_init(&verrou_context);
         interflop_verrou_configure(VR_RANDOM, verrou_context);
     }
 
+    /**
+     * \brief Sets the rounding mode of verrou backend
+     * \details As the configuration of the backend, draws a new random seed
+     * 
+     * \param mode Rounding mode of the operations
+     */
+    static inline void verrou_set_rounding_mode(vr_RoundingMode mode){
+        interflop_verrou_configure(mode, verrou_context);
+    }
+
     /**
      * \brief End of use of verrou backend
      */
-    static void verrou_end(){
+    static inline void verrou_end(){
         interflop_verrou_finalyze(verrou_context);
     }
 
+    /**
+     * \brief Sets the seed of verrou backend, from which the per-thread contexts are seeded
+     * 
+     * \param seed New seed
+     */
+    static inline void verrou_set_seed(unsigned int seed){
+        ::verrou_set_seed(seed);
+    }
+
+    /**
+     * \brief Size of the per-thread context of verrou backend
+     */
+    static inline size_t verrou_thread_context_size(){
+        return ::verrou_thread_context_size();
+    }
+
+    /**
+     * \brief Init the per-thread context of verrou backend, which holds the random generator of the thread
+     * \details The generator is seeded from the seed of the backend and the index of the thread
+     * 
+     * \param context Context to init, of size verrou_thread_context_size()
+     * \param thread_index Index of the thread
+     */
+    static inline void verrou_thread_prepare(void *context, unsigned int thread_index){
+        verrou_thread_context_init(context, thread_index);
+    }
+
+
+    /**
+     * \brief Maximal number of elements of a packed operation (512 bits of single precision values)
+     */
+    static const int max_packed_elem = 16;
+
+    /**
+     * \brief Stores the opposite of the \p nb first elements of \p a in \p res
+     * \tparam PREC Floating Point precision
+     */
+    template<typename PREC>
+    static inline void negate_packed(const PREC *a, PREC *res, int nb){
+        for(int i = 0; i < nb; i++){
+            res[i] = -a[i];
+        }
+    }
 
     /**
      * \brief Class containing the implementations of the overloaded operations : add, sub, mul, div, fmadd, fmsub
@@ -58,10 +111,11 @@ namespace Interflop {
          * 
          * \param a First operand
          * \param b Second operand
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
          */
-        static double add(double a, double b){
+        static double add(double a, double b, void *context){
             double res;
-            interflop_verrou_add_double(a, b, &res, nullptr);
+            interflop_verrou_add_double(a, b, &res, context);
             return res;
         }
 
@@ -71,10 +125,11 @@ namespace Interflop {
          * 
          * \param a First operand
          * \param b Second operand
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
          */
-        static double sub(double a, double b){
+        static double sub(double a, double b, void *context){
             double res;
-            interflop_verrou_sub_double(a, b, &res, nullptr);
+            interflop_verrou_sub_double(a, b, &res, context);
             return res;
         }
 
@@ -84,10 +139,11 @@ namespace Interflop {
          * 
          * \param a First operand
          * \param b Second operand
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
          */
-        static double mul(double a, double b){
+        static double mul(double a, double b, void *context){
             double res;
-            interflop_verrou_mul_double(a, b, &res, nullptr);
+            interflop_verrou_mul_double(a, b, &res, context);
             return res;
         }
 
@@ -97,10 +153,11 @@ namespace Interflop {
          * 
          * \param a First operand
          * \param b Second operand
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
          */
-        static double div(double a, double b){
+        static double div(double a, double b, void *context){
             double res;
-            interflop_verrou_div_double(a, b, &res, nullptr);
+            interflop_verrou_div_double(a, b, &res, context);
             return res;
         }
 
@@ -111,16 +168,17 @@ namespace Interflop {
          * \param a First operand
          * \param b Second operand
          * \param c Third operand
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
          */
-        static double fmadd(double a, double b, double c){
+        static double fmadd(double a, double b, double c, void *context){
             double res;
 
             #ifdef USE_VERROU_FMA
-                interflop_verrou_madd_double(a, b, c, &res, nullptr);
+                interflop_verrou_madd_double(a, b, c, &res, context);
             #else
                 double coeff;
-                interflop_verrou_mul_double(a, b, &coeff, nullptr);
-                interflop_verrou_add_double(coeff, c, &res, nullptr);
+                interflop_verrou_mul_double(a, b, &coeff, context);
+                interflop_verrou_add_double(coeff, c, &res, context);
             #endif
 
             return res;
@@ -134,16 +192,17 @@ namespace Interflop {
          * \param a First operand
          * \param b Second operand
          * \param c Third operand
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
          */
-        static double fmsub(double a, double b, double c){
+        static double fmsub(double a, double b, double c, void *context){
             double res;
 
             #ifdef USE_VERROU_FMA
-                interflop_verrou_madd_double(a, b, -1*c, &res, nullptr);
+                interflop_verrou_madd_double(a, b, -1*c, &res, context);
             #else
                 double coeff;
-                interflop_verrou_mul_double(a, b, &coeff, nullptr);
-                interflop_verrou_sub_double(coeff, c, &res, nullptr);
+                interflop_verrou_mul_double(a, b, &coeff, context);
+                interflop_verrou_sub_double(coeff, c, &res, context);
             #endif
 
             return res;
@@ -156,16 +215,17 @@ namespace Interflop {
          * \param a First operand
          * \param b Second operand
          * \param c Third operand
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
          */
-        static double nfmadd(double a, double b, double c){
+        static double nfmadd(double a, double b, double c, void *context){
             double res;
 
             #ifdef USE_VERROU_FMA
-                interflop_verrou_madd_double(-a, b, c, &res, nullptr);
+                interflop_verrou_madd_double(-a, b, c, &res, context);
             #else
                 double coeff;
-                interflop_verrou_mul_double(a, b, &coeff, nullptr);
-                interflop_verrou_add_double(-coeff, c, &res, nullptr);
+                interflop_verrou_mul_double(a, b, &coeff, context);
+                interflop_verrou_add_double(-coeff, c, &res, context);
             #endif
             return res;
         }
@@ -178,20 +238,171 @@ namespace Interflop {
          * \param a First operand
          * \param b Second operand
          * \param c Third operand
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
          */
-        static double nfmsub(double a, double b, double c){
+        static double nfmsub(double a, double b, double c, void *context){
             double res;
 
             #ifdef USE_VERROU_FMA
-                interflop_verrou_madd_double(-a, b, -c, &res, nullptr);
+                interflop_verrou_madd_double(-a, b, -c, &res, context);
             #else
                 double coeff;
-                interflop_verrou_mul_double(a, b, &coeff, nullptr);
-                interflop_verrou_sub_double(-coeff, c, &res, nullptr);
+                interflop_verrou_mul_double(a, b, &coeff, context);
+                interflop_verrou_sub_double(-coeff, c, &res, context);
             #endif
 
             return res;
         }
+
+
+        /**
+         * \brief Packed add double precision : res[i] = a[i]+b[i]
+         * \details Redirection to verrou implementation, which computes the elements with vector kernels when available
+         * 
+         * \param a First operands
+         * \param b Second operands
+         * \param res Results, may alias \p a or \p b
+         * \param nb Number of elements
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
+         */
+        static void add_packed(const double *a, const double *b, double *res, int nb, void *context){
+            interflop_verrou_add_double_packed(a, b, res, nb, context);
+        }
+
+        /**
+         * \brief Packed sub double precision : res[i] = a[i]-b[i]
+         * \details Redirection to verrou implementation, which computes the elements with vector kernels when available
+         * 
+         * \param a First operands
+         * \param b Second operands
+         * \param res Results, may alias \p a or \p b
+         * \param nb Number of elements
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
+         */
+        static void sub_packed(const double *a, const double *b, double *res, int nb, void *context){
+            interflop_verrou_sub_double_packed(a, b, res, nb, context);
+        }
+
+        /**
+         * \brief Packed mul double precision : res[i] = a[i]*b[i]
+         * \details Redirection to verrou implementation, which computes the elements with vector kernels when available
+         * 
+         * \param a First operands
+         * \param b Second operands
+         * \param res Results, may alias \p a or \p b
+         * \param nb Number of elements
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
+         */
+        static void mul_packed(const double *a, const double *b, double *res, int nb, void *context){
+            interflop_verrou_mul_double_packed(a, b, res, nb, context);
+        }
+
+        /**
+         * \brief Packed div double precision : res[i] = a[i]/b[i]
+         * \details Redirection to verrou implementation, which computes the elements with vector kernels when available
+         * 
+         * \param a First operands
+         * \param b Second operands
+         * \param res Results, may alias \p a or \p b
+         * \param nb Number of elements
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
+         */
+        static void div_packed(const double *a, const double *b, double *res, int nb, void *context){
+            interflop_verrou_div_double_packed(a, b, res, nb, context);
+        }
+
+        /**
+         * \brief Packed fmadd double precision : res[i] = a[i]*b[i]+c[i]
+         * \details Same combination of verrou functions as fmadd, applied to the packed operands
+         * 
+         * \param a First operands
+         * \param b Second operands
+         * \param c Third operands
+         * \param res Results, may alias the operands
+         * \param nb Number of elements
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
+         */
+        static void fmadd_packed(const double *a, const double *b, const double *c, double *res, int nb, void *context){
+            #ifdef USE_VERROU_FMA
+                interflop_verrou_madd_double_packed(a, b, c, res, nb, context);
+            #else
+                double coeff[max_packed_elem];
+                interflop_verrou_mul_double_packed(a, b, coeff, nb, context);
+                interflop_verrou_add_double_packed(coeff, c, res, nb, context);
+            #endif
+        }
+
+        /**
+         * \brief Packed fmsub double precision : res[i] = a[i]*b[i]-c[i]
+         * \details Same combination of verrou functions as fmsub, applied to the packed operands
+         * 
+         * \param a First operands
+         * \param b Second operands
+         * \param c Third operands
+         * \param res Results, may alias the operands
+         * \param nb Number of elements
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
+         */
+        static void fmsub_packed(const double *a, const double *b, const double *c, double *res, int nb, void *context){
+            #ifdef USE_VERROU_FMA
+                double neg_c[max_packed_elem];
+                negate_packed(c, neg_c, nb);
+                interflop_verrou_madd_double_packed(a, b, neg_c, res, nb, context);
+            #else
+                double coeff[max_packed_elem];
+                interflop_verrou_mul_double_packed(a, b, coeff, nb, context);
+                interflop_verrou_sub_double_packed(coeff, c, res, nb, context);
+            #endif
+        }
+
+        /**
+         * \brief Packed nfmadd double precision : res[i] = -(a[i]*b[i])+c[i]
+         * \details Same combination of verrou functions as nfmadd, applied to the packed operands
+         * 
+         * \param a First operands
+         * \param b Second operands
+         * \param c Third operands
+         * \param res Results, may alias the operands
+         * \param nb Number of elements
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
+         */
+        static void nfmadd_packed(const double *a, const double *b, const double *c, double *res, int nb, void *context){
+            #ifdef USE_VERROU_FMA
+                double neg_a[max_packed_elem];
+                negate_packed(a, neg_a, nb);
+                interflop_verrou_madd_double_packed(neg_a, b, c, res, nb, context);
+            #else
+                double coeff[max_packed_elem];
+                interflop_verrou_mul_double_packed(a, b, coeff, nb, context);
+                negate_packed(coeff, coeff, nb);
+                interflop_verrou_add_double_packed(coeff, c, res, nb, context);
+            #endif
+        }
+
+        /**
+         * \brief Packed nfmsub double precision : res[i] = -(a[i]*b[i])-c[i]
+         * \details Same combination of verrou functions as nfmsub, applied to the packed operands
+         * 
+         * \param a First operands
+         * \param b Second operands
+         * \param c Third operands
+         * \param res Results, may alias the operands
+         * \param nb Number of elements
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
+         */
+        static void nfmsub_packed(const double *a, const double *b, const double *c, double *res, int nb, void *context){
+            #ifdef USE_VERROU_FMA
+                double neg_a[max_packed_elem], neg_c[max_packed_elem];
+                negate_packed(a, neg_a, nb);
+                negate_packed(c, neg_c, nb);
+                interflop_verrou_madd_double_packed(neg_a, b, neg_c, res, nb, context);
+            #else
+                double coeff[max_packed_elem];
+                interflop_verrou_mul_double_packed(a, b, coeff, nb, context);
+                negate_packed(coeff, coeff, nb);
+                interflop_verrou_sub_double_packed(coeff, c, res, nb, context);
+            #endif
+        }
     };
 
     /**
@@ -207,10 +418,11 @@ namespace Interflop {
          * 
          * \param a First operand
          * \param b Second operand
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
          */
-        static float add(float a, float b){
+        static float add(float a, float b, void *context){
             float res;
-            interflop_verrou_add_float(a, b, &res, nullptr);
+            interflop_verrou_add_float(a, b, &res, context);
             return res;
         }
 
@@ -220,10 +432,11 @@ namespace Interflop {
          * 
          * \param a First operand
          * \param b Second operand
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
          */
-        static float sub(float a, float b){
+        static float sub(float a, float b, void *context){
             float res;
-            interflop_verrou_sub_float(a, b, &res, nullptr);
+            interflop_verrou_sub_float(a, b, &res, context);
             return res;
         }
 
@@ -233,10 +446,11 @@ namespace Interflop {
          * 
          * \param a First operand
          * \param b Second operand
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
          */
-        static float mul(float a, float b){
+        static float mul(float a, float b, void *context){
             float res;
-            interflop_verrou_mul_float(a, b, &res, nullptr);
+            interflop_verrou_mul_float(a, b, &res, context);
             return res;
         }
 
@@ -247,10 +461,11 @@ namespace Interflop {
          * \param a First operand
          * \param b Second operand
          * 
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
          */
-        static float div(float a, float b){
+        static float div(float a, float b, void *context){
             float res;
-            interflop_verrou_div_float(a, b, &res, nullptr);
+            interflop_verrou_div_float(a, b, &res, context);
             return res;
         }
 
@@ -261,16 +476,17 @@ namespace Interflop {
          * \param a First operand
          * \param b Second operand
          * \param c Third operand
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
          */
-        static float fmadd(float a, float b, float c){
+        static float fmadd(float a, float b, float c, void *context){
             float res;
 
         #ifdef USE_VERROU_FMA
-            interflop_verrou_madd_float(a, b, c, &res, nullptr);
+            interflop_verrou_madd_float(a, b, c, &res, context);
         #else
             float coeff;
-            interflop_verrou_mul_float(a, b, &coeff, nullptr);
-            interflop_verrou_add_float(coeff, c, &res, nullptr);
+            interflop_verrou_mul_float(a, b, &coeff, context);
+            interflop_verrou_add_float(coeff, c, &res, context);
         #endif
 
             return res;
@@ -283,16 +499,17 @@ namespace Interflop {
          * \param a First operand
          * \param b Second operand
          * \param c Third operand
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
          */
-        static float fmsub(float a, float b, float c){
+        static float fmsub(float a, float b, float c, void *context){
             float res;
 
         #ifdef USE_VERROU_FMA
-            interflop_verrou_madd_float(a, b, -1*c, &res, nullptr);
+            interflop_verrou_madd_float(a, b, -1*c, &res, context);
         #else
             float coeff;
-            interflop_verrou_mul_float(a, b, &coeff, nullptr);
-            interflop_verrou_sub_float(coeff, c, &res, nullptr);
+            interflop_verrou_mul_float(a, b, &coeff, context);
+            interflop_verrou_sub_float(coeff, c, &res, context);
         #endif
 
             return res;
@@ -305,16 +522,17 @@ namespace Interflop {
          * \param a First operand
          * \param b Second operand
          * \param c Third operand
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
          */
-        static float nfmadd(float a, float b, float c){
+        static float nfmadd(float a, float b, float c, void *context){
             float res;
 
         #ifdef USE_VERROU_FMA
-            interflop_verrou_madd_float(-a, b, c, &res, nullptr);
+            interflop_verrou_madd_float(-a, b, c, &res, context);
         #else
             float coeff;
-            interflop_verrou_mul_float(a, b, &coeff, nullptr);
-            interflop_verrou_add_float(-coeff, c, &res, nullptr);
+            interflop_verrou_mul_float(a, b, &coeff, context);
+            interflop_verrou_add_float(-coeff, c, &res, context);
         #endif
             return res;
         }
@@ -326,20 +544,171 @@ namespace Interflop {
          * \param a First operand
          * \param b Second operand
          * \param c Third operand
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
          */
-        static float nfmsub(float a, float b, float c){
+        static float nfmsub(float a, float b, float c, void *context){
             float res;
 
         #ifdef USE_VERROU_FMA
-            interflop_verrou_madd_float(-a, b, -c, &res, nullptr);
+            interflop_verrou_madd_float(-a, b, -c, &res, context);
         #else
             float coeff;
-            interflop_verrou_mul_float(a, b, &coeff, nullptr);
-            interflop_verrou_sub_float(-coeff, c, &res, nullptr);
+            interflop_verrou_mul_float(a, b, &coeff, context);
+            interflop_verrou_sub_float(-coeff, c, &res, context);
         #endif
 
             return res;
         }
+
+
+        /**
+         * \brief Packed add single precision : res[i] = a[i]+b[i]
+         * \details Redirection to verrou implementation, which computes the elements with vector kernels when available
+         * 
+         * \param a First operands
+         * \param b Second operands
+         * \param res Results, may alias \p a or \p b
+         * \param nb Number of elements
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
+         */
+        static void add_packed(const float *a, const float *b, float *res, int nb, void *context){
+            interflop_verrou_add_float_packed(a, b, res, nb, context);
+        }
+
+        /**
+         * \brief Packed sub single precision : res[i] = a[i]-b[i]
+         * \details Redirection to verrou implementation, which computes the elements with vector kernels when available
+         * 
+         * \param a First operands
+         * \param b Second operands
+         * \param res Results, may alias \p a or \p b
+         * \param nb Number of elements
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
+         */
+        static void sub_packed(const float *a, const float *b, float *res, int nb, void *context){
+            interflop_verrou_sub_float_packed(a, b, res, nb, context);
+        }
+
+        /**
+         * \brief Packed mul single precision : res[i] = a[i]*b[i]
+         * \details Redirection to verrou implementation, which computes the elements with vector kernels when available
+         * 
+         * \param a First operands
+         * \param b Second operands
+         * \param res Results, may alias \p a or \p b
+         * \param nb Number of elements
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
+         */
+        static void mul_packed(const float *a, const float *b, float *res, int nb, void *context){
+            interflop_verrou_mul_float_packed(a, b, res, nb, context);
+        }
+
+        /**
+         * \brief Packed div single precision : res[i] = a[i]/b[i]
+         * \details Redirection to verrou implementation, which computes the elements with vector kernels when available
+         * 
+         * \param a First operands
+         * \param b Second operands
+         * \param res Results, may alias \p a or \p b
+         * \param nb Number of elements
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
+         */
+        static void div_packed(const float *a, const float *b, float *res, int nb, void *context){
+            interflop_verrou_div_float_packed(a, b, res, nb, context);
+        }
+
+        /**
+         * \brief Packed fmadd single precision : res[i] = a[i]*b[i]+c[i]
+         * \details Same combination of verrou functions as fmadd, applied to the packed operands
+         * 
+         * \param a First operands
+         * \param b Second operands
+         * \param c Third operands
+         * \param res Results, may alias the operands
+         * \param nb Number of elements
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
+         */
+        static void fmadd_packed(const float *a, const float *b, const float *c, float *res, int nb, void *context){
+            #ifdef USE_VERROU_FMA
+                interflop_verrou_madd_float_packed(a, b, c, res, nb, context);
+            #else
+                float coeff[max_packed_elem];
+                interflop_verrou_mul_float_packed(a, b, coeff, nb, context);
+                interflop_verrou_add_float_packed(coeff, c, res, nb, context);
+            #endif
+        }
+
+        /**
+         * \brief Packed fmsub single precision : res[i] = a[i]*b[i]-c[i]
+         * \details Same combination of verrou functions as fmsub, applied to the packed operands
+         * 
+         * \param a First operands
+         * \param b Second operands
+         * \param c Third operands
+         * \param res Results, may alias the operands
+         * \param nb Number of elements
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
+         */
+        static void fmsub_packed(const float *a, const float *b, const float *c, float *res, int nb, void *context){
+            #ifdef USE_VERROU_FMA
+                float neg_c[max_packed_elem];
+                negate_packed(c, neg_c, nb);
+                interflop_verrou_madd_float_packed(a, b, neg_c, res, nb, context);
+            #else
+                float coeff[max_packed_elem];
+                interflop_verrou_mul_float_packed(a, b, coeff, nb, context);
+                interflop_verrou_sub_float_packed(coeff, c, res, nb, context);
+            #endif
+        }
+
+        /**
+         * \brief Packed nfmadd single precision : res[i] = -(a[i]*b[i])+c[i]
+         * \details Same combination of verrou functions as nfmadd, applied to the packed operands
+         * 
+         * \param a First operands
+         * \param b Second operands
+         * \param c Third operands
+         * \param res Results, may alias the operands
+         * \param nb Number of elements
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
+         */
+        static void nfmadd_packed(const float *a, const float *b, const float *c, float *res, int nb, void *context){
+            #ifdef USE_VERROU_FMA
+                float neg_a[max_packed_elem];
+                negate_packed(a, neg_a, nb);
+                interflop_verrou_madd_float_packed(neg_a, b, c, res, nb, context);
+            #else
+                float coeff[max_packed_elem];
+                interflop_verrou_mul_float_packed(a, b, coeff, nb, context);
+                negate_packed(coeff, coeff, nb);
+                interflop_verrou_add_float_packed(coeff, c, res, nb, context);
+            #endif
+        }
+
+        /**
+         * \brief Packed nfmsub single precision : res[i] = -(a[i]*b[i])-c[i]
+         * \details Same combination of verrou functions as nfmsub, applied to the packed operands
+         * 
+         * \param a First operands
+         * \param b Second operands
+         * \param c Third operands
+         * \param res Results, may alias the operands
+         * \param nb Number of elements
+         * \param context Backend context of the calling thread (see verrou_thread_context_init), nullptr for the default one
+         */
+        static void nfmsub_packed(const float *a, const float *b, const float *c, float *res, int nb, void *context){
+            #ifdef USE_VERROU_FMA
+                float neg_a[max_packed_elem], neg_c[max_packed_elem];
+                negate_packed(a, neg_a, nb);
+                negate_packed(c, neg_c, nb);
+                interflop_verrou_madd_float_packed(neg_a, b, neg_c, res, nb, context);
+            #else
+                float coeff[max_packed_elem];
+                interflop_verrou_mul_float_packed(a, b, coeff, nb, context);
+                negate_packed(coeff, coeff, nb);
+                interflop_verrou_sub_float_packed(coeff, c, res, nb, context);
+            #endif
+        }
     };
 }
 
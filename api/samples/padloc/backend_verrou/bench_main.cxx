@@ -0,0 +1,388 @@
+/*
+   Throughput benchmark of the verrou backend operators, without DynamoRIO.
+
+   Every operator interflop_verrou_{add,sub,mul,div,madd}_{float,double} is
+   applied to arrays of operands following several distributions, in every
+   rounding mode. The time per operation and, when the perf counters are
+   available, the branch miss rate are reported.
+
+   usage : ./bench_main [-n nb_operands] [-r repetitions] [-o file.csv]
+                        [-m mode_name] [-d distribution]
+*/
+
+#include "interflop_verrou.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+// * branch counters
+// the branch instructions and misses of the user code are counted by a group
+// of perf events. When perf_event_open is not allowed, the rates are reported
+// as n/a.
+struct BranchCounters {
+  int fdInstructions=-1;
+  int fdMisses=-1;
+
+  bool available() const {
+    return fdInstructions>=0 && fdMisses>=0;
+  }
+
+#ifdef __linux__
+  static int open(unsigned long long config, int group){
+    struct perf_event_attr attr;
+    memset(&attr,0,sizeof(attr));
+    attr.type=PERF_TYPE_HARDWARE;
+    attr.size=sizeof(attr);
+    attr.config=config;
+    attr.disabled= group<0 ? 1 : 0;
+    attr.exclude_kernel=1;
+    attr.exclude_hv=1;
+    return (int)syscall(__NR_perf_event_open,&attr,0,-1,group,0);
+  }
+
+  BranchCounters(){
+    fdInstructions=open(PERF_COUNT_HW_BRANCH_INSTRUCTIONS,-1);
+    if(fdInstructions>=0){
+      fdMisses=open(PERF_COUNT_HW_BRANCH_MISSES,fdInstructions);
+    }
+  }
+
+  ~BranchCounters(){
+    if(fdMisses>=0) close(fdMisses);
+    if(fdInstructions>=0) close(fdInstructions);
+  }
+
+  void start(){
+    if(!available()) return;
+    ioctl(fdInstructions,PERF_EVENT_IOC_RESET,PERF_IOC_FLAG_GROUP);
+    ioctl(fdInstructions,PERF_EVENT_IOC_ENABLE,PERF_IOC_FLAG_GROUP);
+  }
+
+  // returns the branch miss rate since start, or a negative value
+  double stop(){
+    if(!available()) return -1.;
+    ioctl(fdInstructions,PERF_EVENT_IOC_DISABLE,PERF_IOC_FLAG_GROUP);
+    unsigned long long instructions=0, misses=0;
+    if(read(fdInstructions,&instructions,sizeof(instructions))!=sizeof(instructions) ||
+       read(fdMisses,&misses,sizeof(misses))!=sizeof(misses) || instructions==0){
+      return -1.;
+    }
+    return (double)misses/(double)instructions;
+  }
+#else
+  void start(){}
+  double stop(){ return -1.; }
+#endif
+};
+
+
+
+// * handlers
+// the backend calls the nan handler for every NaN result, which happens with
+// the nan_inf distribution : the NaNs are counted instead of reported
+static unsigned long long nbNan=0;
+
+static void countNan(){
+  nbNan++;
+}
+
+static void panic(const char* msg){
+  fprintf(stderr,"verrou panic : %s\n",msg);
+  exit(1);
+}
+
+
+
+// * operand distributions
+enum Distribution {
+  DIST_EXACT,      // small integers : the results are exact, except some divisions
+  DIST_RANDOM,     // random signs and exponents : the results are inexact
+  DIST_CANCELLING, // operands of opposite values : catastrophic cancellations
+  DIST_DENORMAL,   // subnormal operands and results
+  DIST_NAN_INF,    // NaN and infinities mixed with normal values
+  DIST_NB
+};
+
+static const char* distributionName[DIST_NB]={"exact","random","cancelling","denormal","nan_inf"};
+
+enum Operation { OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MADD, OP_NB };
+
+static const char* operationName[OP_NB]={"add","sub","mul","div","madd"};
+
+
+template<class REALTYPE>
+struct Operands {
+  std::vector<REALTYPE> a, b, c, res;
+
+  // fills the operands of the operation op, so that the distribution applies
+  // to its result : the cancelling operands of a sub are equal, those of an
+  // add are opposite
+  void fill(Distribution dist, Operation op, size_t nb, std::mt19937_64& gen){
+    a.resize(nb); b.resize(nb); c.resize(nb); res.assign(nb,0);
+    std::uniform_real_distribution<REALTYPE> unit(1,2);
+    std::uniform_int_distribution<int> exponent(-20,20);
+    std::uniform_int_distribution<int> integer(1,1000);
+    std::uniform_int_distribution<int> coin(0,1);
+    std::uniform_int_distribution<int> special(0,7);
+    const REALTYPE eps=std::numeric_limits<REALTYPE>::epsilon();
+    const REALTYPE denormMin=std::numeric_limits<REALTYPE>::denorm_min();
+    const REALTYPE nan=std::numeric_limits<REALTYPE>::quiet_NaN();
+    const REALTYPE inf=std::numeric_limits<REALTYPE>::infinity();
+
+    for(size_t i=0; i<nb; i++){
+      REALTYPE sign= coin(gen) ? 1 : -1;
+      switch(dist){
+      case DIST_EXACT:
+        a[i]=(REALTYPE)integer(gen);
+        b[i]=(REALTYPE)integer(gen);
+        c[i]=(REALTYPE)integer(gen);
+        break;
+      case DIST_RANDOM:
+        a[i]=sign*std::ldexp(unit(gen),exponent(gen));
+        b[i]=(coin(gen) ? 1 : -1)*std::ldexp(unit(gen),exponent(gen));
+        c[i]=(coin(gen) ? 1 : -1)*std::ldexp(unit(gen),exponent(gen));
+        break;
+      case DIST_CANCELLING:{
+        a[i]=sign*unit(gen);
+        REALTYPE close=a[i]*(1+(REALTYPE)integer(gen)*eps);
+        b[i]= (op==OP_SUB) ? close : -close;
+        // a*b+c cancels when c is close to -a*b
+        c[i]=-a[i]*b[i]*(1+(REALTYPE)integer(gen)*eps);
+        break;
+      }
+      case DIST_DENORMAL:
+        a[i]=sign*denormMin*(REALTYPE)integer(gen);
+        b[i]=(op==OP_MUL || op==OP_MADD) ? unit(gen)/2 : (op==OP_DIV ? unit(gen)*2 : denormMin*(REALTYPE)integer(gen));
+        c[i]=denormMin*(REALTYPE)integer(gen);
+        break;
+      case DIST_NAN_INF:
+        // one operand out of four is special
+        a[i]=sign*unit(gen);
+        b[i]=unit(gen);
+        c[i]=unit(gen);
+        switch(special(gen)){
+        case 0: a[i]=nan; break;
+        case 1: b[i]=sign*inf; break;
+        default: break;
+        }
+        break;
+      default:
+        break;
+      }
+    }
+  }
+};
+
+
+// * operators
+template<class REALTYPE> struct Backend;
+
+template<> struct Backend<double> {
+  static const char* name(){ return "double"; }
+  static void (*binary(Operation op))(double,double,double*,void*){
+    switch(op){
+    case OP_ADD: return &interflop_verrou_add_double;
+    case OP_SUB: return &interflop_verrou_sub_double;
+    case OP_MUL: return &interflop_verrou_mul_double;
+    default:     return &interflop_verrou_div_double;
+    }
+  }
+  static void madd(double a, double b, double c, double* res, void* context){
+    interflop_verrou_madd_double(a,b,c,res,context);
+  }
+};
+
+template<> struct Backend<float> {
+  static const char* name(){ return "float"; }
+  static void (*binary(Operation op))(float,float,float*,void*){
+    switch(op){
+    case OP_ADD: return &interflop_verrou_add_float;
+    case OP_SUB: return &interflop_verrou_sub_float;
+    case OP_MUL: return &interflop_verrou_mul_float;
+    default:     return &interflop_verrou_div_float;
+    }
+  }
+  static void madd(float a, float b, float c, float* res, void* context){
+    interflop_verrou_madd_float(a,b,c,res,context);
+  }
+};
+
+
+// the loops call the operators of the backend one element at a time, as the
+// stubs of PADLOC do
+template<class REALTYPE>
+static void runOnce(Operation op, Operands<REALTYPE>& x, void* context){
+  const size_t nb=x.a.size();
+  const REALTYPE* a=x.a.data();
+  const REALTYPE* b=x.b.data();
+  const REALTYPE* c=x.c.data();
+  REALTYPE* res=x.res.data();
+  if(op==OP_MADD){
+    for(size_t i=0; i<nb; i++){
+      Backend<REALTYPE>::madd(a[i],b[i],c[i],res+i,context);
+    }
+  }else{
+    void (*fct)(REALTYPE,REALTYPE,REALTYPE*,void*)=Backend<REALTYPE>::binary(op);
+    for(size_t i=0; i<nb; i++){
+      fct(a[i],b[i],res+i,context);
+    }
+  }
+}
+
+
+struct Config {
+  size_t nb=1<<20;
+  int repetitions=5;
+  const char* csv=NULL;
+  int mode=-1;
+  int dist=-1;
+};
+
+struct Result {
+  double nsPerOp;
+  double missRate;
+};
+
+template<class REALTYPE>
+static Result measure(Operation op, Distribution dist, const Config& config,
+                      void* context, BranchCounters& counters){
+  std::mt19937_64 gen(42+op*DIST_NB+dist);
+  Operands<REALTYPE> x;
+  x.fill(dist,op,config.nb,gen);
+
+  // warm up the caches and the branch predictors
+  runOnce<REALTYPE>(op,x,context);
+
+  // the fastest repetition is kept
+  Result best={std::numeric_limits<double>::infinity(),-1.};
+  for(int r=0; r<config.repetitions; r++){
+    counters.start();
+    auto start=std::chrono::steady_clock::now();
+    runOnce<REALTYPE>(op,x,context);
+    double ns=std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now()-start).count();
+    double missRate=counters.stop();
+    if(ns<best.nsPerOp*config.nb){
+      best.nsPerOp=ns/config.nb;
+      best.missRate=missRate;
+    }
+  }
+  return best;
+}
+
+
+static void report(FILE* csv, vr_RoundingMode mode, Operation op, const char* type,
+                   Distribution dist, const Config& config, const Result& result){
+  char rate[32];
+  if(result.missRate<0){
+    snprintf(rate,sizeof(rate),"n/a");
+  }else{
+    snprintf(rate,sizeof(rate),"%.4f",result.missRate);
+  }
+  printf("%-9s %-5s %-7s %-11s %9.2f ns/op  %s branch misses/branch\n",
+         verrou_rounding_mode_name(mode),operationName[op],type,distributionName[dist],
+         result.nsPerOp,rate);
+  if(csv!=NULL){
+    fprintf(csv,"%s,%s,%s,%s,%zu,%.3f,%s\n",verrou_rounding_mode_name(mode),operationName[op],
+            type,distributionName[dist],config.nb,result.nsPerOp,rate);
+  }
+}
+
+
+static void usage(const char* prog){
+  fprintf(stderr,"usage : %s [-n nb_operands] [-r repetitions] [-o file.csv] [-m mode] [-d distribution]\n",prog);
+  exit(1);
+}
+
+int main(int argc, char** argv){
+  Config config;
+  for(int i=1; i<argc; i++){
+    if(i+1>=argc) usage(argv[0]);
+    if(strcmp(argv[i],"-n")==0){
+      config.nb=strtoul(argv[++i],NULL,10);
+    }else if(strcmp(argv[i],"-r")==0){
+      config.repetitions=atoi(argv[++i]);
+    }else if(strcmp(argv[i],"-o")==0){
+      config.csv=argv[++i];
+    }else if(strcmp(argv[i],"-m")==0){
+      const char* name=argv[++i];
+      for(int m=VR_NEAREST; m<=VR_NATIVE; m++){
+        if(strcmp(name,verrou_rounding_mode_name((vr_RoundingMode)m))==0) config.mode=m;
+      }
+      if(config.mode<0) usage(argv[0]);
+    }else if(strcmp(argv[i],"-d")==0){
+      const char* name=argv[++i];
+      for(int d=0; d<DIST_NB; d++){
+        if(strcmp(name,distributionName[d])==0) config.dist=d;
+      }
+      if(config.dist<0) usage(argv[0]);
+    }else{
+      usage(argv[0]);
+    }
+  }
+  if(config.nb==0 || config.repetitions<=0) usage(argv[0]);
+
+  FILE* csv=NULL;
+  if(config.csv!=NULL){
+    csv=fopen(config.csv,"w");
+    if(csv==NULL){
+      perror(config.csv);
+      return 1;
+    }
+    fprintf(csv,"mode,operation,type,distribution,operations,ns_per_op,branch_miss_rate\n");
+  }
+
+  void* backendContext;
+  interflop_verrou_init(&backendContext);
+  verrou_set_nan_handler(&countNan);
+  verrou_set_panic_handler(&panic);
+
+  // the operators are given a per-thread context, as in PADLOC
+  std::vector<char> threadContext(verrou_thread_context_size());
+
+  BranchCounters counters;
+  if(!counters.available()){
+    fprintf(stderr,"perf counters unavailable : branch miss rates not measured\n");
+  }
+
+  for(int m=VR_NEAREST; m<=VR_NATIVE; m++){
+    if(config.mode>=0 && m!=config.mode) continue;
+    vr_RoundingMode mode=(vr_RoundingMode)m;
+    interflop_verrou_configure(mode,backendContext);
+    // fixed seed, so that two runs draw the same random roundings
+    verrou_set_seed(1);
+    verrou_thread_context_init(threadContext.data(),0);
+
+    for(int o=0; o<OP_NB; o++){
+      Operation op=(Operation)o;
+      for(int d=0; d<DIST_NB; d++){
+        if(config.dist>=0 && d!=config.dist) continue;
+        Distribution dist=(Distribution)d;
+        report(csv,mode,op,Backend<double>::name(),dist,config,
+               measure<double>(op,dist,config,threadContext.data(),counters));
+        report(csv,mode,op,Backend<float>::name(),dist,config,
+               measure<float>(op,dist,config,threadContext.data(),counters));
+      }
+    }
+  }
+
+  interflop_verrou_finalyze(backendContext);
+  if(csv!=NULL){
+    fclose(csv);
+  }
+  return 0;
+}
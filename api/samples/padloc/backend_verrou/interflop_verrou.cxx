@@ -45,6 +45,7 @@
 
 #include "vr_roundingOp.hxx"
 #include "vr_op.hxx"
+#include "vr_op_simd.hxx"
 #include "interflop_backend_interface.h"
 
 
@@ -129,7 +130,7 @@ void verrou_end_instr(){
 }
 
 void verrou_set_seed (unsigned int seed) {
-  vr_seed = vr_rand_int (&vr_rand);
+  vr_seed = seed;
   vr_rand_setSeed (&vr_rand, seed);
 }
 
@@ -139,6 +140,15 @@ void verrou_set_random_seed () {
   //vr_rand_setSeed(&vr_rand, vr_seed);
 }
 
+size_t verrou_thread_context_size () {
+  return sizeof(Vr_Rand);
+}
+
+void verrou_thread_context_init (void* context, unsigned int thread_index) {
+  //Stream 0 is used by the default generator
+  vr_rand_setSeedStream ((Vr_Rand*)context, vr_seed, thread_index + 1);
+}
+
 void IFV_FCTNAME(add_double) (double a, double b, double* res,void* context) {
   typedef OpWithSelectedRoundingMode<AddOp <double>,double > Op;
   Op::apply(Op::PackArgs(a,b),res,context);
@@ -196,10 +206,64 @@ void IFV_FCTNAME(madd_float) (float a, float b, float c, float* res, void* conte
 
 
 
+// * Packed operations
+void IFV_FCTNAME(add_double_packed) (const double* a, const double* b, double* res, int nb, void* context) {
+  const double* args[2]={a,b};
+  OpPacked<AddOp <double> >::apply(args,res,nb,context);
+}
+
+void IFV_FCTNAME(add_float_packed) (const float* a, const float* b, float* res, int nb, void* context) {
+  const float* args[2]={a,b};
+  OpPacked<AddOp <float> >::apply(args,res,nb,context);
+}
+
+void IFV_FCTNAME(sub_double_packed) (const double* a, const double* b, double* res, int nb, void* context) {
+  const double* args[2]={a,b};
+  OpPacked<SubOp <double> >::apply(args,res,nb,context);
+}
+
+void IFV_FCTNAME(sub_float_packed) (const float* a, const float* b, float* res, int nb, void* context) {
+  const float* args[2]={a,b};
+  OpPacked<SubOp <float> >::apply(args,res,nb,context);
+}
+
+void IFV_FCTNAME(mul_double_packed) (const double* a, const double* b, double* res, int nb, void* context) {
+  const double* args[2]={a,b};
+  OpPacked<MulOp <double> >::apply(args,res,nb,context);
+}
+
+void IFV_FCTNAME(mul_float_packed) (const float* a, const float* b, float* res, int nb, void* context) {
+  const float* args[2]={a,b};
+  OpPacked<MulOp <float> >::apply(args,res,nb,context);
+}
+
+void IFV_FCTNAME(div_double_packed) (const double* a, const double* b, double* res, int nb, void* context) {
+  const double* args[2]={a,b};
+  OpPacked<DivOp <double> >::apply(args,res,nb,context);
+}
+
+void IFV_FCTNAME(div_float_packed) (const float* a, const float* b, float* res, int nb, void* context) {
+  const float* args[2]={a,b};
+  OpPacked<DivOp <float> >::apply(args,res,nb,context);
+}
+
+void IFV_FCTNAME(madd_double_packed) (const double* a, const double* b, const double* c, double* res, int nb, void* context){
+  const double* args[3]={a,b,c};
+  OpPacked<MAddOp <double> >::apply(args,res,nb,context);
+}
+
+void IFV_FCTNAME(madd_float_packed) (const float* a, const float* b, const float* c, float* res, int nb, void* context){
+  const float* args[3]={a,b,c};
+  OpPacked<MAddOp <float> >::apply(args,res,nb,context);
+}
+
 
 struct interflop_backend_interface_t IFV_FCTNAME(init)(void ** context){
   struct interflop_backend_interface_t config;
 
+  //Operations use the default generator, unless given a thread context
+  *context = NULL;
+
   config.interflop_add_float = & IFV_FCTNAME(add_float);
   config.interflop_sub_float = & IFV_FCTNAME(sub_float);
   config.interflop_mul_float = & IFV_FCTNAME(mul_float);
@@ -40,6 +40,8 @@ extern "C" {
 #endif
 #define IFV_FCTNAME(FCT) interflop_verrou_##FCT
 
+#include <stddef.h>
+
 #include "interflop_backend_interface.h"
 
 
@@ -73,6 +75,13 @@ extern "C" {
   void verrou_set_seed (unsigned int seed);
   void verrou_set_random_seed (void);
 
+  /* Per-thread context : holds the random generator of a thread, seeded
+     from the current seed and the thread index. It can be given as the
+     context of the operations instead of NULL, which selects the shared
+     default generator. */
+  size_t verrou_thread_context_size (void);
+  void verrou_thread_context_init (void* context, unsigned int thread_index);
+
   extern void (*vr_panicHandler)(const char*);
   void verrou_set_panic_handler(void (*)(const char*));
   extern void (*vr_nanHandler)(void);
@@ -97,6 +106,21 @@ extern "C" {
   void IFV_FCTNAME(madd_double)(double a, double b, double c, double* res, void* context);
   void IFV_FCTNAME(madd_float) (float a,  float b,  float c,  float*  res, void* context);
 
+  /* Packed versions : res[i] = op(a[i], b[i]) for i < nb. res may alias the
+     arguments. With the random rounding mode, the elements are computed by
+     vector kernels when the backend is compiled with AVX2 and FMA or AVX-512. */
+  void IFV_FCTNAME(add_double_packed) (const double* a, const double* b, double* res, int nb, void* context);
+  void IFV_FCTNAME(add_float_packed)  (const float*  a, const float*  b, float*  res, int nb, void* context);
+  void IFV_FCTNAME(sub_double_packed) (const double* a, const double* b, double* res, int nb, void* context);
+  void IFV_FCTNAME(sub_float_packed)  (const float*  a, const float*  b, float*  res, int nb, void* context);
+  void IFV_FCTNAME(mul_double_packed) (const double* a, const double* b, double* res, int nb, void* context);
+  void IFV_FCTNAME(mul_float_packed)  (const float*  a, const float*  b, float*  res, int nb, void* context);
+  void IFV_FCTNAME(div_double_packed) (const double* a, const double* b, double* res, int nb, void* context);
+  void IFV_FCTNAME(div_float_packed)  (const float*  a, const float*  b, float*  res, int nb, void* context);
+
+  void IFV_FCTNAME(madd_double_packed)(const double* a, const double* b, const double* c, double* res, int nb, void* context);
+  void IFV_FCTNAME(madd_float_packed) (const float*  a, const float*  b, const float*  c, float*  res, int nb, void* context);
+
   
 #ifdef __cplusplus
 }
@@ -0,0 +1,401 @@
+/*
+   Offline replay of the floating point operation traces recorded by PADLOC
+   (-rt option), without DynamoRIO.
+
+   Every recorded operation is recomputed by the operators of the client in the
+   selected rounding modes, with several seeds for the random modes, and its
+   result is compared to the IEEE result in rounding to nearest. The
+   sensitivity of each instruction is reported : number of elements, number
+   of elements whose result changed, mean and max relative difference. The
+   operations are replayed independently, the differences aren't propagated.
+
+   The rounding mode of the backend is a global of the process : the
+   (mode, seed) jobs run in forked worker processes, at most -j at a time,
+   which send their statistics to the parent through a pipe.
+
+   usage : ./replay_main [-m mode_name[,mode_name...]] [-s nb_seeds] [-j jobs]
+                         [-o file.csv] trace.plct [trace.plct...]
+*/
+
+#include "interflop_verrou.h"
+#include "../backend/backend.hxx"
+#include "../trace_format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef HAS_ZLIB
+#include <zlib.h>
+#endif
+
+
+// * handlers
+static void ignoreNan(){
+}
+
+static void panic(const char* msg){
+  fprintf(stderr,"verrou panic : %s\n",msg);
+  exit(1);
+}
+
+
+// * traces
+static const char* operationName[PLC_TRACE_NB_OPS]={"add","sub","mul","div","fmadd","fmsub","nfmadd","nfmsub"};
+
+// records of every trace file, decompressed. The workers inherit them at fork.
+static std::vector<std::vector<char>> traces;
+
+static bool readExactly(FILE* file, void* data, size_t size){
+  return fread(data,1,size,file)==size;
+}
+
+static bool loadTrace(const char* path){
+  FILE* file=fopen(path,"rb");
+  if(file==NULL){
+    perror(path);
+    return false;
+  }
+  plc_trace_header_t header;
+  if(!readExactly(file,&header,sizeof(header)) || header.magic!=PLC_TRACE_MAGIC || header.version!=PLC_TRACE_VERSION){
+    fprintf(stderr,"%s : not a PADLOC trace of version %d\n",path,PLC_TRACE_VERSION);
+    fclose(file);
+    return false;
+  }
+  std::vector<char> records;
+  std::vector<char> stored;
+  plc_trace_chunk_t chunk;
+  while(readExactly(file,&chunk,sizeof(chunk))){
+    stored.resize(chunk.stored_size);
+    if(!readExactly(file,stored.data(),chunk.stored_size)){
+      fprintf(stderr,"%s : truncated chunk\n",path);
+      fclose(file);
+      return false;
+    }
+    size_t offset=records.size();
+    records.resize(offset+chunk.raw_size);
+    if(chunk.stored_size==chunk.raw_size){
+      memcpy(records.data()+offset,stored.data(),chunk.raw_size);
+      continue;
+    }
+#ifdef HAS_ZLIB
+    uLongf rawSize=chunk.raw_size;
+    if(uncompress((Bytef*)records.data()+offset,&rawSize,(const Bytef*)stored.data(),chunk.stored_size)!=Z_OK
+       || rawSize!=chunk.raw_size){
+      fprintf(stderr,"%s : corrupted chunk\n",path);
+      fclose(file);
+      return false;
+    }
+#else
+    fprintf(stderr,"%s : compressed chunk, rebuild with HAS_ZLIB\n",path);
+    fclose(file);
+    return false;
+#endif
+  }
+  fclose(file);
+  traces.push_back(std::move(records));
+  return true;
+}
+
+
+// * replay
+// statistics of one instruction, in one rounding mode
+struct Stats {
+  unsigned long long elements=0;
+  unsigned long long changed=0;
+  double sumRelDiff=0.;
+  double maxRelDiff=0.;
+
+  void add(double result, double reference){
+    elements++;
+    if(memcmp(&result,&reference,sizeof(double))==0) return;
+    changed++;
+    double diff=std::fabs(result-reference);
+    double relDiff=reference==0. ? diff : diff/std::fabs(reference);
+    // NaNs and infinities differ from everything, they don't weigh on the mean
+    if(!std::isfinite(relDiff)) return;
+    sumRelDiff+=relDiff;
+    if(relDiff>maxRelDiff) maxRelDiff=relDiff;
+  }
+
+  void merge(const Stats& other){
+    elements+=other.elements;
+    changed+=other.changed;
+    sumRelDiff+=other.sumRelDiff;
+    if(other.maxRelDiff>maxRelDiff) maxRelDiff=other.maxRelDiff;
+  }
+};
+
+// key of the statistics : the instruction and its operation
+typedef std::pair<uint64_t,int> Key;
+typedef std::map<Key,Stats> StatsMap;
+
+// the operations are computed by the operators of the client, fused or not
+// depending on USE_VERROU_FMA
+template<class REALTYPE>
+static REALTYPE compute(int op, REALTYPE a, REALTYPE b, REALTYPE c, void* context){
+  typedef Interflop::Op<REALTYPE> Op;
+  switch(op){
+  case PLC_TRACE_ADD: return Op::add(a,b,context);
+  case PLC_TRACE_SUB: return Op::sub(a,b,context);
+  case PLC_TRACE_MUL: return Op::mul(a,b,context);
+  case PLC_TRACE_DIV: return Op::div(a,b,context);
+  case PLC_TRACE_FMADD: return Op::fmadd(a,b,c,context);
+  case PLC_TRACE_FMSUB: return Op::fmsub(a,b,c,context);
+  case PLC_TRACE_NFMADD: return Op::nfmadd(a,b,c,context);
+  default: return Op::nfmsub(a,b,c,context);
+  }
+}
+
+// IEEE result, the fused operations being rounded once
+template<class REALTYPE>
+static REALTYPE reference(int op, REALTYPE a, REALTYPE b, REALTYPE c){
+  switch(op){
+  case PLC_TRACE_ADD: return a+b;
+  case PLC_TRACE_SUB: return a-b;
+  case PLC_TRACE_MUL: return a*b;
+  case PLC_TRACE_DIV: return a/b;
+  case PLC_TRACE_FMADD: return std::fma(a,b,c);
+  case PLC_TRACE_FMSUB: return std::fma(a,b,-c);
+  case PLC_TRACE_NFMADD: return std::fma(-a,b,c);
+  default: return std::fma(-a,b,-c);
+  }
+}
+
+template<class REALTYPE>
+static void replayRecord(const plc_trace_record_t* record, void* context, Stats& stats){
+  const REALTYPE* a=(const REALTYPE*)(record+1);
+  const REALTYPE* b=a+record->nb_elem;
+  const REALTYPE* c=b+record->nb_elem;
+  for(int i=0; i<record->nb_elem; i++){
+    REALTYPE cElem=record->nb_srcs>2 ? c[i] : (REALTYPE)0;
+    REALTYPE res=compute<REALTYPE>(record->op,a[i],b[i],cElem,context);
+    stats.add((double)res,(double)reference<REALTYPE>(record->op,a[i],b[i],cElem));
+  }
+}
+
+static void replayTraces(vr_RoundingMode mode, unsigned int seed, StatsMap& statsMap){
+  void* backendContext;
+  interflop_verrou_init(&backendContext);
+  verrou_set_nan_handler(&ignoreNan);
+  verrou_set_panic_handler(&panic);
+  interflop_verrou_configure(mode,backendContext);
+  // configure draws a random seed : the seed of the job is set afterwards
+  verrou_set_seed(seed);
+  std::vector<char> threadContext(verrou_thread_context_size());
+
+  for(size_t t=0; t<traces.size(); t++){
+    // one random stream per trace, as per thread in the client
+    verrou_thread_context_init(threadContext.data(),(unsigned int)t);
+    const char* ptr=traces[t].data();
+    const char* end=ptr+traces[t].size();
+    while(ptr+sizeof(plc_trace_record_t)<=end){
+      const plc_trace_record_t* record=(const plc_trace_record_t*)ptr;
+      if(record->op>=PLC_TRACE_NB_OPS || ptr+PLC_TRACE_RECORD_SIZE(record)>end){
+        fprintf(stderr,"trace %zu : corrupted record\n",t);
+        break;
+      }
+      Stats& stats=statsMap[Key(record->pc,record->op)];
+      if(record->is_double){
+        replayRecord<double>(record,threadContext.data(),stats);
+      }else{
+        replayRecord<float>(record,threadContext.data(),stats);
+      }
+      ptr+=PLC_TRACE_RECORD_SIZE(record);
+    }
+  }
+  interflop_verrou_finalyze(backendContext);
+}
+
+
+// * jobs
+struct Job {
+  vr_RoundingMode mode;
+  unsigned int seed;
+  pid_t pid;
+  int fd;
+};
+
+// the statistics go through the pipe as raw (key, stats) pairs
+struct Entry {
+  uint64_t pc;
+  int op;
+  Stats stats;
+};
+
+static void writeAll(int fd, const void* data, size_t size){
+  const char* ptr=(const char*)data;
+  while(size>0){
+    ssize_t written=write(fd,ptr,size);
+    if(written<=0) exit(1);
+    ptr+=written;
+    size-=written;
+  }
+}
+
+static void startJob(Job& job){
+  int fds[2];
+  if(pipe(fds)!=0){
+    perror("pipe");
+    exit(1);
+  }
+  job.pid=fork();
+  if(job.pid<0){
+    perror("fork");
+    exit(1);
+  }
+  if(job.pid==0){
+    close(fds[0]);
+    StatsMap statsMap;
+    replayTraces(job.mode,job.seed,statsMap);
+    for(StatsMap::const_iterator it=statsMap.begin(); it!=statsMap.end(); ++it){
+      Entry entry;
+      entry.pc=it->first.first;
+      entry.op=it->first.second;
+      entry.stats=it->second;
+      writeAll(fds[1],&entry,sizeof(entry));
+    }
+    close(fds[1]);
+    _exit(0);
+  }
+  close(fds[1]);
+  job.fd=fds[0];
+}
+
+// reads the statistics of the job until the end of the pipe, so that the
+// worker never blocks on a full pipe, then reaps it
+static bool finishJob(Job& job, StatsMap& statsMap){
+  FILE* input=fdopen(job.fd,"rb");
+  Entry entry;
+  while(fread(&entry,sizeof(entry),1,input)==1){
+    statsMap[Key(entry.pc,entry.op)].merge(entry.stats);
+  }
+  fclose(input);
+  int status;
+  waitpid(job.pid,&status,0);
+  return WIFEXITED(status) && WEXITSTATUS(status)==0;
+}
+
+// the deterministic modes give the same result for every seed
+static bool isRandomMode(vr_RoundingMode mode){
+  return mode==VR_RANDOM || mode==VR_AVERAGE;
+}
+
+
+static void usage(const char* prog){
+  fprintf(stderr,"usage : %s [-m mode_name[,mode_name...]] [-s nb_seeds] [-j jobs] [-o file.csv] trace.plct [trace.plct...]\n",prog);
+  exit(1);
+}
+
+static int modeOfName(const std::string& name){
+  for(int m=VR_NEAREST; m<=VR_NATIVE; m++){
+    if(name==verrou_rounding_mode_name((vr_RoundingMode)m)) return m;
+  }
+  return -1;
+}
+
+int main(int argc, char** argv){
+  std::vector<vr_RoundingMode> modes;
+  unsigned int nbSeeds=4;
+  long nbJobs=sysconf(_SC_NPROCESSORS_ONLN);
+  const char* csvName=NULL;
+  int i=1;
+  for(; i<argc && argv[i][0]=='-'; i++){
+    if(i+1>=argc) usage(argv[0]);
+    if(strcmp(argv[i],"-m")==0){
+      std::string list=argv[++i];
+      size_t begin=0;
+      while(begin<=list.size()){
+        size_t end=list.find(',',begin);
+        if(end==std::string::npos) end=list.size();
+        int mode=modeOfName(list.substr(begin,end-begin));
+        if(mode<0) usage(argv[0]);
+        if(std::find(modes.begin(),modes.end(),(vr_RoundingMode)mode)==modes.end()){
+          modes.push_back((vr_RoundingMode)mode);
+        }
+        begin=end+1;
+      }
+    }else if(strcmp(argv[i],"-s")==0){
+      nbSeeds=strtoul(argv[++i],NULL,10);
+    }else if(strcmp(argv[i],"-j")==0){
+      nbJobs=strtol(argv[++i],NULL,10);
+    }else if(strcmp(argv[i],"-o")==0){
+      csvName=argv[++i];
+    }else{
+      usage(argv[0]);
+    }
+  }
+  if(i>=argc || nbSeeds==0 || nbJobs<=0) usage(argv[0]);
+  if(modes.empty()){
+    modes.push_back(VR_RANDOM);
+    modes.push_back(VR_AVERAGE);
+  }
+
+  for(; i<argc; i++){
+    if(!loadTrace(argv[i])) return 1;
+  }
+
+  std::vector<Job> jobs;
+  for(size_t m=0; m<modes.size(); m++){
+    unsigned int seeds=isRandomMode(modes[m]) ? nbSeeds : 1;
+    for(unsigned int s=0; s<seeds; s++){
+      Job job;
+      job.mode=modes[m];
+      job.seed=s+1;
+      jobs.push_back(job);
+    }
+  }
+
+  // statistics merged over the seeds of each mode
+  std::vector<StatsMap> results(VR_NATIVE+1);
+  size_t next=0;
+  bool failed=false;
+  for(size_t done=0; done<jobs.size(); done++){
+    while(next<jobs.size() && next<done+(size_t)nbJobs){
+      startJob(jobs[next++]);
+    }
+    failed|=!finishJob(jobs[done],results[jobs[done].mode]);
+  }
+  if(failed){
+    fprintf(stderr,"a replay worker failed\n");
+    return 1;
+  }
+
+  FILE* csv=NULL;
+  if(csvName!=NULL){
+    csv=fopen(csvName,"w");
+    if(csv==NULL){
+      perror(csvName);
+      return 1;
+    }
+    fprintf(csv,"mode,pc,operation,elements,changed,mean_rel_diff,max_rel_diff\n");
+  }
+  for(size_t m=0; m<modes.size(); m++){
+    Stats total;
+    const StatsMap& statsMap=results[modes[m]];
+    for(StatsMap::const_iterator it=statsMap.begin(); it!=statsMap.end(); ++it){
+      const Stats& stats=it->second;
+      total.merge(stats);
+      if(csv!=NULL){
+        fprintf(csv,"%s,0x%llx,%s,%llu,%llu,%.3e,%.3e\n",verrou_rounding_mode_name(modes[m]),
+                (unsigned long long)it->first.first,operationName[it->first.second],stats.elements,stats.changed,
+                stats.changed ? stats.sumRelDiff/stats.changed : 0.,stats.maxRelDiff);
+      }
+    }
+    printf("%-12s %zu instructions, %llu elements, %llu changed, max relative difference %.3e\n",
+           verrou_rounding_mode_name(modes[m]),statsMap.size(),total.elements,total.changed,total.maxRelDiff);
+  }
+  if(csv!=NULL){
+    fclose(csv);
+  }
+  return 0;
+}
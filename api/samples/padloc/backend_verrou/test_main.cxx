@@ -5,6 +5,9 @@
 #include <stdio.h>
 #include <iostream>
 #include <iomanip>
+#include <cstring>
+#include <cmath>
+#include <limits>
 
 
 
@@ -25,6 +28,256 @@ void print_debug(int nbArg, const char * op,const  double* a, const double* res)
 } ;
 
 
+// * Packed operations
+// Each packed operation must give the results of the scalar operation :
+// the same bits in the deterministic rounding modes, and in random mode
+// either the result rounded downward or the one rounded upward.
+
+template<class REAL>
+struct scalarOps{
+  typedef void (*op2)(REAL,REAL,REAL*,void*);
+};
+
+template<class REAL>
+struct packedOps{
+  typedef void (*op2)(const REAL*,const REAL*,REAL*,int,void*);
+};
+
+// Operations 0..3 : add, sub, mul, div ; 4 : madd
+static const int nbTestedOps=5;
+static const char* testedOpName[nbTestedOps]={"add","sub","mul","div","madd"};
+
+template<class REAL> struct opsOf;
+
+template<>
+struct opsOf<double>{
+  static void scalar(int op, const double* a, const double* b, const double* c, double* res, int nb, void* ctx){
+    static const scalarOps<double>::op2 ops[4]={&interflop_verrou_add_double,&interflop_verrou_sub_double,
+                                                &interflop_verrou_mul_double,&interflop_verrou_div_double};
+    for(int i=0; i<nb; i++){
+      if(op<4) ops[op](a[i],b[i],res+i,ctx);
+      else interflop_verrou_madd_double(a[i],b[i],c[i],res+i,ctx);
+    }
+  }
+  static void packed(int op, const double* a, const double* b, const double* c, double* res, int nb, void* ctx){
+    static const packedOps<double>::op2 ops[4]={&interflop_verrou_add_double_packed,&interflop_verrou_sub_double_packed,
+                                                &interflop_verrou_mul_double_packed,&interflop_verrou_div_double_packed};
+    if(op<4) ops[op](a,b,res,nb,ctx);
+    else interflop_verrou_madd_double_packed(a,b,c,res,nb,ctx);
+  }
+};
+
+template<>
+struct opsOf<float>{
+  static void scalar(int op, const float* a, const float* b, const float* c, float* res, int nb, void* ctx){
+    static const scalarOps<float>::op2 ops[4]={&interflop_verrou_add_float,&interflop_verrou_sub_float,
+                                               &interflop_verrou_mul_float,&interflop_verrou_div_float};
+    for(int i=0; i<nb; i++){
+      if(op<4) ops[op](a[i],b[i],res+i,ctx);
+      else interflop_verrou_madd_float(a[i],b[i],c[i],res+i,ctx);
+    }
+  }
+  static void packed(int op, const float* a, const float* b, const float* c, float* res, int nb, void* ctx){
+    static const packedOps<float>::op2 ops[4]={&interflop_verrou_add_float_packed,&interflop_verrou_sub_float_packed,
+                                               &interflop_verrou_mul_float_packed,&interflop_verrou_div_float_packed};
+    if(op<4) ops[op](a,b,res,nb,ctx);
+    else interflop_verrou_madd_float_packed(a,b,c,res,nb,ctx);
+  }
+};
+
+static void ignoreNan(){
+}
+
+template<class REAL>
+static bool sameBits(REAL a, REAL b){
+  return std::memcmp(&a,&b,sizeof(REAL))==0;
+}
+
+// Deterministic pseudo random inputs, with special values (NaN, Inf,
+// zeros, subnormals, overflowing values) among them
+static unsigned long long testSeed=1;
+static unsigned int testRand(){
+  testSeed=testSeed*6364136223846793005ULL+1442695040888963407ULL;
+  return (unsigned int)(testSeed>>33);
+}
+
+template<class REAL>
+static REAL testValue(){
+  typedef std::numeric_limits<REAL> lim;
+  const unsigned int k=testRand()%40;
+  switch(k){
+  case 0: return lim::quiet_NaN();
+  case 1: return lim::infinity();
+  case 2: return -lim::infinity();
+  case 3: return REAL(0.);
+  case 4: return -REAL(0.);
+  case 5: return lim::denorm_min()*REAL(testRand()%1000+1);
+  case 6: return lim::max()/REAL(testRand()%4+1);
+  case 7: return lim::min();
+  }
+  const REAL mant=REAL(testRand())/REAL(1u<<31)+REAL(0.5);
+  const int e=(int)(testRand()%41)-20;
+  return ((testRand()&1) ? -1 : 1)*std::ldexp(mant,e);
+}
+
+template<class REAL>
+static int checkPacked(void* context){
+  typedef opsOf<REAL> Ops;
+  const int maxNb=17;
+  const vr_RoundingMode deterministic[]={VR_NEAREST,VR_UPWARD,VR_DOWNWARD,VR_ZERO,VR_FARTHEST};
+  const char* typeName= sizeof(REAL)==sizeof(double) ? "double" : "float";
+  int nbError=0;
+
+  for(int op=0; op<nbTestedOps; op++){
+    for(int nb=1; nb<=maxNb; nb++){
+      for(int trial=0; trial<20; trial++){
+        REAL a[maxNb],b[maxNb],c[maxNb];
+        for(int i=0; i<nb; i++){
+          a[i]=testValue<REAL>();
+          b[i]=testValue<REAL>();
+          c[i]=testValue<REAL>();
+        }
+        REAL ref[maxNb], res[maxNb], inPlace[maxNb];
+
+        for(size_t m=0; m<sizeof(deterministic)/sizeof(deterministic[0]); m++){
+          interflop_verrou_configure(deterministic[m],context);
+          Ops::scalar(op,a,b,c,ref,nb,context);
+          Ops::packed(op,a,b,c,res,nb,context);
+          for(int arg=0; arg<3; arg++){
+            //res aliases the argument arg
+            REAL x[maxNb],y[maxNb],z[maxNb];
+            std::memcpy(x,a,sizeof(a));
+            std::memcpy(y,b,sizeof(b));
+            std::memcpy(z,c,sizeof(c));
+            REAL* out= arg==0 ? x : (arg==1 ? y : z);
+            Ops::packed(op,x,y,z,out,nb,context);
+            for(int i=0; i<nb; i++){
+              if(!sameBits(out[i],ref[i])){
+                std::cout << typeName << " " << testedOpName[op] << "_packed in place (arg " << arg << ") "
+                          << verrou_rounding_mode_name(deterministic[m]) << " nb=" << nb << " i=" << i
+                          << " : " << out[i] << " != " << ref[i] << std::endl;
+                nbError++;
+              }
+            }
+          }
+          for(int i=0; i<nb; i++){
+            if(!sameBits(res[i],ref[i])){
+              std::cout << typeName << " " << testedOpName[op] << "_packed "
+                        << verrou_rounding_mode_name(deterministic[m]) << " nb=" << nb << " i=" << i
+                        << " : " << res[i] << " != " << ref[i] << std::endl;
+              nbError++;
+            }
+          }
+        }
+
+        REAL down[maxNb], up[maxNb];
+        interflop_verrou_configure(VR_DOWNWARD,context);
+        Ops::scalar(op,a,b,c,down,nb,context);
+        interflop_verrou_configure(VR_UPWARD,context);
+        Ops::scalar(op,a,b,c,up,nb,context);
+        interflop_verrou_configure(VR_RANDOM,context);
+        Ops::packed(op,a,b,c,res,nb,context);
+        std::memcpy(inPlace,a,sizeof(a));
+        Ops::packed(op,inPlace,b,c,inPlace,nb,context);
+        for(int i=0; i<nb; i++){
+          const REAL* got[2]={res,inPlace};
+          for(int k=0; k<2; k++){
+            //compared as values : the sign of a zero may differ
+            const REAL x=got[k][i];
+            const bool ok= x==down[i] || x==up[i] ||
+              (std::isnan(x) && std::isnan(down[i]) && std::isnan(up[i]));
+            if(!ok){
+              std::cout << typeName << " " << testedOpName[op] << "_packed "
+                        << (k==0 ? "" : "in place ") << "RANDOM nb=" << nb << " i=" << i
+                        << " : " << x << " not in {" << down[i] << "," << up[i] << "}"
+                        << " args " << a[i] << "," << b[i] << "," << c[i] << std::endl;
+              nbError++;
+            }
+          }
+        }
+      }
+    }
+  }
+  return nbError;
+}
+
+
+// * Seeds and thread contexts
+// A seed and a thread index give a reproducible sequence of random
+// roundings, and the threads of a same seed get different sequences.
+
+static const int nbRandomOps=256;
+
+// Random roundings of inexact operations, with the scalar and the packed
+// operations (which use the scalar and the vector generators)
+static void randomSequence(void* context, double* res){
+  double a[nbRandomOps], b[nbRandomOps];
+  for(int i=0; i<nbRandomOps; i++){
+    a[i]=0.1*(i+1);
+    b[i]=1./(i+3);
+  }
+  for(int i=0; i<nbRandomOps/2; i++){
+    interflop_verrou_add_double(a[i],b[i],res+i,context);
+  }
+  interflop_verrou_div_double_packed(a+nbRandomOps/2,b+nbRandomOps/2,res+nbRandomOps/2,nbRandomOps/2,context);
+}
+
+static bool sameSequence(const double* x, const double* y){
+  return std::memcmp(x,y,nbRandomOps*sizeof(double))==0;
+}
+
+static int checkThreadContexts(){
+  int nbError=0;
+  interflop_verrou_configure(VR_RANDOM,NULL);
+  const size_t size=verrou_thread_context_size();
+  char* ctx1=new char[size];
+  char* ctx2=new char[size];
+  double seq1[nbRandomOps], seq2[nbRandomOps];
+
+  for(unsigned int seed=1; seed<=4; seed++){
+    for(unsigned int thread=0; thread<4; thread++){
+      verrou_set_seed(seed);
+      verrou_thread_context_init(ctx1,thread);
+      randomSequence(ctx1,seq1);
+      verrou_set_seed(seed);
+      verrou_thread_context_init(ctx2,thread);
+      randomSequence(ctx2,seq2);
+      if(!sameSequence(seq1,seq2)){
+        std::cout << "seed " << seed << " thread " << thread << " : sequence not reproduced" << std::endl;
+        nbError++;
+      }
+
+      verrou_thread_context_init(ctx2,thread+1);
+      randomSequence(ctx2,seq2);
+      if(sameSequence(seq1,seq2)){
+        std::cout << "seed " << seed << " threads " << thread << "," << thread+1 << " : same sequence" << std::endl;
+        nbError++;
+      }
+    }
+
+    //Default generator (operations without context)
+    verrou_set_seed(seed);
+    randomSequence(NULL,seq1);
+    verrou_set_seed(seed);
+    randomSequence(NULL,seq2);
+    if(!sameSequence(seq1,seq2)){
+      std::cout << "seed " << seed << " : default sequence not reproduced" << std::endl;
+      nbError++;
+    }
+    verrou_set_seed(seed+100);
+    randomSequence(NULL,seq2);
+    if(sameSequence(seq1,seq2)){
+      std::cout << "seeds " << seed << "," << seed+100 << " : same default sequence" << std::endl;
+      nbError++;
+    }
+  }
+
+  delete[] ctx1;
+  delete[] ctx2;
+  return nbError;
+}
+
+
 int main(int argc, char** argv){
 
   void* context;
@@ -47,10 +300,18 @@ int main(int argc, char** argv){
 
 
   
+  verrou_set_debug_print_op(NULL);
+  verrou_set_nan_handler(&ignoreNan);
+  std::cout << std::setprecision(17);
+  const int nbError=checkPacked<double>(context)+checkPacked<float>(context);
+  std::cout << "packed operations: " << (nbError==0 ? "OK" : "FAILED") << std::endl;
+  const int nbSeedError=checkThreadContexts();
+  std::cout << "seeds and thread contexts: " << (nbSeedError==0 ? "OK" : "FAILED") << std::endl;
+
   interflop_verrou_finalyze(context);
   
 
-  return 0;
+  return (nbError==0 && nbSeedError==0) ? 0 : 1;
 }
 
 
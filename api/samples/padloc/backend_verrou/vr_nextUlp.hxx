@@ -36,6 +36,7 @@
 //#include <math.h>
 #include <cfloat>
 #include <stdint.h>
+#include <string.h>
 #include <limits>
 
 #include "interflop_verrou.h"
@@ -48,18 +49,22 @@ inline REALTYPE nextAwayFromZero(REALTYPE a){
 
 template<>
 inline double nextAwayFromZero<double>(double a){
-  double res=a;
-  uint64_t* resU=reinterpret_cast<uint64_t*>(&res);
-  (*resU)+=1;
+  uint64_t resU;
+  memcpy(&resU,&a,sizeof(a));
+  resU+=1;
+  double res;
+  memcpy(&res,&resU,sizeof(res));
   return res;
 };
 
 
 template<>
 inline float nextAwayFromZero<float>(float a){
-  float res=a;
-  uint32_t* resU=reinterpret_cast<uint32_t*>(&res);
-  (*resU)+=1;
+  uint32_t resU;
+  memcpy(&resU,&a,sizeof(a));
+  resU+=1;
+  float res;
+  memcpy(&res,&resU,sizeof(res));
   return res;
 };
 
@@ -72,18 +77,22 @@ inline REALTYPE nextTowardZero(REALTYPE a){
 
 template<>
 inline double nextTowardZero<double>(double a){
-  double res=a;
-  uint64_t* resU=reinterpret_cast<uint64_t*>(&res);
-  (*resU)-=1;
+  uint64_t resU;
+  memcpy(&resU,&a,sizeof(a));
+  resU-=1;
+  double res;
+  memcpy(&res,&resU,sizeof(res));
   return res;
 };
 
 
 template<>
 inline float nextTowardZero<float>(float a){
-  float res=a;
-  uint32_t* resU=reinterpret_cast<uint32_t*>(&res);
-  (*resU)-=1;
+  uint32_t resU;
+  memcpy(&resU,&a,sizeof(a));
+  resU-=1;
+  float res;
+  memcpy(&res,&resU,sizeof(res));
   return res;
 };
 
@@ -0,0 +1,599 @@
+/*--------------------------------------------------------------------*/
+/*--- Verrou: a FPU instrumentation tool.                          ---*/
+/*--- Vectorized implementation of the random rounding of packed   ---*/
+/*--- operations.                                                  ---*/
+/*---                                              vr_op_simd.hxx ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Verrou, a FPU instrumentation tool.
+
+   Copyright (C) 2014-2016
+     F. Févotte     <francois.fevotte@edf.fr>
+     B. Lathuilière <bruno.lathuiliere@edf.fr>
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#pragma once
+#include <stdint.h>
+
+//Warning FILE include after vr_op.hxx and vr_roundingOp.hxx
+
+// Scalar application of OP to the lane I of packed arguments.
+// Used when the vector kernels are not available, when the rounding mode is
+// not random, and for the lanes the vector kernels can not decide exactly.
+template<class OP, int NB=OP::PackArgs::nb>
+struct vr_packedLane;
+
+template<class OP>
+struct vr_packedLane<OP,2>{
+  typedef typename OP::RealType RealType;
+  static inline void apply(const RealType* const* args, int i, RealType* res, void* context){
+    OpWithSelectedRoundingMode<OP,RealType>::apply(typename OP::PackArgs(args[0][i],args[1][i]),res,context);
+  }
+};
+
+template<class OP>
+struct vr_packedLane<OP,3>{
+  typedef typename OP::RealType RealType;
+  static inline void apply(const RealType* const* args, int i, RealType* res, void* context){
+    OpWithSelectedRoundingMode<OP,RealType>::apply(typename OP::PackArgs(args[0][i],args[1][i],args[2][i]),res,context);
+  }
+};
+
+
+#if (defined(__AVX2__) && defined(__FMA__)) || defined(__AVX512F__)
+#define VR_USE_SIMD
+#include <immintrin.h>
+
+
+// * Vector random generator
+// One xorshift64 generator per 64 bits lane, the sign bit of each lane
+// (of each 32 bits half for float) gives the random decision of the lane.
+// The states live in Vr_Rand::simd_ and are kept in a register during a
+// packed operation.
+#ifdef __AVX512F__
+typedef __m512i vr_rand_simd_state_t;
+#else
+typedef __m256i vr_rand_simd_state_t;
+#endif
+
+inline vr_rand_simd_state_t vr_rand_simd_load (const Vr_Rand * r) {
+#ifdef __AVX512F__
+  return _mm512_loadu_si512((const void*)r->simd_);
+#else
+  return _mm256_loadu_si256((const __m256i*)r->simd_);
+#endif
+}
+
+inline void vr_rand_simd_store (Vr_Rand * r, vr_rand_simd_state_t x) {
+#ifdef __AVX512F__
+  _mm512_storeu_si512((void*)r->simd_,x);
+#else
+  _mm256_storeu_si256((__m256i*)r->simd_,x);
+#endif
+}
+
+inline vr_rand_simd_state_t vr_rand_simd_next (vr_rand_simd_state_t& x) {
+#ifdef __AVX512F__
+  // The zero-masking forms with a full mask : the unmasked shifts of gcc
+  // take an undefined pass-through vector, reported as uninitialized at -O2
+  const __mmask8 all=(__mmask8)-1;
+  x=_mm512_xor_si512(x,_mm512_maskz_slli_epi64(all,x,13));
+  x=_mm512_xor_si512(x,_mm512_maskz_srli_epi64(all,x,7));
+  x=_mm512_xor_si512(x,_mm512_maskz_slli_epi64(all,x,17));
+#else
+  x=_mm256_xor_si256(x,_mm256_slli_epi64(x,13));
+  x=_mm256_xor_si256(x,_mm256_srli_epi64(x,7));
+  x=_mm256_xor_si256(x,_mm256_slli_epi64(x,17));
+#endif
+  return x;
+}
+
+
+
+// * Vector types
+// Abstraction of the intrinsics used by the kernels : Vect holds SimdLength
+// values, Mask holds one boolean per lane.
+template<class REALTYPE>
+struct vr_simd;
+
+#ifdef __AVX512F__
+
+template<>
+struct vr_simd<double>{
+  typedef __m512d Vect;
+  typedef __mmask8 Mask;
+  static const int SimdLength=8;
+
+  static inline Vect load(const double* p){return _mm512_loadu_pd(p);}
+  static inline void store(double* p, Vect a){_mm512_storeu_pd(p,a);}
+  static inline Vect set1(double a){return _mm512_set1_pd(a);}
+  static inline Vect fromBits(int64_t a){return _mm512_castsi512_pd(_mm512_set1_epi64(a));}
+
+  static inline Vect add(Vect a, Vect b){return _mm512_add_pd(a,b);}
+  static inline Vect sub(Vect a, Vect b){return _mm512_sub_pd(a,b);}
+  static inline Vect mul(Vect a, Vect b){return _mm512_mul_pd(a,b);}
+  static inline Vect div(Vect a, Vect b){return _mm512_div_pd(a,b);}
+  static inline Vect fmadd(Vect a, Vect b, Vect c){return _mm512_fmadd_pd(a,b,c);}
+  static inline Vect fmsub(Vect a, Vect b, Vect c){return _mm512_fmsub_pd(a,b,c);}
+  static inline Vect fnmadd(Vect a, Vect b, Vect c){return _mm512_fnmadd_pd(a,b,c);}
+  static inline Vect xorSign(Vect a, Vect b){
+    return _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(a),
+                                                 _mm512_and_si512(_mm512_castpd_si512(b),_mm512_set1_epi64(INT64_MIN))));
+  }
+  static inline Vect abs(Vect a){
+    return _mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(a),_mm512_set1_epi64(INT64_MAX)));
+  }
+
+  template<int PRED>
+  static inline Mask cmp(Vect a, Vect b){return _mm512_cmp_pd_mask(a,b,PRED);}
+  static inline Mask and_(Mask a, Mask b){return a & b;}
+  static inline Mask or_(Mask a, Mask b){return a | b;}
+  static inline Mask andnot(Mask a, Mask b){return (Mask)(~a & b);}
+  static inline int toInt(Mask a){return a;}
+  static inline Vect blend(Vect a, Vect b, Mask m){return _mm512_mask_blend_pd(m,a,b);}
+  static inline Mask random(vr_rand_simd_state_t& r){
+    return _mm512_cmplt_epi64_mask(vr_rand_simd_next(r),_mm512_setzero_si512());
+  }
+  static inline Vect step(Vect a, Mask inc, Mask dec){
+    const __m512i one(_mm512_set1_epi64(1));
+    __m512i bits(_mm512_castpd_si512(a));
+    bits=_mm512_mask_add_epi64(bits,inc,bits,one);
+    bits=_mm512_mask_sub_epi64(bits,dec,bits,one);
+    return _mm512_castsi512_pd(bits);
+  }
+};
+
+template<>
+struct vr_simd<float>{
+  typedef __m512 Vect;
+  typedef __mmask16 Mask;
+  static const int SimdLength=16;
+
+  static inline Vect load(const float* p){return _mm512_loadu_ps(p);}
+  static inline void store(float* p, Vect a){_mm512_storeu_ps(p,a);}
+  static inline Vect set1(float a){return _mm512_set1_ps(a);}
+  static inline Vect fromBits(int32_t a){return _mm512_castsi512_ps(_mm512_set1_epi32(a));}
+
+  static inline Vect add(Vect a, Vect b){return _mm512_add_ps(a,b);}
+  static inline Vect sub(Vect a, Vect b){return _mm512_sub_ps(a,b);}
+  static inline Vect mul(Vect a, Vect b){return _mm512_mul_ps(a,b);}
+  static inline Vect div(Vect a, Vect b){return _mm512_div_ps(a,b);}
+  static inline Vect fmadd(Vect a, Vect b, Vect c){return _mm512_fmadd_ps(a,b,c);}
+  static inline Vect fmsub(Vect a, Vect b, Vect c){return _mm512_fmsub_ps(a,b,c);}
+  static inline Vect fnmadd(Vect a, Vect b, Vect c){return _mm512_fnmadd_ps(a,b,c);}
+  static inline Vect xorSign(Vect a, Vect b){
+    return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a),
+                                                _mm512_and_si512(_mm512_castps_si512(b),_mm512_set1_epi32(INT32_MIN))));
+  }
+  static inline Vect abs(Vect a){
+    return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a),_mm512_set1_epi32(INT32_MAX)));
+  }
+
+  template<int PRED>
+  static inline Mask cmp(Vect a, Vect b){return _mm512_cmp_ps_mask(a,b,PRED);}
+  static inline Mask and_(Mask a, Mask b){return a & b;}
+  static inline Mask or_(Mask a, Mask b){return a | b;}
+  static inline Mask andnot(Mask a, Mask b){return (Mask)(~a & b);}
+  static inline int toInt(Mask a){return a;}
+  static inline Vect blend(Vect a, Vect b, Mask m){return _mm512_mask_blend_ps(m,a,b);}
+  static inline Mask random(vr_rand_simd_state_t& r){
+    return _mm512_cmplt_epi32_mask(vr_rand_simd_next(r),_mm512_setzero_si512());
+  }
+  static inline Vect step(Vect a, Mask inc, Mask dec){
+    const __m512i one(_mm512_set1_epi32(1));
+    __m512i bits(_mm512_castps_si512(a));
+    bits=_mm512_mask_add_epi32(bits,inc,bits,one);
+    bits=_mm512_mask_sub_epi32(bits,dec,bits,one);
+    return _mm512_castsi512_ps(bits);
+  }
+};
+
+#else //__AVX512F__
+
+template<>
+struct vr_simd<double>{
+  typedef __m256d Vect;
+  typedef __m256d Mask;
+  static const int SimdLength=4;
+
+  static inline Vect load(const double* p){return _mm256_loadu_pd(p);}
+  static inline void store(double* p, Vect a){_mm256_storeu_pd(p,a);}
+  static inline Vect set1(double a){return _mm256_set1_pd(a);}
+  static inline Vect fromBits(int64_t a){return _mm256_castsi256_pd(_mm256_set1_epi64x(a));}
+
+  static inline Vect add(Vect a, Vect b){return _mm256_add_pd(a,b);}
+  static inline Vect sub(Vect a, Vect b){return _mm256_sub_pd(a,b);}
+  static inline Vect mul(Vect a, Vect b){return _mm256_mul_pd(a,b);}
+  static inline Vect div(Vect a, Vect b){return _mm256_div_pd(a,b);}
+  static inline Vect fmadd(Vect a, Vect b, Vect c){return _mm256_fmadd_pd(a,b,c);}
+  static inline Vect fmsub(Vect a, Vect b, Vect c){return _mm256_fmsub_pd(a,b,c);}
+  static inline Vect fnmadd(Vect a, Vect b, Vect c){return _mm256_fnmadd_pd(a,b,c);}
+  static inline Vect xorSign(Vect a, Vect b){return _mm256_xor_pd(a,_mm256_and_pd(b,set1(-0.)));}
+  static inline Vect abs(Vect a){return _mm256_andnot_pd(set1(-0.),a);}
+
+  template<int PRED>
+  static inline Mask cmp(Vect a, Vect b){return _mm256_cmp_pd(a,b,PRED);}
+  static inline Mask and_(Mask a, Mask b){return _mm256_and_pd(a,b);}
+  static inline Mask or_(Mask a, Mask b){return _mm256_or_pd(a,b);}
+  static inline Mask andnot(Mask a, Mask b){return _mm256_andnot_pd(a,b);}
+  static inline int toInt(Mask a){return _mm256_movemask_pd(a);}
+  static inline Vect blend(Vect a, Vect b, Mask m){return _mm256_blendv_pd(a,b,m);}
+  static inline Mask random(vr_rand_simd_state_t& r){
+    return _mm256_castsi256_pd(_mm256_cmpgt_epi64(_mm256_setzero_si256(),vr_rand_simd_next(r)));
+  }
+  static inline Vect step(Vect a, Mask inc, Mask dec){
+    const __m256i one(_mm256_set1_epi64x(1));
+    __m256i bits(_mm256_castpd_si256(a));
+    bits=_mm256_add_epi64(bits,_mm256_and_si256(_mm256_castpd_si256(inc),one));
+    bits=_mm256_sub_epi64(bits,_mm256_and_si256(_mm256_castpd_si256(dec),one));
+    return _mm256_castsi256_pd(bits);
+  }
+};
+
+template<>
+struct vr_simd<float>{
+  typedef __m256 Vect;
+  typedef __m256 Mask;
+  static const int SimdLength=8;
+
+  static inline Vect load(const float* p){return _mm256_loadu_ps(p);}
+  static inline void store(float* p, Vect a){_mm256_storeu_ps(p,a);}
+  static inline Vect set1(float a){return _mm256_set1_ps(a);}
+  static inline Vect fromBits(int32_t a){return _mm256_castsi256_ps(_mm256_set1_epi32(a));}
+
+  static inline Vect add(Vect a, Vect b){return _mm256_add_ps(a,b);}
+  static inline Vect sub(Vect a, Vect b){return _mm256_sub_ps(a,b);}
+  static inline Vect mul(Vect a, Vect b){return _mm256_mul_ps(a,b);}
+  static inline Vect div(Vect a, Vect b){return _mm256_div_ps(a,b);}
+  static inline Vect fmadd(Vect a, Vect b, Vect c){return _mm256_fmadd_ps(a,b,c);}
+  static inline Vect fmsub(Vect a, Vect b, Vect c){return _mm256_fmsub_ps(a,b,c);}
+  static inline Vect fnmadd(Vect a, Vect b, Vect c){return _mm256_fnmadd_ps(a,b,c);}
+  static inline Vect xorSign(Vect a, Vect b){return _mm256_xor_ps(a,_mm256_and_ps(b,set1(-0.f)));}
+  static inline Vect abs(Vect a){return _mm256_andnot_ps(set1(-0.f),a);}
+
+  template<int PRED>
+  static inline Mask cmp(Vect a, Vect b){return _mm256_cmp_ps(a,b,PRED);}
+  static inline Mask and_(Mask a, Mask b){return _mm256_and_ps(a,b);}
+  static inline Mask or_(Mask a, Mask b){return _mm256_or_ps(a,b);}
+  static inline Mask andnot(Mask a, Mask b){return _mm256_andnot_ps(a,b);}
+  static inline int toInt(Mask a){return _mm256_movemask_ps(a);}
+  static inline Vect blend(Vect a, Vect b, Mask m){return _mm256_blendv_ps(a,b,m);}
+  static inline Mask random(vr_rand_simd_state_t& r){
+    return _mm256_castsi256_ps(_mm256_srai_epi32(vr_rand_simd_next(r),31));
+  }
+  static inline Vect step(Vect a, Mask inc, Mask dec){
+    const __m256i one(_mm256_set1_epi32(1));
+    __m256i bits(_mm256_castps_si256(a));
+    bits=_mm256_add_epi32(bits,_mm256_and_si256(_mm256_castps_si256(inc),one));
+    bits=_mm256_sub_epi32(bits,_mm256_and_si256(_mm256_castps_si256(dec),one));
+    return _mm256_castsi256_ps(bits);
+  }
+};
+
+#endif //__AVX512F__
+
+
+// Smallest magnitudes for which the FMA based error terms are exact
+// (below, the error may not be representable because of the underflow)
+template<class REALTYPE> struct vr_simdLimits;
+
+// Without USE_VERROU_FMA, the scalar error of MulOp and DivOp comes from the
+// splitting of the operands, which overflows from maxExactSplit : such lanes
+// are given to the scalar operation to get its decisions.
+template<>
+struct vr_simdLimits<double>{
+  static inline vr_simd<double>::Vect minExactProd(){return vr_simd<double>::fromBits(0x0360000000000000LL);} //2^-969
+  static inline vr_simd<double>::Vect minExactDiv(){return vr_simd<double>::fromBits(0x0380000000000000LL);} //2^-967
+  static inline vr_simd<double>::Vect maxExactSplit(){return vr_simd<double>::fromBits(0x7e30000000000000LL);} //2^996
+};
+
+template<>
+struct vr_simdLimits<float>{
+  static inline vr_simd<float>::Vect minExactProd(){return vr_simd<float>::fromBits(0x0d000000);} //2^-101
+  static inline vr_simd<float>::Vect minExactDiv(){return vr_simd<float>::fromBits(0x0e000000);} //2^-99
+  static inline vr_simd<float>::Vect maxExactSplit(){return vr_simd<float>::fromBits(0x79000000);} //2^115
+};
+
+
+
+// * Vector operations
+// Vector counterparts of the operations of vr_op.hxx. For each lane,
+// sameSignOfError has the sign of the scalar OP::sameSignOfError, and
+// scalarLanes selects the lanes which have to be computed by the scalar
+// operation (NaN, Inf, underflow of the error terms...).
+template<class OP>
+class SimdOp{
+public:
+  static const bool available=false;
+};
+
+template<typename REAL>
+class SimdOp<AddOp<REAL> >{
+public:
+  typedef vr_simd<REAL> S;
+  typedef typename S::Vect Vect;
+  typedef typename S::Mask Mask;
+  static const bool available=true;
+
+  static inline Vect nearestOp(const Vect* p){
+    return S::add(p[0],p[1]);
+  }
+
+  static inline Vect sameSignOfError(const Vect* p, const Vect& x){
+    //algo TwoSum
+    const Vect z(S::sub(x,p[0]));
+    return S::add(S::sub(p[0],S::sub(x,z)),S::sub(p[1],z));
+  }
+
+  static inline Mask scalarLanes(const Vect* p, const Vect& x, const Vect& e){
+    return S::or_(S::template cmp<_CMP_NLT_UQ>(S::abs(x),S::set1(std::numeric_limits<REAL>::infinity())),
+                  S::template cmp<_CMP_UNORD_Q>(e,e));
+  }
+};
+
+template<typename REAL>
+class SimdOp<SubOp<REAL> >{
+public:
+  typedef vr_simd<REAL> S;
+  typedef typename S::Vect Vect;
+  typedef typename S::Mask Mask;
+  static const bool available=true;
+
+  static inline Vect nearestOp(const Vect* p){
+    return S::sub(p[0],p[1]);
+  }
+
+  static inline Vect sameSignOfError(const Vect* p, const Vect& x){
+    //algo TwoSum with -b
+    const Vect mb(S::xorSign(p[1],S::set1(-0.)));
+    const Vect z(S::sub(x,p[0]));
+    return S::add(S::sub(p[0],S::sub(x,z)),S::sub(mb,z));
+  }
+
+  static inline Mask scalarLanes(const Vect* p, const Vect& x, const Vect& e){
+    return SimdOp<AddOp<REAL> >::scalarLanes(p,x,e);
+  }
+};
+
+template<typename REAL>
+class SimdOp<MulOp<REAL> >{
+public:
+  typedef vr_simd<REAL> S;
+  typedef typename S::Vect Vect;
+  typedef typename S::Mask Mask;
+  static const bool available=true;
+
+  static inline Vect nearestOp(const Vect* p){
+    return S::mul(p[0],p[1]);
+  }
+
+  static inline Vect sameSignOfError(const Vect* p, const Vect& x){
+    //TwoProd with FMA
+    return S::fmsub(p[0],p[1],x);
+  }
+
+  static inline Mask scalarLanes(const Vect* p, const Vect& x, const Vect& e){
+    const Vect absX(S::abs(x));
+    const Mask lanes(S::or_(S::or_(S::template cmp<_CMP_NLT_UQ>(absX,S::set1(std::numeric_limits<REAL>::infinity())),
+                                   S::template cmp<_CMP_LT_OQ>(absX,vr_simdLimits<REAL>::minExactProd())),
+                            S::template cmp<_CMP_UNORD_Q>(e,e)));
+#ifdef USE_VERROU_FMA
+    return lanes;
+#else
+    const Vect minExact(vr_simdLimits<REAL>::minExactProd());
+    const Vect maxSplit(vr_simdLimits<REAL>::maxExactSplit());
+    const Vect absA(S::abs(p[0]));
+    const Vect absB(S::abs(p[1]));
+    return S::or_(S::or_(lanes,S::template cmp<_CMP_NLT_UQ>(absX,maxSplit)),
+                  S::or_(S::or_(S::template cmp<_CMP_NLT_UQ>(absA,maxSplit),S::template cmp<_CMP_NLT_UQ>(absB,maxSplit)),
+                         S::or_(S::template cmp<_CMP_LT_OQ>(absA,minExact),S::template cmp<_CMP_LT_OQ>(absB,minExact))));
+#endif
+  }
+};
+
+template<typename REAL>
+class SimdOp<DivOp<REAL> >{
+public:
+  typedef vr_simd<REAL> S;
+  typedef typename S::Vect Vect;
+  typedef typename S::Mask Mask;
+  static const bool available=true;
+
+  static inline Vect nearestOp(const Vect* p){
+    return S::div(p[0],p[1]);
+  }
+
+  static inline Vect sameSignOfError(const Vect* p, const Vect& c){
+    //sign(x-c*y) * sign(y), without the possible underflow of the product
+    const Vect r(S::fnmadd(c,p[1],p[0]));
+    return S::xorSign(r,p[1]);
+  }
+
+  static inline Mask scalarLanes(const Vect* p, const Vect& c, const Vect& e){
+    const Vect inf(S::set1(std::numeric_limits<REAL>::infinity()));
+    const Vect minExact(vr_simdLimits<REAL>::minExactDiv());
+    const Mask lanes(S::or_(S::or_(S::template cmp<_CMP_NLT_UQ>(S::abs(c),inf),
+                                   S::template cmp<_CMP_LT_OQ>(S::abs(c),minExact)),
+                            S::or_(S::template cmp<_CMP_LT_OQ>(S::abs(p[0]),minExact),
+                                   S::template cmp<_CMP_UNORD_Q>(e,e))));
+#ifdef USE_VERROU_FMA
+    return lanes;
+#else
+    const Vect maxSplit(vr_simdLimits<REAL>::maxExactSplit());
+    return S::or_(S::or_(lanes,S::template cmp<_CMP_NLT_UQ>(S::abs(c),maxSplit)),
+                  S::or_(S::template cmp<_CMP_NLT_UQ>(S::abs(p[0]),maxSplit),
+                         S::template cmp<_CMP_NLT_UQ>(S::abs(p[1]),maxSplit)));
+#endif
+  }
+};
+
+#ifdef USE_VERROU_FMA
+template<typename REAL>
+class SimdOp<MAddOp<REAL> >{
+public:
+  typedef vr_simd<REAL> S;
+  typedef typename S::Vect Vect;
+  typedef typename S::Mask Mask;
+  static const bool available=true;
+
+  static inline Vect nearestOp(const Vect* p){
+    return S::fmadd(p[0],p[1],p[2]);
+  }
+
+  static inline Vect sameSignOfError(const Vect* p, const Vect& z){
+    //ErrFmaApp : Exact and Aproximated Error of the FMA By Boldo and Muller
+    const Vect ph(S::mul(p[0],p[1]));
+    const Vect pl(S::fmsub(p[0],p[1],ph));
+    const Vect uh(S::add(p[2],ph));
+    const Vect t0(S::sub(uh,p[2]));
+    const Vect ul(S::add(S::sub(p[2],S::sub(uh,t0)),S::sub(ph,t0)));
+    const Vect t(S::sub(uh,z));
+    return S::add(t,S::add(pl,ul));
+  }
+
+  static inline Mask scalarLanes(const Vect* p, const Vect& z, const Vect& e){
+    const Vect inf(S::set1(std::numeric_limits<REAL>::infinity()));
+    const Vect absPh(S::abs(S::mul(p[0],p[1])));
+    return S::or_(S::or_(S::template cmp<_CMP_NLT_UQ>(S::abs(z),inf),
+                         S::template cmp<_CMP_NLT_UQ>(absPh,inf)),
+                  S::or_(S::template cmp<_CMP_LT_OQ>(absPh,vr_simdLimits<REAL>::minExactProd()),
+                         S::template cmp<_CMP_UNORD_Q>(e,e)));
+  }
+};
+#endif //USE_VERROU_FMA
+
+
+
+// * Vector random rounding
+// Same decisions as RoundingRandom : when the error is not null, the
+// nearest result is kept or moved to nextAfter/nextPrev depending on a
+// random bit and on the sign of the error.
+template<class OP>
+class RoundingRandomSimd{
+public:
+  typedef typename OP::RealType RealType;
+  typedef vr_simd<RealType> S;
+  typedef typename S::Vect Vect;
+  typedef typename S::Mask Mask;
+
+  // Returns the bit mask of the lanes which have to be computed by the scalar operation
+  static inline int apply(const Vect* p, Vect& res, vr_rand_simd_state_t& rand){
+    const Vect zero(S::set1(0.));
+    const Vect nearest(SimdOp<OP>::nearestOp(p));
+    const Vect signError(SimdOp<OP>::sameSignOfError(p,nearest));
+    const int scalarLanes=S::toInt(SimdOp<OP>::scalarLanes(p,nearest,signError));
+
+    const Mask change(S::andnot(S::template cmp<_CMP_EQ_OQ>(signError,zero),S::random(rand)));
+    const Mask up(S::template cmp<_CMP_GT_OQ>(signError,zero));
+    //nextAfter : away from zero if res>=0 ; nextPrev : away from zero if res<0
+    const Mask away(S::or_(S::and_(up,S::template cmp<_CMP_GE_OQ>(nearest,zero)),
+                           S::andnot(up,S::template cmp<_CMP_LT_OQ>(nearest,zero))));
+    const Mask prevOfZero(S::andnot(up,S::and_(change,S::template cmp<_CMP_EQ_OQ>(nearest,zero))));
+
+    res=S::step(nearest,S::and_(change,away),S::andnot(away,change));
+    res=S::blend(res,S::set1(-std::numeric_limits<RealType>::denorm_min()),prevOfZero);
+    return scalarLanes;
+  }
+};
+
+// Vector driver of the packed operations in random rounding mode, returns
+// false when OP has no vector kernel.
+template<class OP, bool AVAILABLE=SimdOp<OP>::available>
+class OpPackedRandomSimd{
+public:
+  typedef typename OP::RealType RealType;
+  static inline bool apply(const RealType* const* args, RealType* res, int nb, void* context){
+    return false;
+  }
+};
+
+template<class OP>
+class OpPackedRandomSimd<OP,true>{
+public:
+  typedef typename OP::RealType RealType;
+  typedef vr_simd<RealType> S;
+  static const int nbParam=OP::PackArgs::nb;
+  static const int SimdLength=S::SimdLength;
+
+  static inline bool apply(const RealType* const* args, RealType* res, int nb, void* context){
+    Vr_Rand* rand=vr_rand_of_context(context);
+    vr_rand_simd_state_t randState=vr_rand_simd_load(rand);
+    for(int i=0; i<nb; i+=SimdLength){
+      const int len=(nb-i < SimdLength) ? nb-i : SimdLength;
+
+      //Copy of the inputs (res may alias them), the missing lanes are padded
+      //with 1 for which every operation is exact
+      RealType in[nbParam][SimdLength];
+      const RealType* inPtr[nbParam];
+      typename S::Vect p[nbParam];
+      for(int k=0; k<nbParam; k++){
+        for(int j=0; j<SimdLength; j++){
+          in[k][j]= (j<len) ? args[k][i+j] : RealType(1.);
+        }
+        inPtr[k]=in[k];
+        p[k]=S::load(in[k]);
+      }
+
+      typename S::Vect r;
+      const int scalarLanes=RoundingRandomSimd<OP>::apply(p,r,randState);
+
+      if(len==SimdLength && scalarLanes==0){
+        S::store(res+i,r);
+      }else{
+        RealType out[SimdLength];
+        S::store(out,r);
+        for(int j=0; j<len; j++){
+          if((scalarLanes >> j) & 1){
+            vr_packedLane<OP>::apply(inPtr,j,out+j,context);
+          }
+          res[i+j]=out[j];
+        }
+      }
+    }
+    vr_rand_simd_store(rand,randState);
+    return true;
+  }
+};
+
+#endif //(__AVX2__ && __FMA__) || __AVX512F__
+
+
+
+// * Packed operations
+template<class OP>
+class OpPacked{
+public:
+  typedef typename OP::RealType RealType;
+  static const int nbParam=OP::PackArgs::nb;
+
+  // args[k][i] is the k-th argument of the i-th element, res may alias args
+  static inline void apply(const RealType* const* args, RealType* res, int nb, void* context){
+#if defined(VR_USE_SIMD) && !defined(DEBUG_PRINT_OP)
+    if(ROUNDINGMODE==VR_RANDOM && OpPackedRandomSimd<OP>::apply(args,res,nb,context)){
+      return;
+    }
+#endif
+    for(int i=0; i<nb; i++){
+      vr_packedLane<OP>::apply(args,i,res+i,context);
+    }
+  }
+
+};
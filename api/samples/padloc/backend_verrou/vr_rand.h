@@ -33,18 +33,25 @@
 #define __VR_RAND_H
 
 //#include "pub_tool_basics.h"
+#include <stdint.h>
 
+#define VR_RAND_SIMD_MAX_LANES 8
+
+/* xoshiro256** generator. The random bits are consumed one by one from
+   current_, refilled 64 bits at a time. simd_ holds the states of the
+   per-lane generators of the vector kernels (vr_op_simd.hxx). */
 typedef struct Vr_Rand_ Vr_Rand;
 struct Vr_Rand_ {
-  int current_;
+  uint64_t state_[4];
+  uint64_t current_;
   int count_;
-  unsigned long int next_;
   unsigned int seed_;
-  int reload_;
+  uint64_t simd_[VR_RAND_SIMD_MAX_LANES];
 };
 
 //extern Vr_Rand vr_rand;
 
+/* Default state, used by the operations called without context */
 Vr_Rand vr_rand;
 
 #include "vr_rand_implem.h"
@@ -52,6 +59,7 @@ Vr_Rand vr_rand;
 
 
 /* void vr_rand_setSeed (Vr_Rand * r, unsigned int c); */
+/* void vr_rand_setSeedStream (Vr_Rand * r, unsigned int c, unsigned int stream); */
 /* unsigned int vr_rand_getSeed (Vr_Rand * r); */
 /* bool vr_rand_bool (Vr_Rand * r); */
 /* int vr_rand_int (Vr_Rand * r); */
@@ -33,21 +33,52 @@
 
 //Warning FILE include in vr_rand.h
 
-inline static int vr_rand_next (Vr_Rand * r){
-  r->next_ = r->next_ * 1103515245 + 12345;
-  return (unsigned int)(r->next_/65536) % 32768;
+inline static uint64_t vr_rand_splitmix64 (uint64_t* x){
+  uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+inline static uint64_t vr_rand_rotl (uint64_t x, int k){
+  return (x << k) | (x >> (64 - k));
+}
+
+inline static uint64_t vr_rand_next (Vr_Rand * r){
+  uint64_t* s = r->state_;
+  const uint64_t res = vr_rand_rotl(s[1] * 5, 7) * 9;
+  const uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = vr_rand_rotl(s[3], 45);
+  return res;
 }
 
 inline int vr_rand_max () {
-  return 32767;
+  return 0x7fffffff;
 }
 
-inline void vr_rand_setSeed (Vr_Rand * r, unsigned int c) {
-  r->reload_  = 31;
-  r->count_   = 0;
+/* Seeds the generator from the seed c and the stream number (thread index) :
+   different streams of a same seed give independent sequences */
+inline void vr_rand_setSeedStream (Vr_Rand * r, unsigned int c, unsigned int stream) {
+  uint64_t x = ((uint64_t)stream << 32) | c;
   r->seed_    = c;
-  r->next_    = c;
+  for(int i = 0; i < 4; i++){
+    r->state_[i] = vr_rand_splitmix64 (&x);
+  }
+  for(int i = 0; i < VR_RAND_SIMD_MAX_LANES; i++){
+    uint64_t z = vr_rand_splitmix64 (&x);
+    r->simd_[i] = (z != 0) ? z : 0x9e3779b97f4a7c15ULL;
+  }
   r->current_ = vr_rand_next (r);
+  r->count_   = 0;
+}
+
+inline void vr_rand_setSeed (Vr_Rand * r, unsigned int c) {
+  vr_rand_setSeedStream (r, c, 0);
 }
 
 
@@ -56,7 +87,7 @@ inline unsigned int vr_rand_getSeed (Vr_Rand * r) {
 }
 
 inline bool vr_rand_bool (Vr_Rand * r) {
-  if (r->count_ == r->reload_){
+  if (r->count_ == 64){
     r->current_ = vr_rand_next (r);
     r->count_ = 0;
   }
@@ -66,5 +97,11 @@ inline bool vr_rand_bool (Vr_Rand * r) {
 }
 
 inline int vr_rand_int (Vr_Rand * r) {
-  return vr_rand_next (r);
+  return (int)(vr_rand_next (r) >> 33);
+}
+
+/* The context of the operations is the generator of the calling thread,
+   NULL selects the default generator */
+inline Vr_Rand* vr_rand_of_context (void* context) {
+  return (context != NULL) ? (Vr_Rand*)context : &vr_rand;
 }
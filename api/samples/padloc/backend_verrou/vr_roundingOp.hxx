@@ -86,11 +86,11 @@ public:
   typedef typename OP::RealType RealType;
   typedef typename OP::PackArgs PackArgs;
 
-  static inline RealType apply(const PackArgs& p ){
+  static inline RealType apply(const PackArgs& p, Vr_Rand* rand){
     
     RealType res=OP::nearestOp(p);
 
-    //std::cout << "seed : " << vr_rand_getSeed(&vr_rand) << std::endl;
+    //std::cout << "seed : " << vr_rand_getSeed(rand) << std::endl;
 
     if (isNanInf<RealType> (res)){
       return res;
@@ -99,11 +99,12 @@ public:
     OP::check(p,res);
     const RealType signError=OP::sameSignOfError(p,res);
 
-    
-    if(signError==0.){
+    //As for RoundingUpward and RoundingDownward, an unknown sign of error
+    //(NaN) keeps the nearest result
+    if(signError==0. || isNan(signError)){
       return res;
     }else{
-      const bool doNoChange = vr_rand_bool(&vr_rand);
+      const bool doNoChange = vr_rand_bool(rand);
       //std::cout << "sign error : " << signError << "\tdonoChange : " << doNoChange << "\t";
       if(doNoChange){
         //std::cout << std::endl;
@@ -129,7 +130,7 @@ public:
   typedef typename OP::RealType RealType;
   typedef typename OP::PackArgs PackArgs;
 
-  static inline RealType apply(const PackArgs& p){
+  static inline RealType apply(const PackArgs& p, Vr_Rand* rand){
     const RealType res=OP::nearestOp(p) ;
 
     if (isNanInf<RealType> (res)){
@@ -147,7 +148,7 @@ public:
       const RealType nextRes(nextAfter<RealType>(res));
       const RealType u(nextRes -res);
       const int s(1);
-      const bool doNotChange = ((vr_rand_int(&vr_rand) * u)
+      const bool doNotChange = ((vr_rand_int(rand) * u)
 				> (vr_rand_max() * s * error));
       if(doNotChange){
 	return res;
@@ -160,7 +161,7 @@ public:
       const RealType prevRes(nextPrev<RealType>(res));
       const RealType u(res -prevRes);
       const int s(-1);
-      const bool doNotChange = ((vr_rand_int(&vr_rand) * u)
+      const bool doNotChange = ((vr_rand_int(rand) * u)
 				> (vr_rand_max() * s * error));
       if(doNotChange){
 	return res;
@@ -399,10 +400,10 @@ public:
       return RoundingZero<OP>::apply (p);
     case VR_RANDOM:
       //std::cout << "VR_RANDOM" << std::endl;
-      return RoundingRandom<OP>::apply (p);
+      return RoundingRandom<OP>::apply (p, vr_rand_of_context(context));
     case VR_AVERAGE:
       //std::cout << "VR_AVERAGE" << std::endl;
-      return RoundingAverage<OP>::apply (p);
+      return RoundingAverage<OP>::apply (p, vr_rand_of_context(context));
     case VR_FARTHEST:
       //std::cout << "VR_FARTHEST" << std::endl;
       return RoundingFarthest<OP>::apply (p);
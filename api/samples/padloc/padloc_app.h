@@ -0,0 +1,67 @@
+#ifndef PADLOC_APP_HEADER
+#define PADLOC_APP_HEADER
+
+/**
+ * \file padloc_app.h
+ * \brief Functions an instrumented application can call to drive PADLOC. Part of the PADLOC project.
+ *
+ * \details This header is included by the application, not by the client. The
+ * functions are empty : the client recognizes them by their symbol and
+ * instruments their entry, so that a program built with this header runs
+ * unchanged without PADLOC. They are weak so that the compiler keeps the
+ * calls, and the program must keep its symbols (no stripping).
+ *
+ * \author Brasseur Dylan, Teaudors Mickaël, Valeri Yoann
+ * \date 2019
+ * \copyright Interflop
+ */
+
+#if defined(_MSC_VER)
+#define PADLOC_APP_FUNCTION __declspec(noinline) inline
+#else
+#define PADLOC_APP_FUNCTION __attribute__((noinline, weak))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief Marks the point at which the Monte-Carlo replicas are forked (-mc option)
+ * \details Without it, the replicas are forked at the entry of main. Only the
+ * first call is a fork point, it must be made while the program has a single thread.
+ */
+PADLOC_APP_FUNCTION void padloc_sample_start(void){
+}
+
+/**
+ * \brief Marks \p value as an output of the program, reduced over the Monte-Carlo replicas (-mc option)
+ * \details The values given for the same name by a replica are numbered in
+ * their order, and each occurrence is reduced separately.
+ *
+ * \param name Name of the output, in the report
+ * \param value Value computed by this replica
+ */
+PADLOC_APP_FUNCTION void padloc_sample_output(const char *name, double value){
+    (void)name;
+    (void)value;
+}
+
+/**
+ * \brief Enables the instrumentation of the floating point operations (-ro option)
+ * \details The code executed before, or after padloc_roi_stop, isn't instrumented.
+ */
+PADLOC_APP_FUNCTION void padloc_roi_start(void){
+}
+
+/**
+ * \brief Disables the instrumentation of the floating point operations (-ro option)
+ */
+PADLOC_APP_FUNCTION void padloc_roi_stop(void){
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //PADLOC_APP_HEADER
@@ -10,10 +10,20 @@
  * \copyright Interflop
  */
 
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#include <unordered_map>
+#include <vector>
 
 #include "padloc_client.h"
 #include "analyse.hpp"
+#include "persist.hpp"
+#include "profile.hpp"
+#include "trace.hpp"
 #include "utils.hpp"
 
 #if defined(X86)
@@ -70,6 +80,11 @@
      * \details Currently, we save 16 registers for X86 (1 slot to save the arithmetic flags), and 31 for AArch64.
      */
     #define NUM_GPR_SLOTS 17
+    /**
+     * \def NUM_OPMASK_SLOTS
+     * \brief Gives the number of opmask registers (K0 to K7), saved after the GPR when AVX 512 is supported.
+     */
+    #define NUM_OPMASK_SLOTS 8
 #elif defined(AArch64)
     /**
      * This array gathers all the GPR to save.
@@ -89,6 +104,11 @@
      * \details Currently, we save 16 registers for X86 (1 slot to save the arithmetic flags), and 31 for AArch64.
      */
     #define NUM_GPR_SLOTS 32
+    /**
+     * \def NUM_OPMASK_SLOTS
+     * \brief Gives the number of opmask registers, there are none on AArch64.
+     */
+    #define NUM_OPMASK_SLOTS 0
 #endif
 #undef R
 
@@ -142,6 +162,151 @@ int get_index_tls_result(){
     return tls_result;
 }
 
+/**
+ * \def PLC_CACHE_LINE
+ * \brief Size in bytes of a cache line, alignment of the thread arena and of each of its buffers
+ */
+#define PLC_CACHE_LINE 64
+
+/**
+ * \brief Rounds \p size up to a multiple of PLC_CACHE_LINE
+ */
+static inline size_t cache_line_round(size_t size){
+    return (size + PLC_CACHE_LINE - 1) & ~(size_t)(PLC_CACHE_LINE - 1);
+}
+
+/**
+ * \brief Returns the size in bytes of the float tls buffer
+ * \details Large enough for every SIMD register of the processor at its widest,
+ * which is the largest layout a run can use
+ */
+static size_t simd_area_size(){
+    return AVX_512_SUPPORTED ? 64 * NB_ZMM_REG : AVX_SUPPORTED ? 32 * NB_YMM_REG : 16 * NB_XMM_REG;
+}
+
+/**
+ * \brief Returns the size in bytes of the gpr tls buffer
+ * \details The GPR slots are followed by the slots of the opmask registers
+ */
+static size_t gpr_area_size(){
+    return cache_line_round((NUM_GPR_SLOTS + NUM_OPMASK_SLOTS) * sizeof(reg_t));
+}
+
+/**
+ * \brief Returns the offset in bytes of the thread context from the float tls buffer
+ * \details The thread context follows the float and gpr tls buffers in the arena,
+ * so the address of a saved SIMD register is known relatively to it.
+ */
+static size_t thread_context_offset(){
+    return simd_area_size() + gpr_area_size();
+}
+
+/**
+ * \brief Returns the size in bytes of the thread arena
+ * \details The arena holds, each on its own cache lines : the float tls buffer,
+ * the gpr tls buffer, and the result tls buffer, which is the thread context
+ * (plc_thread_context_t). PLC_CACHE_LINE - 1 bytes are added for the alignment.
+ */
+static size_t thread_arena_size(){
+    return thread_context_offset() + cache_line_round(sizeof(plc_thread_context_t)) + PLC_CACHE_LINE - 1;
+}
+
+/**
+ * \brief Returns the size in bytes of the shadow register file of a thread, in lane mode
+ * \details The samples follow the plc_shadow_file_t structure
+ */
+static size_t shadow_file_size(){
+    return sizeof(plc_shadow_file_t) + PLC_NB_SHADOW_REGS * (get_nb_lane_samples() - 1) * MAX_OPND_SIZE_BYTES;
+}
+
+void plc_thread_arena_init(void *drcontext, void *backend_context){
+    byte *raw = (byte *)dr_thread_alloc(drcontext, thread_arena_size());
+    byte *simd = (byte *)(((ptr_uint_t)raw + PLC_CACHE_LINE - 1) & ~(ptr_uint_t)(PLC_CACHE_LINE - 1));
+    byte *gpr = simd + simd_area_size();
+    plc_thread_context_t *context = (plc_thread_context_t *)(simd + thread_context_offset());
+    context->destination = nullptr;
+    context->arena = raw;
+    context->evex_control = 0;
+    context->backend = backend_context;
+    context->simd = simd;
+    context->gpr = (reg_t *)gpr;
+    context->shadow = nullptr;
+    context->trace = plc_trace_enabled();
+#if defined(X86)
+    if(get_nb_lane_samples() > 1){
+        plc_shadow_file_t *shadow = (plc_shadow_file_t *)dr_thread_alloc(drcontext, shadow_file_size());
+        memset(shadow, 0, sizeof(plc_shadow_file_t));
+        shadow->call.nb = (uint32_t)(get_nb_lane_samples() - 1);
+        shadow->samples = (byte (*)[MAX_OPND_SIZE_BYTES])(shadow + 1);
+        context->shadow = shadow;
+    }
+#endif
+
+    SET_TLS(drcontext, tls_float, simd);
+    SET_TLS(drcontext, tls_gpr, gpr);
+    SET_TLS(drcontext, tls_result, context);
+}
+
+plc_thread_context_t *plc_get_thread_context(void *drcontext){
+    return (plc_thread_context_t *)GET_TLS(drcontext, tls_result);
+}
+
+int plc_get_shadow_samples(void *drcontext, double value, double *samples){
+    const plc_shadow_file_t *shadow = plc_get_thread_context(drcontext)->shadow;
+    if(shadow == nullptr){
+        return 0;
+    }
+    for(int r = 0; r < PLC_NB_SHADOW_REGS; r++){
+        if((shadow->written & (1U << r)) && memcmp(shadow->tags[r], &value, sizeof(double)) == 0){
+            for(uint32_t k = 0; k < shadow->call.nb; k++){
+                memcpy(&samples[k], shadow->samples[r * shadow->call.nb + k], sizeof(double));
+            }
+            return (int)shadow->call.nb;
+        }
+    }
+    return 0;
+}
+
+void plc_thread_arena_exit(void *drcontext){
+    plc_thread_context_t *context = plc_get_thread_context(drcontext);
+    if(context->shadow != nullptr){
+        dr_thread_free(drcontext, context->shadow, shadow_file_size());
+    }
+    dr_thread_free(drcontext, context->arena, thread_arena_size());
+}
+
+/**
+ * \brief Returns the slot of the GPR in the gpr tls
+ * \details Slot 0 holds the arithmetic flags, slot 1 RAX, slot 2 RCX, and so
+ * on following GPR_ORDER. Sub-registers (EAX, AX, AL...) share the slot of
+ * their 64 bits register.
+ * 
+ * \param gpr The GPR to get the slot from
+ * \return The index of the slot
+ * 
+ * \warning We assume the given register is indeed a GPR
+ */
+inline int gpr_slot(reg_id_t gpr){
+    return ((int)reg_to_pointer_sized(gpr) - DR_REG_START_GPR) + 1;
+}
+
+/**
+ * \brief Returns the index of the SIMD register compared to the MM0
+ * \details XMM1, YMM1 and ZMM1 all have the index 1.
+ * 
+ * \param simd The SIMD register to get the index from
+ * \return The index of the register
+ * 
+ * \warning We assume the given register is a SIMD register
+ */
+inline int simd_index(reg_id_t simd){
+    const reg_id_t START = 
+        reg_is_strictly_zmm(simd) ? DR_REG_START_ZMM 
+                                  : reg_is_strictly_ymm(simd) ? DR_REG_START_YMM
+                                                              : DR_REG_START_XMM;
+    return (int)simd - START;
+}
+
 /**
  * \brief Returns the offset, in bytes, of the GPR stored in the tls
  * \details The offset is relative to the address stored in the gpr tls.
@@ -153,34 +318,139 @@ int get_index_tls_result(){
  * \warning We assume the given register is indeed a GPR
  */
 inline int offset_of_gpr(reg_id_t gpr){
-    return (((int)gpr - DR_REG_START_GPR) + 1) << 3;
+    return gpr_slot(gpr) << 3;
+}
+
+#if defined(X86)
+/**
+ * \brief Returns the offset, in bytes, of the opmask register in the gpr tls
+ * \details The opmask registers are stored after the GPR, K0 first.
+ * 
+ * \param opmask The opmask register to get the offset from
+ * \return The offset in bytes
+ */
+inline int offset_of_opmask(reg_id_t opmask){
+    return (NUM_GPR_SLOTS + (int)(opmask - DR_REG_K0)) << 3;
+}
+#endif
+
+/**
+ * \brief Returns the number of bits set in \p mask
+ */
+static inline int count_bits(uint32_t mask){
+#if defined(_MSC_VER)
+    return (int)__popcnt(mask);
+#else
+    return __builtin_popcount(mask);
+#endif
 }
 
 /**
  * \brief Returns the offset, in bytes, of the simd register in the tls
  * \details The returned offset is relative to the adress stored in float tls.
  * Since x86 is Little Endian, the offset of ZMM1, YMM1 and XMM1 for example is the same.
- * Depending on the current architecture, we saved the biggest version of the SIMD register, thus
- * the offset is calculated from the size of the biggest version of the SIMD register multiplied by
- * the index of this register compared to the MM0.
+ * The layout is the one of the run whose registers are \p regs : the saved
+ * registers are packed in the order of their index, in slots of
+ * regs->simd_slot_size bytes, so the offset is the number of saved registers
+ * of lower index multiplied by the size of a slot.
  * 
+ * \param regs Registers saved around the run
  * \param simd The SIMD register to get the offset from
  * \return The offset in bytes
  * 
- * \warning We assume the given register is a SIMD register
+ * \warning We assume the given register is a SIMD register saved in \p regs
  */
-inline int offset_of_simd(reg_id_t simd){
-    /* 128 bits = 16 bytes = 2^4 */
-    static const int OFFSET = 
-        AVX_512_SUPPORTED ? 6 
-                          : AVX_SUPPORTED ? 5 : 4; 
-    const reg_id_t START = 
-        reg_is_strictly_zmm(simd) ? DR_REG_START_ZMM 
-                                  : reg_is_strictly_ymm(simd) ? DR_REG_START_YMM
-                                                              : DR_REG_START_XMM;
-    return ((uint)simd - START) << OFFSET;
+inline int offset_of_simd(const plc_register_set_t *regs, reg_id_t simd){
+    const uint32_t lower = (((uint32_t)1) << simd_index(simd)) - 1;
+    return count_bits(regs->simd & lower) * (int)regs->simd_slot_size;
+}
+
+/**
+ * \brief Returns the size in bytes of the SIMD registers written by AVX instructions
+ * \details VEX and EVEX encoded instructions zero their destination up to the
+ * full width of the register : 64 bytes if AVX 512 is supported, else 32.
+ */
+static inline int avx_register_size(){
+#if defined(X86)
+    static const int size = AVX_512_SUPPORTED ? 64 : 32;
+    return size;
+#else
+    return 0;
+#endif
 }
 
+#if defined(X86)
+/**
+ * \brief Helpers of the EVEX variants of padloc_backend and padloc_backend_fused
+ * \details A masked operation is only computed over its selected elements : the
+ * selected elements of the sources are packed, the backend is called over them,
+ * and the results are unpacked to the destination. The other elements of the
+ * destination are left unchanged (merging-masking) or zeroed (zeroing-masking).
+ * A broadcast source is expanded the same way.
+ */
+struct padloc_evex{
+
+    /**
+     * \brief Returns the elements selected by the opmask register of the EVEX control word
+     * 
+     * \param control EVEX control word of the instruction
+     * \param all Mask of all the elements of the operation
+     * \param context Thread context, holding the saved opmask registers
+     * \return Mask of the selected elements, bit i for the element i
+     */
+    static inline uint32_t selected_elements(uint32_t control, uint32_t all, const plc_thread_context_t *context){
+        if(PLC_EVEX_OPMASK(control) == 0){
+            return all;
+        }
+        //At most 16 elements, the low 16 bits of the saved opmask register are enough
+        const byte *gpr = (const byte *)context->gpr;
+        return *(const uint16_t *)(gpr + offset_of_opmask(DR_REG_K0 + PLC_EVEX_OPMASK(control))) & all;
+    }
+
+    /**
+     * \brief Packs the selected elements of \p src in \p dst
+     * 
+     * \tparam FTYPE float or double depending on the precision of the instruction
+     * \param src Source operand
+     * \param dst Buffer receiving the selected elements
+     * \param selected Mask of the selected elements
+     * \param broadcast True if \p src is a single element, given to every selected element
+     * \return The number of selected elements
+     */
+    template<typename FTYPE>
+    static inline int pack(const FTYPE *src, FTYPE *dst, uint32_t selected, bool broadcast){
+        int nb = 0;
+        for(int i = 0; selected != 0; i++, selected >>= 1){
+            if(selected & 1){
+                dst[nb++] = broadcast ? src[0] : src[i];
+            }
+        }
+        return nb;
+    }
+
+    /**
+     * \brief Unpacks the results to the selected elements of the destination
+     * 
+     * \tparam FTYPE float or double depending on the precision of the instruction
+     * \param src Results, one per selected element
+     * \param dst Destination operand
+     * \param selected Mask of the selected elements
+     * \param nb_elem Number of elements of the operation
+     * \param zeroing True if the elements which aren't selected are zeroed
+     */
+    template<typename FTYPE>
+    static inline void unpack(const FTYPE *src, FTYPE *dst, uint32_t selected, int nb_elem, bool zeroing){
+        for(int i = 0, j = 0; i < nb_elem; i++){
+            if(selected & (1U << i)){
+                dst[i] = src[j++];
+            }else if(zeroing){
+                dst[i] = 0;
+            }
+        }
+    }
+};
+#endif
+
 /**
  * \brief Definition of intermediary functions between front-end and back-end
  * for 2 operands instructions
@@ -188,55 +458,136 @@ inline int offset_of_simd(reg_id_t simd){
  * \tparam FTYPE float or double depending on the precision of the instruction
  * \tparam Backend_function Function corresponding to the overloaded operation
  * (add, sub, fmadd ...) : implementation in Backend.hxx.
+ * \tparam Backend_packed_function Packed version of Backend_function (add_packed, sub_packed ...),
+ * used when the operation has more than one element
  * \tparam INSTR_CATEGORY Marks the difference SSE and AVX instructions.
  * Possible values are PLC_OP_SSE and PLC_OP_AVX
  * \tparam SIMD_TYPE Define the length of the elements of the operation.
  * Possible values are PLC_OP_SCALAR, PLC_OP_128, PLC_OP_256 and PLC_OP_512
+ * \tparam EVEX True for EVEX encoded instructions, which read the EVEX control word of the thread context
  */
-template<typename FTYPE, FTYPE (*Backend_function)(FTYPE, FTYPE), int INSTR_CATEGORY, int SIMD_TYPE = PLC_OP_SCALAR>
+template<typename FTYPE, FTYPE (*Backend_function)(FTYPE, FTYPE, void*), void (*Backend_packed_function)(const FTYPE*, const FTYPE*, FTYPE*, int, void*),
+         int INSTR_CATEGORY, int SIMD_TYPE = PLC_OP_SCALAR, bool EVEX = false>
 struct padloc_backend{
 
+    static const int operation_size =   (SIMD_TYPE == PLC_OP_128) ? 16 : (SIMD_TYPE == PLC_OP_256) ? 32 :
+                                        (SIMD_TYPE == PLC_OP_512) ? 64 : sizeof(FTYPE);
+    static const int nb_elem = operation_size / sizeof(FTYPE);
+
     /**
-     * \brief Apply the backend function corresponding to the current overloaded instruction scalarly over the source operands
+     * \brief Computes the operation over the source operands into \p tls
      * 
-     * \details Determine the number of scalar element involved in the operation and apply the corresponding backend function over each of them. \n
-     * If the overloaded instruction is AVX, set the high part of YMM with 0.
+     * \details A scalar operation calls the backend function, a packed operation calls the packed
+     * backend function once over all its elements. \n
+     * If the instruction is EVEX encoded, only the elements selected by its opmask are computed (see padloc_evex).
      * 
      * \param vect_a Memory reference to the first operand
      * \param vect_b Memory reference to the second operand 
+     * \param tls Memory reference to the destination
+     * \param thread Context of the thread
      */
-    static void apply(FTYPE *vect_a, FTYPE *vect_b){
-
-        static const int operation_size =   (SIMD_TYPE == PLC_OP_128) ? 16 : (SIMD_TYPE == PLC_OP_256) ? 32 :
-                                            (SIMD_TYPE == PLC_OP_512) ? 64 : sizeof(FTYPE);
-        static const int nb_elem = operation_size / sizeof(FTYPE);
-
-        static const int max_operation_size = (INSTR_CATEGORY == PLC_OP_SSE) ? 16
-                                            : (INSTR_CATEGORY == PLC_OP_AVX) ? 32
-                                            : sizeof(FTYPE);
-        static const int max_nb_elem = max_operation_size / sizeof(FTYPE);
-
-        FTYPE res;
+    static void compute(FTYPE *vect_a, FTYPE *vect_b, FTYPE *tls, plc_thread_context_t *thread){
+        void *context = thread->backend;
 
-        FTYPE *tls = *(FTYPE **)GET_TLS(dr_get_current_drcontext(), tls_result);
-
-        for(int i = 0; i < nb_elem; i++){
 #if defined(X86)
-            res = Backend_function(vect_a[i], vect_b[i]);
+        static const uint32_t all = (uint32_t)((((uint64_t)1) << nb_elem) - 1);
+        const uint32_t control = EVEX ? (uint32_t)thread->evex_control : 0;
+        const uint32_t selected = EVEX ? padloc_evex::selected_elements(control, all, thread) : all;
+        if(EVEX && (selected != all || PLC_EVEX_BROADCAST(control) != 0)){
+            FTYPE a[nb_elem], b[nb_elem], res[nb_elem];
+            const int nb = padloc_evex::pack(vect_a, a, selected, PLC_EVEX_BROADCAST(control) == 1);
+            padloc_evex::pack(vect_b, b, selected, PLC_EVEX_BROADCAST(control) == 2);
+            if(nb == 1){
+                res[0] = Backend_function(a[0], b[0], context);
+            }else if(nb > 1){
+                Backend_packed_function(a, b, res, nb, context);
+            }
+            padloc_evex::unpack(res, tls, selected, nb_elem, (control & PLC_EVEX_ZEROING) != 0);
+        }else
+#endif
+        if(nb_elem == 1){
+#if defined(X86)
+            *tls = Backend_function(*vect_a, *vect_b, context);
+#elif defined(AARCH64)
+            *tls = Backend_function(*vect_b, *vect_a, context);
+#endif
+        }else{
+#if defined(X86)
+            Backend_packed_function(vect_a, vect_b, tls, nb_elem, context);
 #elif defined(AARCH64)
-            res = Backend_function(vect_b[i], vect_a[i]);
+            Backend_packed_function(vect_b, vect_a, tls, nb_elem, context);
 #endif
-            *(tls + i) = res;
         }
+    }
 
-
-        /* If this is an AVX instruction, set the high part with 0 */
+    /**
+     * \brief If this is an AVX instruction, set the high part of the destination \p tls with 0
+     */
+    static inline void zero_upper(FTYPE *tls){
         if(INSTR_CATEGORY == PLC_OP_AVX){
+            const int max_nb_elem = avx_register_size() / sizeof(FTYPE);
             for(int i = MAX(nb_elem, 16 / sizeof(FTYPE)); i < max_nb_elem; i++){
                 *(tls + i) = 0;
             }
         }
     }
+
+#if defined(X86)
+    /**
+     * \brief Computes the shadow samples of the operation, in lane mode
+     * 
+     * \details The operands of each sample are given by the call of the shadow register
+     * file, set by the block dispatcher. The elements of all the samples are gathered and
+     * computed by a single call to the packed backend function, each element drawing its
+     * own random rounding. EVEX masked or broadcast operations are computed sample by sample.
+     * 
+     * \param thread Context of the thread, holding the shadow register file
+     */
+    static void compute_samples(plc_thread_context_t *thread){
+        const plc_samples_call_t &call = thread->shadow->call;
+        static const uint32_t all = (uint32_t)((((uint64_t)1) << nb_elem) - 1);
+        const uint32_t control = EVEX ? (uint32_t)thread->evex_control : 0;
+        if(EVEX && (padloc_evex::selected_elements(control, all, thread) != all || PLC_EVEX_BROADCAST(control) != 0)){
+            for(uint32_t k = 0; k < call.nb; k++){
+                compute((FTYPE *)call.sources[0][k], (FTYPE *)call.sources[1][k], (FTYPE *)call.destinations[k], thread);
+            }
+            return;
+        }
+        FTYPE a[(PLC_MAX_LANE_SAMPLES - 1) * nb_elem], b[(PLC_MAX_LANE_SAMPLES - 1) * nb_elem],
+              res[(PLC_MAX_LANE_SAMPLES - 1) * nb_elem];
+        for(uint32_t k = 0; k < call.nb; k++){
+            memcpy(a + k * nb_elem, call.sources[0][k], operation_size);
+            memcpy(b + k * nb_elem, call.sources[1][k], operation_size);
+        }
+        Backend_packed_function(a, b, res, call.nb * nb_elem, thread->backend);
+        for(uint32_t k = 0; k < call.nb; k++){
+            memcpy(call.destinations[k], res + k * nb_elem, operation_size);
+            zero_upper((FTYPE *)call.destinations[k]);
+        }
+    }
+#endif
+
+    /**
+     * \brief Apply the backend function corresponding to the current overloaded instruction over the source operands
+     * 
+     * \details Computes the operation into the destination of the thread context (see compute).
+     * In lane mode, the shadow samples are computed first, as the destination may be one of the sources. \n
+     * If the overloaded instruction is AVX, set the high part of the register with 0.
+     * 
+     * \param vect_a Memory reference to the first operand
+     * \param vect_b Memory reference to the second operand 
+     * \param thread Context of the thread, holding the destination
+     */
+    static void apply(FTYPE *vect_a, FTYPE *vect_b, plc_thread_context_t *thread){
+        FTYPE *tls = (FTYPE *)thread->destination;
+#if defined(X86)
+        if(thread->shadow != nullptr){
+            compute_samples(thread);
+        }
+#endif
+        compute(vect_a, vect_b, tls, thread);
+        zero_upper(tls);
+    }
 };
 
 /**
@@ -246,54 +597,274 @@ struct padloc_backend{
  * \tparam FTYPE float or double depending on the precision of the instruction
  * \tparam Backend_function Function corresponding to the overloaded operation
  * (add, sub, fmadd ...) : implementation in Backend.hxx.
+ * \tparam Backend_packed_function Packed version of Backend_function (fmadd_packed, fmsub_packed ...),
+ * used when the operation has more than one element
  * \tparam INSTR_CATEGORY Marks the difference SSE and AVX instructions.
  * Possible values are PLC_OP_SSE and PLC_OP_AVX
  * \tparam SIMD_TYPE Define the length of the elements of the operation.
  * Possible values are PLC_OP_SCALAR, PLC_OP_128, PLC_OP_256 and PLC_OP_512
+ * \tparam EVEX True for EVEX encoded instructions, which read the EVEX control word of the thread context
  */
-template<typename FTYPE, FTYPE (*Backend_function)(FTYPE, FTYPE, FTYPE), int INSTR_CATEGORY, int SIMD_TYPE = PLC_OP_SCALAR>
+template<typename FTYPE, FTYPE (*Backend_function)(FTYPE, FTYPE, FTYPE, void*),
+         void (*Backend_packed_function)(const FTYPE*, const FTYPE*, const FTYPE*, FTYPE*, int, void*),
+         int INSTR_CATEGORY, int SIMD_TYPE = PLC_OP_SCALAR, bool EVEX = false>
 struct padloc_backend_fused{
 
-     /**
-     * \brief Apply the backend function corresponding to the current overloaded instruction scalarly over the source operands
+    static const int vect_size =  (SIMD_TYPE == PLC_OP_128) ? 16 : (SIMD_TYPE == PLC_OP_256) ? 32
+                                : (SIMD_TYPE == PLC_OP_512) ? 64 : sizeof(FTYPE);
+    static const int nb_elem = vect_size / sizeof(FTYPE);
+
+    /**
+     * \brief Computes the operation over the source operands into \p tls
      * 
-     * \details Determine the number of scalar element involved in the operation and apply the corresponding backend function over each of them. \n
-     * If the overloaded instruction is AVX, set the high part of YMM with 0.
+     * \details A scalar operation calls the backend function, a packed operation calls the packed
+     * backend function once over all its elements. \n
+     * If the instruction is EVEX encoded, only the elements selected by its opmask are computed (see padloc_evex).
      * 
      * \param vect_a Memory reference to the first operand
      * \param vect_b Memory reference to the second operand 
      * \param vect_c Memory reference to the third operand 
+     * \param tls Memory reference to the destination
+     * \param thread Context of the thread
      */
-    static void apply(FTYPE *vect_a, FTYPE *vect_b, FTYPE *vect_c){
+    static void compute(FTYPE *vect_a, FTYPE *vect_b, FTYPE *vect_c, FTYPE *tls, plc_thread_context_t *thread){
+        void *context = thread->backend;
 
-        static const int vect_size =  (SIMD_TYPE == PLC_OP_128) ? 16 : (SIMD_TYPE == PLC_OP_256) ? 32
-                                    : (SIMD_TYPE == PLC_OP_512) ? 64 : sizeof(FTYPE);
-        static const int nb_elem = vect_size / sizeof(FTYPE);
-
-        static const int max_operation_size = (INSTR_CATEGORY == PLC_OP_SSE) ? 16
-                                            : (INSTR_CATEGORY == PLC_OP_AVX) ? 32
-                                            : sizeof(FTYPE);
-        static const int max_nb_elem = max_operation_size / sizeof(FTYPE);
-
-        FTYPE res;
-        FTYPE *tls = *(FTYPE **)(GET_TLS(dr_get_current_drcontext(), tls_result));
-
-        for(int i = 0; i < nb_elem; i++){
 #if defined(X86)
-            res = Backend_function(vect_a[i], vect_b[i], vect_c[i]);
+        static const uint32_t all = (uint32_t)((((uint64_t)1) << nb_elem) - 1);
+        const uint32_t control = EVEX ? (uint32_t)thread->evex_control : 0;
+        const uint32_t selected = EVEX ? padloc_evex::selected_elements(control, all, thread) : all;
+        if(EVEX && (selected != all || PLC_EVEX_BROADCAST(control) != 0)){
+            FTYPE a[nb_elem], b[nb_elem], c[nb_elem], res[nb_elem];
+            const int nb = padloc_evex::pack(vect_a, a, selected, PLC_EVEX_BROADCAST(control) == 1);
+            padloc_evex::pack(vect_b, b, selected, PLC_EVEX_BROADCAST(control) == 2);
+            padloc_evex::pack(vect_c, c, selected, PLC_EVEX_BROADCAST(control) == 3);
+            if(nb == 1){
+                res[0] = Backend_function(a[0], b[0], c[0], context);
+            }else if(nb > 1){
+                Backend_packed_function(a, b, c, res, nb, context);
+            }
+            padloc_evex::unpack(res, tls, selected, nb_elem, (control & PLC_EVEX_ZEROING) != 0);
+        }else
+#endif
+        if(nb_elem == 1){
+#if defined(X86)
+            *tls = Backend_function(*vect_a, *vect_b, *vect_c, context);
+#elif defined(AARCH64)
+            *tls = Backend_function(*vect_b, *vect_a, *vect_c, context);
+#endif
+        }else{
+#if defined(X86)
+            Backend_packed_function(vect_a, vect_b, vect_c, tls, nb_elem, context);
 #elif defined(AARCH64)
-            res = Backend_function(vect_b[i], vect_a[i], vect_c[i]);
+            Backend_packed_function(vect_b, vect_a, vect_c, tls, nb_elem, context);
 #endif
-            *(tls + i) = res;
         }
+    }
 
-        /* If this is an AVX instruction, set the high part with 0 */
+    /**
+     * \brief If this is an AVX instruction, set the high part of the destination \p tls with 0
+     */
+    static inline void zero_upper(FTYPE *tls){
         if(INSTR_CATEGORY == PLC_OP_AVX){
+            const int max_nb_elem = avx_register_size() / sizeof(FTYPE);
             for(int i = MAX(nb_elem, 16 / sizeof(FTYPE)); i < max_nb_elem; i++){
                 *(tls + i) = 0;
             }
         }
     }
+
+#if defined(X86)
+    /**
+     * \brief Computes the shadow samples of the operation, in lane mode
+     * \details See padloc_backend::compute_samples
+     * 
+     * \param thread Context of the thread, holding the shadow register file
+     */
+    static void compute_samples(plc_thread_context_t *thread){
+        const plc_samples_call_t &call = thread->shadow->call;
+        static const uint32_t all = (uint32_t)((((uint64_t)1) << nb_elem) - 1);
+        const uint32_t control = EVEX ? (uint32_t)thread->evex_control : 0;
+        if(EVEX && (padloc_evex::selected_elements(control, all, thread) != all || PLC_EVEX_BROADCAST(control) != 0)){
+            for(uint32_t k = 0; k < call.nb; k++){
+                compute((FTYPE *)call.sources[0][k], (FTYPE *)call.sources[1][k], (FTYPE *)call.sources[2][k],
+                        (FTYPE *)call.destinations[k], thread);
+            }
+            return;
+        }
+        FTYPE a[(PLC_MAX_LANE_SAMPLES - 1) * nb_elem], b[(PLC_MAX_LANE_SAMPLES - 1) * nb_elem],
+              c[(PLC_MAX_LANE_SAMPLES - 1) * nb_elem], res[(PLC_MAX_LANE_SAMPLES - 1) * nb_elem];
+        for(uint32_t k = 0; k < call.nb; k++){
+            memcpy(a + k * nb_elem, call.sources[0][k], vect_size);
+            memcpy(b + k * nb_elem, call.sources[1][k], vect_size);
+            memcpy(c + k * nb_elem, call.sources[2][k], vect_size);
+        }
+        Backend_packed_function(a, b, c, res, call.nb * nb_elem, thread->backend);
+        for(uint32_t k = 0; k < call.nb; k++){
+            memcpy(call.destinations[k], res + k * nb_elem, vect_size);
+            zero_upper((FTYPE *)call.destinations[k]);
+        }
+    }
+#endif
+
+    /**
+     * \brief Apply the backend function corresponding to the current overloaded instruction over the source operands
+     * 
+     * \details Computes the operation into the destination of the thread context (see compute).
+     * In lane mode, the shadow samples are computed first, as the destination may be one of the sources. \n
+     * If the overloaded instruction is AVX, set the high part of the register with 0.
+     * 
+     * \param vect_a Memory reference to the first operand
+     * \param vect_b Memory reference to the second operand 
+     * \param vect_c Memory reference to the third operand 
+     * \param thread Context of the thread, holding the destination
+     */
+    static void apply(FTYPE *vect_a, FTYPE *vect_b, FTYPE *vect_c, plc_thread_context_t *thread){
+        FTYPE *tls = (FTYPE *)thread->destination;
+#if defined(X86)
+        if(thread->shadow != nullptr){
+            compute_samples(thread);
+        }
+#endif
+        compute(vect_a, vect_b, vect_c, tls, thread);
+        zero_upper(tls);
+    }
+};
+
+/**
+ * \brief Dispatcher interpreting a run of instrumented instructions
+ * \details Called once per execution of the run when the backend is called
+ * per block (PLC_CALL_BLOCK). For each described instruction, the addresses of
+ * the sources are computed from the saved registers, the destination and the
+ * EVEX control word of the thread context are set, and the corresponding apply
+ * function of padloc_backend or padloc_backend_fused is called.
+ */
+struct padloc_block_backend{
+
+    /**
+     * \brief Returns the address of an operand described in the block table
+     * 
+     * \param opnd Description of the operand
+     * \param simd Address of the saved SIMD registers
+     * \param gpr Address of the saved GPR
+     * \return The address of the operand
+     */
+    static inline void *operand_address(const plc_operand_desc_t &opnd, byte *simd, const reg_t *gpr){
+        switch(opnd.kind){
+            case PLC_OPND_SIMD:
+                return simd + opnd.disp;
+            case PLC_OPND_BASE_DISP:
+                return (void *)((opnd.base != 0 ? gpr[opnd.base] : 0) +
+                                (opnd.index != 0 ? gpr[opnd.index] * opnd.scale : 0) + (ptr_int_t)opnd.disp);
+            default: /* PLC_OPND_ADDR */
+                return opnd.addr;
+        }
+    }
+
+#if defined(X86)
+    /**
+     * \brief Returns the register whose shadow samples belong to the content \p actual of \p reg
+     * 
+     * \details The samples of a register are valid while its content is the one it had when they
+     * were computed, kept as its tag. Otherwise, the samples of another register with the same
+     * content are used : the value was copied by uninstrumented instructions.
+     * 
+     * \param shadow Shadow register file of the thread
+     * \param reg Index of the register
+     * \param actual Content of the register
+     * \param size Size in bytes of the content
+     * \return The index of the register holding the samples, -1 if none
+     */
+    static inline int shadow_register(const plc_shadow_file_t *shadow, int reg, const byte *actual, size_t size){
+        if((shadow->written & (1U << reg)) && memcmp(shadow->tags[reg], actual, MIN(size, shadow->tag_size[reg])) == 0){
+            return reg;
+        }
+        for(int r = 0; r < PLC_NB_SHADOW_REGS; r++){
+            if((shadow->written & (1U << r)) && memcmp(shadow->tags[r], actual, MIN(size, shadow->tag_size[r])) == 0){
+                return r;
+            }
+        }
+        return -1;
+    }
+
+    /**
+     * \brief Sets the operands of each shadow sample of the instruction \p desc
+     * 
+     * \details A SIMD source reads the samples of its register, or its actual content if it has none.
+     * A memory source is the same for every sample. The samples of the destination are first set to
+     * the samples of its current content, so that the elements not computed are kept.
+     * 
+     * \param desc Description of the instruction
+     * \param srcs Addresses of the sources
+     * \param shadow Shadow register file of the thread
+     * \param simd Address of the saved SIMD registers
+     */
+    static void prepare_samples(const plc_instr_desc_t &desc, void *const *srcs, plc_shadow_file_t *shadow, byte *simd){
+        plc_samples_call_t &call = shadow->call;
+        for(uint32_t s = 0; s < desc.nb_srcs; s++){
+            const int r = desc.args[s].kind == PLC_OPND_SIMD ?
+                          shadow_register(shadow, desc.args[s].simd, (const byte *)srcs[s], desc.simd_slot_size) : -1;
+            for(uint32_t k = 0; k < call.nb; k++){
+                call.sources[s][k] = r < 0 ? srcs[s] : (void *)shadow->samples[r * call.nb + k];
+            }
+        }
+        const byte *actual = simd + desc.dst_offset;
+        const int r = shadow_register(shadow, desc.dst_simd, actual, desc.simd_slot_size);
+        for(uint32_t k = 0; k < call.nb; k++){
+            call.destinations[k] = shadow->samples[desc.dst_simd * call.nb + k];
+            if(r != desc.dst_simd){
+                memcpy(call.destinations[k], r < 0 ? actual : shadow->samples[r * call.nb + k], desc.simd_slot_size);
+            }
+        }
+    }
+#endif
+
+    /**
+     * \brief Apply the backend functions of every instruction of \p block, in order
+     * 
+     * \details In lane mode, the shadow samples of the destination are computed with the actual
+     * result, which becomes the tag of the destination. In recording mode, each operation is
+     * recorded with its sources before being computed.
+     * 
+     * \param block Descriptor table of the run
+     * \param thread Context of the thread
+     */
+    static void apply(const plc_block_desc_t *block, plc_thread_context_t *thread){
+        byte *simd = thread->simd;
+        const reg_t *gpr = thread->gpr;
+
+        for(uint32_t i = 0; i < block->count; i++){
+            const plc_instr_desc_t &desc = block->instrs[i];
+            void *a = operand_address(desc.args[0], simd, gpr);
+            void *b = operand_address(desc.args[1], simd, gpr);
+            void *c = desc.nb_srcs == 3 ? operand_address(desc.args[2], simd, gpr) : nullptr;
+            if(thread->trace){
+                void *srcs[3] = {a, b, c};
+                plc_trace_record(desc, srcs);
+            }
+#if defined(X86)
+            plc_shadow_file_t *shadow = thread->shadow;
+            if(shadow != nullptr){
+                void *srcs[3] = {a, b, c};
+                prepare_samples(desc, srcs, shadow, simd);
+            }
+#endif
+            thread->destination = simd + desc.dst_offset;
+            thread->evex_control = desc.evex_control;
+            if(desc.nb_srcs == 3){
+                ((void (*)(void *, void *, void *, plc_thread_context_t *))desc.apply)(a, b, c, thread);
+            }else{
+                ((void (*)(void *, void *, plc_thread_context_t *))desc.apply)(a, b, thread);
+            }
+#if defined(X86)
+            if(shadow != nullptr){
+                memcpy(shadow->tags[desc.dst_simd], simd + desc.dst_offset, desc.simd_slot_size);
+                shadow->tag_size[desc.dst_simd] = desc.simd_slot_size;
+                shadow->written |= 1U << desc.dst_simd;
+            }
+#endif
+        }
+    }
 };
 
 void translate_insert(instr_t *newinstr, instrlist_t *ilist, instr_t *instr){
@@ -303,123 +874,112 @@ void translate_insert(instr_t *newinstr, instrlist_t *ilist, instr_t *instr){
 }
 
 /**
- * \brief Subset of insert_call for two sources instructions
+ * \brief Subset of get_backend_apply for two sources instructions
  
- * \param drcontext DynamoRIO context
- * \param bb Basic Block instructions list
- * \param instr The reference instruction in the list to insert the call
  * \param oc The flags associated to the current overloaded instruction
  * \tparam FTYPE Floating point precision : Double of Float
  * \tparam FTYPE (*Backend_function)(FTYPE) Function pointer to the backend implementation
+ * \tparam Backend_packed_function Function pointer to the packed backend implementation
+ * \tparam EVEX True to get the EVEX variant of padloc_backend, selected from \p oc by the default call
+ * \return The apply function of the corresponding padloc_backend
  */
-template<typename FTYPE, FTYPE (*Backend_function)(FTYPE, FTYPE)>
-void insert_corresponding_vect_call(void *drcontext, instrlist_t *bb, instr_t *instr, OPERATION_CATEGORY oc){
+template<typename FTYPE, FTYPE (*Backend_function)(FTYPE, FTYPE, void*), void (*Backend_packed_function)(const FTYPE*, const FTYPE*, FTYPE*, int, void*),
+         bool EVEX = false>
+void *get_corresponding_vect_apply(OPERATION_CATEGORY oc){
+    if(!EVEX && (oc & PLC_OP_EVEX)){
+        return get_corresponding_vect_apply<FTYPE, Backend_function, Backend_packed_function, true>(oc);
+    }
     switch(oc & PLC_SIMD_TYPE_MASK){
         case PLC_OP_128:
             if(oc & PLC_OP_SSE){
-                dr_insert_call(drcontext, bb, instr,
-                               (void *)padloc_backend<FTYPE, Backend_function, PLC_OP_SSE, PLC_OP_128>::apply, 0);
+                return (void *)padloc_backend<FTYPE, Backend_function, Backend_packed_function, PLC_OP_SSE, PLC_OP_128>::apply;
             }else{
-                dr_insert_call(drcontext, bb, instr,
-                               (void *)padloc_backend<FTYPE, Backend_function, PLC_OP_AVX, PLC_OP_128>::apply, 0);
+                return (void *)padloc_backend<FTYPE, Backend_function, Backend_packed_function, PLC_OP_AVX, PLC_OP_128, EVEX>::apply;
             }
-            break;
         case PLC_OP_256:
-            dr_insert_call(drcontext, bb, instr, (void *)padloc_backend<FTYPE, Backend_function, PLC_OP_AVX, PLC_OP_256>::apply,
-                           0);
-            break;
+            return (void *)padloc_backend<FTYPE, Backend_function, Backend_packed_function, PLC_OP_AVX, PLC_OP_256, EVEX>::apply;
         case PLC_OP_512:
-            dr_insert_call(drcontext, bb, instr, (void *)padloc_backend<FTYPE, Backend_function, PLC_OP_AVX, PLC_OP_512>::apply,
-                           0);
-            break;
+            return (void *)padloc_backend<FTYPE, Backend_function, Backend_packed_function, PLC_OP_AVX, PLC_OP_512, EVEX>::apply;
         default: /*SCALAR */
             if(oc & PLC_OP_SSE){
-                dr_insert_call(drcontext, bb, instr, (void *)padloc_backend<FTYPE, Backend_function, PLC_OP_SSE>::apply, 0);
+                return (void *)padloc_backend<FTYPE, Backend_function, Backend_packed_function, PLC_OP_SSE>::apply;
             }else{
-                dr_insert_call(drcontext, bb, instr, (void *)padloc_backend<FTYPE, Backend_function, PLC_OP_AVX>::apply, 0);
+                return (void *)padloc_backend<FTYPE, Backend_function, Backend_packed_function, PLC_OP_AVX, PLC_OP_SCALAR, EVEX>::apply;
             }
     }
 }
 
 /**
- * \brief Subset of insert_call for three sources instructions
+ * \brief Subset of get_backend_apply for three sources instructions
  
- * \param drcontext DynamoRIO context
- * \param bb Basic Block instructions list
- * \param instr The reference instruction in the list to insert the call
  * \param oc The flags associated to the current overloaded instruction
  * \tparam FTYPE Floating point precision : Double of Float
  * \tparam FTYPE (*Backend_function)(FTYPE) Function pointer to the backend implementation
+ * \tparam Backend_packed_function Function pointer to the packed backend implementation
+ * \tparam EVEX True to get the EVEX variant of padloc_backend_fused, selected from \p oc by the default call
+ * \return The apply function of the corresponding padloc_backend_fused
  */
-template<typename FTYPE, FTYPE (*Backend_function)(FTYPE, FTYPE, FTYPE)>
-void insert_corresponding_vect_call_fused(void *drcontext, instrlist_t *bb, instr_t *instr, OPERATION_CATEGORY oc){
+template<typename FTYPE, FTYPE (*Backend_function)(FTYPE, FTYPE, FTYPE, void*),
+         void (*Backend_packed_function)(const FTYPE*, const FTYPE*, const FTYPE*, FTYPE*, int, void*), bool EVEX = false>
+void *get_corresponding_vect_apply_fused(OPERATION_CATEGORY oc){
+    if(!EVEX && (oc & PLC_OP_EVEX)){
+        return get_corresponding_vect_apply_fused<FTYPE, Backend_function, Backend_packed_function, true>(oc);
+    }
     switch(oc & PLC_SIMD_TYPE_MASK){
         case PLC_OP_128:
             if(oc & PLC_OP_SSE){
-                dr_insert_call(drcontext, bb, instr,
-                               (void *)padloc_backend_fused<FTYPE, Backend_function, PLC_OP_SSE, PLC_OP_128>::apply, 0);
+                return (void *)padloc_backend_fused<FTYPE, Backend_function, Backend_packed_function, PLC_OP_SSE, PLC_OP_128>::apply;
             }else{
-                dr_insert_call(drcontext, bb, instr,
-                               (void *)padloc_backend_fused<FTYPE, Backend_function, PLC_OP_AVX, PLC_OP_128>::apply, 0);
+                return (void *)padloc_backend_fused<FTYPE, Backend_function, Backend_packed_function, PLC_OP_AVX, PLC_OP_128, EVEX>::apply;
             }
-            break;
         case PLC_OP_256:
-            dr_insert_call(drcontext, bb, instr,
-                           (void *)padloc_backend_fused<FTYPE, Backend_function, PLC_OP_AVX, PLC_OP_256>::apply, 0);
-            break;
+            return (void *)padloc_backend_fused<FTYPE, Backend_function, Backend_packed_function, PLC_OP_AVX, PLC_OP_256, EVEX>::apply;
         case PLC_OP_512:
-            dr_insert_call(drcontext, bb, instr,
-                           (void *)padloc_backend_fused<FTYPE, Backend_function, PLC_OP_AVX, PLC_OP_512>::apply, 0);
-            break;
-
+            return (void *)padloc_backend_fused<FTYPE, Backend_function, Backend_packed_function, PLC_OP_AVX, PLC_OP_512, EVEX>::apply;
         default: /*SCALAR */
             if(oc & PLC_OP_SSE){
-                dr_insert_call(drcontext, bb, instr, (void *)padloc_backend_fused<FTYPE, Backend_function, PLC_OP_SSE>::apply,
-                               0);
+                return (void *)padloc_backend_fused<FTYPE, Backend_function, Backend_packed_function, PLC_OP_SSE>::apply;
             }else{
-                dr_insert_call(drcontext, bb, instr, (void *)padloc_backend_fused<FTYPE, Backend_function, PLC_OP_AVX>::apply,
-                               0);
+                return (void *)padloc_backend_fused<FTYPE, Backend_function, Backend_packed_function, PLC_OP_AVX, PLC_OP_SCALAR, EVEX>::apply;
             }
     }
 }
 
 /**
- * \brief Insert the call depending on the current overloaded instruction features.
+ * \brief Returns the backend function corresponding to the current overloaded instruction features.
  * 
- * \param drcontext DynamoRIO context
- * \param bb Basic Block instructions list
- * \param instr The reference instruction in the list to insert the call
  * \param oc The flags associated to the current overloaded instruction
  * \param is_double True if the instruction is performed in double precision, False if it is in single precision
+ * \return The apply function to call, nullptr if the operation is unknown
  */
-void insert_call(void *drcontext, instrlist_t *bb, instr_t *instr, OPERATION_CATEGORY oc, bool is_double){
+static void *get_backend_apply(OPERATION_CATEGORY oc, bool is_double){
     if(oc & PLC_OP_FUSED){
         if(oc & PLC_OP_FMA){
             if(!(oc & PLC_OP_NEG)){
                 if(is_double){
-                    insert_corresponding_vect_call_fused<double, Interflop::Op<double>::fmadd>(drcontext, bb, instr, oc);
+                    return get_corresponding_vect_apply_fused<double, Interflop::Op<double>::fmadd, Interflop::Op<double>::fmadd_packed>(oc);
                 }else{
-                    insert_corresponding_vect_call_fused<float, Interflop::Op<float>::fmadd>(drcontext, bb, instr, oc);
+                    return get_corresponding_vect_apply_fused<float, Interflop::Op<float>::fmadd, Interflop::Op<float>::fmadd_packed>(oc);
                 }
             }else{
                 if(is_double){
-                    insert_corresponding_vect_call_fused<double, Interflop::Op<double>::nfmadd>(drcontext, bb, instr, oc);
+                    return get_corresponding_vect_apply_fused<double, Interflop::Op<double>::nfmadd, Interflop::Op<double>::nfmadd_packed>(oc);
                 }else{
-                    insert_corresponding_vect_call_fused<float, Interflop::Op<float>::nfmadd>(drcontext, bb, instr, oc);
+                    return get_corresponding_vect_apply_fused<float, Interflop::Op<float>::nfmadd, Interflop::Op<float>::nfmadd_packed>(oc);
                 }
             }
         }else if(oc & PLC_OP_FMS){
             if(!(oc & PLC_OP_NEG)){
                 if(is_double){
-                    insert_corresponding_vect_call_fused<double, Interflop::Op<double>::fmsub>(drcontext, bb, instr, oc);
+                    return get_corresponding_vect_apply_fused<double, Interflop::Op<double>::fmsub, Interflop::Op<double>::fmsub_packed>(oc);
                 }else{
-                    insert_corresponding_vect_call_fused<float, Interflop::Op<float>::fmsub>(drcontext, bb, instr, oc);
+                    return get_corresponding_vect_apply_fused<float, Interflop::Op<float>::fmsub, Interflop::Op<float>::fmsub_packed>(oc);
                 }
             }else{
                 if(is_double){
-                    insert_corresponding_vect_call_fused<double, Interflop::Op<double>::nfmsub>(drcontext, bb, instr, oc);
+                    return get_corresponding_vect_apply_fused<double, Interflop::Op<double>::nfmsub, Interflop::Op<double>::nfmsub_packed>(oc);
                 }else{
-                    insert_corresponding_vect_call_fused<float, Interflop::Op<float>::nfmsub>(drcontext, bb, instr, oc);
+                    return get_corresponding_vect_apply_fused<float, Interflop::Op<float>::nfmsub, Interflop::Op<float>::nfmsub_packed>(oc);
                 }
             }
         }
@@ -427,48 +987,465 @@ void insert_call(void *drcontext, instrlist_t *bb, instr_t *instr, OPERATION_CAT
         switch(oc & PLC_OP_TYPE_MASK){
             case PLC_OP_ADD:
                 if(is_double){
-                    insert_corresponding_vect_call<double, Interflop::Op<double>::add>(drcontext, bb, instr, oc);
+                    return get_corresponding_vect_apply<double, Interflop::Op<double>::add, Interflop::Op<double>::add_packed>(oc);
                 }else{
-                    insert_corresponding_vect_call<float, Interflop::Op<float>::add>(drcontext, bb, instr, oc);
+                    return get_corresponding_vect_apply<float, Interflop::Op<float>::add, Interflop::Op<float>::add_packed>(oc);
                 }
-                break;
             case PLC_OP_SUB:
                 if(is_double){
-                    insert_corresponding_vect_call<double, Interflop::Op<double>::sub>(drcontext, bb, instr, oc);
+                    return get_corresponding_vect_apply<double, Interflop::Op<double>::sub, Interflop::Op<double>::sub_packed>(oc);
                 }else{
-                    insert_corresponding_vect_call<float, Interflop::Op<float>::sub>(drcontext, bb, instr, oc);
+                    return get_corresponding_vect_apply<float, Interflop::Op<float>::sub, Interflop::Op<float>::sub_packed>(oc);
                 }
-                break;
             case PLC_OP_MUL:
                 if(is_double){
-                    insert_corresponding_vect_call<double, Interflop::Op<double>::mul>(drcontext, bb, instr, oc);
+                    return get_corresponding_vect_apply<double, Interflop::Op<double>::mul, Interflop::Op<double>::mul_packed>(oc);
                 }else{
-                    insert_corresponding_vect_call<float, Interflop::Op<float>::mul>(drcontext, bb, instr, oc);
+                    return get_corresponding_vect_apply<float, Interflop::Op<float>::mul, Interflop::Op<float>::mul_packed>(oc);
                 }
-                break;
             case PLC_OP_DIV:
                 if(is_double){
-                    insert_corresponding_vect_call<double, Interflop::Op<double>::div>(drcontext, bb, instr, oc);
+                    return get_corresponding_vect_apply<double, Interflop::Op<double>::div, Interflop::Op<double>::div_packed>(oc);
                 }else{
-                    insert_corresponding_vect_call<float, Interflop::Op<float>::div>(drcontext, bb, instr, oc);
+                    return get_corresponding_vect_apply<float, Interflop::Op<float>::div, Interflop::Op<float>::div_packed>(oc);
                 }
-                break;
-            default:
-                PRINT_ERROR_MESSAGE("ERROR OPERATION NOT FOUND !");
         }
     }
+    return nullptr;
+}
+
+/**
+ * \brief Insert the call depending on the current overloaded instruction features.
+ * 
+ * \param drcontext DynamoRIO context
+ * \param bb Basic Block instructions list
+ * \param instr The reference instruction in the list to insert the call
+ * \param oc The flags associated to the current overloaded instruction
+ * \param is_double True if the instruction is performed in double precision, False if it is in single precision
+ */
+void insert_call(void *drcontext, instrlist_t *bb, instr_t *instr, OPERATION_CATEGORY oc, bool is_double){
+    void *apply = get_backend_apply(oc, is_double);
+    if(apply == nullptr){
+        PRINT_ERROR_MESSAGE("ERROR OPERATION NOT FOUND !");
+        return;
+    }
+    //The thread context follows the sources
+    INSERT_READ_TLS(drcontext, tls_result, bb, instr, (oc & PLC_OP_FUSED) ? DR_REG_OP_D_ADDR : DR_REG_OP_C_ADDR);
+    dr_insert_call(drcontext, bb, instr, apply, 0);
+}
+
+#if defined(X86) && defined(X64)
+/**
+ * \def SCALAR_OPCODE
+ * \brief Gives the opcode of the scalar instruction \p name (add, sub, mul,
+ * mov, ucomi) in the right precision, VEX encoded if AVX is supported
+ */
+#define SCALAR_OPCODE(name, is_double) \
+        (AVX_SUPPORTED ? ((is_double) ? OP_v##name##sd : OP_v##name##ss) \
+                       : ((is_double) ? OP_##name##sd : OP_##name##ss))
+
+/**
+ * Scratch SIMD registers used by the exact fast path
+ */
+static const reg_id_t FAST_PATH_XMM[] = {DR_REG_XMM11, DR_REG_XMM12, DR_REG_XMM13, DR_REG_XMM14, DR_REG_XMM15};
+
+/**
+ * Constants used by the exact fast path for double precision products :
+ * the mask giving the absolute value, and the smallest magnitude (2^-969)
+ * for which the error of a product is representable
+ */
+alignas(16) static const uint64_t FAST_PATH_DOUBLE_CONSTANTS[4] = {
+    0x7fffffffffffffffULL, 0x7fffffffffffffffULL, 0x0360000000000000ULL, 0
+};
+
+/**
+ * Same as FAST_PATH_DOUBLE_CONSTANTS in single precision (2^-101)
+ */
+alignas(16) static const uint32_t FAST_PATH_FLOAT_CONSTANTS[8] = {
+    0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff, 0x0d000000, 0, 0, 0
+};
+
+/**
+ * \brief Returns true if the exact fast path can be used for an instruction of category \p oc
+ * \details Only scalar additions, subtractions and, if FMA is supported, multiplications are handled.
+ * EVEX encoded instructions, which may be masked, are left to the backend.
+ */
+static bool has_exact_fast_path(OPERATION_CATEGORY oc){
+    if(!(oc & PLC_OP_SCALAR) || plc_is_fused(oc) || (oc & PLC_OP_EVEX)){
+        return false;
+    }
+    switch(oc & PLC_OP_TYPE_MASK){
+        case PLC_OP_ADD:
+        case PLC_OP_SUB:
+            return true;
+        case PLC_OP_MUL:
+            return proc_has_feature(FEATURE_FMA);
+        default:
+            return false;
+    }
+}
+
+/**
+ * \brief Inserts prior to \p where the meta-instructions for dst = src1 <op> src2
+ * \details Without AVX, the two operands form is used, copying src1 to dst first if needed.
+ * 
+ * \param drcontext DynamoRIO's context
+ * \param bb Current basic block
+ * \param where Instruction prior to whom we insert the meta-instructions
+ * \param opcode Opcode of the operation, from SCALAR_OPCODE
+ * \param dst Destination register
+ * \param src1 First source register
+ * \param src2 Second source register, must be different from dst without AVX
+ */
+static void insert_scalar_op(void *drcontext, instrlist_t *bb, instr_t *where, int opcode,
+                             reg_id_t dst, reg_id_t src1, reg_id_t src2){
+    if(AVX_SUPPORTED){
+        MINSERT(bb, where, instr_create_1dst_2src(drcontext, opcode, OP_REG(dst), OP_REG(src1), OP_REG(src2)));
+    }else{
+        if(dst != src1){
+            MINSERT(bb, where, INSTR_CREATE_movapd(drcontext, OP_REG(dst), OP_REG(src1)));
+        }
+        MINSERT(bb, where, instr_create_1dst_2src(drcontext, opcode, OP_REG(dst), OP_REG(src2), OP_REG(dst)));
+    }
+}
+#endif
+
+instr_t *insert_exact_fast_path(void *drcontext, instrlist_t *bb, instr_t *where, instr_t *instr, OPERATION_CATEGORY oc,
+                                const plc_register_set_t *regs){
+#if defined(X86) && defined(X64)
+    if(!get_exact_fast_path() || !has_exact_fast_path(oc)){
+        return nullptr;
+    }
+    const bool is_double = plc_is_double(oc);
+    const opnd_size_t size = is_double ? OPSZ_8 : OPSZ_4;
+    const reg_id_t A = FAST_PATH_XMM[0], B = FAST_PATH_XMM[1], S = FAST_PATH_XMM[2],
+                   E = FAST_PATH_XMM[3], T = FAST_PATH_XMM[4];
+    //Register holding the error term
+    reg_id_t error = A;
+    instr_t *slow = INSTR_CREATE_label(drcontext), *done = INSTR_CREATE_label(drcontext);
+
+    //Address of the saved destination register in OP_C (unused by non fused operations)
+    INSERT_READ_TLS(drcontext, get_index_tls_float(), bb, where, DR_REG_OP_C_ADDR);
+    MINSERT(bb, where, INSTR_CREATE_lea(drcontext, OP_REG(DR_REG_OP_C_ADDR),
+                                        OP_BASE_DISP(DR_REG_OP_C_ADDR, offset_of_simd(regs, GET_REG(DST(instr, 0))), OPSZ_lea)));
+    //Load the operands, in the order of the backend parameters
+    MINSERT(bb, where, instr_create_1dst_1src(drcontext, SCALAR_OPCODE(mov, is_double), OP_REG(A),
+                                              OP_BASE_DISP(DR_REG_OP_A_ADDR, 0, size)));
+    MINSERT(bb, where, instr_create_1dst_1src(drcontext, SCALAR_OPCODE(mov, is_double), OP_REG(B),
+                                              OP_BASE_DISP(DR_REG_OP_B_ADDR, 0, size)));
+
+    if((oc & PLC_OP_TYPE_MASK) == PLC_OP_MUL){
+        //TwoProd : s = a*b, e = fma(a, b, -s). FMA implies AVX, so only VEX instructions are used
+        insert_scalar_op(drcontext, bb, where, SCALAR_OPCODE(mul, is_double), S, A, B);
+        //The error is only representable if |s| is big enough, otherwise go to the backend
+        MINSERT(bb, where, XINST_CREATE_load_int(drcontext, OP_REG(DR_REG_R11),
+                                                 OPND_CREATE_INTPTR(is_double ? (const void *)FAST_PATH_DOUBLE_CONSTANTS
+                                                                              : (const void *)FAST_PATH_FLOAT_CONSTANTS)));
+        MINSERT(bb, where, instr_create_1dst_2src(drcontext, OP_vandps, OP_REG(T), OP_REG(S),
+                                                  OP_BASE_DISP(DR_REG_R11, 0, OPSZ_16)));
+        MINSERT(bb, where, instr_create_0dst_2src(drcontext, SCALAR_OPCODE(ucomi, is_double), OP_REG(T),
+                                                  OP_BASE_DISP(DR_REG_R11, 16, size)));
+        MINSERT(bb, where, INSTR_CREATE_jcc(drcontext, OP_jb, opnd_create_instr(slow)));
+        MINSERT(bb, where, INSTR_CREATE_vmovapd(drcontext, OP_REG(E), OP_REG(A)));
+        MINSERT(bb, where, is_double ? INSTR_CREATE_vfmsub213sd(drcontext, OP_REG(E), OP_REG(B), OP_REG(S))
+                                     : INSTR_CREATE_vfmsub213ss(drcontext, OP_REG(E), OP_REG(B), OP_REG(S)));
+        error = E;
+    }else{
+        //TwoSum : s = a+b, bb = s-a, e = (a-(s-bb)) + (b-bb)
+        const bool is_sub = (oc & PLC_OP_TYPE_MASK) == PLC_OP_SUB;
+        const int op = is_sub ? SCALAR_OPCODE(sub, is_double) : SCALAR_OPCODE(add, is_double);
+        const int inv = is_sub ? SCALAR_OPCODE(add, is_double) : SCALAR_OPCODE(sub, is_double);
+        insert_scalar_op(drcontext, bb, where, op, S, A, B);
+        insert_scalar_op(drcontext, bb, where, SCALAR_OPCODE(sub, is_double), E, S, A);
+        insert_scalar_op(drcontext, bb, where, SCALAR_OPCODE(sub, is_double), T, S, E);
+        insert_scalar_op(drcontext, bb, where, SCALAR_OPCODE(sub, is_double), A, A, T);
+        insert_scalar_op(drcontext, bb, where, inv, B, B, E);
+        insert_scalar_op(drcontext, bb, where, op, A, A, B);
+    }
+    //Go to the backend if the error isn't zero (or is NaN)
+    insert_scalar_op(drcontext, bb, where, AVX_SUPPORTED ? OP_vxorps : OP_xorps, T, T, T);
+    MINSERT(bb, where, instr_create_0dst_2src(drcontext, SCALAR_OPCODE(ucomi, is_double), OP_REG(error), OP_REG(T)));
+    MINSERT(bb, where, INSTR_CREATE_jcc(drcontext, OP_jne, opnd_create_instr(slow)));
+    MINSERT(bb, where, INSTR_CREATE_jcc(drcontext, OP_jp, opnd_create_instr(slow)));
+    //The result is exact, write it like the backend would
+    MINSERT(bb, where, instr_create_1dst_1src(drcontext, SCALAR_OPCODE(mov, is_double),
+                                              OP_BASE_DISP(DR_REG_OP_C_ADDR, 0, size), OP_REG(S)));
+    if(oc & PLC_OP_AVX){
+        MINSERT(bb, where, INSTR_CREATE_vmovups(drcontext, OP_BASE_DISP(DR_REG_OP_C_ADDR, 16, OPSZ_16), OP_REG(T)));
+        if(avx_register_size() == 64){
+            MINSERT(bb, where, INSTR_CREATE_vmovups(drcontext, OP_BASE_DISP(DR_REG_OP_C_ADDR, 32, OPSZ_32),
+                                                    OP_REG(reg_resize_to_opsz(T, OPSZ_32))));
+        }
+    }
+    MINSERT(bb, where, INSTR_CREATE_jmp(drcontext, opnd_create_instr(done)));
+    MINSERT(bb, where, slow);
+    return done;
+#else //AArch64
+    DR_ASSERT_MSG(false, "insert_exact_fast_path not implemented for this architecture");
+    return nullptr;
+#endif
+}
+
+#if defined(X86) && defined(X64)
+/**
+ * \def ALL_GPR_SLOTS
+ * \brief Mask selecting every slot of the gpr tls (flags included)
+ */
+#define ALL_GPR_SLOTS ((uint32_t)(((uint64_t)1 << NUM_GPR_SLOTS) - 1))
+
+/**
+ * \def GPR_BIT
+ * \brief Bit of the register set designating the slot of the GPR \p reg
+ */
+#define GPR_BIT(reg) ((uint32_t)1 << gpr_slot((reg)))
+
+/**
+ * \def SIMD_BIT
+ * \brief Bit of the register set designating the SIMD register \p reg
+ */
+#define SIMD_BIT(reg) ((uint32_t)1 << simd_index((reg)))
+
+/**
+ * \def FLAGS_BIT
+ * \brief Bit of the register set designating the arithmetic flags
+ */
+#define FLAGS_BIT ((uint32_t)1)
+
+/**
+ * \def ALL_OPMASK_REGISTERS
+ * \brief Mask selecting every opmask register
+ */
+#define ALL_OPMASK_REGISTERS ((uint32_t)((1U << NUM_OPMASK_SLOTS) - 1))
+
+/**
+ * \brief Returns the mask selecting every saved SIMD register
+ * \details 32 ZMM registers if AVX 512 is supported, else 16 YMM or XMM
+ */
+static uint32_t all_simd_registers(){
+    return AVX_512_SUPPORTED ? (uint32_t)((((uint64_t)1) << NB_ZMM_REG) - 1)
+                             : (((uint32_t)1) << NB_XMM_REG) - 1;
+}
+
+/**
+ * \def CALLER_SAVED_GPRS
+ * \brief Mask selecting the GPR any function may modify under the SysV calling convention
+ */
+#define CALLER_SAVED_GPRS (GPR_BIT(DR_REG_XAX) | GPR_BIT(DR_REG_XCX) | GPR_BIT(DR_REG_XDX) | \
+                           GPR_BIT(DR_REG_XSI) | GPR_BIT(DR_REG_XDI) | GPR_BIT(DR_REG_R8) |  \
+                           GPR_BIT(DR_REG_R9) | GPR_BIT(DR_REG_R10) | GPR_BIT(DR_REG_R11))
+
+/**
+ * \brief Returns the width of the part of the SIMD registers the backend may modify
+ * \details The width found by the backend analysis, unless it couldn't follow
+ * every path of the backend : a function it didn't analyse may use any register.
+ */
+static int backend_simd_write_width(){
+    return get_call_graph_resolved() ? get_simd_write_width() : 64;
+}
+
+/**
+ * \brief Returns the registers which may be modified by a call to the backend
+ * \details Computed once from the registers found by the backend analysis
+ * plugin. The calling convention registers, the arithmetic flags and R11
+ * (used by dr_insert_call when the callee is not reachable) are always part
+ * of the set. Unless the analysis followed every path of the backend, the
+ * registers any function may modify under the SysV calling convention are
+ * added : every caller-saved GPR and every SIMD register. If the analysis
+ * didn't find any register, every register is considered clobbered.
+ */
+static const plc_register_set_t &backend_clobbered_registers(){
+    static const plc_register_set_t clobbered = [](){
+        plc_register_set_t set;
+        std::vector<reg_id_t> gpr = get_gpr_reg(), simd = get_float_reg();
+        if(gpr.empty() && simd.empty()){
+            set.gpr = ALL_GPR_SLOTS;
+            set.simd = all_simd_registers();
+            return set;
+        }
+        set.gpr = FLAGS_BIT | GPR_BIT(DR_REG_OP_A_ADDR) | GPR_BIT(DR_REG_OP_B_ADDR) |
+                  GPR_BIT(DR_REG_OP_C_ADDR) | GPR_BIT(DR_REG_OP_D_ADDR) | GPR_BIT(DR_REG_R11);
+        set.simd = 0;
+        for(auto reg : gpr){
+            if(IS_GPR(reg)){
+                set.gpr |= GPR_BIT(reg);
+            }
+        }
+        for(auto reg : simd){
+            if(IS_XMM(reg) || IS_YMM(reg) || IS_ZMM(reg)){
+                set.simd |= SIMD_BIT(reg);
+            }
+        }
+        if(!get_call_graph_resolved()){
+            set.gpr |= CALLER_SAVED_GPRS;
+            set.simd = all_simd_registers();
+        }
+        set.simd &= all_simd_registers();
+        return set;
+    }();
+    return clobbered;
+}
+
+/**
+ * \brief Updates \p live with the registers read and written by \p instr,
+ * going backward
+ * \details A register is removed from the set when fully overwritten by the
+ * instruction, and added when read. Instrumented instructions are considered
+ * to read all of their SIMD operands, since their instrumentation saves and
+ * restores them.
+ * 
+ * \param instr Instruction of the basic block
+ * \param live Registers live after \p instr, becomes the registers live before it
+ */
+static void update_liveness(instr_t *instr, plc_register_set_t *live){
+    if(instr_is_cti(instr) || instr_is_syscall(instr) || instr_is_interrupt(instr)){
+        live->gpr = ALL_GPR_SLOTS;
+        live->simd = all_simd_registers();
+        return;
+    }
+    uint flags = instr_get_arith_flags(instr, DR_QUERY_DEFAULT);
+    if(TESTALL(EFLAGS_WRITE_6, flags)){
+        live->gpr &= ~FLAGS_BIT;
+    }
+    if(TESTANY(EFLAGS_READ_6, flags)){
+        live->gpr |= FLAGS_BIT;
+    }
+    for(size_t i = 1; i < NUM_GPR_SLOTS; i++){
+        reg_id_t reg = GPR_ORDER[i];
+        if(instr_writes_to_exact_reg(instr, reg, DR_QUERY_DEFAULT) ||
+           instr_writes_to_exact_reg(instr, reg_64_to_32(reg), DR_QUERY_DEFAULT)){
+            live->gpr &= ~GPR_BIT(reg);
+        }
+        if(instr_reads_from_reg(instr, reg, DR_QUERY_DEFAULT)){
+            live->gpr |= GPR_BIT(reg);
+        }
+    }
+    const bool instrumented = plc_is_instrumented(plc_get_operation_category(instr));
+    const int nb_simd = AVX_512_SUPPORTED ? NB_ZMM_REG : NB_XMM_REG;
+    const reg_id_t start = AVX_512_SUPPORTED ? DR_REG_START_ZMM : AVX_SUPPORTED ? DR_REG_START_YMM : DR_REG_START_XMM;
+    for(int i = 0; i < nb_simd; i++){
+        reg_id_t reg = start + i;
+        if(instrumented){
+            if(instr_reads_from_reg(instr, reg, DR_QUERY_DEFAULT) || instr_writes_to_reg(instr, reg, DR_QUERY_DEFAULT)){
+                live->simd |= SIMD_BIT(reg);
+            }
+            continue;
+        }
+        if(instr_writes_to_exact_reg(instr, reg, DR_QUERY_DEFAULT) ||
+           (AVX_SUPPORTED && !AVX_512_SUPPORTED && instr_zeroes_ymmh(instr) &&
+            instr_writes_to_exact_reg(instr, DR_REG_START_XMM + i, DR_QUERY_DEFAULT))){
+            live->simd &= ~SIMD_BIT(reg);
+        }
+        if(instr_reads_from_reg(instr, reg, DR_QUERY_DEFAULT)){
+            live->simd |= SIMD_BIT(reg);
+        }
+    }
+}
+
+/**
+ * \brief Adds to \p regs the registers needed to instrument \p instr
+ * \details Those are the SIMD sources and destination, which are read from
+ * and written to the float tls, the GPR used to compute the address of a
+ * memory operand, which are read from the gpr tls, and the opmask register
+ * of an EVEX instruction, read by the backend.
+ * 
+ * \param instr Instrumented instruction
+ * \param regs Register set to update
+ */
+static void add_operand_registers(instr_t *instr, plc_register_set_t *regs){
+    if(plc_first_source(instr) != 0){
+        regs->opmask |= 1U << (GET_REG(instr_get_src(instr, 0)) - DR_REG_K0);
+    }
+    for(int i = 0; i < instr_num_srcs(instr) - plc_first_source(instr); i++){
+        opnd_t src = SRC(instr, i);
+        if(IS_REG(src)){
+            reg_id_t reg = GET_REG(src);
+            if(IS_XMM(reg) || IS_YMM(reg) || IS_ZMM(reg)){
+                regs->simd |= SIMD_BIT(reg);
+            }
+        }else if(OP_IS_BASE_DISP(src)){
+            reg_id_t base = opnd_get_base(src), index = opnd_get_index(src);
+            if(base != DR_REG_NULL && IS_GPR(base)){
+                regs->gpr |= GPR_BIT(base);
+            }
+            if(index != DR_REG_NULL && IS_GPR(index)){
+                regs->gpr |= GPR_BIT(index);
+            }
+        }
+    }
+    regs->simd |= SIMD_BIT(GET_REG(DST(instr, 0)));
+}
+#endif
+
+void plc_compute_register_set(instrlist_t *bb, instr_t *first, plc_register_set_t *regs){
+#if defined(X86) && defined(X64)
+    regs->simd_slot_size = AVX_512_SUPPORTED ? 64 : AVX_SUPPORTED ? 32 : 16;
+    if(get_save_mode() == PLC_SAVE_ALL){
+        regs->gpr = ALL_GPR_SLOTS;
+        regs->simd = all_simd_registers();
+        regs->opmask = AVX_512_SUPPORTED ? ALL_OPMASK_REGISTERS : 0;
+        return;
+    }
+    //RAX and RCX are used to save the flags, RSP is modified before the calls
+    regs->gpr = GPR_BIT(DR_REG_XAX) | GPR_BIT(DR_REG_XCX) | GPR_BIT(DR_REG_XSP);
+    regs->simd = 0;
+    regs->opmask = 0;
+    //Registers needed by the instrumented instructions of the run
+    instr_t *last = first;
+    bool vex_encoded = false;
+    for(instr_t *instr = first; instr != NULL && plc_is_instrumented(plc_get_operation_category(instr));
+        instr = instr_get_next_app(instr)){
+        add_operand_registers(instr, regs);
+        vex_encoded = vex_encoded || (plc_get_operation_category(instr) & PLC_OP_AVX);
+        last = instr;
+    }
+    //Everything is live at the end of the basic block
+    plc_register_set_t live = {ALL_GPR_SLOTS, all_simd_registers(), 0, 0};
+    for(instr_t *instr = instrlist_last_app(bb); instr != NULL && instr != last;
+        instr = instr_get_prev_app(instr)){
+        update_liveness(instr, &live);
+    }
+    const plc_register_set_t &clobbered = backend_clobbered_registers();
+    regs->gpr |= clobbered.gpr & live.gpr;
+    regs->simd |= clobbered.simd & live.simd;
+    //The analysis doesn't follow the opmask registers : unless the backend only writes XMM registers, it may use AVX 512
+    if(AVX_512_SUPPORTED && backend_simd_write_width() != 16){
+        regs->opmask = ALL_OPMASK_REGISTERS;
+    }
+    if(get_exact_fast_path() && get_call_mode() == PLC_CALL_INSTR){
+        //The exact fast path modifies the flags and its scratch SIMD registers
+        regs->gpr |= FLAGS_BIT;
+        for(auto reg : FAST_PATH_XMM){
+            regs->simd |= SIMD_BIT(reg);
+        }
+        //With AVX, the fast path uses VEX instructions, zeroing the upper part of its registers
+        vex_encoded = vex_encoded || AVX_SUPPORTED;
+    }
+    if(plc_profile_enabled()){
+        //The profiling counters and timestamps modify the flags, and RDX is written by rdtsc
+        regs->gpr |= FLAGS_BIT | (GPR_BIT(DR_REG_XDX) & live.gpr);
+    }
+    //If nothing modifies more than the XMM part of the registers, only the XMM part is saved.
+    //Legacy SSE instructions can't access XMM16 to XMM31, so they aren't saved either
+    if(backend_simd_write_width() == 16 && !vex_encoded){
+        regs->simd_slot_size = 16;
+        regs->simd &= (((uint32_t)1) << NB_XMM_REG) - 1;
+    }
+#else //AArch64
+    DR_ASSERT_MSG(false, "plc_compute_register_set not implemented for this architecture");
+#endif
 }
 
 /**
  * \brief Save the GPR and arithmetic flags
- * \details This function will save the arithmetic flags and all the GPR on
- * the fake stack
+ * \details This function will save the arithmetic flags and the GPR selected
+ * in \p regs on the fake stack. RAX and RCX are always saved.
  * 
  * \param drcontext DynamoRIO's context
  * \param bb The list of instructions
  * \param where We will insert all saving instructions before this instruction
+ * \param regs Registers to save
  */
-void insert_save_gpr_and_flags(void *drcontext, instrlist_t *bb, instr_t *where){
+void insert_save_gpr_and_flags(void *drcontext, instrlist_t *bb, instr_t *where, const plc_register_set_t *regs){
 #if defined(X86) && defined(X64)
     //save rcx to spill slot
     dr_save_reg(drcontext, bb, where, DR_REG_RCX, SPILL_SLOT_SCRATCH_REG); 
@@ -476,17 +1453,22 @@ void insert_save_gpr_and_flags(void *drcontext, instrlist_t *bb, instr_t *where)
     INSERT_READ_TLS(drcontext, get_index_tls_gpr(), bb, where, DR_REG_RCX); 
     //store rax in second position
     MINSERT(bb, where, XINST_CREATE_store(drcontext, OP_BASE_DISP(DR_REG_RCX, 8, OPSZ_8),OP_REG(DR_REG_XAX))); 
-    //store arith flags to rax
-    MINSERT(bb, where, INSTR_CREATE_lahf(drcontext)); 
-    //store arith flags in first position
-    MINSERT(bb, where, XINST_CREATE_store(drcontext, OP_BASE_DISP(DR_REG_RCX, 0, OPSZ_8),OP_REG(DR_REG_XAX))); 
+    if(regs->gpr & FLAGS_BIT){
+        //store arith flags to rax
+        MINSERT(bb, where, INSTR_CREATE_lahf(drcontext)); 
+        //store arith flags in first position
+        MINSERT(bb, where, XINST_CREATE_store(drcontext, OP_BASE_DISP(DR_REG_RCX, 0, OPSZ_8),OP_REG(DR_REG_XAX))); 
+    }
     //restore rcx into rax
     dr_restore_reg(drcontext, bb, where, DR_REG_XAX, SPILL_SLOT_SCRATCH_REG); 
     //store rcx in third position
     MINSERT(bb, where, XINST_CREATE_store(drcontext, OP_BASE_DISP(DR_REG_RCX, 16, OPSZ_8),OP_REG(DR_REG_XAX))); 
-    //save all the other GPR
+    //save the other selected GPR
     for(size_t i=3; i<NUM_GPR_SLOTS; i++)
     {
+        if(!(regs->gpr & (1U << i))){
+            continue;
+        }
         MINSERT(bb, where, XINST_CREATE_store(drcontext, OP_BASE_DISP(DR_REG_RCX, offset_of_gpr(GPR_ORDER[i]), OPSZ_8), OP_REG(GPR_ORDER[i])));
     }
 
@@ -497,26 +1479,32 @@ void insert_save_gpr_and_flags(void *drcontext, instrlist_t *bb, instr_t *where)
 
 /**
  * \brief Restore the GPR and arithmetic flags
- * \details This function will restore the arithmetic flags and all the GPR
- * from the fake stack
+ * \details This function will restore the arithmetic flags and the GPR
+ * selected in \p regs from the fake stack. RAX and RCX are always restored.
  * 
  * \param drcontext DynamoRIO's context
  * \param bb The list of instructions
  * \param where We will insert all restore instructions before this instruction
+ * \param regs Registers to restore
  */
-void insert_restore_gpr_and_flags(void *drcontext, instrlist_t *bb, instr_t *where){
+void insert_restore_gpr_and_flags(void *drcontext, instrlist_t *bb, instr_t *where, const plc_register_set_t *regs){
 #if defined(X86) && defined(X64)
     //read tls into rcx
     INSERT_READ_TLS(drcontext, get_index_tls_gpr(), bb, where, DR_REG_RCX);
-    //load saved arith flags to rax
-    MINSERT(bb, where, XINST_CREATE_load(drcontext, OP_REG(DR_REG_RAX), OP_BASE_DISP(DR_REG_RCX, 0, OPSZ_8)));
-    //load arith flags
-    MINSERT(bb, where, INSTR_CREATE_sahf(drcontext));
+    if(regs->gpr & FLAGS_BIT){
+        //load saved arith flags to rax
+        MINSERT(bb, where, XINST_CREATE_load(drcontext, OP_REG(DR_REG_RAX), OP_BASE_DISP(DR_REG_RCX, 0, OPSZ_8)));
+        //load arith flags
+        MINSERT(bb, where, INSTR_CREATE_sahf(drcontext));
+    }
     //load saved rax into rax
     MINSERT(bb, where, XINST_CREATE_load(drcontext, OP_REG(DR_REG_RAX), OP_BASE_DISP(DR_REG_RCX, 8, OPSZ_8)));
-    //load back all GPR in reverse, overwrite RCX in the end
+    //load back the selected GPR in reverse, overwrite RCX in the end
     for(size_t i=NUM_GPR_SLOTS-1; i>=2 /*RCX*/; --i)
     {
+        if(i != 2 && !(regs->gpr & (1U << i))){
+            continue;
+        }
         MINSERT(bb, where, XINST_CREATE_load(drcontext, OP_REG(GPR_ORDER[i]), OP_BASE_DISP(DR_REG_RCX, offset_of_gpr(GPR_ORDER[i]), OPSZ_8)));
     }
 
@@ -532,55 +1520,86 @@ void insert_restore_gpr_and_flags(void *drcontext, instrlist_t *bb, instr_t *whe
  * \param bb The list of instructions
  * \param where Instruction prior to whom we insert the meta-instructions
  * \param destination Destination register of the instrumented instruction
+ * \param regs Registers saved around the run, defining the layout of the float tls
  */
-void insert_set_destination_tls(void *drcontext, instrlist_t *bb, instr_t *where, reg_id_t destination){
+void insert_set_destination_tls(void *drcontext, instrlist_t *bb, instr_t *where, reg_id_t destination,
+                                const plc_register_set_t *regs){
 #if defined(X86) && defined(X64)
-    //Result tls adress in OP_A register
+    //Thread context adress in OP_A register
     INSERT_READ_TLS(drcontext, get_index_tls_result(), bb, where, DR_REG_OP_A_ADDR);
-    //Floating registers tls adress in OP_B register
-    INSERT_READ_TLS(drcontext, get_index_tls_float(), bb, where, DR_REG_OP_B_ADDR);
-    //Loads the adress of the destination register who is in the saved array, in OP_C register
-    MINSERT(bb, where, INSTR_CREATE_lea(drcontext, OP_REG(DR_REG_OP_C_ADDR), OP_BASE_DISP(DR_REG_OP_B_ADDR, offset_of_simd(destination), OPSZ_lea)));
-    //Stores the adress in the buffer of the result tls
-    MINSERT(bb, where, XINST_CREATE_store(drcontext, OP_BASE_DISP(DR_REG_OP_A_ADDR,0, OPSZ_8), OP_REG(DR_REG_OP_C_ADDR)));
+    //Loads the adress of the destination register who is in the saved array, which precedes the thread context, in OP_C register
+    const int disp = offset_of_simd(regs, destination) - (int)thread_context_offset();
+    MINSERT(bb, where, INSTR_CREATE_lea(drcontext, OP_REG(DR_REG_OP_C_ADDR), OP_BASE_DISP(DR_REG_OP_A_ADDR, disp, OPSZ_lea)));
+    //Stores the adress in the destination of the thread context
+    MINSERT(bb, where, XINST_CREATE_store(drcontext, OP_BASE_DISP(DR_REG_OP_A_ADDR, offsetof(plc_thread_context_t, destination), OPSZ_8),
+                                          OP_REG(DR_REG_OP_C_ADDR)));
 #else //AArch64
     DR_ASSERT_MSG(false, "insert_set_destination_tls not implemented for this architecture");
 #endif
 }
 
+#if defined(X86) && defined(X64)
+/**
+ * \def OPMASK_MOVE_OPCODE
+ * \brief Opcode moving a whole opmask register : KMOVQ with AVX512BW (64 bits masks), else KMOVW
+ */
+#define OPMASK_MOVE_OPCODE (proc_has_feature(FEATURE_AVX512BW) ? OP_kmovq : OP_kmovw)
+
+/**
+ * \def OPMASK_MOVE_SIZE
+ * \brief Size of the memory operand of OPMASK_MOVE_OPCODE
+ */
+#define OPMASK_MOVE_SIZE (proc_has_feature(FEATURE_AVX512BW) ? OPSZ_8 : OPSZ_2)
+#endif
+
 /**
- * \brief Save all the SIMD registers
- * \details This function will save all the SIMD registers on the fake stack
+ * \brief Save the SIMD registers
+ * \details This function will save the SIMD registers selected in \p regs on
+ * the fake stack, and the selected opmask registers in the gpr tls
  * 
  * \param drcontext DynamoRIO's context
  * \param bb The list of instructions
  * \param where Instruction prior to whom we insert the meta-instructions
+ * \param regs Registers to save
  */
-void insert_save_simd_registers(void *drcontext, instrlist_t *bb, instr_t *where){
+void insert_save_simd_registers(void *drcontext, instrlist_t *bb, instr_t *where, const plc_register_set_t *regs){
 #if defined(X86) && defined(X64)
     //Loads the adress of the simd registers TLS
     INSERT_READ_TLS(drcontext, get_index_tls_float(), bb, where, DR_SCRATCH_REG);
-    //By default, SSE
+    //By default, SSE : only the XMM part of the registers is in the layout of the run
     reg_id_t start = DR_REG_START_XMM, stop = DR_REG_XMM15;
     bool is_avx=false;
     opnd_size_t size = OPSZ_16;
-    if(AVX_512_SUPPORTED)
+    if(regs->simd_slot_size == 64)
     {
         is_avx = true;
         start = DR_REG_START_ZMM;
         stop = DR_REG_STOP_ZMM;
         size=OPSZ_64;
-    }else if(AVX_SUPPORTED)
+    }else if(regs->simd_slot_size == 32)
     {
         is_avx=true;
         start = DR_REG_START_YMM;
         stop = DR_REG_YMM15;
         size = OPSZ_32;
     }
-    //Save all the SIMD registers
+    //Save the selected SIMD registers
     for(reg_id_t i=start; i<=stop; i++)
     {
-        MINSERT(bb, where, MOVE_FLOATING_PACKED(is_avx, drcontext, OP_BASE_DISP(DR_SCRATCH_REG, offset_of_simd(i),size), OP_REG(i)));
+        if(!(regs->simd & SIMD_BIT(i))){
+            continue;
+        }
+        MINSERT(bb, where, MOVE_FLOATING_PACKED(is_avx, drcontext, OP_BASE_DISP(DR_SCRATCH_REG, offset_of_simd(regs, i),size), OP_REG(i)));
+    }
+    //Save the selected opmask registers, after the GPR
+    if(regs->opmask != 0){
+        INSERT_READ_TLS(drcontext, get_index_tls_gpr(), bb, where, DR_SCRATCH_REG);
+        for(reg_id_t i = DR_REG_K0; i < DR_REG_K0 + NUM_OPMASK_SLOTS; i++){
+            if(regs->opmask & (1U << (i - DR_REG_K0))){
+                MINSERT(bb, where, instr_create_1dst_1src(drcontext, OPMASK_MOVE_OPCODE,
+                                                          OP_BASE_DISP(DR_SCRATCH_REG, offset_of_opmask(i), OPMASK_MOVE_SIZE), OP_REG(i)));
+            }
+        }
     }
 #else //AArch64
     DR_ASSERT_MSG(false, "insert_save_simd_registers not implemented for this architecture");
@@ -588,38 +1607,53 @@ void insert_save_simd_registers(void *drcontext, instrlist_t *bb, instr_t *where
 }
 
 /**
- * \brief Restore all the SIMD registers
- * \details This function will restore all the SIMD registers from the fake stack
+ * \brief Restore the SIMD registers
+ * \details This function will restore the SIMD registers selected in \p regs
+ * from the fake stack, and the selected opmask registers from the gpr tls
  * 
  * \param drcontext DynamoRIO's context
  * \param bb The list of instructions
  * \param where Instruction prior to whom we insert the meta-instructions
+ * \param regs Registers to restore
  */
-void insert_restore_simd_registers(void *drcontext, instrlist_t *bb, instr_t *where){
+void insert_restore_simd_registers(void *drcontext, instrlist_t *bb, instr_t *where, const plc_register_set_t *regs){
 #if defined(X86) && defined(X64)
     //Loads the adress of the simd registers TLS
     INSERT_READ_TLS(drcontext, get_index_tls_float(), bb, where, DR_SCRATCH_REG);
-    //By default, SSE
+    //By default, SSE : only the XMM part of the registers is in the layout of the run
     reg_id_t start = DR_REG_START_XMM, stop = DR_REG_XMM15;
     bool is_avx=false;
     opnd_size_t size = OPSZ_16;
-    if(AVX_512_SUPPORTED)
+    if(regs->simd_slot_size == 64)
     {
         is_avx = true;
         start = DR_REG_START_ZMM;
         stop = DR_REG_STOP_ZMM;
         size=OPSZ_64;
-    }else if(AVX_SUPPORTED)
+    }else if(regs->simd_slot_size == 32)
     {
         is_avx=true;
         start = DR_REG_START_YMM;
         stop = DR_REG_YMM15;
         size = OPSZ_32;
     }
-    //Restore all the SIMD registers
+    //Restore the selected SIMD registers
     for(reg_id_t i=start; i<=stop; i++)
     {
-        MINSERT(bb, where, MOVE_FLOATING_PACKED(is_avx, drcontext, OP_REG(i), OP_BASE_DISP(DR_SCRATCH_REG, offset_of_simd(i),size)));
+        if(!(regs->simd & SIMD_BIT(i))){
+            continue;
+        }
+        MINSERT(bb, where, MOVE_FLOATING_PACKED(is_avx, drcontext, OP_REG(i), OP_BASE_DISP(DR_SCRATCH_REG, offset_of_simd(regs, i),size)));
+    }
+    //Restore the selected opmask registers
+    if(regs->opmask != 0){
+        INSERT_READ_TLS(drcontext, get_index_tls_gpr(), bb, where, DR_SCRATCH_REG);
+        for(reg_id_t i = DR_REG_K0; i < DR_REG_K0 + NUM_OPMASK_SLOTS; i++){
+            if(regs->opmask & (1U << (i - DR_REG_K0))){
+                MINSERT(bb, where, instr_create_1dst_1src(drcontext, OPMASK_MOVE_OPCODE, OP_REG(i),
+                                                          OP_BASE_DISP(DR_SCRATCH_REG, offset_of_opmask(i), OPMASK_MOVE_SIZE)));
+            }
+        }
     }
 #else //AArch64
     DR_ASSERT_MSG(false, "insert_save_simd_registers not implemented for this architecture");
@@ -637,25 +1671,26 @@ void insert_restore_simd_registers(void *drcontext, instrlist_t *bb, instr_t *wh
  * \param src1 Source 1 of the instruction
  * \param src2 Source 2 of the instruction
  * \param out_reg Register array defining where to put the adresses
+ * \param regs Registers saved around the run, defining the layout of the float tls
  * 
  * \warning Assumes the GPR have been saved
  */
 static void insert_set_operands_all_registers(void *drcontext, instrlist_t *bb, instr_t *where, reg_id_t src0, reg_id_t src1,
-                                              reg_id_t src2, reg_id_t out_reg[]){
+                                              reg_id_t src2, reg_id_t out_reg[], const plc_register_set_t *regs){
 #if defined(X86) && defined(X64)
     if(src2 == DR_REG_NULL)
     {
         //2 registers
         INSERT_READ_TLS(drcontext, get_index_tls_float(), bb, where, out_reg[1]);
-        MINSERT(bb, where, INSTR_CREATE_lea(drcontext, OP_REG(out_reg[0]), OP_BASE_DISP(out_reg[1], offset_of_simd(src0), OPSZ_lea)));
-        MINSERT(bb, where, INSTR_CREATE_lea(drcontext, OP_REG(out_reg[1]), OP_BASE_DISP(out_reg[1], offset_of_simd(src1), OPSZ_lea)));
+        MINSERT(bb, where, INSTR_CREATE_lea(drcontext, OP_REG(out_reg[0]), OP_BASE_DISP(out_reg[1], offset_of_simd(regs, src0), OPSZ_lea)));
+        MINSERT(bb, where, INSTR_CREATE_lea(drcontext, OP_REG(out_reg[1]), OP_BASE_DISP(out_reg[1], offset_of_simd(regs, src1), OPSZ_lea)));
     }else
     {
         //3 registers
         INSERT_READ_TLS(drcontext, get_index_tls_float(), bb, where, out_reg[2]);
-        MINSERT(bb, where, INSTR_CREATE_lea(drcontext, OP_REG(out_reg[0]), OP_BASE_DISP(out_reg[2], offset_of_simd(src0), OPSZ_lea)));
-        MINSERT(bb, where, INSTR_CREATE_lea(drcontext, OP_REG(out_reg[1]), OP_BASE_DISP(out_reg[2], offset_of_simd(src1), OPSZ_lea)));
-        MINSERT(bb, where, INSTR_CREATE_lea(drcontext, OP_REG(out_reg[2]), OP_BASE_DISP(out_reg[2], offset_of_simd(src2), OPSZ_lea)));
+        MINSERT(bb, where, INSTR_CREATE_lea(drcontext, OP_REG(out_reg[0]), OP_BASE_DISP(out_reg[2], offset_of_simd(regs, src0), OPSZ_lea)));
+        MINSERT(bb, where, INSTR_CREATE_lea(drcontext, OP_REG(out_reg[1]), OP_BASE_DISP(out_reg[2], offset_of_simd(regs, src1), OPSZ_lea)));
+        MINSERT(bb, where, INSTR_CREATE_lea(drcontext, OP_REG(out_reg[2]), OP_BASE_DISP(out_reg[2], offset_of_simd(regs, src2), OPSZ_lea)));
     }
 #else //AArch64
     DR_ASSERT_MSG(false, "insert_set_operands_all_registers not implemented for this architecture");
@@ -693,6 +1728,15 @@ static void insert_set_operands_base_disp(void *drcontext, instrlist_t *bb, inst
     MINSERT(bb, where, INSTR_CREATE_lea(drcontext, OP_REG(destination),
                                         opnd_create_base_disp(base, index, opnd_get_scale(addr), opnd_get_disp(addr),
                                         OPSZ_lea)));
+#if defined(X86)
+    //lea ignores the segment : its base (e.g. the TLS base for fs or gs) is added afterwards
+    reg_id_t segment = opnd_get_segment(addr);
+    if(segment != DR_REG_NULL){
+        bool found = dr_insert_get_seg_base(drcontext, bb, where, segment, tempindex);
+        DR_ASSERT_MSG(found, "ERROR : CAN'T GET THE BASE OF A SEGMENT REGISTER");
+        MINSERT(bb, where, INSTR_CREATE_add(drcontext, OP_REG(destination), OP_REG(tempindex)));
+    }
+#endif
 }
 
 /**
@@ -725,11 +1769,12 @@ static void insert_set_operands_addr(void *drcontext, instrlist_t *bb, instr_t *
  * \param mem_src_idx index of the operand that is a memory reference
  * \param out_regs array containing the registers (in order) that shoud be set
  * for the calling convention
+ * \param regs Registers saved around the run, defining the layout of the float tls
  * 
  * \warning Assumes the GPR have been saved
  */
 static void insert_set_operands_mem_reference(void *drcontext, instrlist_t *bb, instr_t *where, instr_t *instr, bool fused,
-                                              int mem_src_idx, reg_id_t out_regs[]){
+                                              int mem_src_idx, reg_id_t out_regs[], const plc_register_set_t *regs){
     DR_ASSERT_MSG((mem_src_idx >= 0) && (instr_num_srcs(instr) > mem_src_idx), "MEMORY SOURCE INDEX IS INVALID");
     opnd_t mem_src = SRC(instr, mem_src_idx);
     if(OP_IS_BASE_DISP(mem_src)){
@@ -751,23 +1796,20 @@ static void insert_set_operands_mem_reference(void *drcontext, instrlist_t *bb,
             reg_id_t reg = GET_REG(SRC(instr, i));
             MINSERT(bb, where, INSTR_CREATE_lea(drcontext,
                                                 OP_REG(out_regs[i]),
-                                                OP_BASE_DISP(out_regs[last_reg_idx], offset_of_simd(reg), OPSZ_lea)));
+                                                OP_BASE_DISP(out_regs[last_reg_idx], offset_of_simd(regs, reg), OPSZ_lea)));
         }
     }
 }
 
 /**
- * Inserts prior to \p where meta-instructions to set the calling
- * convention registers to the right adresses
+ * \brief Fills \p reg_op_addr with the calling convention register receiving
+ * the address of each source of \p instr
  * 
- * \param drcontext DynamoRIO's context
- * \param bb Current Basic Block
- * \param where Instruction prior to whom we insert the meta-instructions 
  * \param instr Instrumented instruction
  * \param oc Category of the instrumented instruction
+ * \param reg_op_addr Array receiving, for each source, the register to set
  */
-void insert_set_operands(void *drcontext, instrlist_t *bb, instr_t *where, instr_t *instr, OPERATION_CATEGORY oc){
-    reg_id_t reg_op_addr[3];
+static void get_operands_order(instr_t *instr, OPERATION_CATEGORY oc, reg_id_t reg_op_addr[]){
     const bool fused = plc_is_fused(oc);
     if(fused){
         if(oc & PLC_OP_213){
@@ -797,6 +1839,24 @@ void insert_set_operands(void *drcontext, instrlist_t *bb, instr_t *where, instr
         }
         reg_op_addr[2] = DR_REG_NULL;
     }
+}
+
+/**
+ * Inserts prior to \p where meta-instructions to set the calling
+ * convention registers to the right adresses
+ * 
+ * \param drcontext DynamoRIO's context
+ * \param bb Current Basic Block
+ * \param where Instruction prior to whom we insert the meta-instructions 
+ * \param instr Instrumented instruction
+ * \param oc Category of the instrumented instruction
+ * \param regs Registers saved around the run, defining the layout of the float tls
+ */
+void insert_set_operands(void *drcontext, instrlist_t *bb, instr_t *where, instr_t *instr, OPERATION_CATEGORY oc,
+                         const plc_register_set_t *regs){
+    reg_id_t reg_op_addr[3];
+    const bool fused = plc_is_fused(oc);
+    get_operands_order(instr, oc, reg_op_addr);
 
     int mem_src = -1;
     //Get the index of the memory operand, if there is one
@@ -810,10 +1870,10 @@ void insert_set_operands(void *drcontext, instrlist_t *bb, instr_t *where, instr
     if(mem_src == -1){
         //No memory references, only registers
         insert_set_operands_all_registers(drcontext, bb, where, GET_REG(SRC(instr, 0)), GET_REG(SRC(instr, 1)),
-                                          fused ? GET_REG(SRC(instr, 2)) : DR_REG_NULL, reg_op_addr);
+                                          fused ? GET_REG(SRC(instr, 2)) : DR_REG_NULL, reg_op_addr, regs);
     }else{
         //Memory reference
-        insert_set_operands_mem_reference(drcontext, bb, where, instr, fused, mem_src, reg_op_addr);
+        insert_set_operands_mem_reference(drcontext, bb, where, instr, fused, mem_src, reg_op_addr, regs);
     }
 }
 
@@ -830,4 +1890,204 @@ void insert_restore_rsp(void *drcontext, instrlist_t *bb, instr_t *where){
     INSERT_READ_TLS(drcontext, get_index_tls_gpr(), bb, where, DR_REG_RSP);
     MINSERT(bb, where,
             XINST_CREATE_load(drcontext, OP_REG(DR_REG_RSP), OP_BASE_DISP(DR_REG_RSP, offset_of_gpr(DR_REG_RSP), OPSZ_8)));
-}
\ No newline at end of file
+}
+
+/**
+ * Lock protecting the block descriptors
+ */
+static void *block_desc_lock;
+
+/**
+ * Latest block descriptor of each run, indexed by the address of its first instruction
+ */
+static std::unordered_map<app_pc, plc_block_desc_t *> block_descs;
+
+/**
+ * Every block descriptor allocated, freed at exit
+ */
+static std::vector<plc_block_desc_t *> all_block_descs;
+
+/**
+ * \brief Returns the size in bytes of a block descriptor of \p count instructions
+ */
+static inline size_t block_desc_size(uint32_t count){
+    return sizeof(plc_block_desc_t) + count * sizeof(plc_instr_desc_t);
+}
+
+/**
+ * \brief Returns the index of the parameter held by a calling convention register
+ * 
+ * \param reg One of DR_REG_OP_A_ADDR, DR_REG_OP_B_ADDR or DR_REG_OP_C_ADDR
+ * \return 0, 1 or 2
+ */
+static inline int argument_index(reg_id_t reg){
+    return reg == DR_REG_OP_A_ADDR ? 0 : reg == DR_REG_OP_B_ADDR ? 1 : 2;
+}
+
+/**
+ * \brief Fills \p desc with the description of the source operand \p src
+ * 
+ * \param src Source operand of an instrumented instruction
+ * \param desc Description to fill
+ * \param regs Registers saved around the run, defining the layout of the float tls
+ */
+static void describe_operand(opnd_t src, plc_operand_desc_t *desc, const plc_register_set_t *regs){
+    if(OP_IS_BASE_DISP(src)){
+        reg_id_t base = opnd_get_base(src), index = opnd_get_index(src);
+        desc->kind = PLC_OPND_BASE_DISP;
+        desc->base = base != DR_REG_NULL ? (uint8_t)gpr_slot(base) : 0;
+        desc->index = index != DR_REG_NULL ? (uint8_t)gpr_slot(index) : 0;
+        desc->scale = (uint8_t)opnd_get_scale(src);
+        desc->disp = opnd_get_disp(src);
+    }else if(OP_IS_ADDR(src)){
+        desc->kind = PLC_OPND_ADDR;
+        desc->addr = opnd_get_addr(src);
+    }else{
+        desc->kind = PLC_OPND_SIMD;
+        desc->simd = (uint8_t)simd_index(GET_REG(src));
+        desc->disp = offset_of_simd(regs, GET_REG(src));
+    }
+}
+
+/**
+ * \brief Returns the EVEX control word of \p instr
+ * \details See PLC_EVEX_OPMASK, PLC_EVEX_ZEROING and PLC_EVEX_BROADCAST
+ * 
+ * \param instr Instrumented instruction
+ * \param oc Category of the instrumented instruction
+ * \return The control word, 0 if \p instr isn't EVEX encoded
+ */
+static uint32_t evex_control(instr_t *instr, OPERATION_CATEGORY oc){
+#if defined(X86)
+    if(!(oc & PLC_OP_EVEX)){
+        return 0;
+    }
+    uint32_t control = 0;
+    if(plc_first_source(instr) != 0){
+        control |= (uint32_t)(GET_REG(instr_get_src(instr, 0)) - DR_REG_K0);
+    }
+    if(plc_is_evex_zeroing(instr)){
+        control |= PLC_EVEX_ZEROING;
+    }
+    if(plc_is_evex_broadcast(instr)){
+        reg_id_t reg_op_addr[3];
+        get_operands_order(instr, oc, reg_op_addr);
+        for(int i = 0; i < (plc_is_fused(oc) ? 3 : 2); i++){
+            if(opnd_is_memory_reference(SRC(instr, i))){
+                control |= (uint32_t)(argument_index(reg_op_addr[i]) + 1) << PLC_EVEX_BROADCAST_SHIFT;
+            }
+        }
+    }
+    return control;
+#else
+    return 0;
+#endif
+}
+
+void insert_set_evex_control(void *drcontext, instrlist_t *bb, instr_t *where, instr_t *instr, OPERATION_CATEGORY oc){
+#if defined(X86) && defined(X64)
+    if(!(oc & PLC_OP_EVEX)){
+        return;
+    }
+    //Thread context adress in OP_A register, it receives the control word
+    INSERT_READ_TLS(drcontext, get_index_tls_result(), bb, where, DR_REG_OP_A_ADDR);
+    MINSERT(bb, where, XINST_CREATE_store(drcontext, OP_BASE_DISP(DR_REG_OP_A_ADDR, offsetof(plc_thread_context_t, evex_control), OPSZ_8),
+                                          OPND_CREATE_INT32(evex_control(instr, oc))));
+#else //AArch64
+    DR_ASSERT_MSG(false, "insert_set_evex_control not implemented for this architecture");
+#endif
+}
+
+void plc_block_descriptors_init(){
+    block_desc_lock = dr_mutex_create();
+}
+
+void plc_block_descriptors_exit(){
+    for(auto block : all_block_descs){
+        //The descriptors of the persistent arena are freed with it
+        if(!plc_persist_owns(block)){
+            dr_global_free(block, block_desc_size(block->count));
+        }
+    }
+    all_block_descs.clear();
+    block_descs.clear();
+    dr_mutex_destroy(block_desc_lock);
+}
+
+bool plc_block_describable(instr_t *instr){
+    for(int i = 0; i < instr_num_srcs(instr); i++){
+        opnd_t src = instr_get_src(instr, i);
+        if(OP_IS_BASE_DISP(src) && opnd_get_segment(src) != DR_REG_NULL){
+            return false;
+        }
+    }
+    return true;
+}
+
+const plc_block_desc_t *plc_get_block_descriptor(instr_t *first, const plc_register_set_t *regs){
+    std::vector<plc_instr_desc_t> instrs;
+    for(instr_t *instr = first; instr != NULL; instr = instr_get_next_app(instr)){
+        OPERATION_CATEGORY oc = plc_get_operation_category(instr);
+        if(!plc_is_instrumented(oc) || !plc_block_describable(instr)){
+            break;
+        }
+        plc_instr_desc_t desc;
+        //Zero the padding too, descriptors are compared with memcmp
+        memset(&desc, 0, sizeof(desc));
+        desc.apply = get_backend_apply(oc, plc_is_double(oc));
+        DR_ASSERT_MSG(desc.apply != nullptr, "ERROR OPERATION NOT FOUND !");
+        desc.pc = instr_get_app_pc(instr);
+        desc.oc = (uint32_t)oc;
+        desc.dst_offset = offset_of_simd(regs, GET_REG(DST(instr, 0)));
+        desc.dst_simd = (uint16_t)simd_index(GET_REG(DST(instr, 0)));
+        desc.simd_slot_size = (uint16_t)regs->simd_slot_size;
+        desc.nb_srcs = plc_is_fused(oc) ? 3 : 2;
+        desc.evex_control = evex_control(instr, oc);
+        reg_id_t reg_op_addr[3];
+        get_operands_order(instr, oc, reg_op_addr);
+        for(uint32_t i = 0; i < desc.nb_srcs; i++){
+            describe_operand(SRC(instr, i), &desc.args[argument_index(reg_op_addr[i])], regs);
+        }
+        instrs.push_back(desc);
+    }
+
+    const uint32_t count = (uint32_t)instrs.size();
+    dr_mutex_lock(block_desc_lock);
+    plc_block_desc_t *&block = block_descs[instr_get_app_pc(first)];
+    //Reuse the previous descriptor if the run didn't change, so that a translation rebuilds the same code
+    if(block == nullptr || block->count != count ||
+       memcmp(block->instrs, instrs.data(), count * sizeof(plc_instr_desc_t)) != 0){
+        //Persistable code can only refer to a descriptor of the persistent arena
+        block = (plc_block_desc_t *)plc_persist_alloc(instr_get_app_pc(first), block_desc_size(count));
+        if(block == nullptr){
+            block = (plc_block_desc_t *)dr_global_alloc(block_desc_size(count));
+        }
+        block->count = count;
+        block->instrs = (plc_instr_desc_t *)(block + 1);
+        memcpy(block->instrs, instrs.data(), count * sizeof(plc_instr_desc_t));
+        all_block_descs.push_back(block);
+    }
+    const plc_block_desc_t *ret = block;
+    dr_mutex_unlock(block_desc_lock);
+    return ret;
+}
+
+void plc_register_block_descriptors(byte *start, size_t size){
+    dr_mutex_lock(block_desc_lock);
+    for(byte *ptr = start; ptr < start + size;){
+        plc_block_desc_t *block = (plc_block_desc_t *)ptr;
+        //The pointer to the instructions was persisted, the arena being at the same address
+        DR_ASSERT_MSG(block->instrs == (plc_instr_desc_t *)(block + 1), "CORRUPTED PERSISTED DESCRIPTOR !");
+        block_descs[block->instrs[0].pc] = block;
+        all_block_descs.push_back(block);
+        ptr += (block_desc_size(block->count) + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    }
+    dr_mutex_unlock(block_desc_lock);
+}
+
+void insert_block_call(void *drcontext, instrlist_t *bb, instr_t *where, const plc_block_desc_t *block){
+    //The thread context is the second parameter
+    INSERT_READ_TLS(drcontext, tls_result, bb, where, DR_REG_OP_B_ADDR);
+    dr_insert_call(drcontext, bb, where, (void *)padloc_block_backend::apply, 2, OPND_CREATE_INTPTR(block),
+                   OP_REG(DR_REG_OP_B_ADDR));
+}
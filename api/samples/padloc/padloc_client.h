@@ -10,6 +10,8 @@
 #ifndef PADLOC_SYMBOL_H
 #define PADLOC_SYMBOL_H
 
+#include <cstdint>
+
 #include "dr_api.h"
 #include "drmgr.h"
 #include "backend/backend.hxx"
@@ -51,6 +53,12 @@
  */
 #define DR_REG_OP_C_ADDR DR_REG_R8
 
+/** 
+ * \def DR_REG_OP_D_ADDR
+ * \brief Register of the fourth parameter, the thread context of fused operations
+ */
+#define DR_REG_OP_D_ADDR DR_REG_R9
+
 #elif defined(AARCH64)
 
 /** 
@@ -71,6 +79,12 @@
  */
 #define DR_REG_OP_C_ADDR DR_REG_X2
 
+/** 
+ * \def DR_REG_OP_D_ADDR
+ * \brief Register of the fourth parameter, the thread context of fused operations
+ */
+#define DR_REG_OP_D_ADDR DR_REG_X3
+
 #else
 
 /** 
@@ -91,6 +105,12 @@
  */
 #define DR_REG_OP_C_ADDR DR_REG_XDX
 
+/** 
+ * \def DR_REG_OP_D_ADDR
+ * \brief Register of the fourth parameter, the thread context of fused operations
+ */
+#define DR_REG_OP_D_ADDR DR_REG_XCX
+
 #endif
 
 #if defined(X86)
@@ -133,9 +153,10 @@
 
 /**
  * \def SRC
- * \brief Shortcut for instr_get_src
+ * \brief Shortcut for instr_get_src, giving the sources of the operation
+ * \details The opmask register of EVEX instructions is skipped (see plc_first_source)
  */
-#define SRC(instr, n) instr_get_src((instr), (n))
+#define SRC(instr, n) instr_get_src((instr), plc_first_source(instr) + (n))
 
 /**
  * \def DST
@@ -383,6 +404,321 @@
 #define NB_Q_REG 0
 #endif
 
+/**
+ * \struct plc_register_set_t
+ * \brief Set of registers saved around a run of instrumented instructions
+ * \details Each set bit of \p gpr designates a slot of the gpr tls, in the
+ * order used by the save functions (bit 0 is the arithmetic flags, bit 1 RAX,
+ * bit 2 RCX...). Each set bit of \p simd designates a SIMD register by its
+ * index (bit 0 for XMM0/YMM0/ZMM0 and so on).
+ * The set also defines the layout of the float tls for the run : the selected
+ * SIMD registers are stored next to each other, in the order of their index,
+ * in slots of \p simd_slot_size bytes.
+ * Each set bit of \p opmask designates an opmask register (bit 0 for K0...),
+ * stored in the gpr tls after the GPR.
+ */
+struct plc_register_set_t{
+    /** Mask of the gpr tls slots to save and restore */
+    uint32_t gpr;
+    /** Mask of the SIMD registers to save and restore */
+    uint32_t simd;
+    /** Size in bytes of the slot of each SIMD register in the float tls (16, 32 or 64) */
+    uint32_t simd_slot_size;
+    /** Mask of the opmask registers to save and restore (AVX 512 only) */
+    uint32_t opmask;
+};
+
+/**
+ * \brief Computes the registers to save around the run of instrumented
+ * instructions starting at \p first
+ * \details With PLC_SAVE_ALL, every register is selected. With
+ * PLC_SAVE_LIVE, only the registers the run needs (operands, calling
+ * convention, stack pointer) and the registers clobbered by the backend that
+ * are still live after the run are selected. The SIMD registers are saved
+ * whole, unless neither the run nor the backend modifies more than their XMM
+ * part (PLC_SAVE_LIVE only), in which case only the XMM part is saved.
+ * The opmask registers read by the run are saved, and all of them if the
+ * backend may use AVX 512 instructions.
+ *
+ * \param bb Current basic bloc
+ * \param first First instrumented instruction of the run
+ * \param regs Set to fill
+ */
+void plc_compute_register_set(instrlist_t *bb, instr_t *first, plc_register_set_t *regs);
+
+/**
+ * \enum plc_operand_kind_t
+ * \brief Kind of an operand described in a plc_operand_desc_t
+ */
+typedef enum{
+    /** SIMD register, read from the float tls */
+    PLC_OPND_SIMD,
+    /** Base-disp memory reference, computed from the gpr tls */
+    PLC_OPND_BASE_DISP,
+    /** Relative or absolute address */
+    PLC_OPND_ADDR
+} plc_operand_kind_t;
+
+/**
+ * \struct plc_operand_desc_t
+ * \brief Description of a source operand of an instruction interpreted by the
+ * block dispatcher
+ */
+struct plc_operand_desc_t{
+    /** Kind of the operand (plc_operand_kind_t) */
+    uint8_t kind;
+    /** Slot of the base register in the gpr tls, 0 if there is none */
+    uint8_t base;
+    /** Slot of the index register in the gpr tls, 0 if there is none */
+    uint8_t index;
+    /** Scale of the index */
+    uint8_t scale;
+    /** Index of the register of a SIMD operand, whose shadow samples are read in lane mode */
+    uint8_t simd;
+    /** Displacement of a base-disp operand, or offset of a SIMD register in the float tls */
+    int32_t disp;
+    /** Address of a relative or absolute address operand */
+    void *addr;
+};
+
+/**
+ * \def PLC_EVEX_OPMASK
+ * \brief Opmask register (1 to 7) of an EVEX control word, 0 if the operation isn't masked
+ * \details The EVEX control word describes the masking and broadcast of an AVX 512
+ * instruction to the backend. It is stored in the thread context (plc_thread_context_t).
+ */
+#define PLC_EVEX_OPMASK(control) ((control) & 7)
+
+/**
+ * \def PLC_EVEX_ZEROING
+ * \brief Flag of an EVEX control word : the masked elements are zeroed instead of being left unchanged
+ */
+#define PLC_EVEX_ZEROING 8
+
+/**
+ * \def PLC_EVEX_BROADCAST_SHIFT
+ * \brief Position in an EVEX control word of the parameter (1 to 3) of the backend
+ * function whose element is broadcast, 0 if there is none
+ */
+#define PLC_EVEX_BROADCAST_SHIFT 4
+
+/**
+ * \def PLC_EVEX_BROADCAST
+ * \brief Parameter (1 to 3) of an EVEX control word whose element is broadcast, 0 if there is none
+ */
+#define PLC_EVEX_BROADCAST(control) (((control) >> PLC_EVEX_BROADCAST_SHIFT) & 3)
+
+/**
+ * \def PLC_MAX_LANE_SAMPLES
+ * \brief Maximal number of samples carried by a SIMD register in lane mode, the real value included
+ */
+#define PLC_MAX_LANE_SAMPLES 16
+
+/**
+ * \def PLC_NB_SHADOW_REGS
+ * \brief Number of SIMD registers of the shadow register file (up to ZMM31)
+ */
+#define PLC_NB_SHADOW_REGS 32
+
+/**
+ * \struct plc_samples_call_t
+ * \brief Operands of the shadow samples of the instruction being interpreted, in lane mode
+ * \details Filled by the block dispatcher before calling the apply function,
+ * which computes the shadow samples of the instruction before its real result.
+ */
+struct plc_samples_call_t{
+    /** Number of shadow samples, the real value excluded */
+    uint32_t nb;
+    /** Address of each source of each shadow sample, in the order of the parameters of the apply function */
+    void *sources[3][PLC_MAX_LANE_SAMPLES - 1];
+    /** Address of the destination of each shadow sample */
+    void *destinations[PLC_MAX_LANE_SAMPLES - 1];
+};
+
+/**
+ * \struct plc_shadow_file_t
+ * \brief Shadow register file of a thread, in lane mode
+ * \details Each SIMD register written by an interpreted instruction carries
+ * plc_samples_call_t::nb shadow samples, computed with their own random roundings
+ * from the shadow samples of the sources. The value of the register when its
+ * samples were written is kept as its tag : the samples are only used while the
+ * register still holds this value, so that the registers written by other
+ * instructions (loads, moves, integer operations...) fall back to their real value.
+ */
+struct plc_shadow_file_t{
+    /** Operands of the instruction being interpreted */
+    plc_samples_call_t call;
+    /** Mask of the registers whose samples have been written */
+    uint32_t written;
+    /** Number of meaningful bytes of the tag of each register */
+    uint32_t tag_size[PLC_NB_SHADOW_REGS];
+    /** Value of each register when its samples were written */
+    byte tags[PLC_NB_SHADOW_REGS][MAX_OPND_SIZE_BYTES];
+    /** Shadow samples, the sample k of the register r being samples[r * call.nb + k] */
+    byte (*samples)[MAX_OPND_SIZE_BYTES];
+};
+
+/**
+ * \struct plc_thread_context_t
+ * \brief Per-thread context given to the backend stubs
+ * \details Lives in the thread arena, after the gpr buffer, and is pointed to by
+ * the result tls. The instrumentation passes its address as the last parameter
+ * of the apply functions of padloc_backend and padloc_backend_fused, so that they
+ * find the destination, the backend context and the saved registers without
+ * looking up the drcontext nor any tls.
+ */
+struct plc_thread_context_t{
+    /** Address of the saved destination register, where the result is written */
+    void *destination;
+    /** Allocation of the thread arena, used to free it */
+    void *arena;
+    /** EVEX control word of the current instruction */
+    uint64_t evex_control;
+    /** Backend context of the thread */
+    void *backend;
+    /** Saved SIMD registers (float tls) */
+    byte *simd;
+    /** Saved GPR (gpr tls) */
+    reg_t *gpr;
+    /** Shadow register file of the thread in lane mode, null otherwise */
+    plc_shadow_file_t *shadow;
+    /** True if the operations of the thread are recorded (see trace.hpp) */
+    bool trace;
+};
+
+/**
+ * \struct plc_instr_desc_t
+ * \brief Description of an instruction interpreted by the block dispatcher
+ */
+struct plc_instr_desc_t{
+    /** Backend function to call (padloc_backend<...>::apply or padloc_backend_fused<...>::apply) */
+    void *apply;
+    /** Address of the instruction, written to the trace in recording mode */
+    app_pc pc;
+    /** OPERATION_CATEGORY of the instruction */
+    uint32_t oc;
+    /** Offset of the destination register in the float tls */
+    int32_t dst_offset;
+    /** Index of the destination register, whose shadow samples are written in lane mode */
+    uint16_t dst_simd;
+    /** Size in bytes of the slots of the float tls in the run */
+    uint16_t simd_slot_size;
+    /** Number of sources (2, or 3 for FMA/FMS) */
+    uint32_t nb_srcs;
+    /** EVEX control word of the instruction, 0 if it isn't EVEX encoded */
+    uint32_t evex_control;
+    /** Sources, in the order of the parameters of \p apply */
+    plc_operand_desc_t args[3];
+};
+
+/**
+ * \struct plc_block_desc_t
+ * \brief Table describing a run of consecutive instrumented instructions
+ */
+struct plc_block_desc_t{
+    /** Number of instructions in the run */
+    uint32_t count;
+    /** Descriptions of the instructions, in program order */
+    plc_instr_desc_t *instrs;
+};
+
+/**
+ * \brief Initializes the storage of the block descriptors
+ */
+void plc_block_descriptors_init();
+
+/**
+ * \brief Frees all the block descriptors
+ */
+void plc_block_descriptors_exit();
+
+/**
+ * \brief Returns true if \p instr can be described in a block descriptor
+ * \details The descriptors compute the addresses of memory operands from the
+ * saved GPR only : an operand relative to a segment register (such as a TLS
+ * access through fs or gs) can't be described, and the instruction must be
+ * instrumented with its own backend call.
+ * 
+ * \param instr Instrumented instruction
+ */
+bool plc_block_describable(instr_t *instr);
+
+/**
+ * \brief Returns the descriptor table of the run of instrumented instructions
+ * starting at \p first
+ * \details The run stops at the first instruction which isn't instrumented or
+ * can't be described (see plc_block_describable). The descriptor is kept until
+ * the end of the execution. If the same run was already described (e.g. when
+ * DynamoRIO rebuilds a basic block for address translation), the previous
+ * descriptor is reused.
+ * 
+ * \param first First instrumented instruction of the run
+ * \param regs Registers saved around the run, defining the layout of the float tls
+ * \return The descriptor table of the run
+ */
+const plc_block_desc_t *plc_get_block_descriptor(instr_t *first, const plc_register_set_t *regs);
+
+/**
+ * \brief Registers the block descriptors restored from a persisted file
+ * \details The descriptors are reused by plc_get_block_descriptor, so that the
+ * translation of a persisted block rebuilds the same code
+ * 
+ * \param start First descriptor, in the persistent arena
+ * \param size Size in bytes of the descriptors, laid out contiguously as allocated
+ */
+void plc_register_block_descriptors(byte *start, size_t size);
+
+/**
+ * \brief Inserts prior to \p where the call to the dispatcher interpreting \p block
+ * \warning Assumes the gpr and SIMD registers have been saved !
+ * 
+ * \param drcontext DynamoRIO's context
+ * \param bb Current basic block
+ * \param where instruction prior to whom we insert the call
+ * \param block Descriptor table of the run
+ */
+void insert_block_call(void *drcontext, instrlist_t *bb, instr_t *where, const plc_block_desc_t *block);
+
+/**
+ * \brief Allocates the buffers of the gpr, float and result tls of a thread
+ * \details The three buffers are carved from a single allocation aligned on a
+ * cache line, each starting on its own cache line, so that saving a run's
+ * registers touches as few cache lines as possible. The result tls holds the
+ * thread context (plc_thread_context_t). In lane mode, the shadow register
+ * file of the thread is allocated too.
+ * 
+ * \param drcontext Context of the thread
+ * \param backend_context Backend context of the thread, kept in its thread context
+ */
+void plc_thread_arena_init(void *drcontext, void *backend_context);
+
+/**
+ * \brief Returns the thread context of a thread
+ * 
+ * \param drcontext Context of the thread
+ * \return plc_thread_context_t* The thread context, held by the result tls
+ */
+plc_thread_context_t *plc_get_thread_context(void *drcontext);
+
+/**
+ * \brief Returns the shadow samples of \p value in the current thread, in lane mode
+ * \details Looks for a SIMD register whose first double precision element holds
+ * \p value and carries shadow samples, and copies the first element of its samples.
+ * 
+ * \param drcontext Context of the thread
+ * \param value Real value
+ * \param samples Buffer receiving the shadow samples, of PLC_MAX_LANE_SAMPLES - 1 elements
+ * \return The number of shadow samples copied, 0 if no register carries \p value
+ */
+int plc_get_shadow_samples(void *drcontext, double value, double *samples);
+
+/**
+ * \brief Frees the buffers allocated by plc_thread_arena_init
+ * 
+ * \param drcontext Context of the thread
+ */
+void plc_thread_arena_exit(void *drcontext);
+
 /**
  * \brief Returns the index of the floating point registers tls
  */
@@ -428,6 +764,9 @@ void translate_insert(instr_t *newinstr, instrlist_t *ilist, instr_t *instr);
 
 /**
  * \brief Insert the corresponding call into the application depending on the properties of the instruction overloaded.  
+ * \details The sources are expected in the parameter registers (insert_set_operands).
+ * The address of the thread context is read from the result tls into the last
+ * parameter register right before the call.
  * 
  * \param drcontext DynamoRIO's context
  * \param bb Current basic block
@@ -437,6 +776,29 @@ void translate_insert(instr_t *newinstr, instrlist_t *ilist, instr_t *instr);
  */
 void insert_call(void *drcontext, instrlist_t *bb, instr_t *instr, OPERATION_CATEGORY oc, bool is_double);
 
+/**
+ * \brief Inserts prior to \p where an inline check of the exactness of the
+ * operation, skipping the backend call when the result is exact
+ * \details For scalar additions and subtractions, the error is computed with
+ * TwoSum, and for scalar multiplications with TwoProd (using FMA). If the
+ * error is zero, every rounding mode gives the nearest result, which is
+ * written to the saved destination register, and the execution jumps over the
+ * backend call. Otherwise, the execution falls into the backend call.
+ * Does nothing if the exact fast path is disabled or unsupported for \p oc.
+ * \warning Must be inserted after insert_set_operands, right before insert_call.
+ * The returned label must be inserted right after the backend call.
+ * 
+ * \param drcontext DynamoRIO's context
+ * \param bb Current basic block
+ * \param where instruction prior to whom we insert the meta-instructions
+ * \param instr Instrumented instruction
+ * \param oc Operation category of the instrumented instruction
+ * \param regs Registers saved around the run, defining the layout of the float tls
+ * \return The label to insert after the backend call, nullptr if nothing was inserted
+ */
+instr_t *insert_exact_fast_path(void *drcontext, instrlist_t *bb, instr_t *where, instr_t *instr, OPERATION_CATEGORY oc,
+                                const plc_register_set_t *regs);
+
 /**
  * \brief Inserts prior to where meta-instructions to set the calling convention registers to the right adresses
  * \warning Assumes the GPR have been saved !
@@ -445,26 +807,30 @@ void insert_call(void *drcontext, instrlist_t *bb, instr_t *instr, OPERATION_CAT
  * \param where instruction prior to whom we insert the meta-instructions 
  * \param instr Instrumented instruction
  * \param oc Operation category of the instrumented instruction
+ * \param regs Registers saved around the run, defining the layout of the float tls
  */
-void insert_set_operands(void *drcontext, instrlist_t *bb, instr_t *where, instr_t *instr, OPERATION_CATEGORY oc);
+void insert_set_operands(void *drcontext, instrlist_t *bb, instr_t *where, instr_t *instr, OPERATION_CATEGORY oc,
+                         const plc_register_set_t *regs);
 
 /**
- * \brief Inserts prior to \p where meta-instructions to restore the floating point registers (xmm-ymm-zmm)
+ * \brief Inserts prior to \p where meta-instructions to restore the floating point registers (xmm-ymm-zmm) and the opmask registers
  * \warning Assumes the gpr have been saved beforehand !
  * \param drcontext DynamoRIO context
  * \param bb Current basic bloc
  * \param where instruction prior to whom we insert the meta-instructions 
+ * \param regs Registers to restore
  */
-void insert_restore_simd_registers(void *drcontext, instrlist_t *bb, instr_t *where);
+void insert_restore_simd_registers(void *drcontext, instrlist_t *bb, instr_t *where, const plc_register_set_t *regs);
 
 /**
- * \brief Inserts prior to \p where meta-instructions to save the floating point registers (xmm-ymm-zmm)
+ * \brief Inserts prior to \p where meta-instructions to save the floating point registers (xmm-ymm-zmm) and the opmask registers
  * \warning Assumes the gpr have been saved beforehand !
  * \param drcontext DynamoRIO context
  * \param bb Current basic bloc
  * \param where instruction prior to whom we insert the meta-instructions 
+ * \param regs Registers to save
  */
-void insert_save_simd_registers(void *drcontext, instrlist_t *bb, instr_t *where);
+void insert_save_simd_registers(void *drcontext, instrlist_t *bb, instr_t *where, const plc_register_set_t *regs);
 
 /**
  * \brief Prepares the address in the buffer of the tls register to point to the destination register in memory
@@ -473,24 +839,42 @@ void insert_save_simd_registers(void *drcontext, instrlist_t *bb, instr_t *where
  * \param bb Current basic block
  * \param where instruction prior to whom we insert the meta-instructions 
  * \param destination SIMD registers that should have received the result
+ * \param regs Registers saved around the run, defining the layout of the float tls
+ */
+void insert_set_destination_tls(void *drcontext, instrlist_t *bb, instr_t *where, reg_id_t destination,
+                                const plc_register_set_t *regs);
+
+/**
+ * \brief Prepares the EVEX control word of \p instr in the thread context
+ * \details Does nothing if \p instr isn't EVEX encoded. The control word tells the
+ * backend which opmask register masks the operation, whether the masked elements
+ * are zeroed, and which parameter is broadcast.
+ * \warning Assumes the gpr have been saved beforehand !
+ * \param drcontext DynamoRIO's context
+ * \param bb Current basic block
+ * \param where instruction prior to whom we insert the meta-instructions 
+ * \param instr Instrumented instruction
+ * \param oc Category of the instrumented instruction
  */
-void insert_set_destination_tls(void *drcontext, instrlist_t *bb, instr_t *where, reg_id_t destination);
+void insert_set_evex_control(void *drcontext, instrlist_t *bb, instr_t *where, instr_t *instr, OPERATION_CATEGORY oc);
 
 /**
  * \brief Inserts prior to \param where meta-instructions to restore the arithmetic flags and the gpr registers
  * \param drcontext DynamoRIO context
  * \param bb Current basic bloc
  * \param where instruction prior to whom we insert the meta-instructions 
+ * \param regs Registers to restore
  */
-void insert_restore_gpr_and_flags(void *drcontext, instrlist_t *bb, instr_t *where);
+void insert_restore_gpr_and_flags(void *drcontext, instrlist_t *bb, instr_t *where, const plc_register_set_t *regs);
 
 /**
  * \brief Inserts prior to \param where meta-instructions to save the arithmetic flags and the gpr registers
  * \param drcontext DynamoRIO context
  * \param bb Current basic bloc
  * \param where instruction prior to whom we insert the meta-instructions 
+ * \param regs Registers to save
  */
-void insert_save_gpr_and_flags(void *drcontext, instrlist_t *bb, instr_t *where);
+void insert_save_gpr_and_flags(void *drcontext, instrlist_t *bb, instr_t *where, const plc_register_set_t *regs);
 
 /**
  * \brief Inserts prior to \p where meta-instructions to restore RSP from its saved value
@@ -19,6 +19,18 @@
  */
 #define PREFIX_EVEX 0x000100000
 
+/**
+ * \def PREFIX_EVEX_z
+ * \brief Mask to detect the zeroing-masking bit (EVEX.z) of AVX 512 instructions
+ */
+#define PREFIX_EVEX_z 0x000800000
+
+/**
+ * \def PREFIX_EVEX_b
+ * \brief Mask to detect the broadcast / static rounding bit (EVEX.b) of AVX 512 instructions
+ */
+#define PREFIX_EVEX_b 0x001000000
+
 /**
  * \brief Get the flag corresponding to the size of the operands
  * \details This allows us to distinguish between instructions who have the same opcode
@@ -60,22 +72,70 @@ static unsigned int get_size_flag(instr_t *instr){
 }
 
 /**
- * \brief Returns the operation category of instr. The operation category specifies the features of the instruction
+ * \brief Returns true if one of the sources of the operation is a memory reference
  * 
  * \param instr Analysed instruction
- * \return Operation category of instr
- * 
- * \warning If AVX_512 instruction is detected, it marks it as unsupported.
- * \todo Add support for AVX-512
- * \todo Add more instructions
  */
-enum OPERATION_CATEGORY plc_get_operation_category(instr_t *instr){
+static bool has_memory_source(instr_t *instr){
+    for(int i = 0; i < instr_num_srcs(instr); i++){
+        if(opnd_is_memory_reference(instr_get_src(instr, i))){
+            return true;
+        }
+    }
+    return false;
+}
+
+bool plc_is_evex(instr_t *instr){
 #ifdef X86
-    if(instr_get_prefix_flag(instr, PREFIX_EVEX))
-    {
-        return PLC_UNSUPPORTED;
+    return instr_get_prefix_flag(instr, PREFIX_EVEX);
+#else
+    return false;
+#endif
+}
+
+int plc_first_source(instr_t *instr){
+#ifdef X86
+    if(plc_is_evex(instr) && instr_num_srcs(instr) > 0){
+        opnd_t mask = instr_get_src(instr, 0);
+        return (opnd_is_reg(mask) && reg_is_opmask(opnd_get_reg(mask))) ? 1 : 0;
     }
 #endif
+    return 0;
+}
+
+bool plc_is_evex_zeroing(instr_t *instr){
+#ifdef X86
+    return plc_is_evex(instr) && instr_get_prefix_flag(instr, PREFIX_EVEX_z);
+#else
+    return false;
+#endif
+}
+
+bool plc_is_evex_broadcast(instr_t *instr){
+#ifdef X86
+    return plc_is_evex(instr) && instr_get_prefix_flag(instr, PREFIX_EVEX_b) && has_memory_source(instr);
+#else
+    return false;
+#endif
+}
+
+bool plc_has_static_rounding(instr_t *instr){
+#ifdef X86
+    return plc_is_evex(instr) && instr_get_prefix_flag(instr, PREFIX_EVEX_b) && !has_memory_source(instr);
+#else
+    return false;
+#endif
+}
+
+/**
+ * \brief Returns the operation category of instr from its opcode and the size of its operands
+ * 
+ * \param instr Analysed instruction
+ * \return Operation category of instr
+ * 
+ * \todo Add more instructions
+ */
+static enum OPERATION_CATEGORY get_opcode_category(instr_t *instr){
     switch(instr_get_opcode(instr)){
 #ifdef X86
         // ####### SSE SCALAR #######
@@ -366,3 +426,24 @@ enum OPERATION_CATEGORY plc_get_operation_category(instr_t *instr){
             return PLC_OTHER;
     }
 }
+
+/**
+ * \brief Returns the operation category of instr. The operation category specifies the features of the instruction
+ * \details AVX 512 instructions get the PLC_OP_EVEX flag. With static rounding ({er}),
+ * the L'L bits of the EVEX prefix hold the rounding mode instead of the vector length,
+ * which DynamoRIO still decodes as a length : since static rounding is only allowed on
+ * 512 bits register operations, packed operations are marked as such.
+ * 
+ * \param instr Analysed instruction
+ * \return Operation category of instr
+ */
+enum OPERATION_CATEGORY plc_get_operation_category(instr_t *instr){
+    unsigned int oc = get_opcode_category(instr);
+    if(oc != PLC_OTHER && plc_is_evex(instr)){
+        oc |= PLC_OP_EVEX;
+        if(plc_has_static_rounding(instr) && (oc & PLC_OP_PACKED)){
+            oc = (oc & ~PLC_SIMD_TYPE_MASK) | PLC_OP_512;
+        }
+    }
+    return (OPERATION_CATEGORY)oc;
+}
@@ -169,6 +169,14 @@
  */
 #define PLC_OP_AVX          262144     // 0b1000000000000000000
 
+/**
+ * \def PLC_OP_EVEX
+ * \brief Flag for AVX 512 (EVEX encoded) instructions, set along with PLC_OP_AVX
+ * \details Those may be masked by an opmask register, broadcast a memory element
+ * or use a static rounding mode
+ */
+#define PLC_OP_EVEX         524288     // 0b10000000000000000000
+
 /**
  * \def PLC_OP_UNSUPPORTED
  * \brief Flag for operations that are unsupported for the moment
@@ -396,6 +404,33 @@ enum OPERATION_CATEGORY{
  */
 enum OPERATION_CATEGORY plc_get_operation_category(instr_t *instr);
 
+/**
+ * \brief Returns true if \p instr is EVEX encoded (AVX 512)
+ */
+bool plc_is_evex(instr_t *instr);
+
+/**
+ * \brief Returns the index of the first source of the operation performed by \p instr
+ * \details DynamoRIO puts the opmask register of EVEX instructions before the
+ * sources of the operation : the index is 1 for those, 0 otherwise.
+ */
+int plc_first_source(instr_t *instr);
+
+/**
+ * \brief Returns true if \p instr zeroes its masked elements ({z}) instead of leaving them unchanged
+ */
+bool plc_is_evex_zeroing(instr_t *instr);
+
+/**
+ * \brief Returns true if the memory source of \p instr is a single element broadcast to every element ({1toN})
+ */
+bool plc_is_evex_broadcast(instr_t *instr);
+
+/**
+ * \brief Returns true if \p instr has a static rounding mode ({er}), which also suppresses the exceptions
+ */
+bool plc_has_static_rounding(instr_t *instr);
+
 /**
  * \brief Returns true if the operation category has the double flag set
  */
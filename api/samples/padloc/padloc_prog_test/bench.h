@@ -0,0 +1,136 @@
+/*
+* Micro-benchmark kernels measuring the instrumentation overhead per instruction class
+*
+* Each kernel runs a loop of 4 independent instructions of its class, on XMM0 to XMM3
+* (or YMM/ZMM), with XMM4 and XMM5 as constant operands. The instructions are written
+* in assembly so that the compiler can't fold, reorder or vectorize them : under
+* PADLOC, every iteration is one run of 4 instrumented instructions.
+*
+* The results are appended to a CSV file, one line per measure :
+*       mode,benchmark,threads,instructions,seconds,instructions_per_second
+*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+/* Number of instructions per iteration of a kernel */
+#define BENCH_UNROLL 4
+
+#define BENCH_CLOBBERS "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "cc", "memory"
+
+/*
+* Defines the kernel "name" : the accumulators are loaded from acc and the
+* operands from x and y with "load", then "instr" is applied to each accumulator
+* n times. "W" is the prefix of the registers (x, y or z), "end" is executed
+* after the loop (vzeroupper for the VEX and EVEX kernels).
+*/
+#define BENCH_KERNEL(name, load, W, instr, end)                                         \
+    static void name(long n, const void *acc, const void *x, const void *y) {          \
+        asm volatile(load " (%1), %%" W "mm0\n\t"                                       \
+                     load " (%1), %%" W "mm1\n\t"                                       \
+                     load " (%1), %%" W "mm2\n\t"                                       \
+                     load " (%1), %%" W "mm3\n\t"                                       \
+                     load " (%2), %%" W "mm4\n\t"                                       \
+                     load " (%3), %%" W "mm5\n\t"                                       \
+                     "1:\n\t"                                                           \
+                     instr(W, 0) instr(W, 1) instr(W, 2) instr(W, 3)                    \
+                     "dec %0\n\t"                                                       \
+                     "jnz 1b\n\t"                                                       \
+                     end                                                                \
+                     : "+r"(n) : "r"(acc), "r"(x), "r"(y) : BENCH_CLOBBERS);           \
+    }
+
+/* Two operands (SSE) and three operands (VEX/EVEX) forms : acc = acc op x */
+#define BENCH_SSE(op, W, d) #op " %%xmm4, %%xmm" #d "\n\t"
+#define BENCH_VEX(op, W, d) "v" #op " %%" W "mm4, %%" W "mm" #d ", %%" W "mm" #d "\n\t"
+/* FMA : the forms are chosen so that the accumulators stay bounded */
+#define BENCH_FMA132(op, W, d) "vfmadd132" #op " %%" W "mm5, %%" W "mm4, %%" W "mm" #d "\n\t"
+#define BENCH_FMA213(op, W, d) "vfmadd213" #op " %%" W "mm4, %%" W "mm5, %%" W "mm" #d "\n\t"
+#define BENCH_FMA231(op, W, d) "vfmadd231" #op " %%" W "mm4, %%" W "mm5, %%" W "mm" #d "\n\t"
+
+#define ADDSS(W, d) BENCH_SSE(addss, W, d)
+#define ADDSD(W, d) BENCH_SSE(addsd, W, d)
+#define MULSD(W, d) BENCH_SSE(mulsd, W, d)
+#define DIVSD(W, d) BENCH_SSE(divsd, W, d)
+#define ADDPS(W, d) BENCH_SSE(addps, W, d)
+#define ADDPD(W, d) BENCH_SSE(addpd, W, d)
+#define VADDSS(W, d) BENCH_VEX(addss, W, d)
+#define VADDSD(W, d) BENCH_VEX(addsd, W, d)
+#define VMULSD(W, d) BENCH_VEX(mulsd, W, d)
+#define VADDPS(W, d) BENCH_VEX(addps, W, d)
+#define VADDPD(W, d) BENCH_VEX(addpd, W, d)
+#define VMULPD(W, d) BENCH_VEX(mulpd, W, d)
+#define VDIVPD(W, d) BENCH_VEX(divpd, W, d)
+#define FMA132SD(W, d) BENCH_FMA132(sd, W, d)
+#define FMA213SD(W, d) BENCH_FMA213(sd, W, d)
+#define FMA231SD(W, d) BENCH_FMA231(sd, W, d)
+#define FMA132PD(W, d) BENCH_FMA132(pd, W, d)
+#define FMA213PD(W, d) BENCH_FMA213(pd, W, d)
+#define FMA231PD(W, d) BENCH_FMA231(pd, W, d)
+#define FMA231PS(W, d) BENCH_FMA231(ps, W, d)
+
+/* Operands : the accumulators start at 1, x is small and y is close to 1 */
+alignas(64) static const double bench_acc_d[8] = {1, 1, 1, 1, 1, 1, 1, 1};
+alignas(64) static const double bench_x_d[8] = {1e-3, 1e-3, 1e-3, 1e-3, 1e-3, 1e-3, 1e-3, 1e-3};
+alignas(64) static const double bench_y_d[8] = {0.9999999, 0.9999999, 0.9999999, 0.9999999,
+                                                0.9999999, 0.9999999, 0.9999999, 0.9999999};
+alignas(64) static const float bench_acc_f[16] = {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1};
+alignas(64) static const float bench_x_f[16] = {1e-3f, 1e-3f, 1e-3f, 1e-3f, 1e-3f, 1e-3f, 1e-3f, 1e-3f,
+                                               1e-3f, 1e-3f, 1e-3f, 1e-3f, 1e-3f, 1e-3f, 1e-3f, 1e-3f};
+alignas(64) static const float bench_y_f[16] = {0.9999f, 0.9999f, 0.9999f, 0.9999f, 0.9999f, 0.9999f, 0.9999f, 0.9999f,
+                                               0.9999f, 0.9999f, 0.9999f, 0.9999f, 0.9999f, 0.9999f, 0.9999f, 0.9999f};
+
+/* Instruction set needed by a benchmark */
+enum bench_isa { BENCH_SSE2, BENCH_AVX, BENCH_FMA, BENCH_AVX512 };
+
+struct bench_t {
+    const char *name;
+    void (*kernel)(long, const void *, const void *, const void *);
+    bool is_double;
+    bench_isa isa;
+};
+
+static bool bench_supported(bench_isa isa) {
+    __builtin_cpu_init();
+    switch(isa) {
+        case BENCH_AVX: return __builtin_cpu_supports("avx");
+        case BENCH_FMA: return __builtin_cpu_supports("fma");
+        case BENCH_AVX512: return __builtin_cpu_supports("avx512f");
+        default: return true;
+    }
+}
+
+/* Runs the kernel of "bench" over n iterations, and returns the elapsed time in seconds */
+static double bench_run(const bench_t &bench, long n) {
+    const void *acc = bench.is_double ? (const void *)bench_acc_d : (const void *)bench_acc_f;
+    const void *x = bench.is_double ? (const void *)bench_x_d : (const void *)bench_x_f;
+    const void *y = bench.is_double ? (const void *)bench_y_d : (const void *)bench_y_f;
+    auto start = std::chrono::steady_clock::now();
+    bench.kernel(n, acc, x, y);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/* Opens the CSV file in append mode, writing the header if the file is new */
+static FILE *bench_open(const char *filename) {
+    FILE *file = fopen(filename, "a+");
+    if(file == nullptr) {
+        perror(filename);
+        exit(1);
+    }
+    fseek(file, 0, SEEK_END);
+    if(ftell(file) == 0) {
+        fprintf(file, "mode,benchmark,threads,instructions,seconds,instructions_per_second\n");
+    }
+    return file;
+}
+
+static void bench_report(FILE *file, const char *mode, const char *name, int threads, long instructions, double seconds) {
+    fprintf(file, "%s,%s,%d,%ld,%.6f,%.1f\n", mode, name, threads, instructions, seconds, instructions / seconds);
+    printf("%-32s %3d threads %14.1f instructions/s\n", name, threads, instructions / seconds);
+}
+
+#endif
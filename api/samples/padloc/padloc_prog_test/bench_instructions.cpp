@@ -0,0 +1,80 @@
+/*
+* Measures the instructions per second of each instruction class, natively or under PADLOC
+*
+* Usage : bench_instructions.out [mode] [iterations] [output.csv]
+*/
+
+#include "bench.h"
+
+BENCH_KERNEL(sse_scalar_addss, "movups", "x", ADDSS, "")
+BENCH_KERNEL(sse_scalar_addsd, "movups", "x", ADDSD, "")
+BENCH_KERNEL(sse_scalar_mulsd, "movups", "x", MULSD, "")
+BENCH_KERNEL(sse_scalar_divsd, "movups", "x", DIVSD, "")
+BENCH_KERNEL(sse_packed_128_addps, "movups", "x", ADDPS, "")
+BENCH_KERNEL(sse_packed_128_addpd, "movups", "x", ADDPD, "")
+BENCH_KERNEL(avx_scalar_addss, "vmovups", "x", VADDSS, "vzeroupper\n\t")
+BENCH_KERNEL(avx_scalar_addsd, "vmovups", "x", VADDSD, "vzeroupper\n\t")
+BENCH_KERNEL(avx_scalar_mulsd, "vmovups", "x", VMULSD, "vzeroupper\n\t")
+BENCH_KERNEL(avx_packed_128_addpd, "vmovups", "x", VADDPD, "vzeroupper\n\t")
+BENCH_KERNEL(avx_packed_256_addps, "vmovups", "y", VADDPS, "vzeroupper\n\t")
+BENCH_KERNEL(avx_packed_256_addpd, "vmovups", "y", VADDPD, "vzeroupper\n\t")
+BENCH_KERNEL(avx_packed_256_mulpd, "vmovups", "y", VMULPD, "vzeroupper\n\t")
+BENCH_KERNEL(avx_packed_256_divpd, "vmovups", "y", VDIVPD, "vzeroupper\n\t")
+BENCH_KERNEL(fma_scalar_132sd, "vmovups", "x", FMA132SD, "vzeroupper\n\t")
+BENCH_KERNEL(fma_scalar_213sd, "vmovups", "x", FMA213SD, "vzeroupper\n\t")
+BENCH_KERNEL(fma_scalar_231sd, "vmovups", "x", FMA231SD, "vzeroupper\n\t")
+BENCH_KERNEL(fma_packed_256_132pd, "vmovups", "y", FMA132PD, "vzeroupper\n\t")
+BENCH_KERNEL(fma_packed_256_213pd, "vmovups", "y", FMA213PD, "vzeroupper\n\t")
+BENCH_KERNEL(fma_packed_256_231pd, "vmovups", "y", FMA231PD, "vzeroupper\n\t")
+BENCH_KERNEL(fma_packed_256_231ps, "vmovups", "y", FMA231PS, "vzeroupper\n\t")
+BENCH_KERNEL(avx512_packed_512_addps, "vmovups", "z", VADDPS, "vzeroupper\n\t")
+BENCH_KERNEL(avx512_packed_512_addpd, "vmovups", "z", VADDPD, "vzeroupper\n\t")
+BENCH_KERNEL(avx512_packed_512_mulpd, "vmovups", "z", VMULPD, "vzeroupper\n\t")
+BENCH_KERNEL(avx512_packed_512_231pd, "vmovups", "z", FMA231PD, "vzeroupper\n\t")
+
+static const bench_t benchmarks[] = {
+    {"sse_scalar_addss", sse_scalar_addss, false, BENCH_SSE2},
+    {"sse_scalar_addsd", sse_scalar_addsd, true, BENCH_SSE2},
+    {"sse_scalar_mulsd", sse_scalar_mulsd, true, BENCH_SSE2},
+    {"sse_scalar_divsd", sse_scalar_divsd, true, BENCH_SSE2},
+    {"sse_packed_128_addps", sse_packed_128_addps, false, BENCH_SSE2},
+    {"sse_packed_128_addpd", sse_packed_128_addpd, true, BENCH_SSE2},
+    {"avx_scalar_addss", avx_scalar_addss, false, BENCH_AVX},
+    {"avx_scalar_addsd", avx_scalar_addsd, true, BENCH_AVX},
+    {"avx_scalar_mulsd", avx_scalar_mulsd, true, BENCH_AVX},
+    {"avx_packed_128_addpd", avx_packed_128_addpd, true, BENCH_AVX},
+    {"avx_packed_256_addps", avx_packed_256_addps, false, BENCH_AVX},
+    {"avx_packed_256_addpd", avx_packed_256_addpd, true, BENCH_AVX},
+    {"avx_packed_256_mulpd", avx_packed_256_mulpd, true, BENCH_AVX},
+    {"avx_packed_256_divpd", avx_packed_256_divpd, true, BENCH_AVX},
+    {"fma_scalar_132sd", fma_scalar_132sd, true, BENCH_FMA},
+    {"fma_scalar_213sd", fma_scalar_213sd, true, BENCH_FMA},
+    {"fma_scalar_231sd", fma_scalar_231sd, true, BENCH_FMA},
+    {"fma_packed_256_132pd", fma_packed_256_132pd, true, BENCH_FMA},
+    {"fma_packed_256_213pd", fma_packed_256_213pd, true, BENCH_FMA},
+    {"fma_packed_256_231pd", fma_packed_256_231pd, true, BENCH_FMA},
+    {"fma_packed_256_231ps", fma_packed_256_231ps, false, BENCH_FMA},
+    {"avx512_packed_512_addps", avx512_packed_512_addps, false, BENCH_AVX512},
+    {"avx512_packed_512_addpd", avx512_packed_512_addpd, true, BENCH_AVX512},
+    {"avx512_packed_512_mulpd", avx512_packed_512_mulpd, true, BENCH_AVX512},
+    {"avx512_packed_512_231pd", avx512_packed_512_231pd, true, BENCH_AVX512},
+};
+
+int main(int argc, char const *argv[])
+{
+    const char *mode = argc > 1 ? argv[1] : "native";
+    long iterations = argc > 2 ? atol(argv[2]) : 10000000;
+    const char *output = argc > 3 ? argv[3] : "bench_results.csv";
+
+    FILE *file = bench_open(output);
+    for(const bench_t &bench : benchmarks) {
+        if(!bench_supported(bench.isa)) {
+            printf("%-32s skipped, unsupported by the processor\n", bench.name);
+            continue;
+        }
+        double seconds = bench_run(bench, iterations);
+        bench_report(file, mode, bench.name, 1, iterations * BENCH_UNROLL, seconds);
+    }
+    fclose(file);
+    return 0;
+}
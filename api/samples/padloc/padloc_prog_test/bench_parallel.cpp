@@ -0,0 +1,44 @@
+/*
+* Measures the instructions per second of the OpenMP threads, natively or under PADLOC.
+* The iterations are split between the threads (OMP_NUM_THREADS), so running it
+* with an increasing number of threads gives the thread scaling curve.
+*
+* Usage : bench_parallel.out [mode] [iterations] [output.csv]
+*/
+
+#include <omp.h>
+
+#include "bench.h"
+
+BENCH_KERNEL(sse_scalar_addsd, "movups", "x", ADDSD, "")
+BENCH_KERNEL(avx_packed_256_addpd, "vmovups", "y", VADDPD, "vzeroupper\n\t")
+
+static const bench_t benchmarks[] = {
+    {"parallel_sse_scalar_addsd", sse_scalar_addsd, true, BENCH_SSE2},
+    {"parallel_avx_packed_256_addpd", avx_packed_256_addpd, true, BENCH_AVX},
+};
+
+int main(int argc, char const *argv[])
+{
+    const char *mode = argc > 1 ? argv[1] : "native";
+    long iterations = argc > 2 ? atol(argv[2]) : 10000000;
+    const char *output = argc > 3 ? argv[3] : "bench_results.csv";
+    const int threads = omp_get_max_threads();
+
+    FILE *file = bench_open(output);
+    for(const bench_t &bench : benchmarks) {
+        if(!bench_supported(bench.isa)) {
+            printf("%-32s skipped, unsupported by the processor\n", bench.name);
+            continue;
+        }
+        double start = omp_get_wtime();
+        #pragma omp parallel num_threads(threads)
+        {
+            bench_run(bench, iterations / threads);
+        }
+        double seconds = omp_get_wtime() - start;
+        bench_report(file, mode, bench.name, threads, (iterations / threads) * threads * BENCH_UNROLL, seconds);
+    }
+    fclose(file);
+    return 0;
+}
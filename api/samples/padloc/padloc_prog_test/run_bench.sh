@@ -0,0 +1,41 @@
+#! /bin/bash 
+
+# Runs the micro-benchmarks natively and under PADLOC, and appends the results to a CSV file
+# Usage : run_bench.sh [output.csv] [padloc options...]
+# The number of iterations can be changed with NATIVE_ITERATIONS and PADLOC_ITERATIONS,
+# and the thread counts of the scaling curve with THREADS.
+
+DYNAMORIO_DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" >/dev/null 2>&1 && pwd )/../../../.."
+DYNAMORIO_BUILD_DIR="${DYNAMORIO_DIR}/build"
+PROG_TEST_DIR="${DYNAMORIO_DIR}/api/samples/padloc/padloc_prog_test"
+
+OUTPUT="$(realpath -m ${1:-bench_results.csv})"
+shift
+PADLOC_OPTIONS="$@"
+NATIVE_ITERATIONS=${NATIVE_ITERATIONS:-100000000}
+PADLOC_ITERATIONS=${PADLOC_ITERATIONS:-1000000}
+THREADS=${THREADS:-"1 2 4 8"}
+
+MODE="padloc"
+if [ -n "${PADLOC_OPTIONS}" ]; then
+	MODE="padloc ${PADLOC_OPTIONS}"
+fi
+
+cd ${PROG_TEST_DIR}
+make bench
+
+PADLOC="${DYNAMORIO_BUILD_DIR}/bin64/drrun -c ${DYNAMORIO_BUILD_DIR}/api/bin/libpadloc.so ${PADLOC_OPTIONS} --"
+
+echo -e "BENCH instructions\n"
+./bench_instructions.out native ${NATIVE_ITERATIONS} ${OUTPUT}
+${PADLOC} ./bench_instructions.out "${MODE}" ${PADLOC_ITERATIONS} ${OUTPUT}
+
+for threads in ${THREADS}; do
+	echo -e "\nBENCH parallel, ${threads} threads\n"
+	OMP_NUM_THREADS=${threads} ./bench_parallel.out native ${NATIVE_ITERATIONS} ${OUTPUT}
+	OMP_NUM_THREADS=${threads} ${PADLOC} ./bench_parallel.out "${MODE}" ${PADLOC_ITERATIONS} ${OUTPUT}
+done
+
+echo -e "\nResults appended to ${OUTPUT}"
+
+cd - > /dev/null
@@ -10,6 +10,10 @@ make
 cd ${DYNAMORIO_BUILD_DIR}
 
 for prog_test in ${DYNAMORIO_DIR}/api/samples/padloc/padloc_prog_test/*.out; do
+	# The benchmarks are run by run_bench.sh
+	if [[ $(basename -- $prog_test) == bench_* ]]; then
+		continue
+	fi
 	echo -e "TEST $(basename -- $prog_test)\n"
 	${DYNAMORIO_BUILD_DIR}/bin64/drrun -c ${DYNAMORIO_BUILD_DIR}/api/bin/libpadloc.so -- ${prog_test}	
 	echo -e "\n############################################################################################################\n"
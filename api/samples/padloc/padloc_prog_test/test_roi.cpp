@@ -0,0 +1,31 @@
+#include <cstdio>
+
+#include "../padloc_app.h"
+
+/*
+* Region of interest test : run with "-ro", only the sum between the markers
+* is instrumented, so the warmup and the cooldown results are always the same
+* and only the region one changes from a run to another
+*/
+static double sum(int n)
+{
+    volatile double x = 0.1;
+    double s = 0;
+    for(int i = 0; i < n; i++){
+        s += x;
+    }
+    return s;
+}
+
+int main(int argc, char const *argv[])
+{
+    double warmup = sum(1000);
+
+    padloc_roi_start();
+    double region = sum(1000);
+    padloc_roi_stop();
+
+    double cooldown = sum(1000);
+    printf("warmup : %.17g\nregion : %.17g\ncooldown : %.17g\n", warmup, region, cooldown);
+    return 0;
+}
@@ -0,0 +1,25 @@
+#include <cstdio>
+
+#include "../padloc_app.h"
+
+/*
+* Monte-Carlo sampling test : run with "-mc 16", the report gives the maximal
+* number of significant digits for the exact sum, and fewer for the cancelling one
+*/
+int main(int argc, char const *argv[])
+{
+    padloc_sample_start();
+
+    volatile double x = 0.1;
+    double exact = 0, cancelling = 1e8;
+    for(int i = 0; i < 1000; i++){
+        exact += 0.5;
+        cancelling += x;
+    }
+    cancelling -= 1e8;
+
+    padloc_sample_output("exact", exact);
+    padloc_sample_output("cancelling", cancelling);
+    printf("exact : %.17g\ncancelling : %.17g\n", exact, cancelling);
+    return 0;
+}
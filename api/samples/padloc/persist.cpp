@@ -0,0 +1,427 @@
+/**
+ * \file persist.cpp
+ * \brief Persistent code cache support source file. Part of the PADLOC project.
+ *
+ * \details The arena is reserved without access at one of the
+ * PLC_PERSIST_ARENA_BASES, the first free one, and split in PLC_PERSIST_SLOTS
+ * slabs. A slab is only committed when a module claims it. The slab of a
+ * module is chosen by hashing its base address, which is the same in every
+ * run a persisted file is used (DynamoRIO doesn't relocate them), and is
+ * owned by the first module that allocates in it : a module whose slab is
+ * owned by another one doesn't get persistable descriptors. The descriptors
+ * are bump allocated in the slab, so that its used part is walkable.
+ *
+ * The read-only section of a persisted file holds a header identifying the
+ * client, its options and the slab, followed by the used part of the slab.
+ * Resurrecting it copies back the part of the slab not allocated yet in this
+ * run, after checking that the part already allocated is the same, and
+ * registers the restored descriptors so that the dispatcher and the
+ * translations reuse them.
+ *
+ * \author Brasseur Dylan, Teaudors Mickaël, Valeri Yoann
+ * \date 2019
+ * \copyright Interflop
+ */
+
+#include <string.h>
+
+#include "dr_api.h"
+
+#include "persist.hpp"
+#include "padloc_client.h"
+#include "profile.hpp"
+#include "roi.hpp"
+#include "samples.hpp"
+#include "utils.hpp"
+
+/**
+ * \def PLC_PERSIST_MAGIC
+ * \brief First word of the data of a persisted file ("PLCP")
+ */
+#define PLC_PERSIST_MAGIC 0x50434c50
+
+/**
+ * \def PLC_PERSIST_VERSION
+ * \brief Version of the persisted data, to change with the layout of the descriptors
+ */
+#define PLC_PERSIST_VERSION 2
+
+/**
+ * \def PLC_PERSIST_SLOTS
+ * \brief Number of slabs of the arena
+ */
+#define PLC_PERSIST_SLOTS 256
+
+#if defined(X64)
+/**
+ * \def PLC_PERSIST_ARENA_BASES
+ * \brief Addresses at which the arena may be reserved, tried in order. The
+ * persisted files are only used by runs reserving it at the same address.
+ */
+#define PLC_PERSIST_ARENA_BASES {0x6f0000000000, 0x5f0000000000, 0x4f0000000000}
+
+/**
+ * \def PLC_PERSIST_SLAB_SIZE
+ * \brief Size in bytes of the slab of a module
+ */
+#define PLC_PERSIST_SLAB_SIZE (4 << 20)
+#else
+#define PLC_PERSIST_ARENA_BASES {0x6f000000, 0x5f000000, 0x4f000000}
+#define PLC_PERSIST_SLAB_SIZE (256 << 10)
+#endif
+
+/**
+ * \struct plc_persist_header_t
+ * \brief Header of the read-only data of a persisted file
+ */
+struct plc_persist_header_t{
+    /** PLC_PERSIST_MAGIC */
+    uint32_t magic;
+    /** PLC_PERSIST_VERSION */
+    uint32_t version;
+    /** Base of the client library, the code calls it by absolute addresses */
+    byte *client_base;
+    /** Base of the arena, the code refers to the descriptors by absolute addresses */
+    byte *arena_base;
+    /** Hash of the read-only segments of the client library */
+    uint64_t client_hash;
+    /** Hash of the client arguments */
+    uint64_t options_hash;
+    /** Base of the persisted module, owning the slab */
+    app_pc module_base;
+    /** Index of the slab in the arena */
+    uint32_t slot;
+    /** Unused, 0 */
+    uint32_t reserved;
+    /** Size in bytes of the used part of the slab, following the header */
+    uint64_t used;
+};
+
+/**
+ * \struct plc_persist_slab_t
+ * \brief Bookkeeping of a slab
+ */
+struct plc_persist_slab_t{
+    /** Base of the module owning the slab, null if it's free */
+    app_pc owner;
+    /** End of the module owning the slab */
+    app_pc owner_end;
+    /** Size in bytes of the used part of the slab */
+    size_t used;
+};
+
+/**
+ * Arena of the descriptors, null if the persist mode is disabled
+ */
+static byte *arena = nullptr;
+
+/**
+ * Slabs of the arena, protected by persist_lock
+ */
+static plc_persist_slab_t slabs[PLC_PERSIST_SLOTS];
+
+/**
+ * Lock protecting the slabs
+ */
+static void *persist_lock;
+
+/**
+ * Base of the client library
+ */
+static byte *client_base;
+
+/**
+ * Hash of the read-only segments of the client library, which identifies its build
+ */
+static uint64_t client_hash;
+
+/**
+ * Hash of the client arguments
+ */
+static uint64_t options_hash;
+
+/**
+ * \brief FNV-1a hash of \p size bytes at \p data, continuing \p hash
+ */
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t size){
+    const byte *bytes = (const byte *)data;
+    for(size_t i = 0; i < size; i++){
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/**
+ * \brief Gives the slab \p s to the module from \p start to \p end, committing its memory
+ * \details Must be called with persist_lock held
+ *
+ * \return False if the memory of the slab couldn't be committed, the slab stays free
+ */
+static bool claim_slab(uint32_t s, app_pc start, app_pc end){
+    static bool reported = false;
+    if(!dr_memory_protect(arena + (size_t)s * PLC_PERSIST_SLAB_SIZE, PLC_PERSIST_SLAB_SIZE,
+                          DR_MEMPROT_READ | DR_MEMPROT_WRITE)){
+        if(!reported){
+            reported = true;
+            dr_fprintf(STDERR, "PERSIST FAILURE : Couldn't commit the descriptor slab of the module " PFX
+                       " (out of memory), the blocks of the modules without slab won't be persisted\n", start);
+        }
+        return false;
+    }
+    slabs[s].owner = start;
+    slabs[s].owner_end = end;
+    return true;
+}
+
+/**
+ * \brief Returns the index of the slab of the module based at \p module_base
+ */
+static inline uint32_t slot_of(app_pc module_base){
+    return (uint32_t)((((ptr_uint_t)module_base >> 12) * 0x9e3779b97f4a7c15ULL) >> 32) % PLC_PERSIST_SLOTS;
+}
+
+/**
+ * \brief Returns the slab owned by the module containing \p pc, claiming a
+ * free slab for its module if needed
+ * \details Must be called with persist_lock held
+ *
+ * \return The index of the slab, -1 if \p pc isn't in a module or its slab is owned by another module
+ */
+static int slab_of(app_pc pc){
+    for(int s = 0; s < PLC_PERSIST_SLOTS; s++){
+        if(slabs[s].owner != nullptr && pc >= slabs[s].owner && pc < slabs[s].owner_end){
+            return s;
+        }
+    }
+    module_data_t *module = dr_lookup_module(pc);
+    if(module == nullptr){
+        return -1;
+    }
+    const uint32_t s = slot_of(module->start);
+    int ret = -1;
+    if(slabs[s].owner == nullptr && claim_slab(s, module->start, module->end)){
+        ret = (int)s;
+    }
+    dr_free_module_data(module);
+    return ret;
+}
+
+bool plc_persist_enabled(){
+    return arena != nullptr;
+}
+
+void *plc_persist_alloc(app_pc pc, size_t size){
+    if(arena == nullptr){
+        return nullptr;
+    }
+    size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    void *ret = nullptr;
+    dr_mutex_lock(persist_lock);
+    const int s = slab_of(pc);
+    if(s >= 0 && slabs[s].used + size <= PLC_PERSIST_SLAB_SIZE){
+        ret = arena + (size_t)s * PLC_PERSIST_SLAB_SIZE + slabs[s].used;
+        slabs[s].used += size;
+    }
+    dr_mutex_unlock(persist_lock);
+    return ret;
+}
+
+bool plc_persist_owns(const void *ptr){
+    return arena != nullptr && (const byte *)ptr >= arena &&
+           (const byte *)ptr < arena + (size_t)PLC_PERSIST_SLOTS * PLC_PERSIST_SLAB_SIZE;
+}
+
+/**
+ * \brief Fills the header of the slab of the module of the persisted code \p perscxt
+ * \details The slab isn't claimed : a module without slab persists an empty one.
+ * Must be called with persist_lock held.
+ */
+static void fill_header(void *perscxt, plc_persist_header_t *header){
+    memset(header, 0, sizeof(*header));
+    header->magic = PLC_PERSIST_MAGIC;
+    header->version = PLC_PERSIST_VERSION;
+    header->client_base = client_base;
+    header->arena_base = arena;
+    header->client_hash = client_hash;
+    header->options_hash = options_hash;
+    module_data_t *module = dr_lookup_module(dr_persist_start(perscxt));
+    if(module == nullptr){
+        return;
+    }
+    header->module_base = module->start;
+    header->slot = slot_of(module->start);
+    if(slabs[header->slot].owner == module->start){
+        header->used = slabs[header->slot].used;
+    }
+    dr_free_module_data(module);
+}
+
+/**
+ * \brief Returns the size of the read-only data persisted with the code \p perscxt
+ * \details The header is kept in \p user_data for event_persist_ro, so that
+ * both write the same used size
+ */
+static size_t event_persist_ro_size(void *drcontext, void *perscxt, size_t file_offs, void **user_data){
+    plc_persist_header_t *header = (plc_persist_header_t *)dr_global_alloc(sizeof(plc_persist_header_t));
+    dr_mutex_lock(persist_lock);
+    fill_header(perscxt, header);
+    dr_mutex_unlock(persist_lock);
+    *user_data = header;
+    return sizeof(plc_persist_header_t) + header->used;
+}
+
+/**
+ * \brief Writes the header and the used part of the slab of the module persisted
+ */
+static bool event_persist_ro(void *drcontext, void *perscxt, file_t fd, void *user_data){
+    plc_persist_header_t *header = (plc_persist_header_t *)user_data;
+    bool ok = dr_write_file(fd, header, sizeof(*header)) == (ssize_t)sizeof(*header);
+    if(ok && header->used > 0){
+        ok = dr_write_file(fd, arena + (size_t)header->slot * PLC_PERSIST_SLAB_SIZE, header->used) ==
+             (ssize_t)header->used;
+    }
+    dr_global_free(header, sizeof(*header));
+    return ok;
+}
+
+/**
+ * \brief Validates the read-only data of a persisted file and restores its slab
+ * \details Rejects the file, which DynamoRIO then ignores, if it was written
+ * by another build of the client, at another base or with other options, or
+ * if the slab of its module is owned by another module or holds other
+ * descriptors at the same offsets.
+ */
+static bool event_resurrect_ro(void *drcontext, void *perscxt, byte **map){
+    plc_persist_header_t header;
+    memcpy(&header, *map, sizeof(header));
+    const byte *data = *map + sizeof(header);
+    if(header.magic != PLC_PERSIST_MAGIC || header.version != PLC_PERSIST_VERSION ||
+       header.client_base != client_base || header.arena_base != arena ||
+       header.client_hash != client_hash ||
+       header.options_hash != options_hash || header.slot >= PLC_PERSIST_SLOTS ||
+       header.used > PLC_PERSIST_SLAB_SIZE){
+        if(get_log_level() >= 2){
+            dr_fprintf(STDERR, "Persisted cache of " PFX " ignored : written by another client or with other options\n",
+                       header.module_base);
+        }
+        return false;
+    }
+    byte *slab = arena + (size_t)header.slot * PLC_PERSIST_SLAB_SIZE;
+    size_t restored_start = 0, restored_end = 0;
+    bool ok = true;
+    dr_mutex_lock(persist_lock);
+    plc_persist_slab_t &bookkeeping = slabs[header.slot];
+    if(header.used > 0){
+        if(bookkeeping.owner == nullptr){
+            module_data_t *module = dr_lookup_module(header.module_base);
+            ok = module != nullptr && module->start == header.module_base &&
+                 claim_slab(header.slot, module->start, module->end);
+            if(module != nullptr){
+                dr_free_module_data(module);
+            }
+        }else{
+            ok = bookkeeping.owner == header.module_base;
+        }
+        //The part allocated in this run must hold the same descriptors
+        const size_t common = header.used < bookkeeping.used ? header.used : bookkeeping.used;
+        ok = ok && memcmp(slab, data, common) == 0;
+        if(ok && header.used > bookkeeping.used){
+            restored_start = bookkeeping.used;
+            restored_end = header.used;
+            memcpy(slab + restored_start, data + restored_start, restored_end - restored_start);
+            bookkeeping.used = header.used;
+        }
+    }
+    dr_mutex_unlock(persist_lock);
+    if(!ok){
+        if(get_log_level() >= 2){
+            dr_fprintf(STDERR, "Persisted cache of " PFX " ignored : its descriptors conflict with this run\n",
+                       header.module_base);
+        }
+        return false;
+    }
+    //Outside of persist_lock, which is taken under the lock of the block descriptors
+    if(restored_end > restored_start){
+        plc_register_block_descriptors(slab + restored_start, restored_end - restored_start);
+    }
+    *map += sizeof(header) + header.used;
+    return true;
+}
+
+/**
+ * \brief Returns the hash of the read-only segments of the client library based at \p base
+ */
+static uint64_t hash_client(byte *base){
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    module_data_t *client = dr_lookup_module(base);
+    if(client == nullptr){
+        return hash;
+    }
+#if defined(WINDOWS)
+    hash = hash_bytes(hash, client->start, client->end - client->start);
+#else
+    for(uint i = 0; i < client->num_segments; i++){
+        const module_segment_data_t &segment = client->segments[i];
+        if(!(segment.prot & DR_MEMPROT_WRITE)){
+            hash = hash_bytes(hash, segment.start, segment.end - segment.start);
+        }
+    }
+#endif
+    dr_free_module_data(client);
+    return hash;
+}
+
+void plc_persist_init(client_id_t id, int argc, const char *argv[]){
+    if(!get_persist_mode()){
+        return;
+    }
+    //Those modes insert clean calls whose state isn't kept across runs
+    if(get_roi_mode() || plc_samples_enabled() || plc_profile_enabled()){
+        dr_fprintf(STDERR, "PERSIST FAILURE : -pc can't be used with -ro, -mc, -ls or -pf, the blocks won't be persisted\n");
+        return;
+    }
+    //Only reserved : the slabs are committed when claimed by a module
+    const size_t size = (size_t)PLC_PERSIST_SLOTS * PLC_PERSIST_SLAB_SIZE;
+    static const ptr_uint_t bases[] = PLC_PERSIST_ARENA_BASES;
+    for(ptr_uint_t base : bases){
+        arena = (byte *)dr_raw_mem_alloc(size, DR_MEMPROT_NONE, (void *)base);
+        if(arena == (byte *)base){
+            break;
+        }
+        if(arena != nullptr){
+            dr_raw_mem_free(arena, size);
+            arena = nullptr;
+        }
+    }
+    if(arena == nullptr){
+        dr_fprintf(STDERR, "PERSIST FAILURE : Couldn't reserve the %d MB descriptor arena at any of its addresses "
+                   "(already mapped or out of address space), the blocks won't be persisted\n",
+                   (int)(size >> 20));
+        return;
+    }
+    if(get_log_level() >= 2){
+        dr_printf("Descriptor arena reserved at " PFX "\n", arena);
+    }
+    memset(slabs, 0, sizeof(slabs));
+    persist_lock = dr_mutex_create();
+    client_base = dr_get_client_base(id);
+    client_hash = hash_client(client_base);
+    options_hash = 0xcbf29ce484222325ULL;
+    //argv[0] is the path of the client, which may differ between equivalent runs
+    for(int i = 1; i < argc; i++){
+        options_hash = hash_bytes(options_hash, argv[i], strlen(argv[i]) + 1);
+    }
+    if(!dr_register_persist_ro(event_persist_ro_size, event_persist_ro, event_resurrect_ro)){
+        dr_fprintf(STDERR, "PERSIST FAILURE : Couldn't register the persistence events\n");
+    }
+}
+
+void plc_persist_exit(){
+    if(arena == nullptr){
+        return;
+    }
+    dr_unregister_persist_ro(event_persist_ro_size, event_persist_ro, event_resurrect_ro);
+    dr_raw_mem_free(arena, (size_t)PLC_PERSIST_SLOTS * PLC_PERSIST_SLAB_SIZE);
+    arena = nullptr;
+    dr_mutex_destroy(persist_lock);
+}
@@ -0,0 +1,66 @@
+#ifndef PERSIST_BARRIER_HEADER
+#define PERSIST_BARRIER_HEADER
+
+/**
+ * \file persist.hpp
+ * \brief Persistent code cache support header. Part of the PADLOC project.
+ *
+ * \details When the persist mode is enabled, the instrumented basic blocks
+ * are marked persistable, so that DynamoRIO writes them to its persistent
+ * cache files (drrun -persist) and loads them back in the next runs of the
+ * same modules, without calling the instrumentation again. The persisted
+ * code refers to the client by absolute addresses (backend functions,
+ * constants) and to the block descriptors of the dispatcher (-bc). Those are
+ * allocated in an arena reserved at a fixed address, split in one slab per
+ * module committed on its first use, and each persisted file carries the
+ * slab of its module. A file is
+ * only used if the client is the same build, loaded at the same base, with
+ * the same options, and if the slab of its module can be restored at the
+ * same address.
+ *
+ * \author Brasseur Dylan, Teaudors Mickaël, Valeri Yoann
+ * \date 2019
+ * \copyright Interflop
+ */
+
+#include "dr_api.h"
+
+/**
+ * \brief Returns true if the instrumented blocks are persistable
+ */
+bool plc_persist_enabled();
+
+/**
+ * \brief Reserves the descriptor arena and registers the persistence events
+ * \details Does nothing if the persist mode isn't enabled. The mode is
+ * disabled, with an error message, if the arena can't be reserved at any of
+ * its addresses or if an option inserting non persistable code is enabled.
+ *
+ * \param id ID of the client
+ * \param argc Number of client arguments
+ * \param argv Array of client arguments, which the persisted files must match
+ */
+void plc_persist_init(client_id_t id, int argc, const char *argv[]);
+
+/**
+ * \brief Unregisters the persistence events and frees the descriptor arena
+ * \details Called at the exit of the client, after the block descriptors are freed
+ */
+void plc_persist_exit();
+
+/**
+ * \brief Allocates \p size bytes in the slab of the module containing \p pc
+ *
+ * \param pc Address of the application code the allocation describes
+ * \param size Size in bytes of the allocation
+ * \return The allocated memory, or nullptr if the persist mode is disabled or
+ * the slab can't hold it, in which case the code referring to it can't be persisted
+ */
+void *plc_persist_alloc(app_pc pc, size_t size);
+
+/**
+ * \brief Returns true if \p ptr was allocated by plc_persist_alloc
+ */
+bool plc_persist_owns(const void *ptr);
+
+#endif //PERSIST_BARRIER_HEADER
@@ -0,0 +1,290 @@
+/**
+ * \file profile.cpp
+ * \brief Instrumentation profiler source file. Part of the PADLOC project.
+ *
+ * \details Each thread owns a table of counters, pointed to by a TLS field.
+ * The instrumented code increments the counters inline, and reads the time
+ * stamp counter at the boundaries of the save, backend and restore phases of
+ * each run of instrumented instructions, so that no clean call is added. The
+ * tables are added to the totals when the threads exit, and the report is
+ * written when the client exits.
+ *
+ * \author Brasseur Dylan, Teaudors Mickaël, Valeri Yoann
+ * \date 2019
+ * \copyright Interflop
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "dr_api.h"
+#include "drmgr.h"
+
+#include "profile.hpp"
+#include "padloc_client.h"
+#include "utils.hpp"
+
+/**
+ * \def MINSERT
+ * \brief Code shortening macro, equivalent to instrlist_meta_preinsert
+ */
+#define MINSERT(bb, where, instr) instrlist_meta_preinsert(bb, where, instr)
+
+/**
+ * \struct plc_profile_table_t
+ * \brief Counters of a thread, updated inline by the instrumented code
+ */
+struct plc_profile_table_t{
+    /** Time stamp counter at the previous timestamp of the thread */
+    uint64_t last;
+    /** Cycles spent in each phase */
+    uint64_t cycles[PLC_PROFILE_NB_PHASES];
+    /** Number of executed runs of instrumented instructions */
+    uint64_t runs;
+    /** Keeps the counters on their own cache lines */
+    uint64_t padding[3];
+    /** Number of executed instructions of each site */
+    uint64_t counters[PLC_PROFILE_MAX_SITES];
+};
+
+/**
+ * \struct plc_profile_site_t
+ * \brief Symbol and operation category identifying a counter
+ */
+struct plc_profile_site_t{
+    /** Name of the symbol, in the format of the symbol files, "<unknown>" outside of the modules */
+    std::string symbol;
+    /** Operation category of the counted instructions */
+    OPERATION_CATEGORY oc;
+};
+
+/**
+ * Index of the TLS field holding the table of the thread
+ */
+static int tls_profile = -1;
+
+/**
+ * Registered sites, the index of a site being the index of its counter
+ */
+static std::vector<plc_profile_site_t> sites;
+
+/**
+ * Index of each registered site, by symbol and operation category
+ */
+static std::map<std::pair<std::string, uint32_t>, uint32_t> site_indexes;
+
+/**
+ * Sum of the tables of the exited threads
+ */
+static plc_profile_table_t *totals = nullptr;
+
+/**
+ * Lock protecting the sites and the totals
+ */
+static void *profile_lock = nullptr;
+
+bool plc_profile_enabled(){
+    return !get_profile_file().empty();
+}
+
+void plc_profile_init(){
+    if(!plc_profile_enabled()){
+        return;
+    }
+    tls_profile = drmgr_register_tls_field();
+    DR_ASSERT_MSG(tls_profile != -1, "Couldn't register the profiling TLS field");
+    profile_lock = dr_mutex_create();
+    totals = (plc_profile_table_t *)dr_global_alloc(sizeof(plc_profile_table_t));
+    memset(totals, 0, sizeof(plc_profile_table_t));
+}
+
+void plc_profile_thread_init(void *drcontext){
+    if(!plc_profile_enabled()){
+        return;
+    }
+    plc_profile_table_t *table = (plc_profile_table_t *)dr_thread_alloc(drcontext, sizeof(plc_profile_table_t));
+    memset(table, 0, sizeof(plc_profile_table_t));
+    SET_TLS(drcontext, tls_profile, table);
+}
+
+void plc_profile_thread_exit(void *drcontext){
+    if(!plc_profile_enabled()){
+        return;
+    }
+    plc_profile_table_t *table = (plc_profile_table_t *)GET_TLS(drcontext, tls_profile);
+    dr_mutex_lock(profile_lock);
+    for(int i = 0; i < PLC_PROFILE_NB_PHASES; i++){
+        totals->cycles[i] += table->cycles[i];
+    }
+    totals->runs += table->runs;
+    for(uint32_t i = 0; i < PLC_PROFILE_MAX_SITES; i++){
+        totals->counters[i] += table->counters[i];
+    }
+    dr_mutex_unlock(profile_lock);
+    dr_thread_free(drcontext, table, sizeof(plc_profile_table_t));
+}
+
+uint32_t plc_profile_site(const std::string &symbol, OPERATION_CATEGORY oc){
+    dr_mutex_lock(profile_lock);
+    std::pair<std::string, uint32_t> key(symbol, (uint32_t)oc);
+    auto it = site_indexes.find(key);
+    uint32_t site;
+    if(it != site_indexes.end()){
+        site = it->second;
+    }else{
+        site = (uint32_t)sites.size();
+        sites.push_back({symbol.empty() ? "<unknown>" : symbol, oc});
+        site_indexes[key] = site;
+    }
+    dr_mutex_unlock(profile_lock);
+    //The last counter is shared by the sites that don't fit in the table
+    return std::min(site, (uint32_t)(PLC_PROFILE_MAX_SITES - 1));
+}
+
+void plc_profile_insert_count(void *drcontext, instrlist_t *bb, instr_t *where,
+                              uint32_t site, uint32_t count, reg_id_t scratch){
+#if defined(X86) && defined(X64)
+    INSERT_READ_TLS(drcontext, tls_profile, bb, where, scratch);
+    int disp = (int)(offsetof(plc_profile_table_t, counters) + site * sizeof(uint64_t));
+    opnd_t increment = count < 128 ? OPND_CREATE_INT8(count) : OPND_CREATE_INT32(count);
+    MINSERT(bb, where, INSTR_CREATE_add(drcontext, OP_BASE_DISP(scratch, disp, OPSZ_8), increment));
+#else //AArch64
+    DR_ASSERT_MSG(false, "plc_profile_insert_count not implemented for this architecture");
+#endif
+}
+
+void plc_profile_insert_timestamp(void *drcontext, instrlist_t *bb, instr_t *where,
+                                  plc_profile_phase_t phase){
+#if defined(X86) && defined(X64)
+    INSERT_READ_TLS(drcontext, tls_profile, bb, where, DR_SCRATCH_REG);
+    //Time stamp counter in RAX
+    MINSERT(bb, where, INSTR_CREATE_rdtsc(drcontext));
+    MINSERT(bb, where, INSTR_CREATE_shl(drcontext, OP_REG(DR_REG_XDX), OPND_CREATE_INT8(32)));
+    MINSERT(bb, where, INSTR_CREATE_or(drcontext, OP_REG(DR_REG_XAX), OP_REG(DR_REG_XDX)));
+    opnd_t last = OP_BASE_DISP(DR_SCRATCH_REG, offsetof(plc_profile_table_t, last), OPSZ_8);
+    if(phase == PLC_PROFILE_START){
+        MINSERT(bb, where, XINST_CREATE_store(drcontext, last, OP_REG(DR_REG_XAX)));
+        MINSERT(bb, where, INSTR_CREATE_add(drcontext, OP_BASE_DISP(DR_SCRATCH_REG, offsetof(plc_profile_table_t, runs), OPSZ_8),
+                                            OPND_CREATE_INT8(1)));
+    }else{
+        //Add the cycles elapsed since the last timestamp to the phase
+        MINSERT(bb, where, XINST_CREATE_move(drcontext, OP_REG(DR_REG_XDX), OP_REG(DR_REG_XAX)));
+        MINSERT(bb, where, INSTR_CREATE_sub(drcontext, OP_REG(DR_REG_XAX), last));
+        MINSERT(bb, where, INSTR_CREATE_add(drcontext,
+                                            OP_BASE_DISP(DR_SCRATCH_REG, offsetof(plc_profile_table_t, cycles) + phase * sizeof(uint64_t), OPSZ_8),
+                                            OP_REG(DR_REG_XAX)));
+        MINSERT(bb, where, XINST_CREATE_store(drcontext, last, OP_REG(DR_REG_XDX)));
+    }
+#else //AArch64
+    DR_ASSERT_MSG(false, "plc_profile_insert_timestamp not implemented for this architecture");
+#endif
+}
+
+/**
+ * \brief Returns a readable name for the operation category \p oc
+ *
+ * \param oc Operation category
+ * \return std::string Name of the category, such as "AVX packed double add 256"
+ */
+static std::string category_name(OPERATION_CATEGORY oc){
+    std::string name = (oc & PLC_OP_EVEX) ? "AVX512" : (oc & PLC_OP_AVX) ? "AVX" : "SSE";
+    name += plc_is_packed(oc) ? " packed" : " scalar";
+    name += plc_is_double(oc) ? " double" : " float";
+    if(plc_is_fused(oc)){
+        name += plc_is_negated(oc) ? " n" : " ";
+        name += plc_is_fma(oc) ? "fma" : "fms";
+        name += plc_is_fma132(oc) ? "132" : plc_is_fma213(oc) ? "213" : "231";
+    }else{
+        name += plc_is_add(oc) ? " add" : plc_is_sub(oc) ? " sub" : plc_is_mul(oc) ? " mul" : " div";
+    }
+    if(plc_is_packed(oc)){
+        name += plc_is_512(oc) ? " 512" : plc_is_256(oc) ? " 256" : " 128";
+    }
+    return name;
+}
+
+/**
+ * \brief Writes the counts of \p counts, sorted by decreasing count
+ *
+ * \param output The output file in which to write
+ * \param counts Count of each key
+ * \param total Total count, to compute the percentages
+ * \param commented True to comment out the keys, so that the report stays a valid symbol file.
+ * The keys starting with '<' aren't symbols, and are always commented out.
+ */
+static void write_sorted(std::ofstream &output, const std::map<std::string, uint64_t> &counts,
+                         uint64_t total, bool commented){
+    std::vector<std::pair<std::string, uint64_t>> sorted(counts.begin(), counts.end());
+    std::stable_sort(sorted.begin(), sorted.end(), [](const std::pair<std::string, uint64_t> &a,
+                                                      const std::pair<std::string, uint64_t> &b){
+        return a.second > b.second;
+    });
+    for(const auto &entry : sorted){
+        if(entry.second == 0){
+            break;
+        }
+        output << (commented || entry.first[0] == '<' ? "#\t" : "") << entry.first << "\t# " << entry.second << " operations, "
+               << (total ? 100. * entry.second / total : 0.) << "%\n";
+    }
+}
+
+void plc_profile_exit(){
+    if(!plc_profile_enabled()){
+        return;
+    }
+    std::map<std::string, uint64_t> per_symbol, per_category, per_site;
+    uint64_t total = 0;
+    for(uint32_t i = 0; i < sites.size(); i++){
+        uint32_t counter = std::min(i, (uint32_t)(PLC_PROFILE_MAX_SITES - 1));
+        if(i > counter){
+            //Already counted in the shared counter
+            continue;
+        }
+        uint64_t count = totals->counters[counter];
+        bool shared = (counter == PLC_PROFILE_MAX_SITES - 1) && sites.size() > PLC_PROFILE_MAX_SITES;
+        const std::string symbol = shared ? "<other sites>" : sites[i].symbol;
+        const std::string category = shared ? "<other sites>" : category_name(sites[i].oc);
+        per_symbol[symbol] += count;
+        per_category[category] += count;
+        per_site[symbol + " (" + category + ")"] += count;
+        total += count;
+    }
+    uint64_t cycles = 0;
+    for(int i = 0; i < PLC_PROFILE_NB_PHASES; i++){
+        cycles += totals->cycles[i];
+    }
+    const char *phase_names[PLC_PROFILE_NB_PHASES] = {"save", "backend", "restore"};
+
+    std::ofstream output(get_profile_file());
+    if(!output.good()){
+        dr_fprintf(STDERR, "PROFILE FAILURE : Couldn't open the profile file \"%s\"\n", get_profile_file().c_str());
+    }else{
+        write_to_file_symbol_file_header(output);
+        output << "# PADLOC profile : " << total << " instrumented operations in " << totals->runs << " runs\n";
+        output << "# Cycles (time stamp counter) :\n";
+        for(int i = 0; i < PLC_PROFILE_NB_PHASES; i++){
+            output << "#\t" << phase_names[i] << "\t" << totals->cycles[i] << " cycles, "
+                   << (cycles ? 100. * totals->cycles[i] / cycles : 0.) << "%, "
+                   << (totals->runs ? (double)totals->cycles[i] / totals->runs : 0.) << " per run\n";
+        }
+        output << "#\n# Operations per symbol, the lines below can be copied into a blacklist\n";
+        write_sorted(output, per_symbol, total, false);
+        output << "#\n# Operations per category\n";
+        write_sorted(output, per_category, total, true);
+        output << "#\n# Operations per symbol and category\n";
+        write_sorted(output, per_site, total, true);
+        output.close();
+    }
+
+    drmgr_unregister_tls_field(tls_profile);
+    dr_global_free(totals, sizeof(plc_profile_table_t));
+    totals = nullptr;
+    dr_mutex_destroy(profile_lock);
+    sites.clear();
+    site_indexes.clear();
+}
@@ -0,0 +1,121 @@
+#ifndef PROFILE_BARRIER_HEADER
+#define PROFILE_BARRIER_HEADER
+
+/**
+ * \file profile.hpp
+ * \brief Instrumentation profiler header. Part of the PADLOC project.
+ *
+ * \details The profiler counts, with inline per-thread counters, the executed
+ * instrumented operations of each symbol and operation category, and measures
+ * the time spent saving the registers, in the backend, and restoring the
+ * registers. The report written at exit is sorted so that the most expensive
+ * symbols come first, and can be used as a blacklist.
+ *
+ * \author Brasseur Dylan, Teaudors Mickaël, Valeri Yoann
+ * \date 2019
+ * \copyright Interflop
+ */
+
+#include <string>
+
+#include "dr_api.h"
+
+#include "padloc_operations.hpp"
+
+/**
+ * \def PLC_PROFILE_MAX_SITES
+ * \brief Number of counters of a thread table
+ * \details The sites registered past this number share the last counter, reported as "other sites"
+ */
+#define PLC_PROFILE_MAX_SITES 8192
+
+/**
+ * \enum plc_profile_phase_t
+ * \brief Phases of a run of instrumented instructions whose duration is measured
+ */
+typedef enum{
+    /** Saving the SIMD and opmask registers */
+    PLC_PROFILE_SAVE = 0,
+    /** Setting the operands and calling the backend */
+    PLC_PROFILE_BACKEND,
+    /** Restoring the SIMD and opmask registers */
+    PLC_PROFILE_RESTORE,
+    /** Number of measured phases */
+    PLC_PROFILE_NB_PHASES,
+    /** Start of a run, nothing is measured before it */
+    PLC_PROFILE_START = PLC_PROFILE_NB_PHASES
+} plc_profile_phase_t;
+
+/**
+ * \brief Returns true if the profiling mode is enabled
+ */
+bool plc_profile_enabled();
+
+/**
+ * \brief Initializes the profiler
+ * \details Registers the TLS field of the thread tables. Does nothing if
+ * the profiling mode isn't enabled.
+ */
+void plc_profile_init();
+
+/**
+ * \brief Writes the report to the profile file and frees the profiler
+ * \details Called at the exit of the client, after the thread tables have been merged
+ */
+void plc_profile_exit();
+
+/**
+ * \brief Allocates the counter table of a thread
+ *
+ * \param drcontext Context of the created thread
+ */
+void plc_profile_thread_init(void *drcontext);
+
+/**
+ * \brief Adds the counters of a thread to the totals, and frees its table
+ *
+ * \param drcontext Context of the exiting thread
+ */
+void plc_profile_thread_exit(void *drcontext);
+
+/**
+ * \brief Returns the counter index of the instructions of category \p oc
+ * of the symbol \p symbol
+ * \details The site is registered the first time it is seen
+ *
+ * \param symbol Name of the symbol, as returned by get_symbol_full_name
+ * \param oc Operation category of the instruction
+ * \return uint32_t Index of the counter of the site
+ */
+uint32_t plc_profile_site(const std::string &symbol, OPERATION_CATEGORY oc);
+
+/**
+ * \brief Inserts prior to \p where an inline increment of the counter of \p site
+ * \details The registers and flags must have been saved : \p scratch and the
+ * arithmetic flags are modified
+ *
+ * \param drcontext DynamoRIO's context
+ * \param bb The list of instructions
+ * \param where Instruction prior to whom we insert the meta-instructions
+ * \param site Index of the counter, as returned by plc_profile_site
+ * \param count Value added to the counter
+ * \param scratch Register holding the address of the thread table
+ */
+void plc_profile_insert_count(void *drcontext, instrlist_t *bb, instr_t *where,
+                              uint32_t site, uint32_t count, reg_id_t scratch);
+
+/**
+ * \brief Inserts prior to \p where a timestamp ending \p phase
+ * \details The cycles elapsed since the previous timestamp are added to
+ * \p phase, unless it is PLC_PROFILE_START. RAX, RDX, the scratch register
+ * and the arithmetic flags are modified, so the registers must have been saved.
+ *
+ * \param drcontext DynamoRIO's context
+ * \param bb The list of instructions
+ * \param where Instruction prior to whom we insert the meta-instructions
+ * \param phase Phase ending at this timestamp
+ */
+void plc_profile_insert_timestamp(void *drcontext, instrlist_t *bb, instr_t *where,
+                                  plc_profile_phase_t phase);
+
+#endif //PROFILE_BARRIER_HEADER
@@ -0,0 +1,142 @@
+/**
+ * \file roi.cpp
+ * \brief Region of interest source file. Part of the PADLOC project.
+ *
+ * \details The markers of the application are found by their symbol when the
+ * main module is loaded, and a clean call is inserted at their entry. The
+ * clean call of a marker that switches the instrumentation flushes the whole
+ * code cache, and redirects the execution to the entry of the marker, which
+ * is built again : its clean call then sees that the instrumentation is
+ * already in the right state and returns. A nudge switches the instrumentation
+ * and flushes the code cache from the nudge event.
+ *
+ * The basic blocks store their translations in this mode, since a block can
+ * be built with a state of the instrumentation and translated after a switch.
+ *
+ * \author Brasseur Dylan, Teaudors Mickaël, Valeri Yoann
+ * \date 2019
+ * \copyright Interflop
+ */
+
+#include "dr_api.h"
+#include "drmgr.h"
+#include "drsyms.h"
+
+#include "roi.hpp"
+#include "symbol_config.hpp"
+#include "utils.hpp"
+
+/**
+ * True while the instrumentation is enabled. It is only read when building
+ * basic blocks, so a switch takes effect with the flush of the code cache.
+ */
+static volatile bool roi_active = true;
+
+/**
+ * Address of padloc_roi_start in the main module, null if it doesn't exist
+ */
+static app_pc roi_start_marker = nullptr;
+
+/**
+ * Address of padloc_roi_stop in the main module, null if it doesn't exist
+ */
+static app_pc roi_stop_marker = nullptr;
+
+bool plc_roi_active(){
+    return roi_active;
+}
+
+/**
+ * \brief Switches the instrumentation to \p active and flushes the code cache
+ * \details No lock may be held, as the flush synchronizes with all the threads
+ * 
+ * \param active True to enable the instrumentation
+ * \return True if the state changed, in which case the code cache was flushed
+ */
+static bool roi_switch(bool active){
+    if(roi_active == active){
+        return false;
+    }
+    roi_active = active;
+    if(get_log_level() >= 1){
+        dr_fprintf(STDERR, "Instrumentation %s\n", active ? "enabled" : "disabled");
+    }
+    if(!dr_flush_region((app_pc)0, ~(size_t)0)){
+        dr_fprintf(STDERR, "ROI FAILURE : Couldn't flush the code cache\n");
+    }
+    return true;
+}
+
+/**
+ * \brief Callback called when a module is loaded, finds the markers in the main module
+ */
+static void roi_module_load(void *drcontext, const module_data_t *module, bool loaded){
+    module_data_t *main_module = dr_get_main_module();
+    if(main_module == nullptr){
+        return;
+    }
+    if(main_module->start == module->start){
+        roi_start_marker = get_symbol_address(module, "padloc_roi_start");
+        roi_stop_marker = get_symbol_address(module, "padloc_roi_stop");
+        if(get_log_level() >= 1 && roi_start_marker == nullptr){
+            dr_fprintf(STDERR, "No padloc_roi_start in the main module, the instrumentation is switched by nudges\n");
+        }
+        drsym_free_resources(module->full_path);
+    }
+    dr_free_module_data(main_module);
+}
+
+/**
+ * \brief Clean call at the entry of a marker
+ * \details If the instrumentation is switched, the fragment of the clean call
+ * may have been flushed, so the execution continues from the marker
+ * 
+ * \param marker Address of the marker
+ * \param active True for padloc_roi_start, false for padloc_roi_stop
+ */
+static void roi_marker_reached(app_pc marker, int active){
+    if(roi_switch(active != 0)){
+        void *drcontext = dr_get_current_drcontext();
+        dr_mcontext_t mc = {sizeof(mc), DR_MC_ALL};
+        dr_get_mcontext(drcontext, &mc);
+        mc.pc = marker;
+        dr_redirect_execution(&mc);
+        DR_ASSERT_MSG(false, "Couldn't redirect the execution to the region of interest marker");
+    }
+}
+
+/**
+ * \brief Callback called for each instruction of a basic block, inserts the
+ * clean calls at the entry of the markers
+ */
+static dr_emit_flags_t roi_insertion_event(void *drcontext, void *tag, instrlist_t *bb, instr_t *instr,
+                                           bool for_trace, bool translating, void *user_data){
+    if(!instr_is_app(instr)){
+        return DR_EMIT_STORE_TRANSLATIONS;
+    }
+    app_pc pc = instr_get_app_pc(instr);
+    if(pc != nullptr && (pc == roi_start_marker || pc == roi_stop_marker)){
+        dr_insert_clean_call(drcontext, bb, instr, (void *)roi_marker_reached, false, 2, OPND_CREATE_INTPTR(pc),
+                             OPND_CREATE_INT32(pc == roi_start_marker));
+    }
+    return DR_EMIT_STORE_TRANSLATIONS;
+}
+
+/**
+ * \brief Callback called when the client is nudged
+ * \details The nudge 1 enables the instrumentation, the nudge 0 disables it,
+ * and any other nudge toggles it
+ */
+static void roi_nudge(void *drcontext, uint64 argument){
+    roi_switch(argument == 1 || (argument != 0 && !roi_active));
+}
+
+void plc_roi_init(client_id_t id){
+    if(!get_roi_mode()){
+        return;
+    }
+    roi_active = false;
+    drmgr_register_module_load_event(roi_module_load);
+    drmgr_register_bb_instrumentation_event(nullptr, roi_insertion_event, nullptr);
+    dr_register_nudge_event(roi_nudge, id);
+}
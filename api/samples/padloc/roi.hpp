@@ -0,0 +1,37 @@
+#ifndef ROI_BARRIER_HEADER
+#define ROI_BARRIER_HEADER
+
+/**
+ * \file roi.hpp
+ * \brief Region of interest header. Part of the PADLOC project.
+ *
+ * \details When the region of interest mode is enabled, the program starts
+ * with the instrumentation disabled. It is enabled when the application calls
+ * padloc_roi_start or when the client receives the nudge 1, and disabled when
+ * the application calls padloc_roi_stop or when the client receives the nudge 0
+ * (any other nudge toggles it). Each switch flushes the code cache, so that
+ * the basic blocks are built again with or without instrumentation, and the
+ * code out of the region runs without the clean calls.
+ *
+ * \author Brasseur Dylan, Teaudors Mickaël, Valeri Yoann
+ * \date 2019
+ * \copyright Interflop
+ */
+
+#include "dr_api.h"
+
+/**
+ * \brief Returns true if the instrumentation of the floating point operations is enabled
+ * \details Always true when the region of interest mode isn't enabled
+ */
+bool plc_roi_active();
+
+/**
+ * \brief Registers the events of the region of interest mode
+ * \details Does nothing if the region of interest mode isn't enabled
+ * 
+ * \param id ID of the client, to which the nudges are sent
+ */
+void plc_roi_init(client_id_t id);
+
+#endif //ROI_BARRIER_HEADER
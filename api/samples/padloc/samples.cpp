@@ -0,0 +1,458 @@
+/**
+ * \file samples.cpp
+ * \brief Monte-Carlo sampling driver source file. Part of the PADLOC project.
+ *
+ * \details The fork point and the output function of the application are
+ * found by their symbol when the main module is loaded, and a clean call is
+ * inserted at their entry. The first time the fork point is executed, the
+ * clean call redirects the application to a small stub doing the fork system
+ * call, so that DynamoRIO sees an application fork and keeps the code cache
+ * in the child. The stub jumps back to the fork point, whose clean call then
+ * either lets the replica continue, or forks the next replica. Once all the
+ * replicas are forked, the driver waits for them and reduces their outputs.
+ *
+ * Each replica writes the values of its outputs, one per line, to its own file
+ * next to the samples report, which the driver reads and removes. In lane mode
+ * (-ls), the shadow samples of the output are written with its value, and
+ * without replicas the process is the only replica, reduced at its exit.
+ *
+ * \author Brasseur Dylan, Teaudors Mickaël, Valeri Yoann
+ * \date 2019
+ * \copyright Interflop
+ */
+
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "dr_api.h"
+#include "drmgr.h"
+#include "drsyms.h"
+
+#include "samples.hpp"
+#include "padloc_client.h"
+#include "symbol_config.hpp"
+#include "utils.hpp"
+
+bool plc_samples_enabled(){
+    return get_nb_samples() > 0 || get_nb_lane_samples() > 1;
+}
+
+#if defined(LINUX) && defined(X86_64)
+
+#include <sched.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * \brief Number of significant decimal digits of a double precision value
+ */
+#define PLC_SAMPLES_MAX_DIGITS 15.95
+
+/**
+ * \brief Maximal length of the name of an output
+ */
+#define PLC_SAMPLES_MAX_NAME 256
+
+/**
+ * Address of the fork point in the main module, padloc_sample_start if it
+ * exists, else main. Null until the main module is loaded.
+ */
+static app_pc fork_point = nullptr;
+
+/**
+ * Address of padloc_sample_output in the main module, null if it doesn't exist
+ */
+static app_pc output_function = nullptr;
+
+/**
+ * Code of the fork stub : the fork system call, then a jump back to the fork point
+ */
+static byte *fork_stub = nullptr;
+
+/**
+ * True once the fork point has been reached, the later executions are ignored
+ */
+static bool fork_started = false;
+
+/**
+ * True while a fork done by the stub hasn't been seen back at the fork point.
+ * It is inherited by the replica, which tells the fork event that the fork is ours.
+ */
+static bool fork_pending = false;
+
+/**
+ * Registers clobbered by the fork stub (RAX, RCX and R11), restored when back at the fork point
+ */
+static reg_t saved_xax, saved_xcx, saved_r11;
+
+/**
+ * Number of replicas forked so far, which is the index of the replica being forked
+ */
+static int nb_forked = 0;
+
+/**
+ * Index of this replica, -1 in the driver
+ */
+static int replica_index = -1;
+
+/**
+ * Process ids of the replicas, in the driver
+ */
+static std::vector<int> replica_pids;
+
+/**
+ * Outputs file of this replica
+ */
+static std::ofstream *replica_output = nullptr;
+
+/**
+ * Lock of the outputs file, written by every thread of the replica
+ */
+static void *output_lock = nullptr;
+
+/**
+ * \brief Returns the file in which the replica \p index writes its outputs
+ */
+static std::string replica_file(int index){
+    return get_samples_file() + ".replica" + std::to_string(index);
+}
+
+/**
+ * \brief Callback called when a module is loaded, finds the fork point and
+ * the output function in the main module
+ */
+static void samples_module_load(void *drcontext, const module_data_t *module, bool loaded){
+    module_data_t *main_module = dr_get_main_module();
+    if(main_module == nullptr){
+        return;
+    }
+    if(main_module->start == module->start){
+        fork_point = get_symbol_address(module, "padloc_sample_start");
+        if(fork_point == nullptr){
+            fork_point = get_symbol_address(module, "main");
+        }
+        output_function = get_symbol_address(module, "padloc_sample_output");
+        if(get_nb_samples() == 0){
+            fork_point = nullptr;
+        }else if(fork_point == nullptr){
+            dr_fprintf(STDERR, "SAMPLES FAILURE : Couldn't find the symbol main nor padloc_sample_start, no replica will be forked\n");
+        }else if(get_log_level() >= 1){
+            dr_fprintf(STDERR, "Forking %d replicas at " PFX "\n", get_nb_samples(), fork_point);
+        }
+        drsym_free_resources(module->full_path);
+    }
+    dr_free_module_data(main_module);
+}
+
+/**
+ * \brief Generates the fork stub, which returns to \p target
+ * \details The stub is allocated out of DynamoRIO's memory, so that it is
+ * executed as application code and its fork goes through DynamoRIO.
+ */
+static void generate_fork_stub(void *drcontext, app_pc target){
+    const size_t size = dr_page_size();
+    fork_stub = (byte *)dr_raw_mem_alloc(size, DR_MEMPROT_READ | DR_MEMPROT_WRITE, nullptr);
+    //The return address is stored at the end of the page
+    app_pc *slot = (app_pc *)(fork_stub + size - sizeof(app_pc));
+    *slot = target;
+
+    instrlist_t *ilist = instrlist_create(drcontext);
+    instrlist_append(ilist, INSTR_CREATE_mov_imm(drcontext, opnd_create_reg(DR_REG_EAX),
+                                                 OPND_CREATE_INT32(SYS_fork)));
+    instrlist_append(ilist, INSTR_CREATE_syscall(drcontext));
+    instrlist_append(ilist, INSTR_CREATE_jmp_ind(drcontext, opnd_create_rel_addr(slot, OPSZ_8)));
+    byte *end = instrlist_encode(drcontext, ilist, fork_stub, false);
+    DR_ASSERT_MSG(end != nullptr && end < (byte *)slot, "Couldn't encode the fork stub");
+    instrlist_clear_and_destroy(drcontext, ilist);
+
+    dr_memory_protect(fork_stub, size, DR_MEMPROT_READ | DR_MEMPROT_EXEC);
+}
+
+/**
+ * \brief Returns the number of significant decimal digits of the samples of mean
+ * \p mean and standard deviation \p std
+ * \details Computed as -log10(std / |mean|), bounded by the digits of a double
+ */
+static double significant_digits(double mean, double std){
+    if(std == 0){
+        return PLC_SAMPLES_MAX_DIGITS;
+    }
+    if(mean == 0 || !std::isfinite(mean) || !std::isfinite(std)){
+        return 0;
+    }
+    double digits = -std::log10(std / std::fabs(mean));
+    return digits < 0 ? 0 : (digits > PLC_SAMPLES_MAX_DIGITS ? PLC_SAMPLES_MAX_DIGITS : digits);
+}
+
+/**
+ * \brief Reads the outputs of the replicas, writes the samples report and removes the files of the replicas
+ */
+static void reduce_outputs(int nb_replicas){
+    //Outputs in the order of their first occurrence, the n-th value of a name in a replica being the output "name#n"
+    std::vector<std::string> names;
+    std::map<std::string, std::vector<double>> values;
+    for(int i = 0; i < nb_replicas; i++){
+        std::ifstream input(replica_file(i));
+        std::map<std::string, int> occurrences;
+        std::string line;
+        while(std::getline(input, line)){
+            //Each line is "value [samples...]\tname", read with strtod to accept nan and inf
+            std::vector<double> line_values;
+            const char *start = line.c_str();
+            char *end;
+            for(double value = std::strtod(start, &end); end != start; value = std::strtod(start, &end)){
+                line_values.push_back(value);
+                start = end;
+            }
+            if(line_values.empty() || *end != '\t'){
+                continue;
+            }
+            std::string name(end + 1);
+            int n = occurrences[name]++;
+            std::string key = n == 0 ? name : name + "#" + std::to_string(n);
+            auto it = values.find(key);
+            if(it == values.end()){
+                names.push_back(key);
+                it = values.emplace(key, std::vector<double>()).first;
+            }
+            it->second.insert(it->second.end(), line_values.begin(), line_values.end());
+        }
+        input.close();
+        dr_delete_file(replica_file(i).c_str());
+    }
+
+    std::ofstream output(get_samples_file());
+    if(!output.good()){
+        dr_fprintf(STDERR, "SAMPLES FAILURE : Couldn't open the samples file \"%s\"\n", get_samples_file().c_str());
+        return;
+    }
+    output << "# PADLOC Monte-Carlo samples : " << nb_replicas << " replicas of " << get_nb_lane_samples()
+           << " samples, seeds " << get_samples_seed() << " to " << get_samples_seed() + nb_replicas - 1 << "\n";
+    output << "# output\tsamples\tmean\tstd\tsignificant_digits\n";
+    for(const std::string &name : names){
+        const std::vector<double> &v = values[name];
+        double mean = 0, std = 0;
+        for(double x : v){
+            mean += x;
+        }
+        mean /= v.size();
+        for(double x : v){
+            std += (x - mean) * (x - mean);
+        }
+        std = v.size() > 1 ? std::sqrt(std / (v.size() - 1)) : 0;
+        output << name << "\t" << v.size() << "\t" << std::setprecision(17) << mean << "\t"
+               << std::setprecision(3) << std << "\t" << std::fixed << significant_digits(mean, std)
+               << std::defaultfloat << "\n";
+    }
+    output.close();
+}
+
+/**
+ * \brief Waits for the replicas, reduces their outputs, and exits the driver
+ * \details The exit status is the first non-zero status of the replicas
+ */
+static void driver_exit(){
+    int status = 0;
+    for(size_t i = 0; i < replica_pids.size(); i++){
+        int wstatus;
+        while(waitpid(replica_pids[i], &wstatus, 0) < 0 && errno == EINTR){
+        }
+        int replica_status = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : 128 + WTERMSIG(wstatus);
+        if(replica_status != 0){
+            dr_fprintf(STDERR, "SAMPLES FAILURE : Replica %d exited with status %d\n", (int)i, replica_status);
+            if(status == 0){
+                status = replica_status;
+            }
+        }
+    }
+    reduce_outputs((int)replica_pids.size());
+    dr_exit_process(status);
+}
+
+/**
+ * \brief Clean call at the entry of the fork point
+ * \details Forks the replicas one after the other, see the file description
+ */
+static void fork_point_reached(){
+    void *drcontext = dr_get_current_drcontext();
+    dr_mcontext_t mc = {sizeof(mc), DR_MC_ALL};
+    dr_get_mcontext(drcontext, &mc);
+    if(fork_pending){
+        //Back from the stub, in the driver or in the new replica
+        fork_pending = false;
+        reg_t result = mc.xax;
+        mc.xax = saved_xax;
+        mc.xcx = saved_xcx;
+        mc.r11 = saved_r11;
+        if(replica_index >= 0){
+            dr_set_mcontext(drcontext, &mc);
+            return;
+        }
+        if((ptr_int_t)result < 0){
+            dr_fprintf(STDERR, "SAMPLES FAILURE : Couldn't fork replica %d\n", nb_forked);
+            driver_exit();
+        }
+        replica_pids.push_back((int)result);
+        nb_forked++;
+    }else if(fork_started){
+        return;
+    }
+    fork_started = true;
+    if(nb_forked == get_nb_samples()){
+        driver_exit();
+    }
+    if(fork_stub == nullptr){
+        generate_fork_stub(drcontext, fork_point);
+    }
+    saved_xax = mc.xax;
+    saved_xcx = mc.xcx;
+    saved_r11 = mc.r11;
+    fork_pending = true;
+    mc.pc = fork_stub;
+    dr_redirect_execution(&mc);
+    DR_ASSERT_MSG(false, "Couldn't redirect the execution to the fork stub");
+}
+
+/**
+ * \brief Clean call at the entry of padloc_sample_output, writes the output of the replica
+ * \details In lane mode, the shadow samples of the value follow it
+ */
+static void output_reached(){
+    if(replica_output == nullptr){
+        return;
+    }
+    void *drcontext = dr_get_current_drcontext();
+    dr_mcontext_t mc = {sizeof(mc), (dr_mcontext_flags_t)(DR_MC_INTEGER | DR_MC_MULTIMEDIA)};
+    dr_get_mcontext(drcontext, &mc);
+    //padloc_sample_output(const char *name, double value) : the name in RDI, the value in XMM0
+    char name[PLC_SAMPLES_MAX_NAME];
+    size_t read = 0;
+    dr_safe_read((void *)mc.xdi, sizeof(name) - 1, name, &read);
+    name[read] = '\0';
+    double value;
+    memcpy(&value, &mc.simd[0], sizeof(value));
+    double samples[PLC_MAX_LANE_SAMPLES - 1];
+    const int nb = plc_get_shadow_samples(drcontext, value, samples);
+    dr_mutex_lock(output_lock);
+    *replica_output << std::setprecision(17) << value;
+    for(int k = 0; k < nb; k++){
+        *replica_output << " " << samples[k];
+    }
+    *replica_output << "\t" << name << "\n";
+    dr_mutex_unlock(output_lock);
+}
+
+/**
+ * \brief Callback called for each instruction of a basic block, inserts the
+ * clean calls at the entry of the fork point and of the output function
+ */
+static dr_emit_flags_t samples_insertion_event(void *drcontext, void *tag, instrlist_t *bb,
+                                               instr_t *instr, bool for_trace, bool translating,
+                                               void *user_data){
+    if(!instr_is_app(instr)){
+        return DR_EMIT_DEFAULT;
+    }
+    app_pc pc = instr_get_app_pc(instr);
+    if(pc != nullptr && pc == fork_point){
+        dr_insert_clean_call(drcontext, bb, instr, (void *)fork_point_reached, false, 0);
+    }else if(pc != nullptr && pc == output_function){
+        dr_insert_clean_call(drcontext, bb, instr, (void *)output_reached, true, 0);
+    }
+    return DR_EMIT_DEFAULT;
+}
+
+/**
+ * \brief Callback called in the child of a fork
+ * \details In a replica forked by the driver, seeds the backend and the
+ * random generator of the thread, pins the replica to a core, and opens its
+ * outputs file. The forks of the application are left as they are, and
+ * don't write outputs.
+ */
+static void samples_fork_init(void *drcontext){
+    if(!fork_pending || replica_index >= 0){
+        //The buffer of the parent's file is left to the parent
+        replica_output = nullptr;
+        return;
+    }
+    replica_index = nb_forked;
+    replica_pids.clear();
+    Interflop::verrou_set_seed(get_samples_seed() + replica_index);
+    Interflop::verrou_thread_prepare(plc_get_thread_context(drcontext)->backend, 0);
+
+    long nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if(nb_cpus > 0){
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(replica_index % nb_cpus, &cpus);
+        sched_setaffinity(0, sizeof(cpus), &cpus);
+    }
+
+    replica_output = new std::ofstream(replica_file(replica_index));
+    if(!replica_output->good()){
+        dr_fprintf(STDERR, "SAMPLES FAILURE : Couldn't open the outputs file of replica %d\n", replica_index);
+    }
+}
+
+void plc_samples_init(){
+    if(!plc_samples_enabled()){
+        return;
+    }
+    //A null seed draws the base seed at random
+    if(get_samples_seed() == 0){
+        set_samples_seed(1 + dr_get_random_value(1u << 30));
+    }
+    output_lock = dr_mutex_create();
+    drmgr_register_module_load_event(samples_module_load);
+    drmgr_register_bb_instrumentation_event(nullptr, samples_insertion_event, nullptr);
+    dr_register_fork_init_event(samples_fork_init);
+    //Without replicas, the process is the only one, and it records its lane samples itself
+    if(get_nb_samples() == 0){
+        Interflop::verrou_set_seed(get_samples_seed());
+        replica_index = 0;
+        replica_output = new std::ofstream(replica_file(replica_index));
+        if(!replica_output->good()){
+            dr_fprintf(STDERR, "SAMPLES FAILURE : Couldn't open the outputs file \"%s\"\n", replica_file(0).c_str());
+        }
+    }
+}
+
+void plc_samples_exit(){
+    if(!plc_samples_enabled()){
+        return;
+    }
+    if(replica_output != nullptr){
+        replica_output->close();
+        delete replica_output;
+        replica_output = nullptr;
+        if(get_nb_samples() == 0){
+            reduce_outputs(1);
+        }
+    }
+    dr_mutex_destroy(output_lock);
+    if(fork_stub != nullptr){
+        dr_raw_mem_free(fork_stub, dr_page_size());
+        fork_stub = nullptr;
+    }
+}
+
+#else //LINUX && X86_64
+
+void plc_samples_init(){
+    if(get_nb_samples() > 0){
+        dr_fprintf(STDERR, "SAMPLES FAILURE : The sampling mode is only available on Linux x86-64, the program runs once\n");
+        set_nb_samples(0);
+    }
+}
+
+void plc_samples_exit(){
+}
+
+#endif //LINUX && X86_64
@@ -0,0 +1,47 @@
+#ifndef SAMPLES_BARRIER_HEADER
+#define SAMPLES_BARRIER_HEADER
+
+/**
+ * \file samples.hpp
+ * \brief Monte-Carlo sampling driver header. Part of the PADLOC project.
+ *
+ * \details When the sampling mode is enabled, the instrumented process forks
+ * its replicas at the fork point of the application (padloc_sample_start, or
+ * the entry of main), once DynamoRIO, the symbols and the backend analysis
+ * are initialized. Each replica runs the rest of the program with its own
+ * seed, concurrently with the others, and records the outputs marked with
+ * padloc_sample_output. The forking process doesn't run the program : it
+ * waits for the replicas, and writes the mean, standard deviation and number
+ * of significant digits of each output to the samples report. In lane mode,
+ * the outputs also carry their shadow samples, and the mode is enabled even
+ * without replicas.
+ *
+ * \author Brasseur Dylan, Teaudors Mickaël, Valeri Yoann
+ * \date 2019
+ * \copyright Interflop
+ */
+
+/**
+ * \def PLC_SAMPLES_DEFAULT_FILE
+ * \brief Samples report written when no file is given with -mo
+ */
+#define PLC_SAMPLES_DEFAULT_FILE "padloc_samples.txt"
+
+/**
+ * \brief Returns true if the sampling mode or the lane mode is enabled
+ */
+bool plc_samples_enabled();
+
+/**
+ * \brief Registers the events of the sampling driver
+ * \details Does nothing if the sampling mode isn't enabled
+ */
+void plc_samples_init();
+
+/**
+ * \brief Closes the outputs of a replica and frees the driver
+ * \details Called at the exit of the client
+ */
+void plc_samples_exit();
+
+#endif //SAMPLES_BARRIER_HEADER
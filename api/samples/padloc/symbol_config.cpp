@@ -36,6 +36,7 @@
 
 #include <fstream>
 #include <algorithm>
+#include <unordered_set>
 
 #include "dr_api.h"
 #include "dr_defines.h"
@@ -56,6 +57,8 @@ static void parse_line(string line, bool parsing_whitelist);
 
 static void load_lookup_from_modules_vector();
 
+static void rebuild_lookup_index();
+
 /**
  * File handle where we write the symbols found when generating (\ref symbol_gen)
  */
@@ -91,6 +94,33 @@ static vector<module_entry> modules_vector;
  */
 static vector<lookup_entry_t> lookup_vector;
 
+/**
+ * Index of the segments of the modules of the lookup vector, for PLC_LOOKUP_MODULE lookups
+ */
+static lookup_index_t module_index;
+
+/**
+ * Index of the ranges where a PLC_LOOKUP_SYMBOL lookup succeeds,
+ * merged over all the modules of the lookup vector
+ */
+static lookup_index_t symbol_index;
+
+/**
+ * Symbol tables of the modules loaded when generating the symbols, kept after their unload
+ */
+static vector<symbol_table_t> symbol_tables;
+
+/**
+ * Index of the segments of the loaded modules, for the symbol tables
+ */
+static lookup_index_t symbol_table_index;
+
+/**
+ * Lock protecting the lookup vector and its indexes, written on module load/unload
+ * and read when building basic blocks
+ */
+static void *lookup_lock = nullptr;
+
 /**
  * Set to true when the whitelist has been parsed (for error checking)
  */
@@ -114,7 +144,7 @@ void print_lookup(){
  * \return The index of the element if present, else the size of the vector
  */
 template<typename T>
-static inline size_t vec_idx_of(vector<T, allocator<T>> vec, T elem){
+static inline size_t vec_idx_of(const vector<T> &vec, const T &elem){
     size_t size = vec.size();
     for(size_t i = 0; i < size; ++i){
         if(elem == vec[i]){
@@ -148,20 +178,40 @@ static bool need_cleanup_module(module_entry &entry){
 void write_symbols_to_file(){
     if(get_symbol_mode() == PLC_SYMBOL_GENERATE){
         if(symbol_file.is_open() && symbol_file.good()){
-            write_to_file_symbol_file_header(symbol_file);
-            size_t num_modules = modules_vector.size();
+            //The modules loaded several times are merged, in the order of their first load
+            vector<string> module_names;
+            vector<vector<string>> module_symbols;
+            for(const symbol_table_t &table : symbol_tables){
+                size_t pos = vec_idx_of(module_names, table.module_name);
+                for(const table_symbol_t &symbol : table.symbols){
+                    if(symbol.seen){
+                        if(pos == module_names.size()){
+                            module_names.push_back(table.module_name);
+                            module_symbols.emplace_back();
+                        }
+                        module_symbols[pos].push_back(symbol.name);
+                    }
+                }
+            }
+
+            size_t num_modules = module_names.size();
             size_t totalSymbols = 0;
             for(size_t i = 0; i < num_modules; i++){
-                totalSymbols += modules_vector[i].symbols.size();
+                unordered_set<string> remaining(module_symbols[i].begin(), module_symbols[i].end());
+                auto end = remove_if(module_symbols[i].begin(), module_symbols[i].end(), [&remaining](const string &name){
+                    return remaining.erase(name) == 0;
+                });
+                module_symbols[i].erase(end, module_symbols[i].end());
+                totalSymbols += module_symbols[i].size();
             }
 
+            write_to_file_symbol_file_header(symbol_file);
             symbol_file << "# This list contains " << totalSymbols << " symbols of interest, split between " << num_modules
                         << " modules\n";
             for(size_t i = 0; i < num_modules; i++){
-                symbol_file << modules_vector[i].module_name << '\n';
-                size_t symbols_size = modules_vector[i].symbols.size();
-                for(size_t j = 0; j < symbols_size; j++){
-                    symbol_file << '\t' << modules_vector[i].module_name << '!' << modules_vector[i].symbols[j] << '\n';
+                symbol_file << module_names[i] << '\n';
+                for(const string &symbol : module_symbols[i]){
+                    symbol_file << '\t' << module_names[i] << '!' << symbol << '\n';
                 }
             }
             symbol_file.flush();
@@ -217,71 +267,119 @@ static string get_symbol_name(module_data_t *module, app_pc intr_pc){
     return name;
 }
 
+string get_symbol_full_name(app_pc pc){
+    string name;
+    module_data_t *mod = dr_lookup_module(pc);
+    if(mod){
+        const char *module_name = dr_module_preferred_name(mod);
+        name = module_name != nullptr ? module_name : "";
+        string symbol_name = get_symbol_name(mod, pc);
+        if(!symbol_name.empty()){
+            name += '!' + symbol_name;
+        }
+        dr_free_module_data(mod);
+    }
+    return name;
+}
+
+app_pc get_symbol_address(const module_data_t *module, const char *symbol){
+    size_t modoff;
+    const char *name = dr_module_preferred_name(module);
+    if(name == nullptr){
+        return nullptr;
+    }
+    drsym_error_t err = drsym_lookup_symbol(module->full_path, (string(name) + "!" + symbol).c_str(),
+                                            &modoff, DRSYM_DEFAULT_FLAGS);
+    return err == DRSYM_SUCCESS ? module->start + modoff : nullptr;
+}
+
+/**
+ * \brief Callback of the symbol enumeration, appends the symbol to the table given as \p data
+ */
+static bool add_table_symbol(drsym_info_t *info, drsym_error_t status, void *data){
+    symbol_table_t *table = (symbol_table_t *)data;
+    if(info->name != nullptr && info->name[0] != '\0'){
+        table->symbols.push_back({info->start_offs, MAX(info->start_offs, info->end_offs), 0, info->name, false});
+    }
+    return true;
+}
+
+void load_symbol_table(const module_data_t *module){
+    const char *name = dr_module_preferred_name(module);
+    symbol_table_t table;
+    table.module_name = name != nullptr ? name : "";
+    table.start = module->start;
+    drsym_enumerate_symbols_ex(module->full_path, add_table_symbol, sizeof(drsym_info_t), &table, DRSYM_DEFAULT_FLAGS);
+    drsym_free_resources(module->full_path);
+
+    //The aliases of a symbol are merged into the first one enumerated
+    stable_sort(table.symbols.begin(), table.symbols.end(), [](const table_symbol_t &a, const table_symbol_t &b){
+        return a.start < b.start || (a.start == b.start && a.end < b.end);
+    });
+    auto end = unique(table.symbols.begin(), table.symbols.end(), [](const table_symbol_t &a, const table_symbol_t &b){
+        return a.start == b.start && a.end == b.end;
+    });
+    table.symbols.erase(end, table.symbols.end());
+    size_t reach = 0;
+    for(table_symbol_t &symbol : table.symbols){
+        reach = max(reach, symbol.end);
+        symbol.reach = reach;
+    }
+    if(get_log_level() >= 1){
+        dr_printf("Loaded %d symbols of module %s\n", (int)table.symbols.size(), table.module_name.c_str());
+    }
+
+    dr_rwlock_write_lock(lookup_lock);
+    size_t idx = symbol_tables.size();
+    symbol_tables.push_back(std::move(table));
+#ifndef WINDOWS
+    if(!module->contiguous){
+        for(size_t i = 0; i < module->num_segments; i++){
+            symbol_table_index.intervals.push_back({module->segments[i].start, module->segments[i].end, idx});
+        }
+    }else
+#endif //WINDOWS
+    {
+        symbol_table_index.intervals.push_back({module->start, module->end, idx});
+    }
+    sort(symbol_table_index.intervals.begin(), symbol_table_index.intervals.end());
+    dr_rwlock_write_unlock(lookup_lock);
+}
+
+void unload_symbol_table(const module_data_t *module){
+    dr_rwlock_write_lock(lookup_lock);
+    const lookup_interval_t *interval = symbol_table_index.find(module->start);
+    if(interval != nullptr){
+        size_t idx = interval->entry;
+        auto end = remove_if(symbol_table_index.intervals.begin(), symbol_table_index.intervals.end(),
+                             [idx](const lookup_interval_t &i){
+                                 return i.entry == idx;
+                             });
+        symbol_table_index.intervals.erase(end, symbol_table_index.intervals.end());
+    }
+    dr_rwlock_write_unlock(lookup_lock);
+}
+
 void log_symbol(instrlist_t *ilist){
-    //We save the old module and symbol locations, as we can expect a symbol to appear multiple times in a row
-    static size_t oldModule = 0;
-    static size_t oldPos = 0;
     instr_t *instr = instrlist_first_app(ilist);
-    app_pc pc = 0;
-    module_data_t *mod = nullptr;
-    module_entry entry("", false);
-    if(instr){
-        pc = instr_get_app_pc(instr);
-        if(pc){
-            mod = dr_lookup_module(pc);
-            if(mod){
-
-                entry.module_name = string(dr_module_preferred_name(mod));
-                if(get_log_level() >= 1){
-                    dr_printf("Found : Module name : %s\n", entry.module_name.c_str());
-                }
-                string symbolName = get_symbol_name(mod, pc);
-                if(!symbolName.empty()){
-                    if(get_log_level() >= 1){
-                        dr_printf("Found : Symbol name : %s\n", symbolName.c_str());
-                    }
-                    if(modules_vector.size() > oldModule){
-
-                        if(modules_vector[oldModule] == entry) // If the module is the last seen module
-                        {
-                            //If it's not the old symbol, and it can't be found elsewhere, we need to add it
-                            if((modules_vector[oldModule].symbols.size() <= oldPos
-                                || (modules_vector[oldModule].symbols[oldPos] != symbolName))
-                               && vec_idx_of(modules_vector[oldModule].symbols, symbolName) ==
-                                  modules_vector[oldModule].symbols.size()){
-                                modules_vector[oldModule].symbols.push_back(symbolName);
-                                oldPos = modules_vector[oldModule].symbols.size() - 1;
-                            }
-                        }else{
-                            //It's not the last seen module
-                            size_t pos = vec_idx_of(modules_vector, entry);
-                            if(pos == modules_vector.size()){
-                                modules_vector.push_back(entry);
-                                oldModule = pos;
-                            }
-                            if(vec_idx_of(modules_vector[pos].symbols, symbolName) == modules_vector[pos].symbols.size()){
-                                oldPos = modules_vector[oldModule].symbols.size();
-                                modules_vector[pos].symbols.push_back(symbolName);
-                            }
-                        }
-                    }else{
-                        size_t pos = vec_idx_of(modules_vector, entry);
-                        if(pos == modules_vector.size()){
-                            modules_vector.push_back(entry);
-                            oldModule = pos;
-                        }
-                        if(vec_idx_of(modules_vector[pos].symbols, symbolName) == modules_vector[pos].symbols.size()){
-                            oldPos = modules_vector[oldModule].symbols.size();
-                            modules_vector[pos].symbols.push_back(symbolName);
-                        }
-                    }
-                }
+    app_pc pc = instr != nullptr ? instr_get_app_pc(instr) : nullptr;
+    if(pc == nullptr){
+        return;
+    }
+    dr_rwlock_write_lock(lookup_lock);
+    const lookup_interval_t *interval = symbol_table_index.find(pc);
+    if(interval != nullptr){
+        symbol_table_t &table = symbol_tables[interval->entry];
+        size_t pos = table.find(pc - table.start);
+        if(pos != table.symbols.size() && !table.symbols[pos].seen){
+            table.symbols[pos].seen = true;
+            if(get_log_level() >= 1){
+                dr_printf("Found : Module name : %s\n", table.module_name.c_str());
+                dr_printf("Found : Symbol name : %s\n", table.symbols[pos].name.c_str());
             }
         }
     }
-    if(mod){
-        dr_free_module_data(mod);
-    }
+    dr_rwlock_write_unlock(lookup_lock);
 }
 
 /* ### INTRUMENTATION ### */
@@ -350,7 +448,105 @@ static void lookup_or_load_module(const module_data_t *module){
             drsym_free_resources(module->full_path);
         }
         lookup_vector.push_back(lentry);
+        rebuild_lookup_index();
+    }
+}
+
+/**
+ * \brief Appends the ranges of the segments of a module to \p intervals
+ * 
+ * \param intervals Vector of intervals to fill
+ * \param lentry The module
+ * \param idx Index of the module in the lookup vector
+ */
+static void add_module_intervals(vector<lookup_interval_t> &intervals, const lookup_entry_t &lentry, size_t idx){
+#ifndef WINDOWS
+    if(!lentry.contiguous){
+        for(const addr_range_t &segment : lentry.segments){
+            intervals.push_back({segment.start, segment.end, idx});
+        }
+        return;
     }
+#endif //WINDOWS
+    intervals.push_back({lentry.range.start, lentry.range.end, idx});
+}
+
+/**
+ * \brief Appends the ranges where a symbol lookup succeeds in a module to \p intervals
+ * \details Gives the same answers as lookup_entry_t::contains with PLC_LOOKUP_SYMBOL :
+ * - a total module without symbols : its segments;
+ * - a partial module : its symbols;
+ * - a total module with symbols as exceptions : its full range, except its symbols.
+ * 
+ * \param intervals Vector of intervals to fill
+ * \param lentry The module
+ * \param idx Index of the module in the lookup vector
+ */
+static void add_symbol_intervals(vector<lookup_interval_t> &intervals, const lookup_entry_t &lentry, size_t idx){
+    if(lentry.total && lentry.symbols.empty()){
+        add_module_intervals(intervals, lentry, idx);
+        return;
+    }
+
+    //Symbols, clipped to the full range of the module
+    vector<addr_range_t> symbols;
+    for(const symbol_entry_t &symbol : lentry.symbols){
+        app_pc start = max(symbol.range.start, lentry.range.start);
+        app_pc end = min(symbol.range.end, lentry.range.end);
+        if(start < end){
+            symbols.emplace_back(start, end);
+        }
+    }
+
+    if(!lentry.total){
+        for(const addr_range_t &symbol : symbols){
+            intervals.push_back({symbol.start, symbol.end, idx});
+        }
+    }else{
+        sort(symbols.begin(), symbols.end(), [](const addr_range_t &a, const addr_range_t &b){
+            return a.start < b.start;
+        });
+        //The gaps between the symbols
+        app_pc cursor = lentry.range.start;
+        for(const addr_range_t &symbol : symbols){
+            if(cursor < symbol.start){
+                intervals.push_back({cursor, symbol.start, idx});
+            }
+            cursor = max(cursor, symbol.end);
+        }
+        if(cursor < lentry.range.end){
+            intervals.push_back({cursor, lentry.range.end, idx});
+        }
+    }
+}
+
+/**
+ * \brief Rebuilds the module and symbol indexes from the lookup vector
+ * \details Called whenever the lookup vector changes, on module load and unload.
+ * The intervals of the symbol index are merged when they overlap, since a symbol
+ * lookup succeeds as soon as one of the modules contains the address.
+ */
+static void rebuild_lookup_index(){
+    module_index.intervals.clear();
+    symbol_index.intervals.clear();
+
+    for(size_t i = 0; i < lookup_vector.size(); i++){
+        add_module_intervals(module_index.intervals, lookup_vector[i], i);
+        add_symbol_intervals(symbol_index.intervals, lookup_vector[i], i);
+    }
+    sort(module_index.intervals.begin(), module_index.intervals.end());
+    sort(symbol_index.intervals.begin(), symbol_index.intervals.end());
+
+    vector<lookup_interval_t> &intervals = symbol_index.intervals;
+    size_t merged = 0;
+    for(size_t i = 0; i < intervals.size(); i++){
+        if(merged > 0 && !(intervals[merged - 1].end < intervals[i].start)){
+            intervals[merged - 1].end = max(intervals[merged - 1].end, intervals[i].end);
+        }else{
+            intervals[merged++] = intervals[i];
+        }
+    }
+    intervals.resize(merged);
 }
 
 /**
@@ -361,26 +557,33 @@ static void lookup_or_load_module(const module_data_t *module){
  * \todo Change the iterators to std::begin
  */
 static void load_lookup_from_modules_vector(){
-    auto end = remove_if(modules_vector.begin(), modules_vector.end(), [](module_entry const &mentry){
-        string module_name = mentry.module_name;
-        module_data_t *mod = dr_lookup_module_by_name(module_name.c_str());
+    //The modules stay in the modules vector, so that they can be loaded again after being unloaded
+    for(module_entry const &mentry : modules_vector){
+        module_data_t *mod = dr_lookup_module_by_name(mentry.module_name.c_str());
         if(mod){
             lookup_or_load_module(mod);
             dr_free_module_data(mod);
-            return true;
         }
-        return false;
-    });
+    }
+}
 
-    modules_vector.erase(end, modules_vector.end());
+void symbol_lookup_exit(){
+    if(lookup_lock != nullptr){
+        dr_rwlock_destroy(lookup_lock);
+        lookup_lock = nullptr;
+    }
 }
 
 bool should_instrument_module(module_data_t const *module){
+    dr_rwlock_write_lock(lookup_lock);
     lookup_or_load_module(module);
     lookup_entry_t *found_module = lookup_find(module->start, PLC_LOOKUP_MODULE);
+    bool found_total = found_module != nullptr && found_module->total;
+    dr_rwlock_write_unlock(lookup_lock);
+
     if(found_module != nullptr){
         //We found the module in the list, we need to instrument it if it's not blacklisted totally
-        return (get_symbol_mode() == PLC_SYMBOL_BL_ONLY && !found_module->total) ||
+        return (get_symbol_mode() == PLC_SYMBOL_BL_ONLY && !found_total) ||
                get_symbol_mode() == PLC_SYMBOL_WL_ONLY || get_symbol_mode() == PLC_SYMBOL_BL_WL;
     }else{
         //We didn't find the module in the lookup, we instrument it if we're not white listing
@@ -388,6 +591,31 @@ bool should_instrument_module(module_data_t const *module){
     }
 }
 
+void unload_module_lookup(const module_data_t *module){
+    dr_rwlock_write_lock(lookup_lock);
+    size_t first, last;
+    module_index.overlapping(module->start, module->end, &first, &last);
+
+    vector<size_t> unloaded;
+    for(size_t i = first; i < last; i++){
+        size_t entry = module_index.intervals[i].entry;
+        if(lookup_vector[entry].range.start == module->start &&
+           find(unloaded.begin(), unloaded.end(), entry) == unloaded.end()){
+            unloaded.push_back(entry);
+        }
+    }
+
+    if(!unloaded.empty()){
+        //Erase from the end so that the remaining indexes stay valid
+        sort(unloaded.rbegin(), unloaded.rend());
+        for(size_t entry : unloaded){
+            lookup_vector.erase(lookup_vector.begin() + entry);
+        }
+        rebuild_lookup_index();
+    }
+    dr_rwlock_write_unlock(lookup_lock);
+}
+
 bool needs_to_instrument(instrlist_t *ilist){
     if(ilist == nullptr){
         return false;
@@ -406,7 +634,10 @@ bool needs_to_instrument(instrlist_t *ilist){
     if(instr != nullptr){
         app_pc pc = instr_get_app_pc(instr);
         if(pc){
-            return (lookup_find(pc, PLC_LOOKUP_SYMBOL) != nullptr) ^ (get_symbol_mode() == PLC_SYMBOL_BL_ONLY);
+            dr_rwlock_read_lock(lookup_lock);
+            bool found = lookup_find(pc, PLC_LOOKUP_SYMBOL) != nullptr;
+            dr_rwlock_read_unlock(lookup_lock);
+            return found ^ (get_symbol_mode() == PLC_SYMBOL_BL_ONLY);
         }
     }
 
@@ -582,19 +813,16 @@ static void generate_whitelist_from_file(ifstream &whitelist){
 
 /**
  * \brief Return the lookup entry corresponding to the given address
+ * \details Binary search in the module or symbol index. For a symbol lookup, the
+ * returned entry is one of the modules containing the address.
  * 
  * \param pc Instruction address
  * \param lookup_type Defines the type of lookup we are looking for (symbol or module)
  * \return lookup_entry_t* The corresponding lookup entry, nullptr if it hasn't been found
  */
 static lookup_entry_t *lookup_find(app_pc pc, plc_lookup_type_t lookup_type){
-    for(auto &i : lookup_vector){
-        if(i.contains(pc, lookup_type)){
-            return &i;
-        }
-    }
-
-    return nullptr;
+    const lookup_interval_t *interval = (lookup_type == PLC_LOOKUP_MODULE ? module_index : symbol_index).find(pc);
+    return interval != nullptr ? &lookup_vector[interval->entry] : nullptr;
 }
 
 /**
@@ -722,6 +950,7 @@ bool symbol_argument_parser(std::string arg, int *i, int argc, const char *argv[
 }
 
 void symbol_client_mode_manager(){
+    lookup_lock = dr_rwlock_create();
     switch(get_symbol_mode()){
         case PLC_SYMBOL_BL_ONLY:
             blacklist.open(blacklist_filename);
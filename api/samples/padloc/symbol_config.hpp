@@ -11,6 +11,7 @@
  */
 #include <string>
 #include <vector>
+#include <algorithm>
 
 /**
  * \enum plc_lookup_type_t
@@ -44,7 +45,7 @@ struct module_entry{
      * \param o Other module_entry
      * \return bool True if this module_entry and the other module_entry have the same name
      */
-    inline bool operator==(module_entry o){
+    inline bool operator==(const module_entry &o) const{
         return o.module_name == module_name;
     };
 
@@ -184,26 +185,192 @@ struct lookup_entry_t{
 #endif //WINDOWS
 };
 
+/**
+ * \struct lookup_interval_t
+ * \brief Range of app_pc of the lookup index, associated to an entry of the lookup vector
+ */
+struct lookup_interval_t{
+    /**
+     * \brief Ordering on the start of the intervals
+     * 
+     * \param o Other interval
+     * \return bool True if this interval starts before the other one
+     */
+    inline bool operator<(const lookup_interval_t &o) const{
+        return start < o.start;
+    }
+
+    /** Start of the range */
+    app_pc start;
+    /** End of the range */
+    app_pc end;
+    /** Index of the corresponding entry in the lookup vector */
+    size_t entry;
+};
+
+/**
+ * \struct lookup_index_t
+ * \brief Sorted list of non-overlapping intervals, answering the lookups by binary search
+ */
+struct lookup_index_t{
+    /**
+     * \brief Returns the interval containing the given pc
+     * 
+     * \param pc Instruction address
+     * \return const lookup_interval_t* The interval containing \p pc, nullptr if there is none
+     */
+    inline const lookup_interval_t *find(app_pc pc) const{
+        size_t i = first_after(pc);
+        if(i == 0 || !(pc < intervals[i - 1].end)){
+            return nullptr;
+        }
+        return &intervals[i - 1];
+    }
+
+    /**
+     * \brief Returns the intervals overlapping the range [start, end[
+     * \details The overlapping intervals are intervals[first] to intervals[last - 1]
+     * 
+     * \param start Start of the range
+     * \param end End of the range
+     * \param first Set to the index of the first overlapping interval
+     * \param last Set to the index following the last overlapping interval
+     */
+    inline void overlapping(app_pc start, app_pc end, size_t *first, size_t *last) const{
+        size_t i = first_after(start);
+        *first = (i > 0 && start < intervals[i - 1].end) ? i - 1 : i;
+        *last = i;
+        while(*last < intervals.size() && intervals[*last].start < end){
+            (*last)++;
+        }
+    }
+
+    /**
+     * \brief Returns the index of the first interval starting after pc
+     * 
+     * \param pc Instruction address
+     * \return size_t Index of the first interval whose start is greater than \p pc
+     */
+    inline size_t first_after(app_pc pc) const{
+        lookup_interval_t key;
+        key.start = pc;
+        return std::upper_bound(intervals.begin(), intervals.end(), key) - intervals.begin();
+    }
+
+    /** Intervals, sorted by start */
+    std::vector<lookup_interval_t> intervals;
+};
+
+/**
+ * \struct table_symbol_t
+ * \brief Symbol of a symbol table, as offsets in its module
+ */
+struct table_symbol_t{
+    /** Offset of the start of the symbol */
+    size_t start;
+    /** Offset of the end of the symbol, equal to start if its size isn't known */
+    size_t end;
+    /** Largest end of the symbols of the table up to this one */
+    size_t reach;
+    /** Name of the symbol */
+    std::string name;
+    /** True if an instrumented instruction was seen in the symbol */
+    bool seen;
+};
+
+/**
+ * \struct symbol_table_t
+ * \brief Symbols of a module sorted by address, loaded once when generating the symbols (\ref symbol_gen)
+ */
+struct symbol_table_t{
+    /**
+     * \brief Returns the index of the symbol containing the offset \p offs
+     * \details As symbols can be nested, the symbols starting before \p offs are
+     * checked backward while one of them may still contain it. A symbol without
+     * size contains the offsets up to the start of the next symbol.
+     * 
+     * \param offs Offset in the module
+     * \return size_t Index of the symbol, the number of symbols if there is none
+     */
+    inline size_t find(size_t offs) const{
+        size_t i = std::upper_bound(symbols.begin(), symbols.end(), offs, [](size_t o, const table_symbol_t &symbol){
+            return o < symbol.start;
+        }) - symbols.begin();
+        if(i > 0 && symbols[i - 1].end == symbols[i - 1].start){
+            return i - 1;
+        }
+        for(size_t j = i; j > 0 && symbols[j - 1].reach > offs; j--){
+            if(symbols[j - 1].end > offs){
+                return j - 1;
+            }
+        }
+        return symbols.size();
+    }
+
+    /** Prefered name of the module */
+    std::string module_name;
+    /** Address at which the module is loaded, symbols offsets are relative to it */
+    app_pc start;
+    /** Symbols of the module, sorted by start */
+    std::vector<table_symbol_t> symbols;
+};
+
 /**
  * \brief Function to print the lookup vector
  */
 void print_lookup();
 
 /**
- * \brief Writes the symbols held by the modules vector to the output file
+ * \brief Writes the symbols seen in the symbol tables to the output file
  * (defined by the command line argument)
  * \details Only called when generating the symbols. Writes a header prior to the list of symbols and modules.
  */
 void write_symbols_to_file();
 
 /**
- * \brief Logs the symbol associated with ilist to the modules vector
- * \details Looks for the name of the module and symbol associated with the address of the basic block
+ * \brief Returns the name of the symbol containing \p pc, in the format of the symbol files
+ * \details The name is "module!symbol", or only "module" if the symbol isn't known,
+ * so that it can be written in a whitelist or blacklist
+ * 
+ * \param pc Instruction address
+ * \return std::string The name of the symbol, empty if \p pc isn't part of a module
+ */
+std::string get_symbol_full_name(app_pc pc);
+
+/**
+ * \brief Returns the address of \p symbol in \p module
+ * 
+ * \param module Module of the symbol
+ * \param symbol Name of the symbol
+ * \return app_pc The address of the symbol, nullptr if it isn't found
+ */
+app_pc get_symbol_address(const module_data_t *module, const char *symbol);
+
+/**
+ * \brief Marks the symbol associated with ilist as seen
+ * \details Looks for the symbol containing the address of the basic block in the symbol
+ * table of its module, loaded by load_symbol_table
  * 
  * \param ilist Current basic block
  */
 void log_symbol(instrlist_t *ilist);
 
+/**
+ * \brief Loads the symbol table of a module when generating the symbols
+ * \details The symbols are enumerated once, and the debug information is freed
+ * 
+ * \param module The loaded module
+ */
+void load_symbol_table(const module_data_t *module);
+
+/**
+ * \brief Removes the given module from the addresses of the symbol tables
+ * \details The symbols seen in the module are kept until they are written
+ * 
+ * \param module The unloaded module
+ */
+void unload_symbol_table(const module_data_t *module);
+
 /**
  * \brief Verify that we want to instrument a particular module
  * \details This function verifies, based on the current state of the client
@@ -215,6 +382,15 @@ void log_symbol(instrlist_t *ilist);
  */
 bool should_instrument_module(const module_data_t *module);
 
+/**
+ * \brief Removes the given module from the lookup
+ * \details Called when a module is unloaded, so that another module loaded
+ * at the same addresses isn't mistaken for it.
+ * 
+ * \param module The unloaded module
+ */
+void unload_module_lookup(const module_data_t *module);
+
 /**
  * \brief Verify if we want to instrument the list of instructions \p ilist
  * \details Checks if the adress lies within an instrumented module.
@@ -255,4 +431,10 @@ bool symbol_argument_parser(std::string arg, int *i, int argc, const char *argv[
  */
 void symbol_client_mode_manager();
 
+/**
+ * \brief Frees the resources of the symbol plugin
+ * \details Called at the exit of the client.
+ */
+void symbol_lookup_exit();
+
 #endif //SYMBOL_CONFIG_HEADER
\ No newline at end of file
@@ -0,0 +1,187 @@
+/**
+ * \file trace.cpp
+ * \brief Floating point operation trace recorder source file. Part of the PADLOC project.
+ *
+ * \details The records are written by the block dispatcher, out of the code
+ * cache, so the room left in the buffer is checked before each record instead
+ * of relying on the guard page of the trace buffer. The full callback of
+ * drx_buf, also called when a thread exits, writes the pending records.
+ *
+ * \author Brasseur Dylan, Teaudors Mickaël, Valeri Yoann
+ * \date 2019
+ * \copyright Interflop
+ */
+
+#include <cstring>
+#include <string>
+
+#ifdef HAS_ZLIB
+#include <zlib.h>
+#endif
+
+#include "dr_api.h"
+#include "drmgr.h"
+#include "drx.h"
+
+#include "trace.hpp"
+#include "trace_format.h"
+#include "utils.hpp"
+
+/**
+ * Per-thread trace buffer, null if the recording mode isn't enabled
+ */
+static drx_buf_t *trace_buffer = nullptr;
+
+/**
+ * TLS field holding the trace file of the thread
+ */
+static int trace_tls = -1;
+
+/**
+ * Number of threads created so far, used as the index of the next trace file
+ */
+static volatile int nb_traced_threads = 0;
+
+bool plc_trace_enabled(){
+    return !get_trace_prefix().empty();
+}
+
+/**
+ * \brief Returns the operation of the trace corresponding to \p oc
+ */
+static plc_trace_op_t trace_op(OPERATION_CATEGORY oc){
+    if(oc & PLC_OP_FMA){
+        return (oc & PLC_OP_NEG) ? PLC_TRACE_NFMADD : PLC_TRACE_FMADD;
+    }
+    if(oc & PLC_OP_FMS){
+        return (oc & PLC_OP_NEG) ? PLC_TRACE_NFMSUB : PLC_TRACE_FMSUB;
+    }
+    switch(oc & PLC_OP_TYPE_MASK){
+        case PLC_OP_ADD:
+            return PLC_TRACE_ADD;
+        case PLC_OP_SUB:
+            return PLC_TRACE_SUB;
+        case PLC_OP_MUL:
+            return PLC_TRACE_MUL;
+        default: /* PLC_OP_DIV */
+            return PLC_TRACE_DIV;
+    }
+}
+
+/**
+ * \brief Writes \p size bytes of records from \p base to the trace file of the thread, as one chunk
+ * \details Full callback of the trace buffer, the chunk is compressed when zlib is available
+ */
+static void trace_flush(void *drcontext, void *base, size_t size){
+    file_t file = (file_t)(ptr_int_t)drmgr_get_tls_field(drcontext, trace_tls);
+    if(size == 0 || file == INVALID_FILE){
+        return;
+    }
+    plc_trace_chunk_t chunk;
+    chunk.raw_size = (uint32_t)size;
+    chunk.stored_size = (uint32_t)size;
+#ifdef HAS_ZLIB
+    uLongf compressed_size = compressBound((uLong)size);
+    Bytef *compressed = (Bytef *)dr_thread_alloc(drcontext, compressed_size);
+    if(compress2(compressed, &compressed_size, (const Bytef *)base, (uLong)size, Z_BEST_SPEED) == Z_OK &&
+       compressed_size < size){
+        chunk.stored_size = (uint32_t)compressed_size;
+        dr_write_file(file, &chunk, sizeof(chunk));
+        dr_write_file(file, compressed, compressed_size);
+    }
+    dr_thread_free(drcontext, compressed, compressBound((uLong)size));
+    if(chunk.stored_size != chunk.raw_size){
+        return;
+    }
+#endif
+    dr_write_file(file, &chunk, sizeof(chunk));
+    dr_write_file(file, base, size);
+}
+
+void plc_trace_record(const plc_instr_desc_t &desc, void *const *srcs){
+    void *drcontext = dr_get_current_drcontext();
+    byte *base = (byte *)drx_buf_get_buffer_base(drcontext, trace_buffer);
+    byte *ptr = (byte *)drx_buf_get_buffer_ptr(drcontext, trace_buffer);
+    if(ptr + PLC_TRACE_MAX_RECORD_SIZE > base + drx_buf_get_buffer_size(drcontext, trace_buffer)){
+        trace_flush(drcontext, base, ptr - base);
+        ptr = base;
+    }
+
+    const OPERATION_CATEGORY oc = (OPERATION_CATEGORY)desc.oc;
+    plc_trace_record_t *record = (plc_trace_record_t *)ptr;
+    record->pc = (uint64_t)(ptr_uint_t)desc.pc;
+    record->op = (uint8_t)trace_op(oc);
+    record->is_double = plc_is_double(oc) ? 1 : 0;
+    const int elem_size = record->is_double ? 8 : 4;
+    const int operation_size = (oc & PLC_OP_512) ? 64 : (oc & PLC_OP_256) ? 32 : (oc & PLC_OP_128) ? 16 : elem_size;
+    record->nb_elem = (uint8_t)(operation_size / elem_size);
+    record->nb_srcs = (uint8_t)desc.nb_srcs;
+    record->reserved = 0;
+
+    byte *operands = (byte *)(record + 1);
+    for(uint32_t s = 0; s < desc.nb_srcs; s++){
+        if(PLC_EVEX_BROADCAST(desc.evex_control) == s + 1){
+            //A broadcast source is a single element in memory
+            for(int i = 0; i < record->nb_elem; i++){
+                memcpy(operands + i * elem_size, srcs[s], elem_size);
+            }
+        }else{
+            memcpy(operands, srcs[s], operation_size);
+        }
+        operands += operation_size;
+    }
+    drx_buf_set_buffer_ptr(drcontext, trace_buffer, ptr + PLC_TRACE_RECORD_SIZE(record));
+}
+
+/**
+ * \brief Callback called when a thread is created, opens its trace file
+ */
+static void trace_thread_init(void *drcontext){
+    plc_trace_header_t header;
+    header.magic = PLC_TRACE_MAGIC;
+    header.version = PLC_TRACE_VERSION;
+    header.thread_index = (uint32_t)(dr_atomic_add32_return_sum(&nb_traced_threads, 1) - 1);
+    header.reserved = 0;
+    std::string filename = get_trace_prefix() + "." + std::to_string(header.thread_index) + ".plct";
+    file_t file = dr_open_file(filename.c_str(), DR_FILE_WRITE_OVERWRITE);
+    if(file == INVALID_FILE){
+        dr_fprintf(STDERR, "TRACE FAILURE : Couldn't open the trace file \"%s\"\n", filename.c_str());
+    }else{
+        dr_write_file(file, &header, sizeof(header));
+    }
+    drmgr_set_tls_field(drcontext, trace_tls, (void *)(ptr_int_t)file);
+}
+
+/**
+ * \brief Callback called when a thread exits, closes its trace file
+ * \details Called after the thread exit event of drx_buf, which writes the last records
+ */
+static void trace_thread_exit(void *drcontext){
+    file_t file = (file_t)(ptr_int_t)drmgr_get_tls_field(drcontext, trace_tls);
+    if(file != INVALID_FILE){
+        dr_close_file(file);
+    }
+    drmgr_set_tls_field(drcontext, trace_tls, (void *)(ptr_int_t)INVALID_FILE);
+}
+
+void plc_trace_init(){
+    if(!plc_trace_enabled()){
+        return;
+    }
+    drx_init();
+    trace_tls = drmgr_register_tls_field();
+    trace_buffer = drx_buf_create_trace_buffer(PLC_TRACE_BUFFER_SIZE, trace_flush);
+    DR_ASSERT_MSG(trace_tls != -1 && trace_buffer != nullptr, "Couldn't create the trace buffer");
+    drmgr_register_thread_init_event(trace_thread_init);
+    drmgr_register_thread_exit_event(trace_thread_exit);
+    Interflop::verrou_set_rounding_mode(VR_NEAREST);
+}
+
+void plc_trace_exit(){
+    if(!plc_trace_enabled()){
+        return;
+    }
+    drx_buf_free(trace_buffer);
+    drmgr_unregister_tls_field(trace_tls);
+    drx_exit();
+}
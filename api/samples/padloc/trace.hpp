@@ -0,0 +1,55 @@
+#ifndef TRACE_BARRIER_HEADER
+#define TRACE_BARRIER_HEADER
+
+/**
+ * \file trace.hpp
+ * \brief Floating point operation trace recorder header. Part of the PADLOC project.
+ *
+ * \details When the recording mode is enabled, every operation interpreted by
+ * the block dispatcher is appended, with the values of its sources, to a
+ * per-thread drx_buf trace buffer. The buffer is written to the trace file of
+ * the thread, one chunk at a time, when it is full and when the thread exits.
+ * The operations are computed in round to nearest while recording, so that
+ * the trace is the one of the IEEE execution, and the traces are replayed in
+ * any rounding mode by the replay tool of the backend (backend_verrou/replay_main).
+ * See trace_format.h for the format of the files.
+ *
+ * \author Brasseur Dylan, Teaudors Mickaël, Valeri Yoann
+ * \date 2019
+ * \copyright Interflop
+ */
+
+#include "padloc_client.h"
+
+/**
+ * \def PLC_TRACE_BUFFER_SIZE
+ * \brief Size in bytes of the trace buffer of a thread, written as one chunk when full
+ */
+#define PLC_TRACE_BUFFER_SIZE (1 << 20)
+
+/**
+ * \brief Returns true if the recording mode is enabled
+ */
+bool plc_trace_enabled();
+
+/**
+ * \brief Creates the trace buffer and registers the thread events of the recorder
+ * \details Does nothing if the recording mode isn't enabled
+ */
+void plc_trace_init();
+
+/**
+ * \brief Frees the trace buffer
+ * \details Called at the exit of the client, once the threads have written their traces
+ */
+void plc_trace_exit();
+
+/**
+ * \brief Appends the operation \p desc to the trace buffer of the current thread
+ * 
+ * \param desc Description of the instruction
+ * \param srcs Addresses of the sources, in the order of the operation
+ */
+void plc_trace_record(const plc_instr_desc_t &desc, void *const *srcs);
+
+#endif //TRACE_BARRIER_HEADER
@@ -0,0 +1,126 @@
+#ifndef PADLOC_TRACE_FORMAT_HEADER
+#define PADLOC_TRACE_FORMAT_HEADER
+
+/**
+ * \file trace_format.h
+ * \brief Format of the floating point operation traces. Part of the PADLOC project.
+ *
+ * \details This header is shared by the client, which records the traces
+ * (-rt option), and by the replay tool of the backend, which doesn't depend
+ * on DynamoRIO. A trace file holds the operations of one thread : a
+ * plc_trace_header_t, then chunks made of a plc_trace_chunk_t followed by
+ * the chunk data, compressed with zlib when its stored size differs from its
+ * raw size. The raw data of the chunks is a sequence of records, each one a
+ * plc_trace_record_t followed by its operands.
+ *
+ * \author Brasseur Dylan, Teaudors Mickaël, Valeri Yoann
+ * \date 2019
+ * \copyright Interflop
+ */
+
+#include <stdint.h>
+
+/**
+ * \def PLC_TRACE_MAGIC
+ * \brief First word of a trace file ("PLCT")
+ */
+#define PLC_TRACE_MAGIC 0x54434c50
+
+/**
+ * \def PLC_TRACE_VERSION
+ * \brief Version of the trace format
+ */
+#define PLC_TRACE_VERSION 1
+
+/**
+ * \enum plc_trace_op_t
+ * \brief Operation of a record, computed by the backend function of the same name
+ */
+typedef enum{
+    /** a + b */
+    PLC_TRACE_ADD = 0,
+    /** a - b */
+    PLC_TRACE_SUB,
+    /** a * b */
+    PLC_TRACE_MUL,
+    /** a / b */
+    PLC_TRACE_DIV,
+    /** a * b + c */
+    PLC_TRACE_FMADD,
+    /** a * b - c */
+    PLC_TRACE_FMSUB,
+    /** -(a * b) + c */
+    PLC_TRACE_NFMADD,
+    /** -(a * b) - c */
+    PLC_TRACE_NFMSUB,
+    /** Number of operations */
+    PLC_TRACE_NB_OPS
+} plc_trace_op_t;
+
+/**
+ * \struct plc_trace_header_t
+ * \brief Header of a trace file
+ */
+struct plc_trace_header_t{
+    /** PLC_TRACE_MAGIC */
+    uint32_t magic;
+    /** PLC_TRACE_VERSION */
+    uint32_t version;
+    /** Index of the thread in the order of creation */
+    uint32_t thread_index;
+    /** Unused, 0 */
+    uint32_t reserved;
+};
+
+/**
+ * \struct plc_trace_chunk_t
+ * \brief Header of a chunk of records
+ */
+struct plc_trace_chunk_t{
+    /** Size in bytes of the records of the chunk */
+    uint32_t raw_size;
+    /** Size in bytes of the chunk data following this header, equal to raw_size if it isn't compressed */
+    uint32_t stored_size;
+};
+
+/**
+ * \struct plc_trace_record_t
+ * \brief Record of an executed operation
+ * \details The record is followed by its sources in the order of the
+ * operation (a, b, then c), each made of nb_elem elements, and padded to a
+ * multiple of 8 bytes (see PLC_TRACE_RECORD_SIZE).
+ */
+struct plc_trace_record_t{
+    /** Address of the instruction in the application */
+    uint64_t pc;
+    /** Operation, a plc_trace_op_t */
+    uint8_t op;
+    /** 1 for double precision elements, 0 for single precision */
+    uint8_t is_double;
+    /** Number of elements of each source */
+    uint8_t nb_elem;
+    /** Number of sources, 2 or 3 */
+    uint8_t nb_srcs;
+    /** Unused, 0 */
+    uint32_t reserved;
+};
+
+/**
+ * \def PLC_TRACE_OPERANDS_SIZE
+ * \brief Size in bytes of the sources of the record \p rec
+ */
+#define PLC_TRACE_OPERANDS_SIZE(rec) ((uint32_t)(rec)->nb_srcs * (rec)->nb_elem * ((rec)->is_double ? 8 : 4))
+
+/**
+ * \def PLC_TRACE_RECORD_SIZE
+ * \brief Size in bytes of the record \p rec and of its padded sources
+ */
+#define PLC_TRACE_RECORD_SIZE(rec) ((uint32_t)sizeof(struct plc_trace_record_t) + ((PLC_TRACE_OPERANDS_SIZE(rec) + 7) & ~7u))
+
+/**
+ * \def PLC_TRACE_MAX_RECORD_SIZE
+ * \brief Size in bytes of the largest record, 3 sources of 64 bytes
+ */
+#define PLC_TRACE_MAX_RECORD_SIZE (sizeof(struct plc_trace_record_t) + 3 * 64)
+
+#endif //PADLOC_TRACE_FORMAT_HEADER
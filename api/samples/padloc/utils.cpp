@@ -25,6 +25,8 @@
 
 #include "symbol_config.hpp"
 #include "analyse.hpp"
+#include "samples.hpp"
+#include "padloc_client.h"
 
 /**
  * Header string for files used by the symbol plugin.
@@ -61,6 +63,19 @@ static const char* PLC_HELP_STRING =
     "\t -aa [filename]\n\t --analyse_abort [filename]\n\tAnalyse the registers used by the backend, dump them into the given file, and stop execution\n\n"
     "\t -af [filename]\n\t --analyse_file [filename]\n\tRead the values in the given file, and use those values to save particular registers\n\n"
     "\t -ar\n\t --analyse_run\n\tAnalyse the backend normally and run the program afterwards\n\n"
+    "\t -ac [directory]\n\t --analyse_cache [directory]\n\tKeep the analysis cache in the given directory instead of next to the library\n\n"
+    "\t -anc\n\t --analyse_no_cache\n\tDon't read nor write the analysis cache\n\n"
+    "\t -ps\n\t --partial_save\n\tSave only the registers used by the instrumentation, and the registers clobbered by the backend that are live\n\n"
+    "\t -bc\n\t --batch_calls\n\tCall the backend once per run of floating point instructions, instead of once per instruction\n\n"
+    "\t -ef\n\t --exact_fast_path\n\tSkip the backend for scalar additions, subtractions and multiplications whose result is exact\n\n"
+    "\t -pf [filename]\n\t --profile [filename]\n\tCount the instrumented operations per symbol and the cycles spent in the backend and saving the registers, and write the sorted report to the given file\n\n"
+    "\t -mc [integer]\n\t --samples [integer]\n\tFork the given number of replicas at the entry of main (or at padloc_sample_start), each with its own seed, and reduce the outputs marked with padloc_sample_output (Linux x86-64)\n\n"
+    "\t -mo [filename]\n\t --samples_output [filename]\n\tWrite the mean, standard deviation and significant digits of the outputs of the replicas to the given file (default " PLC_SAMPLES_DEFAULT_FILE ")\n\n"
+    "\t -ls [integer]\n\t --lane_samples [integer]\n\tCarry the given number of samples (2 to 16) in each SIMD register, computing each with its own random rounding, and give them to padloc_sample_output. Implies -bc\n\n"
+    "\t -ms [integer]\n\t --samples_seed [integer]\n\tSeed of the first replica, the next ones using the following seeds (default random)\n\n"
+    "\t -rt [prefix]\n\t --record_trace [prefix]\n\tRecord the operations of each thread, computed in round to nearest, with their operands to the file prefix.<thread>.plct, for the replay tool of the backend. Implies -bc\n\n"
+    "\t -ro\n\t --roi\n\tStart with the instrumentation disabled, and instrument only between padloc_roi_start and padloc_roi_stop, or between the nudges 1 and 0\n\n"
+    "\t -pc\n\t --persist\n\tLet DynamoRIO persist the instrumented blocks and their descriptors (drrun -persist), and reuse them in the next runs of the same modules with the same options\n\n"
     "\n";
 
 /**
@@ -100,6 +115,74 @@ static padloc_symbol_mode_t padloc_symbols_mode = PLC_SYMBOL_DEFAULT;
  */
 static padloc_analyse_mode_t padloc_analyse_mode = PLC_ANALYSE_NEEDED;
 
+/**
+ * Register save mode as defined by the enum in "utils.hpp". This characterizes
+ * which registers are saved and restored around the instrumented
+ * instructions. The default mode is PLC_SAVE_ALL, meaning that all the GPR
+ * and SIMD registers are saved.
+ */
+static padloc_save_mode_t padloc_save_mode = PLC_SAVE_ALL;
+
+/**
+ * Backend call mode as defined by the enum in "utils.hpp". This characterizes
+ * whether the backend is called once per instrumented instruction, or once
+ * per run of instrumented instructions. The default mode is PLC_CALL_INSTR.
+ */
+static padloc_call_mode_t padloc_call_mode = PLC_CALL_INSTR;
+
+/**
+ * True if the instrumented code checks inline whether a scalar operation is
+ * exact, in which case the backend isn't called. Disabled by default.
+ */
+static bool padloc_exact_fast_path = false;
+
+/**
+ * Name of the file in which the profiling report is written. The profiling
+ * mode is disabled when it is empty, which is the default.
+ */
+static std::string padloc_profile_file;
+
+/**
+ * Number of Monte-Carlo replicas forked at the fork point of the application.
+ * The sampling mode is disabled when it is 0, which is the default.
+ */
+static int padloc_nb_samples = 0;
+
+/**
+ * Name of the file in which the reduced outputs of the replicas are written
+ */
+static std::string padloc_samples_file = PLC_SAMPLES_DEFAULT_FILE;
+
+/**
+ * Seed of the first replica, the replica i using the seed padloc_samples_seed + i.
+ * It is drawn at random when the sampling starts if it is 0, which is the default.
+ */
+static unsigned int padloc_samples_seed = 0;
+
+/**
+ * Number of samples carried by each SIMD register in lane mode, the real
+ * value included. The lane mode is disabled when it is 1, which is the default.
+ */
+static int padloc_nb_lane_samples = 1;
+
+/**
+ * Prefix of the trace files of the threads. The recording mode is disabled
+ * when it is empty, which is the default.
+ */
+static std::string padloc_trace_prefix;
+
+/**
+ * True if the instrumentation is toggled at runtime by the region of interest
+ * markers of the application and by nudges. Disabled by default.
+ */
+static bool padloc_roi_mode = false;
+
+/**
+ * True if the instrumented blocks are marked persistable, so that DynamoRIO
+ * reuses them across runs when its persistent cache is enabled. Disabled by default.
+ */
+static bool padloc_persist_mode = false;
+
 void set_log_level(int level){
     log_level = level;
 }
@@ -124,6 +207,94 @@ padloc_analyse_mode_t get_analyse_mode(){
     return padloc_analyse_mode;
 }
 
+void set_save_mode(padloc_save_mode_t mode){
+    padloc_save_mode = mode;
+}
+
+padloc_save_mode_t get_save_mode(){
+    return padloc_save_mode;
+}
+
+void set_call_mode(padloc_call_mode_t mode){
+    padloc_call_mode = mode;
+}
+
+padloc_call_mode_t get_call_mode(){
+    return padloc_call_mode;
+}
+
+void set_exact_fast_path(bool enabled){
+    padloc_exact_fast_path = enabled;
+}
+
+bool get_exact_fast_path(){
+    return padloc_exact_fast_path;
+}
+
+void set_profile_file(const std::string &filename){
+    padloc_profile_file = filename;
+}
+
+const std::string &get_profile_file(){
+    return padloc_profile_file;
+}
+
+void set_nb_samples(int nb){
+    padloc_nb_samples = nb;
+}
+
+int get_nb_samples(){
+    return padloc_nb_samples;
+}
+
+void set_samples_file(const std::string &filename){
+    padloc_samples_file = filename;
+}
+
+const std::string &get_samples_file(){
+    return padloc_samples_file;
+}
+
+void set_samples_seed(unsigned int seed){
+    padloc_samples_seed = seed;
+}
+
+unsigned int get_samples_seed(){
+    return padloc_samples_seed;
+}
+
+void set_nb_lane_samples(int nb){
+    padloc_nb_lane_samples = nb;
+}
+
+int get_nb_lane_samples(){
+    return padloc_nb_lane_samples;
+}
+
+void set_trace_prefix(const std::string &prefix){
+    padloc_trace_prefix = prefix;
+}
+
+const std::string &get_trace_prefix(){
+    return padloc_trace_prefix;
+}
+
+void set_roi_mode(bool enabled){
+    padloc_roi_mode = enabled;
+}
+
+bool get_roi_mode(){
+    return padloc_roi_mode;
+}
+
+void set_persist_mode(bool enabled){
+    padloc_persist_mode = enabled;
+}
+
+bool get_persist_mode(){
+    return padloc_persist_mode;
+}
+
 void print_help(){
     dr_printf(PLC_HELP_STRING);
 }
@@ -157,7 +328,30 @@ bool is_number(const std::string &str){
  *      - help, with "--help" or "-h", which display the help string and stop
  *      the execution of the program;
  *      - loglevel, with "--loglevel" or "-l", which sets the log level with
- *      the following integer, which is between 0 and 3.
+ *      the following integer, which is between 0 and 3;
+ *      - partial save, with "--partial_save" or "-ps", which only saves the
+ *      registers needed around the instrumented instructions;
+ *      - batch calls, with "--batch_calls" or "-bc", which calls the backend
+ *      once per run of instrumented instructions;
+ *      - exact fast path, with "--exact_fast_path" or "-ef", which skips the
+ *      backend when a scalar operation is exact;
+ *      - profile, with "--profile" or "-pf", which counts the instrumented
+ *      operations and writes the report to the following file;
+ *      - samples, with "--samples" or "-mc", which forks the following
+ *      number of Monte-Carlo replicas;
+ *      - samples output, with "--samples_output" or "-mo", which sets the
+ *      file of the samples report;
+ *      - samples seed, with "--samples_seed" or "-ms", which sets the seed
+ *      of the first replica;
+ *      - lane samples, with "--lane_samples" or "-ls", which sets the number
+ *      of samples carried by each SIMD register, and the block call mode;
+ *      - record trace, with "--record_trace" or "-rt", which records the
+ *      operations to the trace files starting with the following prefix, and
+ *      sets the block call mode;
+ *      - region of interest, with "--roi" or "-ro", which toggles the
+ *      instrumentation at runtime;
+ *      - persist, with "--persist" or "-pc", which marks the instrumented
+ *      blocks persistable.
  * 
  * \param arg The current argument as string
  * \param i The index of the current argument, given as pointer to be modified
@@ -208,6 +402,136 @@ static bool utils_argument_parser(const std::string arg, int *i,
             set_symbol_mode(PLC_SYMBOL_HELP);
             return true;
         }
+    }else if(arg == "--partial_save" || arg == "-ps"){
+        /*
+         * The partial save option was detected, so only the registers
+         * needed will be saved around the instrumented instructions.
+         */
+        set_save_mode(PLC_SAVE_LIVE);
+    }else if(arg == "--batch_calls" || arg == "-bc"){
+        /*
+         * The batch calls option was detected, so each run of instrumented
+         * instructions will be interpreted by a single call to the backend.
+         */
+        set_call_mode(PLC_CALL_BLOCK);
+    }else if(arg == "--record_trace" || arg == "-rt"){
+        *i += 1;
+        if(*i < argc){
+            /*
+             * The record trace option was detected, so the operations will be
+             * recorded to the trace files starting with the next command line
+             * string. They are recorded by the block dispatcher.
+             */
+            set_trace_prefix(argv[*i]);
+            set_call_mode(PLC_CALL_BLOCK);
+        }else{
+            dr_fprintf(STDERR,
+                "NOT ENOUGH ARGUMENTS : Lacking the file prefix associated with -rt\n");
+            set_symbol_mode(PLC_SYMBOL_HELP);
+            return true;
+        }
+    }else if(arg == "--roi" || arg == "-ro"){
+        /*
+         * The region of interest option was detected, so the instrumentation
+         * will only be enabled in the regions marked by the application or
+         * by nudges.
+         */
+        set_roi_mode(true);
+    }else if(arg == "--persist" || arg == "-pc"){
+        /*
+         * The persist option was detected, so the instrumented blocks and
+         * their descriptors will be kept in DynamoRIO's persistent cache.
+         */
+        set_persist_mode(true);
+    }else if(arg == "--exact_fast_path" || arg == "-ef"){
+        /*
+         * The exact fast path option was detected, so the exactness of the
+         * scalar operations will be checked before calling the backend.
+         */
+        set_exact_fast_path(true);
+    }else if(arg == "--profile" || arg == "-pf"){
+        *i += 1;
+        if(*i < argc){
+            /*
+             * The profile option was detected, so the instrumented operations
+             * will be counted, and the report written to the next command
+             * line string.
+             */
+            set_profile_file(argv[*i]);
+        }else{
+            dr_fprintf(STDERR,
+                "NOT ENOUGH ARGUMENTS : Lacking the file name associated with -pf\n");
+            set_symbol_mode(PLC_SYMBOL_HELP);
+            return true;
+        }
+    }else if(arg == "--samples" || arg == "-mc" || arg == "--samples_seed" || arg == "-ms"){
+        const bool is_seed = (arg == "--samples_seed" || arg == "-ms");
+        *i += 1;
+        if(*i < argc){
+            /*
+             * The samples or samples seed option was detected, so we check
+             * that the next command line string is a number, which is the
+             * number of replicas or the seed of the first one.
+             */
+            std::string string_number(argv[*i]);
+            if(!is_number(string_number)){
+                dr_fprintf(STDERR,
+                        "SAMPLES FAILURE : \"%s\" is not a number\n",
+                        argv[*i]);
+                set_symbol_mode(PLC_SYMBOL_HELP);
+                return true;
+            }
+            if(is_seed){
+                set_samples_seed((unsigned int)std::stoul(string_number));
+            }else{
+                set_nb_samples(std::stoi(string_number));
+            }
+        }else{
+            dr_fprintf(STDERR,
+                "NOT ENOUGH ARGUMENTS : Lacking the number associated with %s\n", arg.c_str());
+            set_symbol_mode(PLC_SYMBOL_HELP);
+            return true;
+        }
+    }else if(arg == "--lane_samples" || arg == "-ls"){
+        *i += 1;
+        if(*i < argc){
+            /*
+             * The lane samples option was detected, so we check that the next
+             * command line string is a valid number of samples. The samples
+             * are computed by the block dispatcher, so the backend is called
+             * once per run of instrumented instructions.
+             */
+            std::string string_number(argv[*i]);
+            if(!is_number(string_number) || std::stoi(string_number) < 2 ||
+               std::stoi(string_number) > PLC_MAX_LANE_SAMPLES){
+                dr_fprintf(STDERR,
+                        "LANE SAMPLES FAILURE : \"%s\" is not a number of samples between 2 and %d\n",
+                        argv[*i], PLC_MAX_LANE_SAMPLES);
+                set_symbol_mode(PLC_SYMBOL_HELP);
+                return true;
+            }
+            set_nb_lane_samples(std::stoi(string_number));
+            set_call_mode(PLC_CALL_BLOCK);
+        }else{
+            dr_fprintf(STDERR,
+                "NOT ENOUGH ARGUMENTS : Lacking the number associated with -ls\n");
+            set_symbol_mode(PLC_SYMBOL_HELP);
+            return true;
+        }
+    }else if(arg == "--samples_output" || arg == "-mo"){
+        *i += 1;
+        if(*i < argc){
+            /*
+             * The samples output option was detected, so the reduced outputs
+             * of the replicas will be written to the next command line string.
+             */
+            set_samples_file(argv[*i]);
+        }else{
+            dr_fprintf(STDERR,
+                "NOT ENOUGH ARGUMENTS : Lacking the file name associated with -mo\n");
+            set_symbol_mode(PLC_SYMBOL_HELP);
+            return true;
+        }
     }else{
         /* If the argument is not one we know, increment the error counter */
         inc_error();
@@ -11,6 +11,7 @@
  * \copyright Interflop 
  */
 #include <fstream>
+#include <string>
 
 /**
  * \def UNKNOWN_ARGUMENT
@@ -27,6 +28,12 @@
  */
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
 
+/**
+ * \def MIN
+ * \brief Computes the minimum between two number x and y.
+ */
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+
 /**
  * \enum padloc_symbol_mode_t
  * \brief Specifies the mode for the symbol plugin
@@ -67,6 +74,36 @@ typedef enum{
     PLC_ANALYSE_NEEDED
 } padloc_analyse_mode_t;
 
+/**
+ * \enum padloc_save_mode_t
+ * \brief Specifies which registers are saved around instrumented instructions
+ * \details By default, every GPR and SIMD register is saved. The live mode
+ * only saves the registers needed by the instrumentation, and the registers
+ * clobbered by the backend (found by the backend analysis plugin) that are
+ * still live after the instrumented instructions.
+ */
+typedef enum{
+    /** Save every register (Default) */
+    PLC_SAVE_ALL,
+    /** Save only the registers clobbered by the backend that are live */
+    PLC_SAVE_LIVE
+} padloc_save_mode_t;
+
+/**
+ * \enum padloc_call_mode_t
+ * \brief Specifies how the backend is called from the instrumented code
+ * \details By default, each instrumented instruction gets its own call to
+ * the backend. In block mode, each run of consecutive instrumented
+ * instructions is described in a table, and a single call to a dispatcher
+ * interprets the whole run.
+ */
+typedef enum{
+    /** One backend call per instrumented instruction (Default) */
+    PLC_CALL_INSTR,
+    /** One dispatcher call per run of instrumented instructions */
+    PLC_CALL_BLOCK
+} padloc_call_mode_t;
+
 /**
  * \brief Setter for the log level
  * 
@@ -106,6 +143,149 @@ void set_analyse_mode(padloc_analyse_mode_t mode);
  */
 padloc_analyse_mode_t get_analyse_mode();
 
+/**
+ * \brief Setter for the register save mode
+ * 
+ * \param mode The new register save mode
+ */
+void set_save_mode(padloc_save_mode_t mode);
+
+/**
+ * \brief Getter for the register save mode
+ * \return The current register save mode
+ */
+padloc_save_mode_t get_save_mode();
+
+/**
+ * \brief Setter for the backend call mode
+ * 
+ * \param mode The new backend call mode
+ */
+void set_call_mode(padloc_call_mode_t mode);
+
+/**
+ * \brief Getter for the backend call mode
+ * \return The current backend call mode
+ */
+padloc_call_mode_t get_call_mode();
+
+/**
+ * \brief Setter for the exact fast path
+ * 
+ * \param enabled True to skip the backend when the operation is exact
+ */
+void set_exact_fast_path(bool enabled);
+
+/**
+ * \brief Getter for the exact fast path
+ * \return True if the backend is skipped when the operation is exact
+ */
+bool get_exact_fast_path();
+
+/**
+ * \brief Setter for the profiling report file
+ * 
+ * \param filename The file in which the profiling report is written, empty to disable the profiling
+ */
+void set_profile_file(const std::string &filename);
+
+/**
+ * \brief Getter for the profiling report file
+ * \return The file in which the profiling report is written, empty if the profiling is disabled
+ */
+const std::string &get_profile_file();
+
+/**
+ * \brief Setter for the number of Monte-Carlo replicas
+ * 
+ * \param nb The number of replicas forked at the fork point, 0 to disable the sampling mode
+ */
+void set_nb_samples(int nb);
+
+/**
+ * \brief Getter for the number of Monte-Carlo replicas
+ * \return The number of replicas forked at the fork point, 0 if the sampling mode is disabled
+ */
+int get_nb_samples();
+
+/**
+ * \brief Setter for the samples report file
+ * 
+ * \param filename The file in which the reduced outputs of the replicas are written
+ */
+void set_samples_file(const std::string &filename);
+
+/**
+ * \brief Getter for the samples report file
+ * \return The file in which the reduced outputs of the replicas are written
+ */
+const std::string &get_samples_file();
+
+/**
+ * \brief Setter for the seed of the first Monte-Carlo replica
+ * 
+ * \param seed The seed of the first replica, the replica i using seed + i. 0 draws it at random
+ */
+void set_samples_seed(unsigned int seed);
+
+/**
+ * \brief Getter for the seed of the first Monte-Carlo replica
+ * \return The seed of the first replica
+ */
+unsigned int get_samples_seed();
+
+/**
+ * \brief Setter for the number of samples of the lane mode
+ * 
+ * \param nb The number of samples carried by each SIMD register, the real value included, 1 to disable the lane mode
+ */
+void set_nb_lane_samples(int nb);
+
+/**
+ * \brief Getter for the number of samples of the lane mode
+ * \return The number of samples carried by each SIMD register, 1 if the lane mode is disabled
+ */
+int get_nb_lane_samples();
+
+/**
+ * \brief Setter for the prefix of the trace files
+ * 
+ * \param prefix The prefix of the trace files of the threads, empty to disable the recording mode
+ */
+void set_trace_prefix(const std::string &prefix);
+
+/**
+ * \brief Getter for the prefix of the trace files
+ * \return The prefix of the trace files of the threads, empty if the recording mode is disabled
+ */
+const std::string &get_trace_prefix();
+
+/**
+ * \brief Setter for the region of interest mode
+ * 
+ * \param enabled True to toggle the instrumentation at runtime, starting disabled
+ */
+void set_roi_mode(bool enabled);
+
+/**
+ * \brief Getter for the region of interest mode
+ * \return True if the instrumentation is toggled at runtime
+ */
+bool get_roi_mode();
+
+/**
+ * \brief Setter for the persistent cache mode
+ * 
+ * \param enabled True to mark the instrumented blocks persistable
+ */
+void set_persist_mode(bool enabled);
+
+/**
+ * \brief Getter for the persistent cache mode
+ * \return True if the instrumented blocks are marked persistable
+ */
+bool get_persist_mode();
+
 /**
  * \brief Helper function for printing the help string, when a command line
  * related bug occurs, or the user uses "-h" or "--help".
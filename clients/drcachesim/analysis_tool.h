@@ -121,6 +121,24 @@ public:
      */
     virtual bool
     process_memref(const memref_t &memref) = 0;
+    /**
+     * The #analyzer_t class delivers the trace entries to the tools in batches,
+     * through this routine, which operates on the \p count entries starting at \p
+     * memrefs, in trace order.  The default implementation calls process_memref()
+     * on each entry in turn, stopping at the first failure.  A tool can override it
+     * to avoid the per-entry call overhead or to hoist work out of the loop.  The
+     * return value indicates whether it was successful.
+     * On failure, get_error_string() returns a descriptive message.
+     */
+    virtual bool
+    process_memref_batch(const memref_t *memrefs, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            if (!process_memref(memrefs[i]))
+                return false;
+        }
+        return true;
+    }
     /**
      * This routine reports the results of the trace analysis.
      * The return value indicates whether it was successful.
@@ -207,6 +225,26 @@ public:
     {
         return false;
     }
+    /**
+     * The #analyzer_t class delivers the trace entries of a shard to the tools in
+     * batches, through this routine, which operates on the \p count entries
+     * starting at \p memrefs, in trace order.  The \p shard_data parameter is the
+     * value returned by parallel_shard_init() for this shard.  The default
+     * implementation calls parallel_shard_memref() on each entry in turn, stopping
+     * at the first failure.  A tool can override it to avoid the per-entry call
+     * overhead or to hoist work out of the loop.  The return value indicates whether
+     * this function was successful. On failure, parallel_shard_error() returns a
+     * descriptive message.
+     */
+    virtual bool
+    parallel_shard_memref_batch(void *shard_data, const memref_t *memrefs, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            if (!parallel_shard_memref(shard_data, memrefs[i]))
+                return false;
+        }
+        return true;
+    }
     /** Returns a description of the last error for this shard. */
     virtual std::string
     parallel_shard_error(void *shard_data)
@@ -30,17 +30,24 @@
  * DAMAGE.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <fstream>
 #include <iostream>
 #include <thread>
 #include "analysis_tool.h"
 #include "analyzer.h"
 #include "reader/file_reader.h"
 #ifdef HAS_ZLIB
+#    include "reader/chunked_file_reader.h"
 #    include "reader/compressed_file_reader.h"
 #endif
 #ifdef HAS_SNAPPY
 #    include "reader/snappy_file_reader.h"
 #endif
+#ifdef UNIX
+#    include "reader/mmap_file_reader.h"
+#endif
 #include "common/utils.h"
 
 #ifdef HAS_ZLIB
@@ -58,6 +65,7 @@ analyzer_t::analyzer_t()
     , tools(NULL)
     , parallel(true)
     , worker_count(0)
+    , next_shard(0)
 {
     /* Nothing else: child class needs to initialize. */
 }
@@ -73,6 +81,67 @@ ends_with(const std::string &str, const std::string &with)
 }
 #endif
 
+#ifdef UNIX
+static bool
+is_gzip_file(const std::string &path)
+{
+    std::ifstream file(path, std::ifstream::binary);
+    unsigned char magic[2];
+    return file.read(reinterpret_cast<char *>(magic), sizeof(magic)) &&
+        magic[0] == 0x1f && magic[1] == 0x8b;
+}
+
+// Returns whether the trace at path is made of uncompressed files, which we can
+// map into memory.
+static bool
+is_uncompressed_trace(const std::string &path)
+{
+    if (!directory_iterator_t::is_directory(path))
+        return !is_gzip_file(path);
+    directory_iterator_t end;
+    directory_iterator_t iter(path);
+    if (!iter)
+        return false;
+    for (; iter != end; ++iter) {
+        const std::string fname = *iter;
+        if (fname == "." || fname == "..")
+            continue;
+        if (is_gzip_file(path + DIRSEP + fname))
+            return false;
+    }
+    return true;
+}
+#endif
+
+#ifdef HAS_ZLIB
+// Returns whether the trace at path is a chunked trace file, or a directory of them.
+// Sets mixed if it is a directory of both chunked and other files, which no reader
+// supports.
+static bool
+is_chunked_trace(const std::string &path, bool *mixed)
+{
+    *mixed = false;
+    if (!directory_iterator_t::is_directory(path))
+        return is_chunked_trace_file(path);
+    directory_iterator_t end;
+    directory_iterator_t iter(path);
+    if (!iter)
+        return false;
+    bool chunked = false, other = false;
+    for (; iter != end; ++iter) {
+        const std::string fname = *iter;
+        if (fname == "." || fname == "..")
+            continue;
+        if (is_chunked_trace_file(path + DIRSEP + fname))
+            chunked = true;
+        else
+            other = true;
+    }
+    *mixed = chunked && other;
+    return chunked && !other;
+}
+#endif
+
 static std::unique_ptr<reader_t>
 get_reader(const std::string &path, int verbosity)
 {
@@ -95,11 +164,37 @@ get_reader(const std::string &path, int verbosity)
             }
         }
     }
+#endif
+#ifdef HAS_ZLIB
+    // Chunked traces are decompressed in parallel by a pool of threads.
+    bool mixed;
+    if (is_chunked_trace(path, &mixed))
+        return std::unique_ptr<reader_t>(new chunked_file_reader_t(path, verbosity));
+    if (mixed) {
+        ERRMSG("Directory %s mixes chunked and other trace files\n", path.c_str());
+        return nullptr;
+    }
+#endif
+#ifdef UNIX
+    // Uncompressed traces are mapped into memory, and their entries are handed to
+    // the analyzer in place.
+    if (is_uncompressed_trace(path))
+        return std::unique_ptr<reader_t>(new mmap_file_reader_t(path, verbosity));
 #endif
     // No snappy support, or didn't find a .sz file, try the default reader.
     return std::unique_ptr<reader_t>(new default_file_reader_t(path, verbosity));
 }
 
+static uint64_t
+get_file_size(const std::string &path)
+{
+    std::ifstream file(path, std::ifstream::binary | std::ifstream::ate);
+    if (!file)
+        return 0;
+    std::streamoff size = file.tellg();
+    return size < 0 ? 0 : static_cast<uint64_t>(size);
+}
+
 bool
 analyzer_t::init_file_reader(const std::string &trace_path, int verbosity_in)
 {
@@ -131,22 +226,27 @@ analyzer_t::init_file_reader(const std::string &trace_path, int verbosity_in)
             if (!reader) {
                 return false;
             }
-            thread_data.push_back(analyzer_shard_data_t(
-                static_cast<int>(thread_data.size()), std::move(reader), path));
+            thread_data.push_back(
+                analyzer_shard_data_t(static_cast<int>(thread_data.size()),
+                                      std::move(reader), path, get_file_size(path)));
             VPRINT(this, 2, "Opened reader for %s\n", path.c_str());
         }
-        // Like raw2trace, we use a simple round-robin static work assigment.  This
-        // could be improved later with dynamic work queue for better load balancing.
+        // Shard sizes can vary by orders of magnitude, so a static assignment
+        // leaves most workers idle behind the one with the largest shards.
+        // Instead the workers claim shards from a shared queue, largest first
+        // (the longest-processing-time rule), so that the small shards end up
+        // filling the gaps at the end.
         if (worker_count <= 0)
             worker_count = std::thread::hardware_concurrency();
-        worker_tasks.resize(worker_count);
-        int worker = 0;
-        for (size_t i = 0; i < thread_data.size(); ++i) {
-            VPRINT(this, 2, "Worker %d assigned trace shard %zd\n", worker, i);
-            worker_tasks[worker].push_back(&thread_data[i]);
-            thread_data[i].worker = worker;
-            worker = (worker + 1) % worker_count;
-        }
+        shard_queue.reserve(thread_data.size());
+        for (size_t i = 0; i < thread_data.size(); ++i)
+            shard_queue.push_back(&thread_data[i]);
+        std::stable_sort(
+            shard_queue.begin(), shard_queue.end(),
+            [](const analyzer_shard_data_t *a, const analyzer_shard_data_t *b) {
+                return a->size > b->size;
+            });
+        next_shard = 0;
     } else {
         parallel = false;
         serial_trace_iter = get_reader(trace_path, verbosity);
@@ -162,12 +262,14 @@ analyzer_t::init_file_reader(const std::string &trace_path, int verbosity_in)
 }
 
 analyzer_t::analyzer_t(const std::string &trace_path, analysis_tool_t **tools_in,
-                       int num_tools_in, int worker_count_in)
+                       int num_tools_in, int worker_count_in, uint64_t skip_instrs_in)
     : success(true)
     , num_tools(num_tools_in)
     , tools(tools_in)
     , parallel(true)
     , worker_count(worker_count_in)
+    , next_shard(0)
+    , skip_instrs(skip_instrs_in)
 {
     for (int i = 0; i < num_tools; ++i) {
         if (tools[i] == NULL || !*tools[i]) {
@@ -195,6 +297,7 @@ analyzer_t::analyzer_t(const std::string &trace_path)
     // This external-iterator interface does not support parallel analysis.
     , parallel(false)
     , worker_count(0)
+    , next_shard(0)
 {
     if (!init_file_reader(trace_path))
         success = false;
@@ -231,57 +334,107 @@ analyzer_t::start_reading()
     return true;
 }
 
+analyzer_t::analyzer_shard_data_t *
+analyzer_t::claim_shard()
+{
+    size_t next = next_shard.fetch_add(1);
+    if (next >= shard_queue.size())
+        return nullptr;
+    return shard_queue[next];
+}
+
+bool
+analyzer_t::fill_batch(reader_t &iter, std::vector<memref_t> &batch)
+{
+    batch.clear();
+    for (; batch.size() < memref_batch_size && iter != *trace_end; ++iter)
+        batch.push_back(*iter);
+    return !batch.empty();
+}
+
 void
-analyzer_t::process_tasks(std::vector<analyzer_shard_data_t *> *tasks)
+analyzer_t::skip_instructions(reader_t &iter)
 {
-    if (tasks->empty()) {
-        VPRINT(this, 1, "Worker has no tasks\n");
+    if (skip_instrs == 0)
         return;
+    if (iter.seek_to_instruction(skip_instrs))
+        return;
+    // The reader cannot seek, or the trace ended before the instruction: in the
+    // latter case iter is at the end and there is nothing left to read.
+    VPRINT(this, 1, "Reading up to instruction %llu\n",
+           static_cast<unsigned long long>(skip_instrs));
+    uint64_t count = 0;
+    for (; iter != *trace_end; ++iter) {
+        if (type_is_instr((*iter).instr.type) && count++ == skip_instrs)
+            break;
     }
-    VPRINT(this, 1, "Worker %d assigned %zd task(s)\n", (*tasks)[0]->worker,
-           tasks->size());
-    std::vector<void *> worker_data(num_tools);
-    for (int i = 0; i < num_tools; ++i)
-        worker_data[i] = tools[i]->parallel_worker_init((*tasks)[0]->worker);
-    for (analyzer_shard_data_t *tdata : *tasks) {
-        VPRINT(this, 1, "Worker %d starting on trace shard %d\n", tdata->worker,
-               tdata->index);
+}
+
+void
+analyzer_t::process_tasks(int worker)
+{
+    typedef std::chrono::steady_clock clock_t;
+    analyzer_worker_data_t &wdata = worker_data[worker];
+    // The tool worker data is only created once the worker gets a shard.
+    std::vector<void *> tool_worker_data;
+    analyzer_shard_data_t *tdata;
+    while ((tdata = claim_shard()) != nullptr) {
+        clock_t::time_point start = clock_t::now();
+        tdata->worker = worker;
+        if (tool_worker_data.empty()) {
+            tool_worker_data.resize(num_tools);
+            for (int i = 0; i < num_tools; ++i)
+                tool_worker_data[i] = tools[i]->parallel_worker_init(worker);
+        }
+        ++wdata.shards;
+        VPRINT(this, 1, "Worker %d starting on trace shard %d (%llu bytes)\n", worker,
+               tdata->index, static_cast<unsigned long long>(tdata->size));
         if (!tdata->iter->init()) {
             tdata->error = "Failed to read from trace" + tdata->trace_file;
             return;
         }
+        skip_instructions(*tdata->iter);
         std::vector<void *> shard_data(num_tools);
-        for (int i = 0; i < num_tools; ++i)
-            shard_data[i] = tools[i]->parallel_shard_init(tdata->index, worker_data[i]);
+        for (int i = 0; i < num_tools; ++i) {
+            shard_data[i] =
+                tools[i]->parallel_shard_init(tdata->index, tool_worker_data[i]);
+        }
         VPRINT(this, 1, "shard_data[0] is %p\n", shard_data[0]);
-        for (; *tdata->iter != *trace_end; ++(*tdata->iter)) {
+        std::vector<memref_t> batch;
+        batch.reserve(memref_batch_size);
+        while (fill_batch(*tdata->iter, batch)) {
             for (int i = 0; i < num_tools; ++i) {
-                const memref_t &memref = **tdata->iter;
-                if (!tools[i]->parallel_shard_memref(shard_data[i], memref)) {
+                if (!tools[i]->parallel_shard_memref_batch(shard_data[i], batch.data(),
+                                                           batch.size())) {
                     tdata->error = tools[i]->parallel_shard_error(shard_data[i]);
                     VPRINT(this, 1,
                            "Worker %d hit shard memref error %s on trace shard %d\n",
-                           tdata->worker, tdata->error.c_str(), tdata->index);
+                           worker, tdata->error.c_str(), tdata->index);
                     return;
                 }
             }
         }
-        VPRINT(this, 1, "Worker %d finished trace shard %d\n", tdata->worker,
-               tdata->index);
+        VPRINT(this, 1, "Worker %d finished trace shard %d\n", worker, tdata->index);
         for (int i = 0; i < num_tools; ++i) {
             if (!tools[i]->parallel_shard_exit(shard_data[i])) {
                 tdata->error = tools[i]->parallel_shard_error(shard_data[i]);
                 VPRINT(this, 1, "Worker %d hit shard exit error %s on trace shard %d\n",
-                       tdata->worker, tdata->error.c_str(), tdata->index);
+                       worker, tdata->error.c_str(), tdata->index);
                 return;
             }
         }
+        wdata.busy_seconds +=
+            std::chrono::duration<double>(clock_t::now() - start).count();
+    }
+    if (tool_worker_data.empty()) {
+        VPRINT(this, 1, "Worker %d has no tasks\n", worker);
+        return;
     }
     for (int i = 0; i < num_tools; ++i) {
-        const std::string error = tools[i]->parallel_worker_exit(worker_data[i]);
+        const std::string error = tools[i]->parallel_worker_exit(tool_worker_data[i]);
         if (!error.empty()) {
-            (*tasks)[0]->error = error;
-            VPRINT(this, 1, "Worker %d hit worker exit error %s\n", (*tasks)[0]->worker,
+            wdata.error = error;
+            VPRINT(this, 1, "Worker %d hit worker exit error %s\n", worker,
                    error.c_str());
             return;
         }
@@ -295,12 +448,14 @@ analyzer_t::run()
     if (!parallel) {
         if (!start_reading())
             return false;
-        for (; *serial_trace_iter != *trace_end; ++(*serial_trace_iter)) {
+        skip_instructions(*serial_trace_iter);
+        std::vector<memref_t> batch;
+        batch.reserve(memref_batch_size);
+        while (fill_batch(*serial_trace_iter, batch)) {
             for (int i = 0; i < num_tools; ++i) {
-                memref_t memref = **serial_trace_iter;
                 // We short-circuit and exit on an error to avoid confusion over
                 // the results and avoid wasted continued work.
-                if (!tools[i]->process_memref(memref)) {
+                if (!tools[i]->process_memref_batch(batch.data(), batch.size())) {
                     error_string = tools[i]->get_error_string();
                     return false;
                 }
@@ -314,19 +469,40 @@ analyzer_t::run()
     }
     std::vector<std::thread> threads;
     VPRINT(this, 1, "Creating %d worker threads\n", worker_count);
+    worker_data.assign(worker_count, analyzer_worker_data_t());
+    next_shard = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
     threads.reserve(worker_count);
-    for (int i = 0; i < worker_count; ++i) {
-        threads.emplace_back(
-            std::thread(&analyzer_t::process_tasks, this, &worker_tasks[i]));
-    }
+    for (int i = 0; i < worker_count; ++i)
+        threads.emplace_back(std::thread(&analyzer_t::process_tasks, this, i));
     for (std::thread &thread : threads)
         thread.join();
+    const double elapsed =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    // A worker is idle from the time it finds the queue empty until the last
+    // worker is done.
+    for (int i = 0; i < worker_count; ++i) {
+        analyzer_worker_data_t &wdata = worker_data[i];
+        wdata.idle_seconds = std::max(0., elapsed - wdata.busy_seconds);
+        // Printed in release builds too, unlike VPRINT.
+        if (verbosity >= 1) {
+            fprintf(stderr, "%s Worker %d: %d shard(s), busy %.3fs, idle %.3fs\n",
+                    output_prefix, i, wdata.shards, wdata.busy_seconds,
+                    wdata.idle_seconds);
+        }
+    }
     for (auto &tdata : thread_data) {
         if (!tdata.error.empty()) {
             error_string = tdata.error;
             return false;
         }
     }
+    for (auto &wdata : worker_data) {
+        if (!wdata.error.empty()) {
+            error_string = wdata.error;
+            return false;
+        }
+    }
     return true;
 }
 
@@ -43,6 +43,7 @@
  * @brief DrMemtrace top-level trace analysis driver.
  */
 
+#include <atomic>
 #include <iterator>
 #include <memory>
 #include <string>
@@ -81,9 +82,13 @@ public:
      * it does not make a copy.
      * The user must free them afterward.
      * The analyzer calls the initialize() function on each tool before use.
+     * If \p skip_instrs is non-zero, the tools only see the trace from the
+     * instruction with that ordinal on: in the interleaved trace when analyzing
+     * serially, and in each thread file when analyzing in parallel.  Readers
+     * with an index, such as those of chunked traces, seek straight to it.
      */
     analyzer_t(const std::string &trace_path, analysis_tool_t **tools, int num_tools,
-               int worker_count = 0);
+               int worker_count = 0, uint64_t skip_instrs = 0);
     /** Launches the analysis process. */
     virtual bool
     run();
@@ -113,11 +118,12 @@ protected:
     // analyzed by a single worker thread, eliminating the need for locks.
     struct analyzer_shard_data_t {
         analyzer_shard_data_t(int index_in, std::unique_ptr<reader_t> iter_in,
-                              const std::string &trace_file_in)
+                              const std::string &trace_file_in, uint64_t size_in)
             : index(index_in)
             , worker(0)
             , iter(std::move(iter_in))
             , trace_file(trace_file_in)
+            , size(size_in)
         {
         }
         analyzer_shard_data_t(analyzer_shard_data_t &&src)
@@ -126,6 +132,7 @@ protected:
             worker = src.worker;
             iter = std::move(src.iter);
             trace_file = std::move(src.trace_file);
+            size = src.size;
             error = std::move(src.error);
         }
 
@@ -133,6 +140,8 @@ protected:
         int worker;
         std::unique_ptr<reader_t> iter;
         std::string trace_file;
+        // Size of the trace file in bytes, used to schedule the largest shards first.
+        uint64_t size;
         std::string error;
 
     private:
@@ -149,8 +158,31 @@ protected:
     bool
     start_reading();
 
+    // Per-worker scheduling statistics, reported at verbosity 1.
+    struct analyzer_worker_data_t {
+        int shards = 0;
+        double busy_seconds = 0.;
+        double idle_seconds = 0.;
+        std::string error;
+    };
+
+    // Returns the next shard of shard_queue to analyze, or nullptr once they
+    // have all been claimed.
+    analyzer_shard_data_t *
+    claim_shard();
+
+    void
+    process_tasks(int worker);
+
+    // Copies up to memref_batch_size entries from iter into batch, advancing iter.
+    // Returns false once iter has reached the end of the trace.
+    bool
+    fill_batch(reader_t &iter, std::vector<memref_t> &batch);
+
+    // Moves iter, just initialized, to the instruction with ordinal skip_instrs.
+    // It is left at the end if the trace has fewer instructions.
     void
-    process_tasks(std::vector<analyzer_shard_data_t *> *tasks);
+    skip_instructions(reader_t &iter);
 
     bool success;
     std::string error_string;
@@ -161,7 +193,15 @@ protected:
     analysis_tool_t **tools;
     bool parallel;
     int worker_count;
-    std::vector<std::vector<analyzer_shard_data_t *>> worker_tasks;
+    // Shards ordered by decreasing size.  Idle workers claim the next one, so
+    // that the large shards start first and the small ones fill the gaps.
+    std::vector<analyzer_shard_data_t *> shard_queue;
+    std::atomic<size_t> next_shard;
+    std::vector<analyzer_worker_data_t> worker_data;
+    // The trace entries are delivered to the tools in batches of this many, to
+    // amortize the cost of the virtual calls.
+    size_t memref_batch_size = 4096;
+    uint64_t skip_instrs = 0;
     int verbosity = 0;
     const char *output_prefix = "[analyzer]";
 };
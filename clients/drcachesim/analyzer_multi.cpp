@@ -50,6 +50,7 @@
 analyzer_multi_t::analyzer_multi_t()
 {
     worker_count = op_jobs.get_value();
+    skip_instrs = op_skip_instrs.get_value();
     // Initial measurements show it's sometimes faster to keep the parallel model
     // of using single-file readers but use them sequentially, as opposed to
     // the every-file interleaving reader, but the user can specify -jobs 1, so
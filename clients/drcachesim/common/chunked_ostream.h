@@ -0,0 +1,224 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* chunked_ostream_t: writes a trace file in the chunked format of chunked_trace.h,
+ * matching the parts of the std::ostream interface we use for raw2trace.
+ * Seeking is not supported.
+ */
+
+#ifndef _CHUNKED_OSTREAM_H_
+#define _CHUNKED_OSTREAM_H_ 1
+
+#ifndef HAS_ZLIB
+#    error HAS_ZLIB is required
+#endif
+#include <string.h>
+#include <fstream>
+#include <vector>
+#include <zlib.h>
+#include "chunked_trace.h"
+#include "trace_entry.h"
+
+/* As for gzip_streambuf_t, the writes go through a simple buffer.  When it is
+ * full, the complete entries are appended to the current chunk, which is
+ * compressed and written out once it reaches its size.
+ */
+class chunked_streambuf_t : public std::basic_streambuf<char, std::char_traits<char>> {
+public:
+    chunked_streambuf_t(const std::string &path, size_t chunk_entries_in)
+        : chunk_entries(chunk_entries_in)
+    {
+        file.open(path, std::ofstream::binary);
+        if (file) {
+            buf = new char[buffer_size];
+            // We leave an extra slot for extra_char on overflow.
+            setp(buf, buf + buffer_size - 1);
+            chunk.reserve(chunk_entries);
+        }
+    }
+    virtual ~chunked_streambuf_t() override
+    {
+        sync();
+        if (buf != nullptr)
+            finish();
+        delete[] buf;
+    }
+    virtual int
+    overflow(int extra_char) override
+    {
+        if (buf == nullptr)
+            return traits_type::eof();
+        if (extra_char != traits_type::eof()) {
+            // Put the extra char into the buffer.  We left an extra slot for it.
+            *pptr() = traits_type::to_char_type(extra_char);
+            pbump(1);
+        }
+        int res = traits_type::not_eof(extra_char);
+        if (pptr() > pbase() && !append(pbase(), pptr() - pbase()))
+            res = traits_type::eof();
+        setp(buf, buf + buffer_size - 1);
+        return res;
+    }
+    virtual int
+    sync() override
+    {
+        // The current chunk is only written once complete: sync just empties
+        // the buffer into it.
+        return overflow(traits_type::eof()) == traits_type::eof() ? -1 : 0;
+    }
+
+private:
+    bool
+    append(const char *data, size_t len)
+    {
+        // An entry may be split across two buffers: we complete it in partial.
+        while (len > 0) {
+            size_t take = sizeof(partial) - partial_size;
+            if (take > len)
+                take = len;
+            memcpy(reinterpret_cast<char *>(&partial) + partial_size, data, take);
+            partial_size += take;
+            data += take;
+            len -= take;
+            if (partial_size == sizeof(partial)) {
+                partial_size = 0;
+                if (!add_entry(partial))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    bool
+    add_entry(const trace_entry_t &entry)
+    {
+        trace_type_t type = static_cast<trace_type_t>(entry.type);
+        bool is_fetch = type_is_instr(type) && entry.size != 0;
+        // We cut before an instruction fetch, and only cut elsewhere if there is
+        // none for a long time.  We never cut before a bundle, which extends the
+        // instruction fetch before it.
+        if (chunk.size() >= chunk_entries &&
+            (is_fetch ||
+             (chunk.size() >= 2 * chunk_entries && type != TRACE_TYPE_INSTR_BUNDLE))) {
+            if (!write_chunk())
+                return false;
+        }
+        if (chunk.empty()) {
+            chunked_trace_chunk_t start = {};
+            start.entry_ordinal = entry_ordinal;
+            start.instr_ordinal = instr_ordinal;
+            start.timestamp = timestamp;
+            index.push_back(start);
+        }
+        chunk.push_back(entry);
+        ++entry_ordinal;
+        if (is_fetch)
+            ++instr_ordinal;
+        else if (type == TRACE_TYPE_INSTR_BUNDLE)
+            instr_ordinal += entry.size;
+        else if (type == TRACE_TYPE_MARKER && entry.size == TRACE_MARKER_TYPE_TIMESTAMP)
+            timestamp = entry.addr;
+        return true;
+    }
+
+    bool
+    write_chunk()
+    {
+        if (chunk.empty())
+            return true;
+        uLong src_size = static_cast<uLong>(chunk.size() * sizeof(trace_entry_t));
+        uLongf dst_size = compressBound(src_size);
+        compressed.resize(dst_size);
+        if (compress2(reinterpret_cast<Bytef *>(compressed.data()), &dst_size,
+                      reinterpret_cast<const Bytef *>(chunk.data()), src_size,
+                      Z_DEFAULT_COMPRESSION) != Z_OK)
+            return false;
+        chunked_trace_chunk_t &info = index.back();
+        info.offset = offset;
+        info.compressed_size = static_cast<uint32_t>(dst_size);
+        info.num_entries = static_cast<uint32_t>(chunk.size());
+        if (!file.write(compressed.data(), dst_size))
+            return false;
+        offset += dst_size;
+        chunk.clear();
+        return true;
+    }
+
+    void
+    finish()
+    {
+        // A partial entry at the end is dropped, as the readers would.
+        if (!write_chunk())
+            return;
+        chunked_trace_footer_t footer;
+        footer.index_offset = offset;
+        footer.num_chunks = index.size();
+        footer.version = CHUNKED_TRACE_VERSION;
+        footer.magic = CHUNKED_TRACE_MAGIC;
+        file.write(reinterpret_cast<const char *>(index.data()),
+                   index.size() * sizeof(index[0]));
+        file.write(reinterpret_cast<const char *>(&footer), sizeof(footer));
+        file.close();
+    }
+
+    static const int buffer_size = 4096;
+    std::ofstream file;
+    char *buf = nullptr;
+    size_t chunk_entries;
+    std::vector<trace_entry_t> chunk;
+    std::vector<char> compressed;
+    std::vector<chunked_trace_chunk_t> index;
+    trace_entry_t partial;
+    size_t partial_size = 0;
+    uint64_t offset = 0;
+    uint64_t entry_ordinal = 0;
+    uint64_t instr_ordinal = 0;
+    uint64_t timestamp = 0;
+};
+
+class chunked_ostream_t : public std::ostream {
+public:
+    explicit chunked_ostream_t(const std::string &path,
+                               size_t chunk_entries = CHUNKED_TRACE_DEFAULT_CHUNK_ENTRIES)
+        : std::ostream(new chunked_streambuf_t(path, chunk_entries))
+    {
+        if (!rdbuf())
+            setstate(std::ios::badbit);
+    }
+    virtual ~chunked_ostream_t() override
+    {
+        delete rdbuf();
+    }
+};
+
+#endif /* _CHUNKED_OSTREAM_H_ */
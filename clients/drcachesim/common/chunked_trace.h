@@ -0,0 +1,83 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* chunked_trace: the layout of chunked trace files, in which the entries of a
+ * thread are split into chunks compressed independently, followed by an index of
+ * the chunks.  A reader can decompress the chunks in parallel, and start at any
+ * chunk to seek into the trace.
+ */
+
+#ifndef _CHUNKED_TRACE_H_
+#define _CHUNKED_TRACE_H_ 1
+
+#include <stdint.h>
+
+/* A chunked trace file is made of:
+ * + The chunks, each a zlib stream of whole trace_entry_t entries.
+ * + The index: a chunked_trace_chunk_t per chunk, in file order.
+ * + The footer: a chunked_trace_footer_t, ending with CHUNKED_TRACE_MAGIC.
+ * The writer starts a chunk at an instruction fetch whenever possible, so the
+ * first instruction of a chunk does not depend on the entries before it.
+ */
+
+// "DRCHUNKS" when read as little-endian.
+#define CHUNKED_TRACE_MAGIC 0x534b4e5548435244ULL
+#define CHUNKED_TRACE_VERSION 1
+// The default number of entries per chunk: large enough to compress well, small
+// enough to keep a few chunks per thread decoded ahead.
+#define CHUNKED_TRACE_DEFAULT_CHUNK_ENTRIES (16 * 1024)
+
+struct chunked_trace_chunk_t {
+    // The ordinal in the file of the first entry of the chunk.
+    uint64_t entry_ordinal;
+    // The number of instructions before the chunk, counting each instruction
+    // fetch and each instruction of a bundle, as delivered by reader_t.
+    uint64_t instr_ordinal;
+    // The value of the last timestamp marker before the chunk, or 0.
+    uint64_t timestamp;
+    // The offset in the file of the compressed chunk.
+    uint64_t offset;
+    uint32_t compressed_size;
+    uint32_t num_entries;
+};
+
+struct chunked_trace_footer_t {
+    // The offset in the file of the index.
+    uint64_t index_offset;
+    uint64_t num_chunks;
+    uint64_t version;
+    // Last, so the format is identified from the end of the file.
+    uint64_t magic;
+};
+
+#endif /* _CHUNKED_TRACE_H_ */
@@ -315,6 +315,16 @@ droption_t<bytesize_t>
                  "in the beginning of the application execution. "
                  "These memory references are dropped instead of being simulated.");
 
+droption_t<bytesize_t> op_skip_instrs(
+    DROPTION_SCOPE_FRONTEND, "skip_instrs", 0,
+    "Number of instructions to skip in the analysis",
+    "Specifies the number of instructions to skip at the start of the trace before "
+    "the analysis tools see it.  When the trace is analyzed serially they are "
+    "counted in the interleaved trace of all threads, and when it is analyzed in "
+    "parallel in each thread file.  The trace readers of chunked files (see "
+    "-chunked in drraw2trace) seek straight to the instruction, while the others "
+    "read the trace up to it.");
+
 droption_t<bytesize_t> op_warmup_refs(
     DROPTION_SCOPE_FRONTEND, "warmup_refs", 0,
     "Number of memory references to warm caches up",
@@ -0,0 +1,370 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <zlib.h>
+#include "chunked_file_reader.h"
+
+// The most chunks of a file decoded ahead of the one being read.
+#define MAX_CHUNKS_AHEAD 4
+// The entries at the start of the first chunk that open_input_files() consumes:
+// the header, tid and pid.
+#define HEADER_ENTRIES 3
+
+namespace {
+
+// The threads decompressing the chunks of every chunked reader of the process.
+class decoder_pool_t {
+public:
+    static decoder_pool_t &
+    get()
+    {
+        static decoder_pool_t pool;
+        return pool;
+    }
+
+    std::future<std::vector<trace_entry_t>>
+    submit(std::packaged_task<std::vector<trace_entry_t>()> task)
+    {
+        std::future<std::vector<trace_entry_t>> res = task.get_future();
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            tasks.push_back(std::move(task));
+        }
+        cond.notify_one();
+        return res;
+    }
+
+    size_t
+    size() const
+    {
+        return workers.size();
+    }
+
+private:
+    decoder_pool_t()
+    {
+        unsigned int count = std::thread::hardware_concurrency();
+        if (count == 0)
+            count = 1;
+        for (unsigned int i = 0; i < count; ++i)
+            workers.push_back(std::thread(&decoder_pool_t::run, this));
+    }
+    ~decoder_pool_t()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            exiting = true;
+        }
+        cond.notify_all();
+        for (auto &worker : workers)
+            worker.join();
+    }
+
+    void
+    run()
+    {
+        while (true) {
+            std::packaged_task<std::vector<trace_entry_t>()> task;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                cond.wait(guard, [this] { return exiting || !tasks.empty(); });
+                if (exiting)
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::mutex lock;
+    std::condition_variable cond;
+    std::deque<std::packaged_task<std::vector<trace_entry_t>()>> tasks;
+    std::vector<std::thread> workers;
+    bool exiting = false;
+};
+
+// Returns the entries of the chunk, or an empty vector on a corrupted chunk.
+std::vector<trace_entry_t>
+decode_chunk(const std::vector<char> &compressed, uint32_t num_entries)
+{
+    std::vector<trace_entry_t> entries(num_entries);
+    uLongf size = static_cast<uLongf>(num_entries * sizeof(trace_entry_t));
+    if (uncompress(reinterpret_cast<Bytef *>(entries.data()), &size,
+                   reinterpret_cast<const Bytef *>(compressed.data()),
+                   static_cast<uLong>(compressed.size())) != Z_OK ||
+        size != num_entries * sizeof(trace_entry_t))
+        entries.clear();
+    return entries;
+}
+
+// Reads the index of the file, returning false if it is not a chunked trace.
+bool
+read_index(std::ifstream &stream, std::vector<chunked_trace_chunk_t> &index)
+{
+    chunked_trace_footer_t footer;
+    if (!stream.seekg(0, std::ios::end))
+        return false;
+    uint64_t size = static_cast<uint64_t>(stream.tellg());
+    if (size < sizeof(footer) ||
+        !stream.seekg(size - sizeof(footer)) ||
+        !stream.read(reinterpret_cast<char *>(&footer), sizeof(footer)) ||
+        footer.magic != CHUNKED_TRACE_MAGIC || footer.version != CHUNKED_TRACE_VERSION ||
+        footer.index_offset + footer.num_chunks * sizeof(chunked_trace_chunk_t) !=
+            size - sizeof(footer))
+        return false;
+    index.resize(static_cast<size_t>(footer.num_chunks));
+    return index.empty() ||
+        (stream.seekg(footer.index_offset) &&
+         stream.read(reinterpret_cast<char *>(index.data()),
+                     index.size() * sizeof(index[0])));
+}
+
+// Reads the compressed chunks following the ones already submitted, and submits
+// them for decoding until ahead chunks are in flight.
+bool
+submit_chunks(chunked_file_t *file, size_t ahead)
+{
+    while (file->decoding.size() < ahead && file->next_chunk < file->index.size()) {
+        const chunked_trace_chunk_t &chunk = file->index[file->next_chunk];
+        std::vector<char> compressed(chunk.compressed_size);
+        if (!file->stream.seekg(chunk.offset) ||
+            !file->stream.read(compressed.data(), compressed.size()))
+            return false;
+        std::packaged_task<std::vector<trace_entry_t>()> task(
+            std::bind(decode_chunk, std::move(compressed), chunk.num_entries));
+        file->decoding.push_back(decoder_pool_t::get().submit(std::move(task)));
+        ++file->next_chunk;
+    }
+    return true;
+}
+
+// Splits the decoding threads between the files, so that many files do not keep
+// many chunks decoded each.
+size_t
+chunks_ahead(size_t num_files)
+{
+    size_t ahead = 2 * decoder_pool_t::get().size() / num_files;
+    return std::max<size_t>(1, std::min<size_t>(MAX_CHUNKS_AHEAD, ahead));
+}
+
+} // namespace
+
+bool
+is_chunked_trace_file(const std::string &path)
+{
+    std::ifstream stream(path, std::ifstream::binary);
+    std::vector<chunked_trace_chunk_t> index;
+    return stream && read_index(stream, index);
+}
+
+/* clang-format off */ /* (make vera++ newline-after-type check happy) */
+template <>
+/* clang-format on */
+file_reader_t<chunked_file_t *>::~file_reader_t()
+{
+    // Chunks still being decoded complete into their futures' shared state, which
+    // outlives the file.
+    for (auto file : input_files)
+        delete file;
+    delete[] thread_eof;
+}
+
+template <>
+bool
+file_reader_t<chunked_file_t *>::open_single_file(const std::string &path)
+{
+    chunked_file_t *file = new chunked_file_t;
+    file->stream.open(path, std::ifstream::binary);
+    if (!file->stream || !read_index(file->stream, file->index)) {
+        delete file;
+        return false;
+    }
+    VPRINT(this, 1, "Opened input file %s (%zu chunks)\n", path.c_str(),
+           file->index.size());
+    input_files.push_back(file);
+    return true;
+}
+
+template <>
+trace_entry_t *
+file_reader_t<chunked_file_t *>::read_next_thread_entry_in_place(size_t thread_index,
+                                                                 OUT bool *eof)
+{
+    chunked_file_t *file = input_files[thread_index];
+    if (file->next_entry == file->entries.size()) {
+        // Move to the next chunk, submitting the following ones so they are
+        // decoded while this one is read.
+        size_t ahead = chunks_ahead(input_files.size());
+        if (!submit_chunks(file, ahead + 1)) {
+            ERRMSG("Failed to read chunk #%zu of input file #%zu\n", file->next_chunk,
+                   thread_index);
+            *eof = false;
+            return nullptr;
+        }
+        if (file->decoding.empty()) {
+            *eof = true;
+            return nullptr;
+        }
+        file->entries = file->decoding.front().get();
+        file->decoding.pop_front();
+        file->next_entry = 0;
+        if (file->entries.empty()) {
+            ERRMSG("Failed to decompress a chunk of input file #%zu\n", thread_index);
+            *eof = false;
+            return nullptr;
+        }
+        if (!submit_chunks(file, ahead)) {
+            *eof = false;
+            return nullptr;
+        }
+    }
+    trace_entry_t *entry = &file->entries[file->next_entry++];
+    VPRINT(this, 4, "Read from thread #%zd file: type=%d, size=%d, addr=%zu\n",
+           thread_index, entry->type, entry->size, entry->addr);
+    return entry;
+}
+
+template <>
+bool
+file_reader_t<chunked_file_t *>::read_next_thread_entry(size_t thread_index,
+                                                        OUT trace_entry_t *entry,
+                                                        OUT bool *eof)
+{
+    trace_entry_t *next = read_next_thread_entry_in_place(thread_index, eof);
+    if (next == nullptr)
+        return false;
+    *entry = *next;
+    return true;
+}
+
+template <>
+bool
+file_reader_t<chunked_file_t *>::is_complete()
+{
+    // As for file_reader_t<std::ifstream *>, we support a single file opened
+    // temporarily before init(), for analyzer_multi.
+    bool opened_temporarily = false;
+    if (input_files.empty()) {
+        opened_temporarily = true;
+        if (!input_path_list.empty() || input_path.empty() ||
+            directory_iterator_t::is_directory(input_path))
+            return false; // Not supported.
+        if (!open_single_file(input_path))
+            return false;
+    }
+    bool res = false;
+    for (auto file : input_files) {
+        // The last entry is in the last chunk, which we decode here.
+        res = false;
+        if (file->index.empty())
+            break;
+        const chunked_trace_chunk_t &chunk = file->index.back();
+        std::vector<char> compressed(chunk.compressed_size);
+        if (!file->stream.seekg(chunk.offset) ||
+            !file->stream.read(compressed.data(), compressed.size()))
+            break;
+        std::vector<trace_entry_t> entries = decode_chunk(compressed, chunk.num_entries);
+        res = !entries.empty() && entries.back().type == TRACE_TYPE_FOOTER;
+        if (!res)
+            break;
+    }
+    if (opened_temporarily) {
+        // Put things back for init().
+        for (auto file : input_files)
+            delete file;
+        input_files.clear();
+    }
+    return res;
+}
+
+template <>
+bool
+file_reader_t<chunked_file_t *>::seek_to_instruction(uint64_t ordinal)
+{
+    // With several threads, the instruction ordinals of the interleaved stream
+    // depend on the whole merge, so we only seek in a single thread file.
+    if (input_files.size() != 1) {
+        VPRINT(this, 1, "Seeking is only supported in a single thread file\n");
+        return false;
+    }
+    chunked_file_t *file = input_files[0];
+    if (file->index.empty())
+        return false;
+    // Start from the last chunk beginning at or before the instruction.
+    auto chunk = std::upper_bound(file->index.begin(), file->index.end(), ordinal,
+                                  [](uint64_t value, const chunked_trace_chunk_t &c) {
+                                      return value < c.instr_ordinal;
+                                  });
+    if (chunk != file->index.begin())
+        --chunk;
+    VPRINT(this, 2, "Seeking to instruction %llu from chunk #%zu\n",
+           (unsigned long long)ordinal, (size_t)(chunk - file->index.begin()));
+    // The chunks decoded ahead are dropped: their tasks finish on their own.
+    file->decoding.clear();
+    file->entries.clear();
+    file->next_entry = 0;
+    file->next_chunk = chunk - file->index.begin();
+    if (file->next_chunk == 0) {
+        // Skip the entries open_input_files() consumed.
+        bool eof;
+        for (int i = 0; i < HEADER_ENTRIES; ++i) {
+            if (read_next_thread_entry_in_place(0, &eof) == nullptr)
+                return false;
+        }
+    }
+    // Resume the merge from the start of the chunk, then step to the instruction.
+    queues[0] = std::queue<trace_entry_t>();
+    next_times = decltype(next_times)();
+    merge_started = true;
+    thread_count = 1;
+    thread_eof[0] = false;
+    times[0] = 0;
+    index = 0;
+    at_eof = false;
+    reset_input_entry();
+    uint64_t count = chunk->instr_ordinal;
+    for (++*this; !at_eof; ++*this) {
+        if (type_is_instr((**this).data.type)) {
+            if (count == ordinal)
+                return true;
+            ++count;
+        }
+    }
+    return false;
+}
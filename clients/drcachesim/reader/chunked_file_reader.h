@@ -1,5 +1,5 @@
 /* **********************************************************
- * Copyright (c) 2015 Google, Inc.  All rights reserved.
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
  * **********************************************************/
 
 /*
@@ -30,21 +30,47 @@
  * DAMAGE.
  */
 
-/* tlb_entry: represents a TLB entry.
- */
 
-#ifndef _TLB_ENTRY_H_
-#define _TLB_ENTRY_H_ 1
+/* chunked_file_reader: reads trace files in the chunked format of chunked_trace.h.
+ * The chunks are decompressed ahead of the reads by a pool of threads shared by
+ * all the readers of the process, and the index of each file is used to seek.
+ */
 
-#include "caching_device_block.h"
+#ifndef _CHUNKED_FILE_READER_H_
+#define _CHUNKED_FILE_READER_H_ 1
 
-class tlb_entry_t : public caching_device_block_t {
-public:
-    // process ID to differentiate virtual pages
-    // that have the same VPN but belong to different processes.
-    memref_pid_t pid;
+#include <deque>
+#include <fstream>
+#include <future>
+#include <vector>
+#include "chunked_trace.h"
+#include "file_reader.h"
 
-    // XXX: support page privilege and MMU-related exceptions
+struct chunked_file_t {
+    std::ifstream stream;
+    std::vector<chunked_trace_chunk_t> index;
+    // The chunks submitted for decoding, in file order.
+    std::deque<std::future<std::vector<trace_entry_t>>> decoding;
+    // The index of the next chunk to submit.
+    size_t next_chunk = 0;
+    // The decoded chunk being read.
+    std::vector<trace_entry_t> entries;
+    size_t next_entry = 0;
 };
 
-#endif /* _TLB_ENTRY_H_ */
+typedef file_reader_t<chunked_file_t *> chunked_file_reader_t;
+
+template <>
+trace_entry_t *
+file_reader_t<chunked_file_t *>::read_next_thread_entry_in_place(size_t thread_index,
+                                                                 OUT bool *eof);
+
+template <>
+bool
+file_reader_t<chunked_file_t *>::seek_to_instruction(uint64_t ordinal);
+
+// Returns whether the file at path is in the chunked format.
+bool
+is_chunked_trace_file(const std::string &path);
+
+#endif /* _CHUNKED_FILE_READER_H_ */
@@ -70,6 +70,25 @@ file_reader_t<gzFile>::read_next_thread_entry(size_t thread_index,
     return true;
 }
 
+template <>
+size_t
+file_reader_t<gzFile>::read_next_thread_block(size_t thread_index,
+                                              OUT trace_entry_t *buffer,
+                                              size_t max_entries, OUT bool *eof)
+{
+    int len = gzread(input_files[thread_index], (char *)buffer,
+                     (unsigned int)(max_entries * sizeof(*buffer)));
+    // Returns less than asked-for for end of file, or –1 for error.
+    // A partial entry at the end is dropped, as in read_next_thread_entry().
+    if (len < (int)sizeof(*buffer)) {
+        *eof = (len >= 0);
+        return 0;
+    }
+    VPRINT(this, 4, "Read %zu entries from thread #%zd file\n",
+           len / sizeof(*buffer), thread_index);
+    return len / sizeof(*buffer);
+}
+
 template <>
 bool
 file_reader_t<gzFile>::is_complete()
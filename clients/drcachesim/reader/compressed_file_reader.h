@@ -40,4 +40,10 @@
 
 typedef file_reader_t<gzFile> compressed_file_reader_t;
 
+template <>
+size_t
+file_reader_t<gzFile>::read_next_thread_block(size_t thread_index,
+                                              OUT trace_entry_t *buffer,
+                                              size_t max_entries, OUT bool *eof);
+
 #endif /* _COMPRESSED_FILE_READER_H_ */
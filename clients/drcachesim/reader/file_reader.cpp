@@ -71,6 +71,22 @@ file_reader_t<std::ifstream *>::read_next_thread_entry(size_t thread_index,
     return true;
 }
 
+template <>
+size_t
+file_reader_t<std::ifstream *>::read_next_thread_block(size_t thread_index,
+                                                       OUT trace_entry_t *buffer,
+                                                       size_t max_entries, OUT bool *eof)
+{
+    std::ifstream *fstream = input_files[thread_index];
+    fstream->read((char *)buffer, max_entries * sizeof(*buffer));
+    // A partial entry at the end is dropped, as in read_next_thread_entry().
+    size_t count = static_cast<size_t>(fstream->gcount()) / sizeof(*buffer);
+    if (count == 0)
+        *eof = fstream->eof();
+    VPRINT(this, 4, "Read %zu entries from thread #%zd file\n", count, thread_index);
+    return count;
+}
+
 template <>
 bool
 file_reader_t<std::ifstream *>::is_complete()
@@ -40,7 +40,9 @@
 
 #include <string.h>
 #include <fstream>
+#include <functional>
 #include <queue>
+#include <utility>
 #include <vector>
 #include "reader.h"
 #include "memref.h"
@@ -97,10 +99,54 @@ public:
     virtual bool
     is_complete();
 
+    // File types with an index of their contents specialize this.
+    virtual bool
+    seek_to_instruction(uint64_t ordinal)
+    {
+        return false;
+    }
+
 protected:
     virtual bool
     read_next_thread_entry(size_t thread_index, OUT trace_entry_t *entry, OUT bool *eof);
 
+    // Reads up to max_entries entries of the thread into buffer, returning how many
+    // were read: 0 on eof or error.  File types can specialize this to read the
+    // whole block at once.
+    virtual size_t
+    read_next_thread_block(size_t thread_index, OUT trace_entry_t *buffer,
+                           size_t max_entries, OUT bool *eof)
+    {
+        size_t count = 0;
+        while (count < max_entries &&
+               read_next_thread_entry(thread_index, &buffer[count], eof))
+            ++count;
+        return count;
+    }
+
+    // Returns the next entry of the thread, which remains valid until the next call,
+    // or nullptr on eof or error.  The entries are read in blocks into a buffer per
+    // thread, unless the file type specializes this to hand out entries in place.
+    virtual trace_entry_t *
+    read_next_thread_entry_in_place(size_t thread_index, OUT bool *eof)
+    {
+        thread_buffer_t &buffer = buffers[thread_index];
+        if (buffer.next == buffer.count) {
+            if (buffer.entries.empty())
+                buffer.entries.resize(THREAD_BUFFER_ENTRIES);
+            // The eof is only reported once the buffered entries are consumed.
+            bool at_end = false;
+            buffer.next = 0;
+            buffer.count = read_next_thread_block(thread_index, buffer.entries.data(),
+                                                  buffer.entries.size(), &at_end);
+            if (buffer.count == 0) {
+                *eof = at_end;
+                return nullptr;
+            }
+        }
+        return &buffer.entries[buffer.next++];
+    }
+
     virtual bool
     open_single_file(const std::string &path);
 
@@ -149,6 +195,7 @@ protected:
         tids.resize(input_files.size());
         timestamps.resize(input_files.size());
         times.resize(input_files.size(), 0);
+        buffers.resize(input_files.size());
         // We can't take the address of a vector<bool> element so we use a raw array.
         thread_eof = new bool[input_files.size()];
         memset(thread_eof, 0, input_files.size() * sizeof(*thread_eof));
@@ -190,15 +237,21 @@ protected:
         // eof.
         while (thread_count > 0) {
             if (index >= input_files.size()) {
-                // Pick the next thread by looking for the smallest timestamp.
-                uint64_t min_time = 0xffffffffffffffff;
-                size_t next_index = 0;
-                for (size_t i = 0; i < times.size(); ++i) {
-                    if (times[i] == 0 && !thread_eof[i]) {
-                        if (!read_next_thread_entry(i, &timestamps[i], &thread_eof[i])) {
+                // The first time, read the first timestamp of every thread.  After
+                // that, a thread is pushed back into next_times as soon as we reach
+                // its next timestamp, so the threads not at eof are all there.
+                if (!merge_started) {
+                    merge_started = true;
+                    for (size_t i = 0; i < times.size(); ++i) {
+                        if (thread_eof[i])
+                            continue;
+                        trace_entry_t *entry =
+                            read_next_thread_entry_in_place(i, &thread_eof[i]);
+                        if (entry == nullptr) {
                             ERRMSG("Failed to read from input file #%zu\n", i);
                             return nullptr;
                         }
+                        timestamps[i] = *entry;
                         if (timestamps[i].type != TRACE_TYPE_MARKER &&
                             timestamps[i].size != TRACE_MARKER_TYPE_TIMESTAMP) {
                             ERRMSG("Missing timestamp entry in input file #%zu\n", i);
@@ -208,12 +261,18 @@ protected:
                         VPRINT(this, 3,
                                "Thread #%zu timestamp is @0x" ZHEX64_FORMAT_STRING "\n",
                                i, times[i]);
+                        // A zero timestamp is pushed too: it just comes first.
+                        next_times.push(std::make_pair(times[i], i));
                     }
-                    if (times[i] != 0 && times[i] < min_time) {
-                        min_time = times[i];
-                        next_index = i;
-                    }
                 }
+                if (next_times.empty()) {
+                    ERRMSG("No thread left with a timestamp\n");
+                    return nullptr;
+                }
+                // Pick the next thread with the smallest timestamp, the lowest
+                // index first among equal timestamps.
+                size_t next_index = next_times.top().second;
+                next_times.pop();
                 VPRINT(this, 2,
                        "Next thread in timestamp order is #%zu @0x" ZHEX64_FORMAT_STRING
                        "\n",
@@ -235,7 +294,9 @@ protected:
                 return &entry_copy;
             }
             VPRINT(this, 4, "About to read thread #%zu\n", index);
-            if (!read_next_thread_entry(index, &entry_copy, &thread_eof[index])) {
+            trace_entry_t *entry =
+                read_next_thread_entry_in_place(index, &thread_eof[index]);
+            if (entry == nullptr) {
                 if (thread_eof[index]) {
                     VPRINT(this, 2, "Thread #%zu at eof\n", index);
                     --thread_count;
@@ -252,16 +313,17 @@ protected:
                     return nullptr;
                 }
             }
-            if (entry_copy.type == TRACE_TYPE_MARKER &&
-                entry_copy.size == TRACE_MARKER_TYPE_TIMESTAMP) {
+            if (entry->type == TRACE_TYPE_MARKER &&
+                entry->size == TRACE_MARKER_TYPE_TIMESTAMP) {
                 VPRINT(this, 3, "Thread #%zu timestamp 0x" ZHEX64_FORMAT_STRING "\n",
-                       index, (uint64_t)entry_copy.addr);
-                times[index] = entry_copy.addr;
-                timestamps[index] = entry_copy;
+                       index, (uint64_t)entry->addr);
+                times[index] = entry->addr;
+                timestamps[index] = *entry;
+                next_times.push(std::make_pair(times[index], index));
                 index = input_files.size(); // Request thread scan.
                 continue;
             }
-            return &entry_copy;
+            return entry;
         }
         return nullptr;
     }
@@ -279,7 +341,27 @@ private:
     std::vector<trace_entry_t> tids;
     std::vector<trace_entry_t> timestamps;
     std::vector<uint64_t> times;
+    // The threads waiting for their turn, keyed by their next timestamp.
+    std::priority_queue<std::pair<uint64_t, size_t>,
+                        std::vector<std::pair<uint64_t, size_t>>,
+                        std::greater<std::pair<uint64_t, size_t>>>
+        next_times;
+    bool merge_started = false;
     bool *thread_eof = nullptr;
+    // Entries read ahead from each thread file.
+    struct thread_buffer_t {
+        std::vector<trace_entry_t> entries;
+        size_t next = 0;
+        size_t count = 0;
+    };
+    static const size_t THREAD_BUFFER_ENTRIES = 1024;
+    std::vector<thread_buffer_t> buffers;
 };
 
+template <>
+size_t
+file_reader_t<std::ifstream *>::read_next_thread_block(size_t thread_index,
+                                                       OUT trace_entry_t *buffer,
+                                                       size_t max_entries, OUT bool *eof);
+
 #endif /* _FILE_READER_H_ */
@@ -0,0 +1,177 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "mmap_file_reader.h"
+
+// The size of the chunks of the file requested ahead of the entries being read.
+#define READ_AHEAD_BYTES (8 * 1024 * 1024)
+
+/* clang-format off */ /* (make vera++ newline-after-type check happy) */
+template <>
+/* clang-format on */
+file_reader_t<mapped_file_t *>::~file_reader_t()
+{
+    for (auto file : input_files) {
+        if (file->base != nullptr)
+            munmap(file->base, file->size);
+        delete file;
+    }
+    delete[] thread_eof;
+}
+
+template <>
+bool
+file_reader_t<mapped_file_t *>::open_single_file(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return false;
+    }
+    mapped_file_t *file = new mapped_file_t;
+    file->size = static_cast<size_t>(st.st_size);
+    file->base = nullptr;
+    if (file->size > 0) {
+        file->base =
+            mmap(nullptr, file->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    // The mapping keeps its own reference to the file.
+    close(fd);
+    if (file->base == MAP_FAILED) {
+        delete file;
+        return false;
+    }
+    // A partial entry at the end is not handed out: it is reported as an error
+    // once the complete entries before it have been read.
+    file->cur = reinterpret_cast<trace_entry_t *>(file->base);
+    file->end = file->cur + file->size / sizeof(trace_entry_t);
+    file->advised_end = file->cur;
+    if (file->base != nullptr)
+        madvise(file->base, file->size, MADV_SEQUENTIAL);
+    VPRINT(this, 1, "Mapped input file %s (%zu bytes)\n", path.c_str(), file->size);
+    input_files.push_back(file);
+    return true;
+}
+
+template <>
+trace_entry_t *
+file_reader_t<mapped_file_t *>::read_next_thread_entry_in_place(size_t thread_index,
+                                                                OUT bool *eof)
+{
+    mapped_file_t *file = input_files[thread_index];
+    if (file->cur >= file->end) {
+        if (file->size % sizeof(trace_entry_t) != 0) {
+            ERRMSG("Input file #%zu ends with a partial entry of %zu bytes\n",
+                   thread_index, file->size % sizeof(trace_entry_t));
+            *eof = false;
+            return nullptr;
+        }
+        *eof = true;
+        return nullptr;
+    }
+    const size_t chunk_entries = READ_AHEAD_BYTES / sizeof(trace_entry_t);
+    if (file->advised_end < file->end &&
+        static_cast<size_t>(file->advised_end - file->cur) < chunk_entries) {
+        // Keep one to two chunks requested ahead of the entries we hand out, so
+        // they are read while the previous ones are processed.  An entry may
+        // straddle the page boundary: madvise needs the start rounded down.
+        trace_entry_t *start = file->advised_end;
+        size_t entries = file->end - start;
+        if (entries > chunk_entries)
+            entries = chunk_entries;
+        file->advised_end = start + entries;
+        uintptr_t page_start =
+            reinterpret_cast<uintptr_t>(start) & ~(uintptr_t)(getpagesize() - 1);
+        madvise(reinterpret_cast<void *>(page_start),
+                reinterpret_cast<uintptr_t>(file->advised_end) - page_start,
+                MADV_WILLNEED);
+    }
+    trace_entry_t *entry = file->cur++;
+    VPRINT(this, 4, "Read from thread #%zd file: type=%d, size=%d, addr=%zu\n",
+           thread_index, entry->type, entry->size, entry->addr);
+    return entry;
+}
+
+template <>
+bool
+file_reader_t<mapped_file_t *>::read_next_thread_entry(size_t thread_index,
+                                                       OUT trace_entry_t *entry,
+                                                       OUT bool *eof)
+{
+    trace_entry_t *next = read_next_thread_entry_in_place(thread_index, eof);
+    if (next == nullptr)
+        return false;
+    *entry = *next;
+    return true;
+}
+
+template <>
+bool
+file_reader_t<mapped_file_t *>::is_complete()
+{
+    // As for file_reader_t<std::ifstream *>, we support a single file opened
+    // temporarily before init(), for analyzer_multi.
+    bool opened_temporarily = false;
+    if (input_files.empty()) {
+        opened_temporarily = true;
+        if (!input_path_list.empty() || input_path.empty() ||
+            directory_iterator_t::is_directory(input_path))
+            return false; // Not supported.
+        if (!open_single_file(input_path))
+            return false;
+    }
+    bool res = false;
+    for (auto file : input_files) {
+        res = file->end > file->cur && file->size % sizeof(trace_entry_t) == 0 &&
+            (file->end - 1)->type == TRACE_TYPE_FOOTER;
+        if (!res)
+            break;
+    }
+    if (opened_temporarily) {
+        // Put things back for init().
+        for (auto file : input_files) {
+            if (file->base != nullptr)
+                munmap(file->base, file->size);
+            delete file;
+        }
+        input_files.clear();
+    }
+    return res;
+}
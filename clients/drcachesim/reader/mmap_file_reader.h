@@ -1,5 +1,5 @@
 /* **********************************************************
- * Copyright (c) 2015 Google, Inc.  All rights reserved.
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
  * **********************************************************/
 
 /*
@@ -30,22 +30,34 @@
  * DAMAGE.
  */
 
-/* cache_line: represents a cache line.
- */
-
-#ifndef _CACHE_LINE_H_
-#define _CACHE_LINE_H_ 1
 
-#include "caching_device_block.h"
+/* mmap_file_reader: reads uncompressed files containing memory traces by mapping
+ * them into memory and handing out the entries in place, without copying them.
+ */
 
-class cache_line_t : public caching_device_block_t {
+#ifndef _MMAP_FILE_READER_H_
+#define _MMAP_FILE_READER_H_ 1
+
+#include "file_reader.h"
+
+// A trace file mapped into memory.  The mapping is private and writable because
+// reader_t rewrites the type of some entries: the pages it writes to are copied on
+// write, and the file is never modified.
+struct mapped_file_t {
+    trace_entry_t *cur;
+    trace_entry_t *end;
+    // The read-ahead is requested from the kernel in chunks: this is the end of
+    // the part requested so far.
+    trace_entry_t *advised_end;
+    void *base;
+    size_t size;
+};
 
-    // Currently, "cache_line_t" is identical to caching_device_block_t; however,
-    // cache_line_t is probably to be extended to have distinct member variables
-    // and functions, e.g., coherency-related ones. Therefore, it is
-    // reasonable to keep two identical classes now rather than use one instead.
+typedef file_reader_t<mapped_file_t *> mmap_file_reader_t;
 
-    // FIXME i#1726: implement cache coherency protocols
-};
+template <>
+trace_entry_t *
+file_reader_t<mapped_file_t *>::read_next_thread_entry_in_place(size_t thread_index,
+                                                                OUT bool *eof);
 
-#endif /* _CACHE_LINE_H_ */
+#endif /* _MMAP_FILE_READER_H_ */
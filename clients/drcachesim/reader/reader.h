@@ -103,6 +103,15 @@ public:
         return false;
     }
 
+    // Moves to the instruction with the given ordinal, counting from 0 every
+    // instruction memref delivered, so that it becomes the current memref.  Returns
+    // false if the trace ends before it, or if the reader does not support seeking.
+    virtual bool
+    seek_to_instruction(uint64_t ordinal)
+    {
+        return false;
+    }
+
     // We do not support the post-increment operator for two reasons:
     // 1) It prevents pure virtual functions here, as it cannot
     //    return an abstract type;
@@ -130,6 +139,15 @@ protected:
     int verbosity = 0;
     const char *output_prefix = "[reader]";
 
+    // For seeking subclasses: drops the entry being processed, so the next
+    // operator++ starts from a new entry.
+    void
+    reset_input_entry()
+    {
+        input_entry = nullptr;
+        bundle_idx = 0;
+    }
+
 private:
     trace_entry_t *input_entry = nullptr;
     memref_t cur_ref;
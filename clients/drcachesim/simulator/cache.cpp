@@ -52,9 +52,8 @@ cache_t::init(int associativity_, int line_size_, int total_size,
 void
 cache_t::init_blocks()
 {
-    for (int i = 0; i < num_blocks; i++) {
-        blocks[i] = new cache_line_t;
-    }
+    // Cache lines have no state besides the tag and the replacement counter.
+    // FIXME i#1726: implement cache coherency protocols
 }
 
 void
@@ -74,12 +73,11 @@ cache_t::flush(const memref_t &memref)
     last_tag = TAG_INVALID;
     for (; tag <= final_tag; ++tag) {
         int block_idx = compute_block_idx(tag);
-        for (int way = 0; way < associativity; ++way) {
-            if (get_caching_device_block(block_idx, way).tag == tag) {
-                get_caching_device_block(block_idx, way).tag = TAG_INVALID;
-                // Xref cache_block_t constructor about why we set counter to 0.
-                get_caching_device_block(block_idx, way).counter = 0;
-            }
+        int way = find_way(block_idx, tag);
+        if (way != associativity) {
+            get_tag(block_idx, way) = TAG_INVALID;
+            // Xref caching_device_t::init about why we set counter to 0.
+            get_counter(block_idx, way) = 0;
         }
     }
     // We flush parent's code cache here.
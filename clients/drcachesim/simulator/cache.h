@@ -37,7 +37,6 @@
 #define _CACHE_H_ 1
 
 #include "caching_device.h"
-#include "cache_line.h"
 #include "cache_stats.h"
 
 class cache_t : public caching_device_t {
@@ -38,6 +38,13 @@
 
 #include <vector>
 
+#if defined(X86) && defined(X64)
+#    include <emmintrin.h>
+#    ifdef __AVX2__
+#        include <immintrin.h>
+#    endif
+#endif
+
 #include "caching_device_block.h"
 #include "caching_device_stats.h"
 #include "memref.h"
@@ -116,12 +123,64 @@ protected:
     {
         return (tag & blocks_per_set_mask) << assoc_bits;
     }
-    inline caching_device_block_t &
-    get_caching_device_block(int block_idx, int way)
+    inline addr_t &
+    get_tag(int block_idx, int way)
+    {
+        return tags[block_idx + way];
+    }
+    inline int &
+    get_counter(int block_idx, int way)
+    {
+        return counters[block_idx + way];
+    }
+    // Returns the way of the set starting at block_idx holding tag, or
+    // associativity if there is none.
+    inline int
+    find_way(int block_idx, addr_t tag) const
     {
-        return *(blocks[block_idx + way]);
+        const addr_t *set = &tags[block_idx];
+        int way = 0;
+#if defined(X86) && defined(X64)
+#    ifdef __AVX2__
+        if (associativity >= 4) {
+            const __m256i key = _mm256_set1_epi64x((long long)tag);
+            for (; way < associativity; way += 4) {
+                __m256i ways = _mm256_loadu_si256((const __m256i *)(set + way));
+                if (_mm256_movemask_epi8(_mm256_cmpeq_epi64(ways, key)) != 0)
+                    break;
+            }
+            if (way == associativity)
+                return associativity;
+            // The tags of a set are unique: find which of the 4 matched.
+            for (;; ++way) {
+                if (set[way] == tag)
+                    return way;
+            }
+        }
+#    endif
+        // SSE2 has no 64-bit compare: a tag matches when both of its 32-bit
+        // halves do, i.e., when both bits of its half in the mask are set.
+        if (associativity >= 2) {
+            const __m128i key = _mm_set1_epi64x((long long)tag);
+            for (; way < associativity; way += 2) {
+                __m128i ways = _mm_loadu_si128((const __m128i *)(set + way));
+                int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(ways, key)));
+                if ((mask & 0x3) == 0x3)
+                    return way;
+                if ((mask & 0xc) == 0xc)
+                    return way + 1;
+            }
+            return associativity;
+        }
+#endif
+        for (; way < associativity; ++way) {
+            if (set[way] == tag)
+                break;
+        }
+        return way;
     }
-    // a pure virtual function for subclasses to initialize their own block array
+    // A pure virtual function for subclasses to initialize the state they keep
+    // per block, in arrays parallel to tags and counters.
     virtual void
     init_blocks() = 0;
 
@@ -144,10 +203,15 @@ protected:
     // If true, this device is inclusive of its children.
     bool inclusive;
 
-    // This should be an array of caching_device_block_t pointers, otherwise
-    // an extended block class which has its own member variables cannot be indexed
-    // correctly by base class pointers.
-    caching_device_block_t **blocks;
+    // The block state is stored as structure of arrays indexed by block_idx + way,
+    // so the tags of a set are contiguous and can be compared at once, without
+    // touching the replacement state. Subclasses needing more state per block
+    // keep it in their own parallel arrays, sized in init_blocks().
+    std::vector<addr_t> tags;
+    // For use by replacement policies.
+    // XXX: using int_least64_t here results in a ~4% slowdown for 32-bit apps.
+    // A 32-bit counter should be sufficient but we may want to revisit.
+    std::vector<int> counters;
     int blocks_per_set;
     // Optimization fields for fast bit operations
     int blocks_per_set_mask;
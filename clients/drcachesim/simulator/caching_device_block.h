@@ -30,13 +30,13 @@
  * DAMAGE.
  */
 
-/* caching_device_block: represents a unit block of a caching device.
+/* caching_device_block: definitions for the unit blocks of a caching device.
+ * The blocks themselves are stored by caching_device_t as parallel arrays.
  */
 
 #ifndef _CACHING_DEVICE_BLOCK_H_
 #define _CACHING_DEVICE_BLOCK_H_ 1
 
-#include <stdint.h>
 #include "memref.h"
 
 // Assuming a block of a caching device represents a memory space of at least 4-byte,
@@ -45,28 +45,4 @@
 // block status.
 static const addr_t TAG_INVALID = (addr_t)-1; // block is invalid
 
-class caching_device_block_t {
-public:
-    // Initializing counter to 0 is just to be safe and to make it easier to write new
-    // replacement algorithms without errors (and we expect negligible perf cost), as
-    // we expect any use of counter to only occur *after* a valid tag is put in place,
-    // where for the current replacement code we also set the counter at that time.
-    caching_device_block_t()
-        : tag(TAG_INVALID)
-        , counter(0)
-    {
-    }
-    // Destructor must be virtual and default is not.
-    virtual ~caching_device_block_t()
-    {
-    }
-
-    addr_t tag;
-
-    // XXX: using int_least64_t here results in a ~4% slowdown for 32-bit apps.
-    // A 32-bit counter should be sufficient but we may want to revisit.
-    // We already have stdint.h so we can reinstate int_least64_t easily.
-    int counter; // for use by replacement policies
-};
-
 #endif /* _CACHING_DEVICE_BLOCK_H_ */
@@ -78,8 +78,7 @@ caching_device_stats_t::~caching_device_stats_t()
 }
 
 void
-caching_device_stats_t::access(const memref_t &memref, bool hit,
-                               caching_device_block_t *cache_block)
+caching_device_stats_t::access(const memref_t &memref, bool hit)
 {
     // We assume we're single-threaded.
     // We're only computing miss rate so we just inc counters here.
@@ -93,8 +92,7 @@ caching_device_stats_t::access(const memref_t &memref, bool hit,
 }
 
 void
-caching_device_stats_t::child_access(const memref_t &memref, bool hit,
-                                     caching_device_block_t *cache_block)
+caching_device_stats_t::child_access(const memref_t &memref, bool hit)
 {
     if (hit)
         num_child_hits++;
@@ -60,11 +60,11 @@ public:
     // A multi-block memory reference invokes this routine
     // separately for each block touched.
     virtual void
-    access(const memref_t &memref, bool hit, caching_device_block_t *cache_block);
+    access(const memref_t &memref, bool hit);
 
     // Called on each access by a child caching device.
     virtual void
-    child_access(const memref_t &memref, bool hit, caching_device_block_t *cache_block);
+    child_access(const memref_t &memref, bool hit);
 
     virtual void
     print_stats(std::string prefix);
@@ -37,9 +37,7 @@
 void
 tlb_t::init_blocks()
 {
-    for (int i = 0; i < num_blocks; i++) {
-        blocks[i] = new tlb_entry_t;
-    }
+    pids.assign(num_blocks, 0);
 }
 
 void
@@ -64,13 +62,11 @@ tlb_t::request(const memref_t &memref_in)
     // Optimization: check last tag and pid if single-block
     if (tag == final_tag && tag == last_tag && pid == last_pid) {
         // Make sure last_tag and pid are properly in sync.
-        caching_device_block_t *tlb_entry =
-            &get_caching_device_block(last_block_idx, last_way);
-        assert(tag != TAG_INVALID && tag == tlb_entry->tag &&
-               pid == ((tlb_entry_t *)tlb_entry)->pid);
-        stats->access(memref_in, true /*hit*/, tlb_entry);
+        assert(tag != TAG_INVALID && tag == get_tag(last_block_idx, last_way) &&
+               pid == pids[last_block_idx + last_way]);
+        stats->access(memref_in, true /*hit*/);
         if (parent != NULL)
-            parent->get_stats()->child_access(memref_in, true, tlb_entry);
+            parent->get_stats()->child_access(memref_in, true);
         access_update(last_block_idx, last_way);
         return;
     }
@@ -83,31 +79,31 @@ tlb_t::request(const memref_t &memref_in)
         if (tag + 1 <= final_tag)
             memref.data.size = ((tag + 1) << block_size_bits) - memref.data.addr;
 
+        // The same tag can be held by several processes, so we can't stop at
+        // the first way find_way() returns.
         for (way = 0; way < associativity; ++way) {
-            caching_device_block_t *tlb_entry = &get_caching_device_block(block_idx, way);
-            if (tlb_entry->tag == tag && ((tlb_entry_t *)tlb_entry)->pid == pid) {
-                stats->access(memref, true /*hit*/, tlb_entry);
+            if (get_tag(block_idx, way) == tag && pids[block_idx + way] == pid) {
+                stats->access(memref, true /*hit*/);
                 if (parent != NULL)
-                    parent->get_stats()->child_access(memref, true, tlb_entry);
+                    parent->get_stats()->child_access(memref, true);
                 break;
             }
         }
 
         if (way == associativity) {
             way = replace_which_way(block_idx);
-            caching_device_block_t *tlb_entry = &get_caching_device_block(block_idx, way);
 
-            stats->access(memref, false /*miss*/, tlb_entry);
+            stats->access(memref, false /*miss*/);
             // If no parent we assume we get the data from main memory
             if (parent != NULL) {
-                parent->get_stats()->child_access(memref, false, tlb_entry);
+                parent->get_stats()->child_access(memref, false);
                 parent->request(memref);
             }
 
             // XXX: do we need to handle TLB coherency?
 
-            tlb_entry->tag = tag;
-            ((tlb_entry_t *)tlb_entry)->pid = pid;
+            get_tag(block_idx, way) = tag;
+            pids[block_idx + way] = pid;
         }
 
         access_update(block_idx, way);
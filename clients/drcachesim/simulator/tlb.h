@@ -37,7 +37,6 @@
 #define _TLB_H_ 1
 
 #include "caching_device.h"
-#include "tlb_entry.h"
 #include "tlb_stats.h"
 
 class tlb_t : public caching_device_t {
@@ -49,6 +48,11 @@ protected:
     virtual void
     init_blocks();
 
+    // The process ID of each entry, parallel to tags, to differentiate virtual
+    // pages that have the same VPN but belong to different processes.
+    // XXX: support page privilege and MMU-related exceptions
+    std::vector<memref_pid_t> pids;
+
     // Optimization: remember last pid in addition to last tag
     memref_pid_t last_pid;
 };
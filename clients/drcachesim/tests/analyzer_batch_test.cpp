@@ -0,0 +1,316 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+// Tests that the analysis tools compute the same results whether the trace
+// entries are handed to them one at a time or in batches by analyzer_t.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#ifdef UNIX
+#    include <sys/stat.h>
+#else
+#    include <direct.h>
+#endif
+#include "../analyzer.h"
+#include "../common/directory_iterator.h"
+#include "../common/trace_entry.h"
+#include "../common/utils.h"
+#include "../tools/basic_counts_create.h"
+#include "../tools/histogram_create.h"
+#include "../tools/reuse_distance_create.h"
+
+static const int NUM_THREADS = 3;
+static const int NUM_TOOLS = 3;
+
+// Sets the batch size of a multi-tool analyzer, and whether it runs serially.
+class batch_analyzer_t : public analyzer_t {
+public:
+    batch_analyzer_t(const std::string &trace_path, analysis_tool_t **tools_in,
+                     int num_tools_in, bool parallel_in, size_t batch_size)
+    {
+        tools = tools_in;
+        num_tools = num_tools_in;
+        parallel = parallel_in;
+        worker_count = 2;
+        memref_batch_size = batch_size;
+        for (int i = 0; i < num_tools; ++i) {
+            const std::string error = tools[i]->initialize();
+            if (!error.empty()) {
+                success = false;
+                error_string = "Tool failed to initialize: " + error;
+                return;
+            }
+        }
+        if (!init_file_reader(trace_path))
+            success = false;
+    }
+};
+
+static void
+fail(const std::string &msg)
+{
+    std::cerr << "analyzer_batch_test failed: " << msg << "\n";
+    exit(1);
+}
+
+static void
+write_entry(std::ofstream &file, unsigned short type, unsigned short size, addr_t addr)
+{
+    trace_entry_t entry;
+    entry.type = type;
+    entry.size = size;
+    entry.addr = addr;
+    file.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+}
+
+// Writes one raw file per thread.  Their timestamps interleave, so that a serial
+// reader switches threads at every timestamp.  The runs between the timestamps
+// have different lengths, so that the batches end anywhere in them.
+static void
+write_trace(const std::string &dir)
+{
+    uint32_t seed = 7;
+    for (int t = 0; t < NUM_THREADS; ++t) {
+        std::ofstream file(dir + DIRSEP + "drmemtrace.batch." + std::to_string(t) +
+                               ".raw",
+                           std::ofstream::binary);
+        if (!file)
+            fail("cannot create the trace in " + dir);
+        write_entry(file, TRACE_TYPE_HEADER, 0, TRACE_ENTRY_VERSION);
+        write_entry(file, TRACE_TYPE_THREAD, 0, 100 + t);
+        write_entry(file, TRACE_TYPE_PID, 0, 42);
+        addr_t pc = 0x10000;
+        for (int run = 0; run < 40; ++run) {
+            write_entry(file, TRACE_TYPE_MARKER, TRACE_MARKER_TYPE_TIMESTAMP,
+                        1 + run * NUM_THREADS + t);
+            write_entry(file, TRACE_TYPE_MARKER, TRACE_MARKER_TYPE_CPU_ID, t);
+            int length = 20 + (run * 37 + t * 11) % 90;
+            for (int i = 0; i < length; ++i) {
+                seed = seed * 1103515245 + 12345;
+                uint32_t r = seed >> 8;
+                // Mostly sequential fetches, so that consecutive entries often
+                // hit the same line, with the occasional jump.
+                pc = (r & 31) == 0 ? 0x10000 + (r >> 5) % 0x4000 : pc + 4;
+                write_entry(file, TRACE_TYPE_INSTR, 4, pc);
+                switch ((r >> 20) % 8) {
+                case 0:
+                case 1: write_entry(file, TRACE_TYPE_READ, 8, 0x800000 + r % 64); break;
+                case 2:
+                    write_entry(file, TRACE_TYPE_READ, 8, 0x800000 + r % 0x8000);
+                    break;
+                case 3:
+                    write_entry(file, TRACE_TYPE_WRITE, 4, 0x900000 + r % 0x2000);
+                    break;
+                case 4: write_entry(file, TRACE_TYPE_PREFETCHT0, 1, 0xa00000 + r); break;
+                case 5:
+                    write_entry(file, TRACE_TYPE_MARKER, TRACE_MARKER_TYPE_FUNC_ID,
+                                r % 4);
+                    break;
+                default: break;
+                }
+            }
+        }
+        write_entry(file, TRACE_TYPE_THREAD_EXIT, 0, 100 + t);
+        write_entry(file, TRACE_TYPE_FOOTER, 0, 0);
+    }
+}
+
+static void
+create_tools(analysis_tool_t **tools)
+{
+    reuse_distance_knobs_t knobs;
+    knobs.report_histogram = true;
+    // Small enough for the skip list to be used.
+    knobs.skip_list_distance = 50;
+    tools[0] = basic_counts_tool_create();
+    tools[1] = histogram_tool_create();
+    tools[2] = reuse_distance_tool_create(knobs);
+}
+
+// Returns what the tools print, and deletes them.
+static std::string
+results_of(analysis_tool_t **tools)
+{
+    std::ostringstream results;
+    std::streambuf *cerr_buf = std::cerr.rdbuf(results.rdbuf());
+    for (int i = 0; i < NUM_TOOLS; ++i) {
+        if (!tools[i]->print_results()) {
+            std::cerr.rdbuf(cerr_buf);
+            fail("print_results");
+        }
+    }
+    std::cerr.rdbuf(cerr_buf);
+    for (int i = 0; i < NUM_TOOLS; ++i)
+        delete tools[i];
+    return results.str();
+}
+
+// Hands the entries of the serial trace to process_memref one at a time, and
+// returns them in entries.
+static std::string
+serial_per_entry(const std::string &dir, std::vector<memref_t> &entries)
+{
+    analysis_tool_t *tools[NUM_TOOLS];
+    create_tools(tools);
+    for (int i = 0; i < NUM_TOOLS; ++i) {
+        if (!tools[i]->initialize().empty())
+            fail("initialize");
+    }
+    analyzer_t analyzer(dir);
+    if (!analyzer)
+        fail("cannot open " + dir + ": " + analyzer.get_error_string());
+    for (reader_t &iter = analyzer.begin(); iter != analyzer.end(); ++iter) {
+        entries.push_back(*iter);
+        for (int i = 0; i < NUM_TOOLS; ++i) {
+            if (!tools[i]->process_memref(*iter))
+                fail("process_memref: " + tools[i]->get_error_string());
+        }
+    }
+    return results_of(tools);
+}
+
+// Hands the entries of each thread file to parallel_shard_memref one at a time,
+// with the shard indices the analyzer gives them.  Returns the length of the
+// first shard in first_shard_length.
+static std::string
+parallel_per_entry(const std::string &dir, size_t &first_shard_length)
+{
+    analysis_tool_t *tools[NUM_TOOLS];
+    create_tools(tools);
+    void *worker_data[NUM_TOOLS];
+    for (int i = 0; i < NUM_TOOLS; ++i) {
+        if (!tools[i]->initialize().empty())
+            fail("initialize");
+        worker_data[i] = tools[i]->parallel_worker_init(0);
+    }
+    directory_iterator_t end;
+    directory_iterator_t iter(dir);
+    if (!iter)
+        fail("cannot list " + dir);
+    int index = 0;
+    for (; iter != end; ++iter) {
+        const std::string fname = *iter;
+        if (fname == "." || fname == "..")
+            continue;
+        void *shard_data[NUM_TOOLS];
+        for (int i = 0; i < NUM_TOOLS; ++i)
+            shard_data[i] = tools[i]->parallel_shard_init(index, worker_data[i]);
+        analyzer_t analyzer(dir + DIRSEP + fname);
+        if (!analyzer)
+            fail("cannot open " + fname + ": " + analyzer.get_error_string());
+        size_t length = 0;
+        for (reader_t &shard = analyzer.begin(); shard != analyzer.end(); ++shard) {
+            ++length;
+            for (int i = 0; i < NUM_TOOLS; ++i) {
+                if (!tools[i]->parallel_shard_memref(shard_data[i], *shard))
+                    fail("parallel_shard_memref");
+            }
+        }
+        if (index == 0)
+            first_shard_length = length;
+        for (int i = 0; i < NUM_TOOLS; ++i) {
+            if (!tools[i]->parallel_shard_exit(shard_data[i]))
+                fail("parallel_shard_exit");
+        }
+        ++index;
+    }
+    for (int i = 0; i < NUM_TOOLS; ++i) {
+        if (!tools[i]->parallel_worker_exit(worker_data[i]).empty())
+            fail("parallel_worker_exit");
+    }
+    return results_of(tools);
+}
+
+static std::string
+batched(const std::string &dir, bool parallel, size_t batch_size)
+{
+    analysis_tool_t *tools[NUM_TOOLS];
+    create_tools(tools);
+    batch_analyzer_t analyzer(dir, tools, NUM_TOOLS, parallel, batch_size);
+    if (!analyzer)
+        fail("cannot open " + dir + ": " + analyzer.get_error_string());
+    if (!analyzer.run())
+        fail("run: " + analyzer.get_error_string());
+    return results_of(tools);
+}
+
+int
+main(int argc, const char *argv[])
+{
+    std::string dir = argc > 1 ? argv[1] : "analyzer_batch_test.dir";
+#ifdef UNIX
+    mkdir(dir.c_str(), 0755);
+#else
+    _mkdir(dir.c_str());
+#endif
+    write_trace(dir);
+
+    std::vector<memref_t> entries;
+    const std::string serial_expect = serial_per_entry(dir, entries);
+    // The batch sizes where the first batch ends right before the first thread
+    // switch, and right after the first thread exit.
+    size_t first_switch = 1;
+    while (first_switch < entries.size() &&
+           entries[first_switch].data.tid == entries[0].data.tid)
+        ++first_switch;
+    size_t first_exit = 0;
+    while (first_exit < entries.size() &&
+           entries[first_exit].data.type != TRACE_TYPE_THREAD_EXIT)
+        ++first_exit;
+    if (first_switch >= entries.size() || first_exit >= entries.size() ||
+        entries.back().data.type != TRACE_TYPE_THREAD_EXIT)
+        fail("unexpected trace layout");
+    // The last batch ends at the end of the trace for all sizes; with the
+    // size of the whole trace it is also the only batch.
+    const size_t serial_sizes[] = {
+        1, 2, 7, first_switch, first_exit + 1, entries.size(), 4096
+    };
+    for (size_t size : serial_sizes) {
+        if (batched(dir, false, size) != serial_expect)
+            fail("serial results differ for batches of " + std::to_string(size));
+    }
+
+    size_t shard_length = 0;
+    const std::string parallel_expect = parallel_per_entry(dir, shard_length);
+    const size_t parallel_sizes[] = { 1, 2, 7, shard_length, 4096 };
+    for (size_t size : parallel_sizes) {
+        if (batched(dir, true, size) != parallel_expect)
+            fail("parallel results differ for batches of " + std::to_string(size));
+    }
+    std::cerr << "analyzer_batch_test passed\n";
+    return 0;
+}
@@ -33,7 +33,11 @@
 // Unit tests for drcachesim
 #include <iostream>
 #include <cstdlib>
+#include <stdint.h>
 #include "simulator/cache_simulator.h"
+#include "simulator/cache_fifo.h"
+#include "simulator/cache_lru.h"
+#include "simulator/cache_stats.h"
 #include "../common/memref.h"
 
 static cache_simulator_knobs_t
@@ -135,11 +139,171 @@ unit_test_sim_refs()
     }
 }
 
+// Exposes the counts of a cache_stats_t.
+class test_cache_stats_t : public cache_stats_t {
+public:
+    int_least64_t
+    get_hits() const
+    {
+        return num_hits;
+    }
+    int_least64_t
+    get_misses() const
+    {
+        return num_misses;
+    }
+    int_least64_t
+    get_child_hits() const
+    {
+        return num_child_hits;
+    }
+};
+
+// Counts the replacements of a cache and hashes the ways picked by its policy.
+template <class CACHE> class test_cache_t : public CACHE {
+public:
+    int_least64_t
+    get_replacements() const
+    {
+        return replacements;
+    }
+    // The replacements of valid blocks.
+    int_least64_t
+    get_evictions() const
+    {
+        return replacements - this->loaded_blocks;
+    }
+    uint64_t
+    get_victim_hash() const
+    {
+        return victim_hash;
+    }
+
+protected:
+    int
+    replace_which_way(int block_idx) override
+    {
+        int way = CACHE::replace_which_way(block_idx);
+        ++replacements;
+        victim_hash = (victim_hash ^ (uint64_t)(block_idx + way)) * 0x100000001b3ULL;
+        return way;
+    }
+    int_least64_t replacements = 0;
+    uint64_t victim_hash = 0xcbf29ce484222325ULL;
+};
+
+struct cache_counts_t {
+    int_least64_t hits;
+    int_least64_t misses;
+    int_least64_t evictions;
+    uint64_t victim_hash;
+    int_least64_t ll_hits;
+    int_least64_t ll_misses;
+    int_least64_t ll_evictions;
+};
+
+// Feeds a fixed pseudo-random sequence of reads and writes, some of them
+// spanning several lines, to a 64-line L1 of the given policy and
+// associativity backed by a 256-line LRU LL.
+template <class CACHE>
+static cache_counts_t
+run_cache_sequence(int associativity)
+{
+    const int line_size = 64;
+    test_cache_stats_t ll_stats, l1_stats;
+    test_cache_t<cache_lru_t> ll;
+    test_cache_t<CACHE> l1;
+    // cache_fifo_t::init has no default arguments.
+    if (!ll.init(16, line_size, 256 * line_size, nullptr, &ll_stats, nullptr, false,
+                 false, -1, nullptr, {}) ||
+        !l1.init(associativity, line_size, 64 * line_size, &ll, &l1_stats, nullptr,
+                 false, false, -1, nullptr, {})) {
+        std::cerr << "drcachesim unit_test_cache_counts failed: init\n";
+        exit(1);
+    }
+    uint32_t seed = 42;
+    for (int i = 0; i < 20000; i++) {
+        seed = seed * 1103515245 + 12345;
+        uint32_t r = seed >> 8;
+        memref_t ref;
+        ref.data.type = (r & 3) == 0 ? TRACE_TYPE_WRITE : TRACE_TYPE_READ;
+        ref.data.pid = 1;
+        ref.data.tid = 1;
+        ref.data.pc = 0;
+        // Mostly a hot region of 48 lines, sometimes anywhere in 1024 lines.
+        addr_t line = (r >> 2) % 10 < 7 ? (r >> 6) % 48 : 100 + (r >> 6) % 1024;
+        ref.data.addr = line * line_size + (r >> 16) % line_size;
+        ref.data.size = (r >> 22) % 16 == 0 ? 2 * line_size : 8;
+        l1.request(ref);
+    }
+    cache_counts_t counts = { l1_stats.get_hits(),    l1_stats.get_misses(),
+                              l1.get_evictions(),     l1.get_victim_hash(),
+                              ll_stats.get_hits(),    ll_stats.get_misses(),
+                              ll.get_evictions() };
+    return counts;
+}
+
+static void
+check_cache_counts(const char *policy, int associativity, const cache_counts_t &got,
+                   const cache_counts_t &expect)
+{
+    if (got.hits != expect.hits || got.misses != expect.misses ||
+        got.evictions != expect.evictions || got.victim_hash != expect.victim_hash ||
+        got.ll_hits != expect.ll_hits || got.ll_misses != expect.ll_misses ||
+        got.ll_evictions != expect.ll_evictions) {
+        std::cerr << "drcachesim unit_test_cache_counts failed: " << policy << " "
+                  << associativity << "-way: " << got.hits << " hits, " << got.misses
+                  << " misses, " << got.evictions << " evictions, LL " << got.ll_hits
+                  << " hits, " << got.ll_misses << " misses, " << got.ll_evictions
+                  << " evictions\n";
+        exit(1);
+    }
+}
+
+void
+unit_test_cache_counts()
+{
+    // The counts of the simulator before the tags and counters were stored
+    // as arrays and compared with SIMD: any change of the lookup or of the
+    // replacement decisions shows up here.
+    static const int assocs[] = { 1, 2, 4, 8, 16 };
+    static const cache_counts_t lru[] = {
+        { 16984, 14545, 14481, 0xca9c64f01537e6cfULL, 6743, 7802, 7546 },
+        { 16698, 14831, 14767, 0x1962ce1be93bcd38ULL, 7042, 7789, 7533 },
+        { 16867, 14662, 14598, 0xb57f3e323448263fULL, 6818, 7844, 7588 },
+        { 16840, 14689, 14625, 0x76a9e265aaf0c36eULL, 6838, 7851, 7595 },
+        { 16857, 14672, 14608, 0xb9ee520c58eb6c69ULL, 6842, 7830, 7574 },
+    };
+    static const cache_counts_t fifo[] = {
+        { 16984, 14545, 14481, 0xca9c64f01537e6cfULL, 6743, 7802, 7546 },
+        { 15561, 15968, 15904, 0xf5ff495ecec0f4edULL, 8264, 7704, 7448 },
+        { 15045, 16484, 16420, 0x53bc7d6f4fb9ce33ULL, 8815, 7669, 7413 },
+        { 14627, 16902, 16838, 0x0d5a97a86dbd2be0ULL, 9226, 7676, 7420 },
+        { 14377, 17152, 17088, 0x77222a84b84a0bf4ULL, 9510, 7642, 7386 },
+    };
+    static const cache_counts_t lfu[] = {
+        { 16984, 14545, 14481, 0xca9c64f01537e6cfULL, 6743, 7802, 7546 },
+        { 19347, 12182, 12118, 0x40844da5f6fa823eULL, 4860, 7322, 7066 },
+        { 21988, 9541, 9477, 0xe1d36e4cccc2dea7ULL, 2347, 7194, 6938 },
+        { 22092, 9437, 9373, 0xc9f34025df7af74eULL, 2310, 7127, 6871 },
+        { 22063, 9466, 9402, 0xafc862ab872ba180ULL, 2373, 7093, 6837 },
+    };
+    for (int i = 0; i < 5; i++) {
+        check_cache_counts("LRU", assocs[i], run_cache_sequence<cache_lru_t>(assocs[i]),
+                           lru[i]);
+        check_cache_counts("FIFO", assocs[i],
+                           run_cache_sequence<cache_fifo_t>(assocs[i]), fifo[i]);
+        check_cache_counts("LFU", assocs[i], run_cache_sequence<cache_t>(assocs[i]),
+                           lfu[i]);
+    }
+}
+
 int
 main(int argc, const char *argv[])
 {
     unit_test_warmup_fraction();
     unit_test_warmup_refs();
     unit_test_sim_refs();
+    unit_test_cache_counts();
     return 0;
 }
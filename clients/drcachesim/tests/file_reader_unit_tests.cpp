@@ -0,0 +1,424 @@
+/* **********************************************************
+ * Copyright (c) 2020 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+// Unit tests for the trace file readers.  They write their traces under the
+// directory given as the first argument, by default the current directory.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#ifdef UNIX
+#    include <sys/stat.h>
+#else
+#    include <direct.h>
+#endif
+#include "../common/trace_entry.h"
+#include "../common/utils.h"
+#include "../reader/file_reader.h"
+#ifdef HAS_ZLIB
+#    include "../common/chunked_ostream.h"
+#    include "../reader/chunked_file_reader.h"
+#    include "../reader/compressed_file_reader.h"
+#endif
+#ifdef UNIX
+#    include "../reader/mmap_file_reader.h"
+#endif
+
+static std::string out_dir = ".";
+
+static void
+make_dir(const std::string &path)
+{
+#ifdef UNIX
+    mkdir(path.c_str(), 0755);
+#else
+    _mkdir(path.c_str());
+#endif
+}
+
+static void
+write_entry(std::ostream &file, unsigned short type, unsigned short size, addr_t addr)
+{
+    trace_entry_t entry;
+    entry.type = type;
+    entry.size = size;
+    entry.addr = addr;
+    file.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+}
+
+// Writes the trace of a thread whose timestamps are first_time, first_time + step,
+// and so on, with a fetch and entries_per_time entries of all kinds after each.
+static void
+write_thread_entries(std::ostream &file, memref_tid_t tid, uint64_t first_time,
+                     uint64_t step, int num_times, int entries_per_time)
+{
+    write_entry(file, TRACE_TYPE_HEADER, 0, TRACE_ENTRY_VERSION);
+    write_entry(file, TRACE_TYPE_THREAD, 0, tid);
+    write_entry(file, TRACE_TYPE_PID, 0, 42);
+    uint32_t seed = static_cast<uint32_t>(tid);
+    for (int t = 0; t < num_times; ++t) {
+        write_entry(file, TRACE_TYPE_MARKER, TRACE_MARKER_TYPE_TIMESTAMP,
+                    first_time + t * step);
+        // The data references take their pc from the fetch before them, so
+        // we start with one.
+        write_entry(file, TRACE_TYPE_INSTR, 4, 0x1000 + t % 4096);
+        for (int i = 0; i < entries_per_time; ++i) {
+            seed = seed * 1103515245 + 12345;
+            uint32_t r = seed >> 8;
+            switch (r % 8) {
+            case 0:
+                write_entry(file, TRACE_TYPE_INSTR_CONDITIONAL_JUMP, 2, 0x1000 + r % 64);
+                break;
+            case 1: {
+                // A bundle extends the fetch before it.
+                write_entry(file, TRACE_TYPE_INSTR, 4, 0x1000 + r % 4096);
+                trace_entry_t bundle;
+                bundle.type = TRACE_TYPE_INSTR_BUNDLE;
+                bundle.size = 2;
+                bundle.length[0] = 3;
+                bundle.length[1] = 5;
+                file.write(reinterpret_cast<const char *>(&bundle), sizeof(bundle));
+                break;
+            }
+            case 2: write_entry(file, TRACE_TYPE_READ, 8, 0x800000 + r); break;
+            case 3: write_entry(file, TRACE_TYPE_WRITE, 4, 0x900000 + r); break;
+            case 4:
+                write_entry(file, TRACE_TYPE_MARKER, TRACE_MARKER_TYPE_CPU_ID, r % 8);
+                break;
+            default: write_entry(file, TRACE_TYPE_INSTR, 4, 0x1000 + r % 4096); break;
+            }
+        }
+    }
+    write_entry(file, TRACE_TYPE_THREAD_EXIT, 0, tid);
+    write_entry(file, TRACE_TYPE_FOOTER, 0, 0);
+}
+
+static void
+write_thread(const std::string &path, memref_tid_t tid, uint64_t first_time,
+             uint64_t step, int num_times, int entries_per_time)
+{
+    std::ofstream file(path, std::ofstream::binary);
+    if (!file) {
+        std::cerr << "file_reader_unit_tests failed: cannot create " << path << "\n";
+        exit(1);
+    }
+    write_thread_entries(file, tid, first_time, step, num_times, entries_per_time);
+}
+
+static bool
+same_memref(const memref_t &a, const memref_t &b)
+{
+    if (a.data.type != b.data.type || a.data.pid != b.data.pid ||
+        a.data.tid != b.data.tid)
+        return false;
+    if (a.data.type == TRACE_TYPE_MARKER) {
+        return a.marker.marker_type == b.marker.marker_type &&
+            a.marker.marker_value == b.marker.marker_value;
+    }
+    if (a.data.type == TRACE_TYPE_THREAD_EXIT)
+        return true;
+    if (type_is_instr(a.data.type))
+        return a.instr.addr == b.instr.addr && a.instr.size == b.instr.size;
+    return a.data.addr == b.data.addr && a.data.size == b.data.size &&
+        a.data.pc == b.data.pc;
+}
+
+// Returns all the memrefs of the trace at path.
+template <typename READER>
+static std::vector<memref_t>
+read_all(const std::string &path)
+{
+    READER reader(path);
+    READER end;
+    if (!reader.init()) {
+        std::cerr << "file_reader_unit_tests failed: cannot read " << path << "\n";
+        exit(1);
+    }
+    std::vector<memref_t> memrefs;
+    for (; reader != end; ++reader)
+        memrefs.push_back(*reader);
+    return memrefs;
+}
+
+static void
+check_same_memrefs(const std::string &test, const std::vector<memref_t> &expect,
+                   const std::vector<memref_t> &got)
+{
+    for (size_t i = 0; i < expect.size() && i < got.size(); ++i) {
+        if (!same_memref(expect[i], got[i])) {
+            std::cerr << "file_reader_unit_tests " << test
+                      << " failed: memrefs differ at #" << i << "\n";
+            exit(1);
+        }
+    }
+    if (expect.size() != got.size()) {
+        std::cerr << "file_reader_unit_tests " << test << " failed: " << got.size()
+                  << " memrefs instead of " << expect.size() << "\n";
+        exit(1);
+    }
+}
+
+#ifdef UNIX
+// Exposes the per-thread reads of the mmap reader.
+class test_mmap_file_reader_t : public mmap_file_reader_t {
+public:
+    test_mmap_file_reader_t(const std::string &path)
+        : mmap_file_reader_t(path)
+    {
+    }
+    // Returns how many entries of the thread follow its header, and in eof
+    // whether they ended at the end of the file rather than on an error.
+    size_t
+    count_thread_entries(bool *eof)
+    {
+        size_t count = 0;
+        *eof = false;
+        if (!open_input_files())
+            return 0;
+        while (read_next_thread_entry_in_place(0, eof) != nullptr)
+            ++count;
+        return count;
+    }
+};
+
+void
+unit_test_mmap_reader()
+{
+    const std::string dir = out_dir + DIRSEP + "mmap_reader";
+    make_dir(dir);
+    // One thread is larger than the chunks the reader asks the kernel to read
+    // ahead.
+    const int num_threads = 3;
+    for (int t = 0; t < num_threads; ++t) {
+        write_thread(dir + DIRSEP + "drmemtrace.mmap." + std::to_string(t) + ".raw",
+                     100 + t, 1 + t, num_threads, 40, t == 0 ? 20000 : 500);
+    }
+    const std::string single = dir + DIRSEP + "drmemtrace.mmap.1.raw";
+    for (const std::string &path : { dir, single }) {
+        std::vector<memref_t> expect =
+            read_all<file_reader_t<std::ifstream *>>(path);
+        check_same_memrefs("mmap_reader", expect, read_all<mmap_file_reader_t>(path));
+#    ifdef HAS_ZLIB
+        check_same_memrefs("mmap_reader", expect,
+                           read_all<compressed_file_reader_t>(path));
+#    endif
+    }
+    mmap_file_reader_t complete(single);
+    if (!complete.is_complete()) {
+        std::cerr << "file_reader_unit_tests mmap_reader failed: incomplete trace\n";
+        exit(1);
+    }
+
+    // A partial entry at the end must be an error, not an end of file.
+    const std::string partial = out_dir + DIRSEP + "drmemtrace.partial.raw";
+    write_thread(partial, 200, 1, 1, 3, 10);
+    size_t expect_entries;
+    {
+        test_mmap_file_reader_t reader(partial);
+        bool eof;
+        expect_entries = reader.count_thread_entries(&eof);
+        if (!eof || expect_entries == 0) {
+            std::cerr << "file_reader_unit_tests mmap_reader failed: read error\n";
+            exit(1);
+        }
+    }
+    {
+        std::ofstream file(partial, std::ofstream::binary | std::ofstream::app);
+        file.write("\1\2\3", 3);
+    }
+    test_mmap_file_reader_t reader(partial);
+    bool eof;
+    size_t entries = reader.count_thread_entries(&eof);
+    if (eof || entries != expect_entries) {
+        std::cerr << "file_reader_unit_tests mmap_reader failed: partial entry read "
+                  << "as " << (eof ? "end of file" : "error") << " after " << entries
+                  << " entries\n";
+        exit(1);
+    }
+    mmap_file_reader_t incomplete(partial);
+    if (incomplete.is_complete()) {
+        std::cerr << "file_reader_unit_tests mmap_reader failed: partial trace "
+                  << "complete\n";
+        exit(1);
+    }
+}
+#endif
+
+// The memrefs of a thread from one of its timestamps to the next.
+struct timestamp_run_t {
+    uint64_t timestamp;
+    std::vector<memref_t> memrefs;
+};
+
+static bool
+run_is_earlier(const timestamp_run_t &a, const timestamp_run_t &b)
+{
+    return a.timestamp < b.timestamp;
+}
+
+template <typename READER>
+static void
+check_merge(const std::string &dir, const std::vector<memref_t> &expect)
+{
+    check_same_memrefs("merge", expect, read_all<READER>(dir));
+}
+
+void
+unit_test_merge()
+{
+    const std::string dir = out_dir + DIRSEP + "merge";
+    make_dir(dir);
+    // The timestamps of thread t are t modulo 4, so they never tie, and those of
+    // thread 0 start at 0.  The threads have different numbers of timestamps and
+    // are not evenly spaced, so they interleave irregularly and run out at
+    // different times.
+    const int num_threads = 4;
+    const int num_times[num_threads] = { 30, 11, 50, 5 };
+    std::vector<std::string> paths;
+    for (int t = 0; t < num_threads; ++t) {
+        paths.push_back(dir + DIRSEP + "drmemtrace.merge." + std::to_string(t) +
+                        ".raw");
+        write_thread(paths.back(), 300 + t, t, 4 * (t + 1), num_times[t], 7 + t);
+    }
+    // The expected merge: the runs of each thread, read alone, in timestamp order.
+    std::vector<timestamp_run_t> runs;
+    for (int t = 0; t < num_threads; ++t) {
+        std::vector<memref_t> memrefs =
+            read_all<file_reader_t<std::ifstream *>>(paths[t]);
+        for (const memref_t &memref : memrefs) {
+            if (memref.marker.type == TRACE_TYPE_MARKER &&
+                memref.marker.marker_type == TRACE_MARKER_TYPE_TIMESTAMP) {
+                runs.push_back(timestamp_run_t());
+                runs.back().timestamp = memref.marker.marker_value;
+            }
+            if (runs.empty() || runs.back().timestamp % 4 != static_cast<uint64_t>(t)) {
+                std::cerr << "file_reader_unit_tests merge failed: no timestamp "
+                          << "first in thread " << t << "\n";
+                exit(1);
+            }
+            runs.back().memrefs.push_back(memref);
+        }
+    }
+    std::stable_sort(runs.begin(), runs.end(), run_is_earlier);
+    std::vector<memref_t> expect;
+    for (const timestamp_run_t &run : runs)
+        expect.insert(expect.end(), run.memrefs.begin(), run.memrefs.end());
+    check_merge<file_reader_t<std::ifstream *>>(dir, expect);
+#ifdef UNIX
+    check_merge<mmap_file_reader_t>(dir, expect);
+#endif
+#ifdef HAS_ZLIB
+    check_merge<compressed_file_reader_t>(dir, expect);
+#endif
+}
+
+#ifdef HAS_ZLIB
+void
+unit_test_chunked_reader()
+{
+    // Small chunks, so that the trace has many of them.
+    const std::string plain = out_dir + DIRSEP + "drmemtrace.chunked.raw";
+    const std::string chunked = out_dir + DIRSEP + "drmemtrace.chunked.zc";
+    write_thread(plain, 400, 1, 1, 60, 50);
+    {
+        chunked_ostream_t file(chunked, 64);
+        write_thread_entries(file, 400, 1, 1, 60, 50);
+    }
+    if (!is_chunked_trace_file(chunked) || is_chunked_trace_file(plain)) {
+        std::cerr << "file_reader_unit_tests chunked_reader failed: format\n";
+        exit(1);
+    }
+    const std::vector<memref_t> expect = read_all<file_reader_t<std::ifstream *>>(plain);
+    check_same_memrefs("chunked_reader", expect,
+                       read_all<chunked_file_reader_t>(chunked));
+    chunked_file_reader_t complete(chunked);
+    if (!complete.is_complete()) {
+        std::cerr << "file_reader_unit_tests chunked_reader failed: incomplete\n";
+        exit(1);
+    }
+
+    // Seek to instructions at the start, in the middle and at the end of
+    // chunks, in any order, and check the memrefs from there.
+    std::vector<size_t> instrs;
+    for (size_t i = 0; i < expect.size(); ++i) {
+        if (type_is_instr(expect[i].instr.type))
+            instrs.push_back(i);
+    }
+    chunked_file_reader_t reader(chunked);
+    chunked_file_reader_t end;
+    if (!reader.init()) {
+        std::cerr << "file_reader_unit_tests chunked_reader failed: init\n";
+        exit(1);
+    }
+    const uint64_t targets[] = {
+        instrs.size() / 2, 0, 1, 63, 64, 65, instrs.size() - 1, 17, instrs.size() / 3
+    };
+    for (uint64_t target : targets) {
+        if (!reader.seek_to_instruction(target)) {
+            std::cerr << "file_reader_unit_tests chunked_reader failed: seek to "
+                      << target << "\n";
+            exit(1);
+        }
+        for (size_t i = instrs[target]; i < expect.size() && i < instrs[target] + 200;
+             ++i, ++reader) {
+            if (!(reader != end) || !same_memref(expect[i], *reader)) {
+                std::cerr << "file_reader_unit_tests chunked_reader failed: memref #"
+                          << i << " after seeking to " << target << "\n";
+                exit(1);
+            }
+        }
+    }
+    if (reader.seek_to_instruction(instrs.size())) {
+        std::cerr << "file_reader_unit_tests chunked_reader failed: seek past end\n";
+        exit(1);
+    }
+}
+#endif
+
+int
+main(int argc, const char *argv[])
+{
+    if (argc > 1)
+        out_dir = argv[1];
+#ifdef UNIX
+    unit_test_mmap_reader();
+#endif
+    unit_test_merge();
+#ifdef HAS_ZLIB
+    unit_test_chunked_reader();
+#endif
+    return 0;
+}
@@ -88,10 +88,9 @@ basic_counts_t::parallel_shard_error(void *shard_data)
     return counters->error;
 }
 
-bool
-basic_counts_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
+inline void
+basic_counts_t::count_memref(counters_t *counters, const memref_t &memref)
 {
-    counters_t *counters = reinterpret_cast<counters_t *>(shard_data);
     if (type_is_instr(memref.instr.type)) {
         ++counters->instrs;
     } else if (memref.data.type == TRACE_TYPE_INSTR_NO_FETCH) {
@@ -121,22 +120,56 @@ basic_counts_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
     } else if (memref.data.type == TRACE_TYPE_THREAD_EXIT) {
         counters->tid = memref.exit.tid;
     }
+}
+
+bool
+basic_counts_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
+{
+    count_memref(reinterpret_cast<counters_t *>(shard_data), memref);
     return true;
 }
 
+bool
+basic_counts_t::parallel_shard_memref_batch(void *shard_data, const memref_t *memrefs,
+                                            size_t count)
+{
+    counters_t *counters = reinterpret_cast<counters_t *>(shard_data);
+    for (size_t i = 0; i < count; ++i)
+        count_memref(counters, memrefs[i]);
+    return true;
+}
+
+basic_counts_t::counters_t *
+basic_counts_t::get_serial_counters(memref_tid_t tid)
+{
+    const auto &lookup = shard_map.find(tid);
+    if (lookup != shard_map.end())
+        return lookup->second;
+    counters_t *counters = new counters_t;
+    shard_map[tid] = counters;
+    return counters;
+}
+
 bool
 basic_counts_t::process_memref(const memref_t &memref)
 {
-    counters_t *counters;
-    const auto &lookup = shard_map.find(memref.data.tid);
-    if (lookup == shard_map.end()) {
-        counters = new counters_t;
-        shard_map[memref.data.tid] = counters;
-    } else
-        counters = lookup->second;
-    if (!parallel_shard_memref(reinterpret_cast<void *>(counters), memref)) {
-        error_string = counters->error;
-        return false;
+    count_memref(get_serial_counters(memref.data.tid), memref);
+    return true;
+}
+
+bool
+basic_counts_t::process_memref_batch(const memref_t *memrefs, size_t count)
+{
+    // The entries of a thread come in runs: only look up the counters when the
+    // thread changes.
+    memref_tid_t tid = 0;
+    counters_t *counters = nullptr;
+    for (size_t i = 0; i < count; ++i) {
+        if (counters == nullptr || memrefs[i].data.tid != tid) {
+            tid = memrefs[i].data.tid;
+            counters = get_serial_counters(tid);
+        }
+        count_memref(counters, memrefs[i]);
     }
     return true;
 }
@@ -145,7 +178,10 @@ bool
 basic_counts_t::cmp_counters(const std::pair<memref_tid_t, counters_t *> &l,
                              const std::pair<memref_tid_t, counters_t *> &r)
 {
-    return (l.second->instrs > r.second->instrs);
+    // Ties are broken by key: the shard map is unordered.
+    if (l.second->instrs != r.second->instrs)
+        return (l.second->instrs > r.second->instrs);
+    return l.first < r.first;
 }
 
 bool
@@ -46,6 +46,8 @@ public:
     bool
     process_memref(const memref_t &memref) override;
     bool
+    process_memref_batch(const memref_t *memrefs, size_t count) override;
+    bool
     print_results() override;
     bool
     parallel_shard_supported() override;
@@ -55,6 +57,9 @@ public:
     parallel_shard_exit(void *shard_data) override;
     bool
     parallel_shard_memref(void *shard_data, const memref_t &memref) override;
+    bool
+    parallel_shard_memref_batch(void *shard_data, const memref_t *memrefs,
+                                size_t count) override;
     std::string
     parallel_shard_error(void *shard_data) override;
 
@@ -95,6 +100,10 @@ protected:
         int_least64_t other_markers = 0;
         std::string error;
     };
+    static void
+    count_memref(counters_t *counters, const memref_t &memref);
+    counters_t *
+    get_serial_counters(memref_tid_t tid);
     static bool
     cmp_counters(const std::pair<memref_tid_t, counters_t *> &l,
                  const std::pair<memref_tid_t, counters_t *> &r);
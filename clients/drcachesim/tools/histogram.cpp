@@ -111,6 +111,40 @@ histogram_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
     return true;
 }
 
+bool
+histogram_t::parallel_shard_memref_batch(void *shard_data, const memref_t *memrefs,
+                                         size_t count)
+{
+    shard_data_t *shard = reinterpret_cast<shard_data_t *>(shard_data);
+    // Consecutive entries often hit the same line, in particular instruction
+    // fetches: remember the counter of the last line of each map to skip the hash
+    // lookup.  Map values are not moved by rehashing, so the pointers stay valid.
+    addr_t last_iline = 0, last_dline = 0;
+    uint64_t *last_icount = nullptr, *last_dcount = nullptr;
+    for (size_t i = 0; i < count; ++i) {
+        const memref_t &memref = memrefs[i];
+        if (type_is_instr(memref.instr.type) ||
+            memref.instr.type == TRACE_TYPE_PREFETCH_INSTR) {
+            addr_t line = memref.instr.addr >> line_size_bits;
+            if (last_icount == nullptr || line != last_iline) {
+                last_iline = line;
+                last_icount = &shard->icache_map[line];
+            }
+            ++*last_icount;
+        } else if (memref.data.type == TRACE_TYPE_READ ||
+                   memref.data.type == TRACE_TYPE_WRITE ||
+                   type_is_prefetch(memref.data.type)) {
+            addr_t line = memref.data.addr >> line_size_bits;
+            if (last_dcount == nullptr || line != last_dline) {
+                last_dline = line;
+                last_dcount = &shard->dcache_map[line];
+            }
+            ++*last_dcount;
+        }
+    }
+    return true;
+}
+
 std::string
 histogram_t::parallel_shard_error(void *shard_data)
 {
@@ -128,10 +162,25 @@ histogram_t::process_memref(const memref_t &memref)
     return true;
 }
 
+bool
+histogram_t::process_memref_batch(const memref_t *memrefs, size_t count)
+{
+    if (!parallel_shard_memref_batch(reinterpret_cast<void *>(&serial_shard), memrefs,
+                                     count)) {
+        error_string = serial_shard.error;
+        return false;
+    }
+    return true;
+}
+
 bool
 cmp(const std::pair<addr_t, uint64_t> &l, const std::pair<addr_t, uint64_t> &r)
 {
-    return l.second > r.second;
+    // Ties are broken by address: the order of the maps depends on the order the
+    // shards were merged in.
+    if (l.second != r.second)
+        return l.second > r.second;
+    return l.first < r.first;
 }
 
 bool
@@ -50,6 +50,8 @@ public:
     bool
     process_memref(const memref_t &memref) override;
     bool
+    process_memref_batch(const memref_t *memrefs, size_t count) override;
+    bool
     print_results() override;
     bool
     parallel_shard_supported() override;
@@ -63,6 +65,9 @@ public:
     parallel_shard_exit(void *shard_data) override;
     bool
     parallel_shard_memref(void *shard_data, const memref_t &memref) override;
+    bool
+    parallel_shard_memref_batch(void *shard_data, const memref_t *memrefs,
+                                size_t count) override;
     std::string
     parallel_shard_error(void *shard_data) override;
 
@@ -102,10 +102,19 @@ reuse_distance_t::parallel_shard_error(void *shard_data)
     return shard->error;
 }
 
-bool
-reuse_distance_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
+static inline bool
+is_line_ref(const memref_t &memref)
+{
+    return type_is_instr(memref.instr.type) || memref.data.type == TRACE_TYPE_READ ||
+        memref.data.type == TRACE_TYPE_WRITE ||
+        // We may potentially handle prefetches differently.
+        // TRACE_TYPE_PREFETCH_INSTR is handled above.
+        type_is_prefetch(memref.data.type);
+}
+
+inline void
+reuse_distance_t::handle_memref(shard_data_t *shard, const memref_t &memref)
 {
-    shard_data_t *shard = reinterpret_cast<shard_data_t *>(shard_data);
     if (DEBUG_VERBOSE(3)) {
         std::cerr << " ::" << memref.data.pid << "." << memref.data.tid
                   << ":: " << trace_type_names[memref.data.type];
@@ -119,13 +128,9 @@ reuse_distance_t::parallel_shard_memref(void *shard_data, const memref_t &memref
     }
     if (memref.data.type == TRACE_TYPE_THREAD_EXIT) {
         shard->tid = memref.exit.tid;
-        return true;
+        return;
     }
-    if (type_is_instr(memref.instr.type) || memref.data.type == TRACE_TYPE_READ ||
-        memref.data.type == TRACE_TYPE_WRITE ||
-        // We may potentially handle prefetches differently.
-        // TRACE_TYPE_PREFETCH_INSTR is handled above.
-        type_is_prefetch(memref.data.type)) {
+    if (is_line_ref(memref)) {
         ++shard->total_refs;
         addr_t tag = memref.data.addr >> line_size_bits;
         std::unordered_map<addr_t, line_ref_t *>::iterator it =
@@ -149,24 +154,74 @@ reuse_distance_t::parallel_shard_memref(void *shard_data, const memref_t &memref
             }
         }
     }
+}
+
+bool
+reuse_distance_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
+{
+    handle_memref(reinterpret_cast<shard_data_t *>(shard_data), memref);
     return true;
 }
 
 bool
-reuse_distance_t::process_memref(const memref_t &memref)
+reuse_distance_t::parallel_shard_memref_batch(void *shard_data, const memref_t *memrefs,
+                                              size_t count)
+{
+    shard_data_t *shard = reinterpret_cast<shard_data_t *>(shard_data);
+    int_least64_t *zero_dist = nullptr;
+    for (size_t i = 0; i < count; ++i) {
+        const memref_t &memref = memrefs[i];
+        line_ref_t *head = shard->ref_list->head;
+        // Optimization: the head of the list is the line referenced last, so a
+        // reference to it has a distance of 0 and leaves the list unchanged.
+        // We skip the map lookups for these, as for the repeated fetches of
+        // the instructions of a line.
+        if (!DEBUG_VERBOSE(3) && head != NULL && is_line_ref(memref) &&
+            (memref.data.addr >> line_size_bits) == head->tag) {
+            ++shard->total_refs;
+            ++head->total_refs;
+            if (zero_dist == nullptr)
+                zero_dist = &shard->dist_map[0];
+            ++*zero_dist;
+            continue;
+        }
+        handle_memref(shard, memref);
+    }
+    return true;
+}
+
+reuse_distance_t::shard_data_t *
+reuse_distance_t::get_serial_shard(memref_tid_t tid)
 {
     // For serial operation we index using the tid.
-    shard_data_t *shard;
-    const auto &lookup = shard_map.find(memref.data.tid);
-    if (lookup == shard_map.end()) {
-        shard = new shard_data_t(knobs.distance_threshold, knobs.skip_list_distance,
-                                 knobs.verify_skip);
-        shard_map[memref.data.tid] = shard;
-    } else
-        shard = lookup->second;
-    if (!parallel_shard_memref(reinterpret_cast<void *>(shard), memref)) {
-        error_string = shard->error;
-        return false;
+    const auto &lookup = shard_map.find(tid);
+    if (lookup != shard_map.end())
+        return lookup->second;
+    shard_data_t *shard = new shard_data_t(
+        knobs.distance_threshold, knobs.skip_list_distance, knobs.verify_skip);
+    shard_map[tid] = shard;
+    return shard;
+}
+
+bool
+reuse_distance_t::process_memref(const memref_t &memref)
+{
+    handle_memref(get_serial_shard(memref.data.tid), memref);
+    return true;
+}
+
+bool
+reuse_distance_t::process_memref_batch(const memref_t *memrefs, size_t count)
+{
+    // The entries of a thread come in runs: hand each run to the shard batch
+    // routine, only looking up the shard when the thread changes.
+    size_t start = 0;
+    for (size_t i = 1; i <= count; ++i) {
+        if (i == count || memrefs[i].data.tid != memrefs[start].data.tid) {
+            parallel_shard_memref_batch(get_serial_shard(memrefs[start].data.tid),
+                                        memrefs + start, i - start);
+            start = i;
+        }
     }
     return true;
 }
@@ -66,6 +66,8 @@ public:
     bool
     process_memref(const memref_t &memref) override;
     bool
+    process_memref_batch(const memref_t *memrefs, size_t count) override;
+    bool
     print_results() override;
     bool
     parallel_shard_supported() override;
@@ -75,6 +77,9 @@ public:
     parallel_shard_exit(void *shard_data) override;
     bool
     parallel_shard_memref(void *shard_data, const memref_t &memref) override;
+    bool
+    parallel_shard_memref_batch(void *shard_data, const memref_t *memrefs,
+                                size_t count) override;
     std::string
     parallel_shard_error(void *shard_data) override;
 
@@ -100,6 +105,11 @@ protected:
         std::string error;
     };
 
+    void
+    handle_memref(shard_data_t *shard, const memref_t &memref);
+    shard_data_t *
+    get_serial_shard(memref_tid_t tid);
+
     void
     print_shard_results(const shard_data_t *shard);
 
@@ -58,6 +58,7 @@
 #define TRACE_SUBDIR "trace"
 #ifdef HAS_ZLIB
 #    define TRACE_SUFFIX "trace.gz"
+#    define CHUNKED_TRACE_SUFFIX "trace.zc"
 #else
 #    define TRACE_SUFFIX "trace"
 #endif
@@ -49,6 +49,7 @@
 #    include <windows.h>
 #endif
 #ifdef HAS_ZLIB
+#    include "common/chunked_ostream.h"
 #    include "common/gzip_ostream.h"
 #endif
 
@@ -130,13 +131,21 @@ raw2trace_directory_t::open_thread_log_file(const char *basename)
                     basename_pre_suffix - 1 - basename, basename) <= 0) {
         return "Failed to compute output name for file " + std::string(basename);
     }
+    const char *suffix = TRACE_SUFFIX;
+#ifdef HAS_ZLIB
+    if (chunked)
+        suffix = CHUNKED_TRACE_SUFFIX;
+#endif
     if (dr_snprintf(path, BUFFER_SIZE_ELEMENTS(path), "%s%s%s.%s", outdir.c_str(), DIRSEP,
-                    outname, TRACE_SUFFIX) <= 0) {
+                    outname, suffix) <= 0) {
         return "Failed to compute full path of output file for " + std::string(basename);
     }
     std::ostream *ofile;
 #ifdef HAS_ZLIB
-    ofile = new gzip_ostream_t(path);
+    if (chunked)
+        ofile = new chunked_ostream_t(path);
+    else
+        ofile = new gzip_ostream_t(path);
 #else
     ofile = new std::ofstream(path, std::ofstream::binary);
 #endif
@@ -202,10 +211,15 @@ raw2trace_directory_t::tracedir_from_rawdir(const std::string &rawdir_in)
 
 std::string
 raw2trace_directory_t::initialize(const std::string &indir_in,
-                                  const std::string &outdir_in)
+                                  const std::string &outdir_in, bool chunked_in)
 {
     indir = indir_in;
     outdir = outdir_in;
+    chunked = chunked_in;
+#ifndef HAS_ZLIB
+    if (chunked)
+        return "Chunked output requires zlib";
+#endif
 #ifdef WINDOWS
     // Canonicalize.
     std::replace(indir.begin(), indir.end(), ALT_DIRSEP[0], DIRSEP[0]);
@@ -52,9 +52,12 @@ public:
     ~raw2trace_directory_t();
 
     // If outdir.empty() then a peer of indir's OUTFILE_SUBDIR named TRACE_SUBDIR
-    // is used by default.  Returns "" on success or an error message on failure.
+    // is used by default.  If chunked is set, the output files are written in the
+    // seekable chunked format, which requires zlib.  Returns "" on success or an
+    // error message on failure.
     std::string
-    initialize(const std::string &indir, const std::string &outdir);
+    initialize(const std::string &indir, const std::string &outdir,
+               bool chunked = false);
     // Use this instead of initialize() to only fill in modfile_bytes, for
     // constructing a module_mapper_t.  Returns "" on success or an error message on
     // failure.
@@ -78,6 +81,7 @@ private:
     file_t modfile;
     std::string indir;
     std::string outdir;
+    bool chunked = false;
     unsigned int verbosity;
 };
 
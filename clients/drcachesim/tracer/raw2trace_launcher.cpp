@@ -65,6 +65,14 @@ static droption_t<int>
             "disables concurrency and uses  single thread to perform all operations.  A "
             "negative value sets the job count to the number of hardware threads.");
 
+static droption_t<bool> op_chunked(
+    DROPTION_SCOPE_FRONTEND, "chunked", false, "Write seekable chunked trace files",
+    "By default, each output file is a single gzip stream.  If this option is enabled, "
+    "each output file is split into chunks compressed independently, followed by an "
+    "index of the chunks.  The analyzer decompresses the chunks of such files in "
+    "parallel, and can seek to an instruction without decompressing the chunks "
+    "before it.  Requires zlib.");
+
 #define FATAL_ERROR(msg, ...)                               \
     do {                                                    \
         fprintf(stderr, "ERROR: " msg "\n", ##__VA_ARGS__); \
@@ -90,7 +98,8 @@ _tmain(int argc, const TCHAR *targv[])
     }
 
     raw2trace_directory_t dir(op_verbose.get_value());
-    std::string dir_err = dir.initialize(op_indir.get_value(), op_outdir.get_value());
+    std::string dir_err = dir.initialize(op_indir.get_value(), op_outdir.get_value(),
+                                        op_chunked.get_value());
     if (!dir_err.empty())
         FATAL_ERROR("Directory parsing failed: %s", dir_err.c_str());
     raw2trace_t raw2trace(dir.modfile_bytes, dir.in_files, dir.out_files, NULL,